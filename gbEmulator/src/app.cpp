@@ -3,26 +3,33 @@
 App::App()
 {
     initWindow();
-	gb = std::make_unique<GameBoy>(window);
+	gb = std::make_unique<GameBoy>();
+
+    input.loadBindings("keybindings.cfg");
+
+    // create shader program, vao, and display texture
+    renderingManager = std::make_unique<RenderingManager>(*this);
+    renderingManager->init(window);
+}
+
+App::~App()
+{
+    emuThread.stop();
 }
 
 void App::restart()
 {
-	std::string rom = gb->filePath;
-    std::string saveFilePath;
-    
-    if (!gb->loadSaveRequested)
-        saveFilePath = "";
-    else
-        saveFilePath = gb->saveFilePath;
+    // the emulation thread already exited, rebuild the emulator with the requested rom/save and start it again
+    emuThread.stop();
+
+    std::string rom = emuThread.restartRomPath;
+    std::string saveFilePath = emuThread.restartSavePath;
 
-    gb = std::make_unique<GameBoy>(window);
+    gb = std::make_unique<GameBoy>();
+    gb->saveFilePath = saveFilePath;
     gb->readRom(rom, saveFilePath);
-   
-    if (!gb->run() && !glfwWindowShouldClose(window))
-    {
-        restart();
-    };
+
+    emuThread.start(*gb);
 }
 
 void App::initWindow()
@@ -56,6 +63,16 @@ void App::initWindow()
     {
         static_cast<App*>(glfwGetWindowUserPointer(win))->onResize(width, height);
     });
+    // installed before ImGui's so its glfw backend chains to it
+    glfwSetKeyCallback(window, [](GLFWwindow* win, int key, int scancode, int action, int mods)
+    {
+        static_cast<App*>(glfwGetWindowUserPointer(win))->input.onKey(key, action, mods);
+    });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow* win)
+    {
+        // the window contents were damaged (uncovered, restored...), redraw even if the frame didn't change
+        static_cast<App*>(glfwGetWindowUserPointer(win))->renderingManager->forceRedraw = true;
+    });
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
@@ -75,6 +92,9 @@ void App::initWindow()
 
 void App::onClose()
 {
+    // stop the emulation thread first so the save file is written from a consistent state
+    emuThread.stop();
+
     if (gb->mmu.cartHasBattery)
     {
         gb->saveGame();
@@ -84,6 +104,7 @@ void App::onClose()
 void App::onResize(int width, int height)
 {
     glViewport(0, 0, width, height - 19);
+    renderingManager->forceRedraw = true;
 }
 
 void App::run(std::string rom)
@@ -93,10 +114,48 @@ void App::run(std::string rom)
         gb->readRom(rom, "");
     }
 
-    if (!gb->run() && !glfwWindowShouldClose(window))
+    emuThread.start(*gb);
+
+    double lastFrameTime = 0;
+
+    while (!glfwWindowShouldClose(window))
     {
-        restart();
-    };
+        // the ui runs at 60 Hz on its own, sleeping in the event wait instead of spinning until the next frame is due
+        double currentTime = glfwGetTime();
+        double timeUntilNextFrame = (lastFrameTime + 1.0 / 60.0) - currentTime;
+
+        if (timeUntilNextFrame > 0)
+        {
+            glfwWaitEventsTimeout(timeUntilNextFrame);
+            continue;
+        }
+
+        lastFrameTime = currentTime;
+
+        glfwPollEvents();
+
+        // whatever didn't fit in the queues to the emulation thread last time
+        input.flushButtons();
+        emuThread.flushCommands();
+
+        if (emuThread.restartPending())
+        {
+            restart();
+        }
+
+        bool frameChanged = gb->validRomLoaded && renderingManager->uploadFrame(gb->ppu.frameBuffer);
+
+        // nothing changed on screen since the last redraw (paused game, static menu...): keep showing what's there
+        if (renderingManager->needsRedraw(frameChanged))
+        {
+            renderingManager->redraw(gb->validRomLoaded);
+            glfwSwapBuffers(window);
+        }
+    }
+
+    emuThread.stop();
+    renderingManager->terminateUI();
+    renderingManager.reset();
 
     glfwTerminate();
-}
\ No newline at end of file
+}
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
 #include "gb.h"
+#include "emuThread.h"
+#include "input.h"
+#include "renderingManager.h"
 
 class App
 {
 public:
 	App();
+	~App();
 
 	const unsigned int SCR_WIDTH = 320;
 	const unsigned int SCR_HEIGHT = 308;
@@ -18,4 +25,7 @@ public:
 
 	GLFWwindow* window;
 	std::unique_ptr<GameBoy> gb;
-};
\ No newline at end of file
+	std::unique_ptr<RenderingManager> renderingManager;
+	EmuThread emuThread;
+	InputManager input{ emuThread };
+};
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+#include "batchRunner.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// the cpus this process may run on (taskset, cgroups, job objects), empty where that can't be asked
+static std::vector<unsigned int> allowedCores()
+{
+	std::vector<unsigned int> cores;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &set))
+				cores.push_back(cpu);
+		}
+	}
+#elif defined(_WIN32)
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+	{
+		for (unsigned int cpu = 0; cpu < sizeof(DWORD_PTR) * 8; cpu++)
+		{
+			if (processMask & ((DWORD_PTR)1 << cpu))
+				cores.push_back(cpu);
+		}
+	}
+#endif
+	return cores;
+}
+
+static bool pinToCore(std::thread& thread, unsigned int core)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+	return SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << core) != 0;
+#else
+	// no hard affinity on macos, the scheduler places the threads
+	(void)thread;
+	(void)core;
+	return true;
+#endif
+}
+
+BatchRunner::BatchRunner(size_t instances, unsigned int threads, bool pinThreads)
+	: count(instances),
+	  stride((sizeof(GameBoy) + 63) & ~(size_t)63)
+{
+	std::vector<unsigned int> allowed = allowedCores();
+	unsigned int cores = allowed.empty() ? std::max(1u, std::thread::hardware_concurrency())
+		: (unsigned int)allowed.size();
+	workerCount = threads ? threads : cores;
+	// a worker without a share of its own would only ever steal
+	workerCount = (unsigned int)std::clamp<size_t>(workerCount, 1, std::max<size_t>(count, 1));
+
+	storage = (uint8_t*)::operator new(stride * count, std::align_val_t(64));
+	frameData = (uint8_t*)::operator new(LCD_SIZE * count, std::align_val_t(64));
+	std::memset(frameData, 0, LCD_SIZE * count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		GameBoy* gb = new (storage + i * stride) GameBoy();
+
+		// the ppu keeps drawing into this instance's slot of frameData instead of handing frames over
+		gb->ppu.publishFrames = false;
+		gb->ppu.LCD = frameData + i * LCD_SIZE;
+	}
+
+	workers = std::make_unique<Worker[]>(workerCount);
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		Worker& worker = workers[i];
+		worker.begin = count * i / workerCount;
+		worker.end = count * (i + 1) / workerCount;
+		worker.next = worker.end;
+		worker.thread = std::thread(&BatchRunner::work, this, i);
+
+		// only onto the cpus the process is allowed on, a worker that can't be pinned just runs unpinned
+		if (pinThreads && !allowed.empty() && !pinToCore(worker.thread, allowed[i % allowed.size()]))
+			std::cout << "batch runner: can't pin worker " << i << " to cpu " << allowed[i % allowed.size()] << "\n";
+	}
+}
+
+BatchRunner::~BatchRunner()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers[i].thread.join();
+
+	for (size_t i = 0; i < count; i++)
+		instance(i).~GameBoy();
+
+	::operator delete(storage, std::align_val_t(64));
+	::operator delete(frameData, std::align_val_t(64));
+}
+
+bool BatchRunner::loadRom(const uint8_t* data, size_t size)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		// the cartridge info is printed once, not for every instance
+		std::streambuf* coutBuffer = i > 0 ? std::cout.rdbuf(nullptr) : nullptr;
+		bool loaded = instance(i).loadRom(data, size);
+		if (i > 0)
+			std::cout.rdbuf(coutBuffer);
+
+		if (!loaded)
+			return false;
+	}
+
+	return true;
+}
+
+StridedView BatchRunner::fieldView(uint8_t* field, size_t size)
+{
+	return { field, stride, size, count };
+}
+
+void BatchRunner::stepFrame()
+{
+	forEach([this](size_t i) { instance(i).runFrame(); });
+}
+
+void BatchRunner::forEach(const std::function<void(size_t)>& job)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	this->job = &job;
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers[i].next.store(workers[i].begin, std::memory_order_relaxed);
+
+	running = workerCount;
+	generation++;
+	wake.notify_all();
+
+	done.wait(lock, [&]() { return running == 0; });
+}
+
+// claims instances of worker's share one at a time until there are none left. The owner and thieves all go through
+// the same counter, overshooting end is harmless since it is reset every frame.
+void BatchRunner::runShare(Worker& worker)
+{
+	while (true)
+	{
+		size_t i = worker.next.fetch_add(1, std::memory_order_relaxed);
+		if (i >= worker.end)
+			return;
+
+		(*job)(i);
+	}
+}
+
+void BatchRunner::work(unsigned int index)
+{
+	uint64_t seen = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return stopping || generation != seen; });
+
+			if (stopping)
+				return;
+
+			seen = generation;
+		}
+
+		runShare(workers[index]);
+
+		// then steal, starting from the next worker so the thieves spread out
+		for (unsigned int i = 1; i < workerCount; i++)
+			runShare(workers[(index + i) % workerCount]);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--running == 0)
+			done.notify_one();
+	}
+}
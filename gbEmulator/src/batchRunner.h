@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "gb.h"
+
+// count arrays of size bytes each, array i starts at data + i * stride
+struct StridedView
+{
+	uint8_t* data;
+	size_t stride;
+	size_t size;
+	size_t count;
+
+	uint8_t* operator[](size_t i) const { return data + i * stride; }
+};
+
+// Runs many headless GameBoys of the same rom side by side, for automated playtesting. stepFrame runs one frame of
+// every instance on a pool of worker threads, each pinned to its own core. A worker starts with its own contiguous
+// share of the instances and steals single instances from the others when it runs out, so an instance that takes
+// longer (lcd off, more sprites) doesn't hold its whole share back.
+//
+// The instances live in one allocation, each one 64 byte aligned so neighbours never share a cache line, and every
+// ppu draws straight into one contiguous array of frames. Frames and ram are exposed as strided views into those,
+// nothing is copied. The views are valid between stepFrame calls, during one the frames are being drawn.
+class BatchRunner
+{
+public:
+	// threads 0 uses every cpu the process is allowed to run on. pinThreads sets each worker's affinity to one of
+	// those cpus, a worker that can't be pinned is reported and runs unpinned.
+	BatchRunner(size_t instances, unsigned int threads = 0, bool pinThreads = true);
+	~BatchRunner();
+
+	BatchRunner(const BatchRunner&) = delete;
+	BatchRunner& operator=(const BatchRunner&) = delete;
+
+	// loads the rom image into every instance, false if the core rejects it
+	bool loadRom(const uint8_t* data, size_t size);
+
+	size_t size() const { return count; }
+	unsigned int threads() const { return workerCount; }
+	GameBoy& instance(size_t i) { return *(GameBoy*)(storage + i * stride); }
+
+	// JOYPAD_* bits held by instance i from the next frame on
+	void setButtons(size_t i, uint8_t buttons) { instance(i).setButtons(buttons); }
+
+	// runs one frame of every instance and returns once all of them are done
+	void stepFrame();
+
+	// calls job(i) for every instance index on the workers, same scheduling as stepFrame. Each index is handed to
+	// exactly one worker, so job can touch instance i and anything else that belongs to i without locking.
+	void forEach(const std::function<void(size_t)>& job);
+
+	// LCD_WIDTH * LCD_HEIGHT shade values per instance, the frame the last stepFrame finished
+	StridedView frames() const { return { frameData, LCD_SIZE, LCD_SIZE, count }; }
+	StridedView workRam() { return fieldView(instance(0).mmu.wRam, sizeof(MMUState::wRam)); }
+	StridedView highRam() { return fieldView(instance(0).mmu.hRam, sizeof(MMUState::hRam)); }
+
+private:
+	struct alignas(64) Worker
+	{
+		std::thread thread;
+		// next instance of this worker's share nobody has claimed yet, other workers steal from here too
+		std::atomic<size_t> next = 0;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+
+	StridedView fieldView(uint8_t* field, size_t size);
+
+	void work(unsigned int index);
+	void runShare(Worker& worker);
+
+	size_t count;
+	size_t stride;
+	uint8_t* storage = nullptr;
+	uint8_t* frameData = nullptr;
+
+	std::unique_ptr<Worker[]> workers;
+	unsigned int workerCount;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(size_t)>* job = nullptr;
+	uint64_t generation = 0;
+	unsigned int running = 0;
+	bool stopping = false;
+};
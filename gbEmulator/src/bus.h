@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "mmu.h"
+#include "ppu.h"
+
+// kind of bus access in an m-cycle
+#define BUS_IDLE  0
+#define BUS_READ  1
+#define BUS_WRITE 2
+
+// The cpu reaches memory through a Bus, given to CPU as a template parameter so every call below inlines. A bus has
+//   uint8_t read(uint16_t address) and void write(uint16_t address, uint8_t value), the memory itself
+//   void access(uint16_t address, uint8_t value, uint8_t type), called once per m-cycle with what was on the bus
+//   static constexpr bool hasPeripherals, when true the bus also has mmu and ppu members, and the cpu ticks the
+//   timers, dma, serial, rtc and ppu every m-cycle and dispatches interrupts. When false only the cpu runs.
+
+// the real memory map, used by GameBoy
+struct SystemBus
+{
+	static constexpr bool hasPeripherals = true;
+
+	MMU& mmu;
+	PPU& ppu;
+
+	uint8_t read(uint16_t address) { return mmu.read8(address); }
+	void write(uint16_t address, uint8_t value) { mmu.write8(address, value); }
+	void access(uint16_t, uint8_t, uint8_t) {}
+};
+
+// flat 64 KiB of ram with nothing mapped, which is what the sm83 instruction tests assume. The accesses of the
+// current instruction are logged so they can be checked against the vectors' cycle lists, clear logSize between them.
+struct FlatTestBus
+{
+	static constexpr bool hasPeripherals = false;
+
+	struct Cycle
+	{
+		uint16_t address;
+		uint8_t value;
+		uint8_t type; // BUS_*
+	};
+
+	uint8_t memory[0x10000]{};
+
+	Cycle log[16];
+	unsigned int logSize = 0;
+
+	uint8_t read(uint16_t address) { return memory[address]; }
+	void write(uint16_t address, uint8_t value) { memory[address] = value; }
+
+	void access(uint16_t address, uint8_t value, uint8_t type)
+	{
+		if (logSize < 16)
+			log[logSize++] = { address, value, type };
+	}
+};
+
+// one lane of a LockstepCore: the rom every lane shares at 0x0000-0x7FFF, where writes are dropped, and the lane's own
+// 32 KiB of ram at 0x8000-0xFFFF. There is no mbc and no io, the cpu runs on its own.
+struct LaneBus
+{
+	static constexpr bool hasPeripherals = false;
+
+	const uint8_t* rom = nullptr;
+	uint8_t* ram = nullptr;
+
+	uint8_t read(uint16_t address) { return address < 0x8000 ? rom[address] : ram[address - 0x8000]; }
+
+	void write(uint16_t address, uint8_t value)
+	{
+		if (address >= 0x8000)
+			ram[address - 0x8000] = value;
+	}
+
+	void access(uint16_t, uint8_t, uint8_t) {}
+};
+
+// wraps another bus and keeps its last Capacity accesses in a ring buffer, for debugging. Entry i (counting from
+// the first access) is trace[i % Capacity] while i >= count - Capacity.
+template<typename Inner, size_t Capacity = 4096>
+struct TracingBus : Inner
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "trace capacity must be a power of two");
+
+	struct Entry
+	{
+		uint16_t address;
+		uint8_t value;
+		uint8_t type; // BUS_*
+	};
+
+	Entry trace[Capacity];
+	uint64_t count = 0;
+
+	void access(uint16_t address, uint8_t value, uint8_t type)
+	{
+		trace[count++ & (Capacity - 1)] = { address, value, type };
+		Inner::access(address, value, type);
+	}
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Byte buffer that copies share until one of them writes. Copying a CowBuffer only copies a pointer, the first write
+// through a copy that is still shared copies the bytes. A shared buffer is never written, so copies can be used from
+// different threads. Reads go through data() and operator[] like a vector, writes through write() or mutableData().
+class CowBuffer
+{
+public:
+	void assign(size_t size, uint8_t value)
+	{
+		storage = std::make_shared<std::vector<uint8_t>>(size, value);
+		bytes = storage->data();
+		length = size;
+	}
+
+	size_t size() const { return length; }
+	bool empty() const { return length == 0; }
+	const uint8_t* data() const { return bytes; }
+	uint8_t operator[](size_t index) const { return bytes[index]; }
+
+	// true while another copy holds the same bytes
+	bool shared() const { return storage && storage.use_count() > 1; }
+
+	// the bytes of this copy alone, copied first if they are still shared
+	uint8_t* mutableData()
+	{
+		if (shared())
+		{
+			storage = std::make_shared<std::vector<uint8_t>>(*storage);
+			bytes = storage->data();
+		}
+		else
+		{
+			// the last other copy may have been dropped on another thread, its reads happen before our writes
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+
+		return bytes;
+	}
+
+	void write(size_t index, uint8_t value) { mutableData()[index] = value; }
+
+private:
+	std::shared_ptr<std::vector<uint8_t>> storage;
+	uint8_t* bytes = nullptr;
+	size_t length = 0;
+};
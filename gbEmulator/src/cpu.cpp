@@ -3,124 +3,136 @@
 #include "iostream"
 #include  "regs.h"
 
-CPU::CPU(MMU& mmu, PPU& ppu) 
-	: mmu(mmu),
-	  ppu(ppu)
+template<typename Bus>
+CPU<Bus>::CPU(Bus& bus)
+	: bus(bus)
 {};
 
-void CPU::setAF(uint16_t value)
+template<typename Bus>
+void CPU<Bus>::setAF(uint16_t value)
 {
 	regs[REG_A] = value >> 8;
 	regs[REG_F] = value & 0xFF;
 }
 
-void CPU::setBC(uint16_t value)
+template<typename Bus>
+void CPU<Bus>::setBC(uint16_t value)
 {
 	regs[REG_B] = value >> 8;
 	regs[REG_C] = value & 0xFF;
 }
 
-void CPU::setDE(uint16_t value)
+template<typename Bus>
+void CPU<Bus>::setDE(uint16_t value)
 {
 	regs[REG_D] = value >> 8;
 	regs[REG_E] = value & 0xFF;
 }
 
-void CPU::setHL(uint16_t value)
+template<typename Bus>
+void CPU<Bus>::setHL(uint16_t value)
 {
 	regs[REG_H] = value >> 8;
 	regs[REG_L] = value & 0xFF;
 }
 
-uint16_t CPU::getAF()
+template<typename Bus>
+uint16_t CPU<Bus>::getAF()
 {
 	return (regs[REG_A] << 8) | regs[REG_F];
 }
-uint16_t CPU::getBC()
+template<typename Bus>
+uint16_t CPU<Bus>::getBC()
 {
 	return (regs[REG_B] << 8) | regs[REG_C];
 }
-uint16_t CPU::getDE()
+template<typename Bus>
+uint16_t CPU<Bus>::getDE()
 {
 	return (regs[REG_D] << 8) | regs[REG_E];
 }
 
-uint16_t CPU::getHL()
+template<typename Bus>
+uint16_t CPU<Bus>::getHL()
 {
 	return (regs[REG_H] << 8) | regs[REG_L];
 }
 
-void CPU::setFlagZ(bool value)
+template<typename Bus>
+void CPU<Bus>::setFlagZ(bool value)
 {
 	/*std::cout << "SET FLAG VALUE: " << (int)value << "\n";*/
 	regs[REG_F] = (regs[REG_F] & ~(1 << 7)) | (value << 7);
 }
-void CPU::setFlagN(bool value)
+template<typename Bus>
+void CPU<Bus>::setFlagN(bool value)
 {
 	regs[REG_F] = (regs[REG_F] & ~(1 << 6)) | (value << 6);
 }
-void CPU::setFlagH(bool value)
+template<typename Bus>
+void CPU<Bus>::setFlagH(bool value)
 {
 	regs[REG_F] = (regs[REG_F] & ~(1 << 5)) | (value << 5);
 }
-void CPU::setFlagC(bool value)
+template<typename Bus>
+void CPU<Bus>::setFlagC(bool value)
 {
 	regs[REG_F] = (regs[REG_F] & ~(1 << 4)) | (value << 4);
 }
 
-bool CPU::getFlagZ()
+template<typename Bus>
+bool CPU<Bus>::getFlagZ()
 {
 	return regs[REG_F] >> 7;
 }
-bool CPU::getFlagN()
+template<typename Bus>
+bool CPU<Bus>::getFlagN()
 {
 	return regs[REG_F] >> 6 & 0x01;
 }
-bool CPU::getFlagH()
+template<typename Bus>
+bool CPU<Bus>::getFlagH()
 {
 	return regs[REG_F] >> 5 & 0x01;
 }
-bool CPU::getFlagC()
+template<typename Bus>
+bool CPU<Bus>::getFlagC()
 {
 	return regs[REG_F] >> 4 & 0x01;
 }
 
-uint8_t CPU::read8(uint16_t address)
+template<typename Bus>
+uint8_t CPU<Bus>::read8(uint16_t address)
 {
-
 	uint8_t val;
 
-	if (mmu.dmaTransferRequested && (address < 0xFF80 || address >  0xFFFE) && address != 0xFF00)
-	{
-		val = 0xFF;
-	}
-	else if (address == 0xFF00)
+	if constexpr (Bus::hasPeripherals)
 	{
-		uint8_t reg = mmu.read8(address);
-		bool ssba = ((reg >> 5) & 1) ? 0 : 1;
-		bool dPad = ((reg >> 4) & 1) ? 0 : 1;
-
-		if (!ssba && !dPad)
+		if (bus.mmu.dmaTransferRequested && (address < 0xFF80 || address >  0xFFFE) && address != 0xFF00)
 		{
 			val = 0xFF;
 		}
 		else
 		{
-			val = reg;
+			val = bus.read(address);
 		}
 	}
 	else
 	{
-		val = mmu.read8(address);
+		val = bus.read(address);
 	}
-	
-	AddCycle();
+
+	bus.access(address, val, BUS_READ);
+	tick();
 
 	return val;
 }
 
-void CPU::handleInterrupts()
+template<typename Bus>
+void CPU<Bus>::handleInterrupts() requires Bus::hasPeripherals
 {
+	MMU& mmu = bus.mmu;
+
 	if (HALT)
 	{
 		uint8_t IE = mmu.read8(IE_ADDRESS);
@@ -204,12 +216,31 @@ void CPU::handleInterrupts()
 
 		PC = 0x58;
 
+		AddCycle();
+	}
+	else if (mmu.isInterruptRequested(JOYPAD) && mmu.isInterruptEnabled(JOYPAD))
+	{
+		// two m-cycles while nothing happens
+		AddCycle();
+		AddCycle();
+
+		mmu.cancelInterrupt(JOYPAD);
+		IME = 0;
+
+		write8(--SP, PC >> 8);
+		write8(--SP, PC & 0xFF);
+
+		PC = 0x60;
+
 		AddCycle();
 	}
 }
 
-void CPU::handleRTC()
+template<typename Bus>
+void CPU<Bus>::handleRTC() requires Bus::hasPeripherals
 {
+	MMU& mmu = bus.mmu;
+
 	if (mmu.cartridgeHasRTC && !(mmu.rtc.dh >> 6 & 1))
 	{
 		mmu.rtcCycleCounter += 4;
@@ -250,8 +281,11 @@ void CPU::handleRTC()
 	}
 }
 
-void CPU::handleDMATransfer()
+template<typename Bus>
+void CPU<Bus>::handleDMATransfer() requires Bus::hasPeripherals
 {
+	MMU& mmu = bus.mmu;
+
 	if (mmu.dmaTransferRequested)
 	{
 		if (mmu.dmaDelay >= 1 && mmu.dmaDelay < 161)
@@ -271,8 +305,11 @@ void CPU::handleDMATransfer()
 	}
 }
 
-void CPU::handleTimers()
+template<typename Bus>
+void CPU<Bus>::handleTimers() requires Bus::hasPeripherals
 {
+	MMU& mmu = bus.mmu;
+
 	DIV++;
 
 	uint8_t bitPosition;
@@ -334,45 +371,58 @@ void CPU::handleTimers()
 	}
 }
 
-void CPU::write8(uint16_t address, uint8_t value)
+template<typename Bus>
+void CPU<Bus>::write8(uint16_t address, uint8_t value)
 {
-	if (address == DIV_ADDRESS)
+	if constexpr (Bus::hasPeripherals)
 	{
-		value = 0x00;
-		DIV = 0;
-	}
+		MMU& mmu = bus.mmu;
 
-	if (address == TIMA_ADDRESS)
-	{
-		//std::cout << "wrote to TIMA" << "\n";
-		timaReloadPending = false;
+		if (address == DIV_ADDRESS)
+		{
+			value = 0x00;
+			DIV = 0;
+		}
 
-		mmu.cancelInterrupt(TIMER);
-	}
+		if (address == TIMA_ADDRESS)
+		{
+			//std::cout << "wrote to TIMA" << "\n";
+			timaReloadPending = false;
 
-	if (mmu.dmaTransferRequested && (address < 0xFF80 || address >  0xFFFE) && address != 0xFF00)
-	{
-		AddCycle();
-		return;
-	}
-	else
-	{
-		if (address == 0xFF00)
+			mmu.cancelInterrupt(TIMER);
+		}
+
+		if (mmu.watchpointCount && mmu.watchpoints[address])
 		{
-			value = ((mmu.read8(address) & ~(3 << 4)) | (((value >> 4) & 3) << 4));
-			mmu.write8(address, value);
+			mmu.events |= EVENT_WATCHPOINT;
+			mmu.watchpointAddress = address;
 		}
-		else
+
+		// starting a transfer sends whatever is in SB
+		if (address == SC_ADDRESS && (value & 0x80))
 		{
-			mmu.write8(address, value);
+			mmu.serialOut = mmu.read8(SB_ADDRESS);
+			mmu.events |= EVENT_SERIAL;
+
+			serialTransferActive = value & 0x01;
+			serialCycles = 0;
+		}
+
+		if (mmu.dmaTransferRequested && (address < 0xFF80 || address >  0xFFFE) && address != 0xFF00)
+		{
+			bus.access(address, value, BUS_WRITE);
+			tick();
+			return;
 		}
-		
-		AddCycle();
 	}
-}
 
+	bus.write(address, value);
+	bus.access(address, value, BUS_WRITE);
+	tick();
+}
 
-uint16_t CPU::read16(uint16_t address)
+template<typename Bus>
+uint16_t CPU<Bus>::read16(uint16_t address)
 {
 	uint16_t lsb = read8(address);
 	uint16_t msb = read8(address + 1);
@@ -380,7 +430,8 @@ uint16_t CPU::read16(uint16_t address)
 	return (msb << 8) | lsb;
 }
 
-void CPU::write16(uint16_t address, uint16_t value)
+template<typename Bus>
+void CPU<Bus>::write16(uint16_t address, uint16_t value)
 {
 	uint16_t lsb = value & 0xFF;
 	uint16_t msb = value >> 8;
@@ -389,33 +440,73 @@ void CPU::write16(uint16_t address, uint16_t value)
 	write8(address + 1, msb);
 }
 
-void CPU::AddCycle()
+template<typename Bus>
+void CPU<Bus>::handleSerial() requires Bus::hasPeripherals
+{
+	MMU& mmu = bus.mmu;
+
+	if (!serialTransferActive)
+		return;
+
+	serialCycles += 4;
+
+	if (serialCycles >= SERIAL_TRANSFER_CYCLES)
+	{
+		serialTransferActive = false;
+
+		mmu.write8(SB_ADDRESS, 0xFF);
+		mmu.write8(SC_ADDRESS, mmu.read8(SC_ADDRESS) & 0x7F);
+		mmu.requestInterrupt(SERIAL);
+	}
+}
+
+template<typename Bus>
+void CPU<Bus>::AddCycle()
 {
-	handleRTC();
-	handleDMATransfer();
+	bus.access(0, 0, BUS_IDLE);
+	tick();
+}
 
-	if (timaReloadPending)
+template<typename Bus>
+void CPU<Bus>::tick()
+{
+	if constexpr (!Bus::hasPeripherals)
 	{
-		uint8_t TMA = mmu.read8(TMA_ADDRESS);
-		mmu.write8(TIMA_ADDRESS, TMA);
-		mmu.requestInterrupt(TIMER);
-		timaReloadPending = false;
+		tCycles += 4;
 	}
-	
-	for (int i = 0; i < 4; i++)
+	else
 	{
-		tCycles++;
-		ppu.tick();
-		handleTimers();
+		MMU& mmu = bus.mmu;
+
+		handleRTC();
+		handleDMATransfer();
+		handleSerial();
+
+		if (timaReloadPending)
+		{
+			uint8_t TMA = mmu.read8(TMA_ADDRESS);
+			mmu.write8(TIMA_ADDRESS, TMA);
+			mmu.requestInterrupt(TIMER);
+			timaReloadPending = false;
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			tCycles++;
+			bus.ppu.tick();
+			handleTimers();
+		}
 	}
 }
 
-uint8_t CPU::fetch8()
+template<typename Bus>
+uint8_t CPU<Bus>::fetch8()
 {
 	return read8(PC++);
 }
 
-uint16_t CPU::fetch16()
+template<typename Bus>
+uint16_t CPU<Bus>::fetch16()
 {
 	uint16_t lsb = read8(PC++);
 	uint16_t msb = read8(PC++);
@@ -423,7 +514,8 @@ uint16_t CPU::fetch16()
 	return (msb << 8) | lsb;
 }
 
-void CPU::decodeAndExecute(uint8_t opcode)
+template<typename Bus>
+void CPU<Bus>::decodeAndExecute(uint8_t opcode)
 {
 	// NOT IMPLEMENTED: STOP 
 
@@ -2421,4 +2513,9 @@ void CPU::decodeAndExecute(uint8_t opcode)
 
 	}
 
-}
\ No newline at end of file
+}
+
+template class CPU<SystemBus>;
+template class CPU<FlatTestBus>;
+template class CPU<TracingBus<SystemBus>>;
+template class CPU<LaneBus>;
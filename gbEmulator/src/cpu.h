@@ -1,16 +1,47 @@
 #pragma once 
 
 #include <memory>
-#include "mmu.h"
-#include "ppu.h"
+#include "bus.h"
+#include "saveState.h"
 
-class CPU
+// registers, timers and serial, everything in the cpu that a save state has to restore
+// The padding is spelled out (saveState.cpp checks there is none left), so two instances in the same state save to
+// the same bytes.
+struct CPUState
 {
-public:
-	CPU(MMU& mmu, PPU& ppu);
-
 	uint8_t regs[8]{0xFF, 0x13, 0x00, 0xC1, 0x84, 0x03, 0x00, 0x01};
 
+	uint16_t SP = 0xFFFE; // the stack resides towards the end of the gb's memory. It grows AWAY from the end of the memory, so the "TOP" of the
+	uint16_t PC = 0x0100; // stack is actually in the stack's lowest memory address. That is why we decrement the stack pointer by 1 when pushing a byte
+							// and increment when popping a byte.
+	
+	uint16_t DIV = 0; 
+	uint16_t divCycles = 0; 	// 16 bit counter, only put upper 8 bits in FF04, increment every 256 t-cycle, writing to FF04 sets it to 0.
+	bool lastANDResult = 0;
+	bool timaReloadPending = 0;
+
+	bool HALT = false;
+	bool IME = 0;
+	bool updateIME = 0;
+	uint8_t padding0[3]{};
+	
+	uint64_t tCycles = 0; // t-cycles executed since power on
+
+	// serial transfer clocked by the gb itself (SC bit 0 set), 8 bits at 8192 Hz. Nothing is connected to the other end,
+	// so every transfer shifts in 0xFF. Transfers waiting for an external clock never finish, like on hardware.
+	bool serialTransferActive = false;
+	uint8_t padding1[3]{};
+	unsigned int serialCycles = 0;
+};
+
+// The cpu is compiled once per bus (see bus.h), cpu.cpp instantiates it for SystemBus, FlatTestBus,
+// TracingBus<SystemBus> and LaneBus.
+template<typename Bus>
+class CPU : public CPUState
+{
+public:
+	CPU(Bus& bus);
+
 	void setAF(uint16_t value);
 	void setBC(uint16_t value);
 	void setDE(uint16_t value);
@@ -31,34 +62,20 @@ public:
 	bool getFlagH();
 	bool getFlagC();
 
-	uint16_t SP = 0xFFFE; // the stack resides towards the end of the gb's memory. It grows AWAY from the end of the memory, so the "TOP" of the
-	uint16_t PC = 0x0100; // stack is actually in the stack's lowest memory address. That is why we decrement the stack pointer by 1 when pushing a byte
-							// and increment when popping a byte.
-	
-	uint16_t DIV = 0; 
-	uint16_t divCycles = 0; 	// 16 bit counter, only put upper 8 bits in FF04, increment every 256 t-cycle, writing to FF04 sets it to 0.
-	bool lastANDResult = 0;
-	bool timaReloadPending = 0;
-
 	// can the corresponding interrupt handlers.
-	void handleInterrupts();
-
-	bool HALT = false;
-	bool IME = 0;
-	bool updateIME = 0;
-	
-	void AddCycle(); // --> increment tCycles by 4 and tick systems 4x.
+	void handleInterrupts() requires Bus::hasPeripherals;
 
-	unsigned int tCycles;
+	void AddCycle(); // --> internal m-cycle, nothing on the bus. Increment tCycles by 4 and tick systems 4x.
 
-	void handleRTC();
-	void handleTimers();
-	void handleDMATransfer();
+	void handleRTC() requires Bus::hasPeripherals;
+	void handleTimers() requires Bus::hasPeripherals;
+	void handleDMATransfer() requires Bus::hasPeripherals;
+	void handleSerial() requires Bus::hasPeripherals;
 
 	uint8_t fetch8(); // --> same as read but reads using PC and increases it
 	uint16_t fetch16();// --> same as read16 but reads using PC twice and increases it twice
 
-	// these are wrappers to mmu functions
+	// these are wrappers to the bus, one m-cycle each
 	uint8_t read8(uint16_t address);
 	void write8(uint16_t address, uint8_t value);
 
@@ -66,7 +83,8 @@ public:
 	void write16(uint16_t address, uint16_t value); 
 						
 	void decodeAndExecute(uint8_t opcode);
+	Bus& bus;
+
 private:
-	MMU& mmu;
-	PPU& ppu;
+	void tick(); // --> advance everything clocked with the cpu by one m-cycle
 };
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include <iostream>
+#include <chrono>
+#include "emuThread.h"
+
+EmuThread::~EmuThread()
+{
+	stop();
+}
+
+void EmuThread::start(GameBoy& gb)
+{
+	this->gb = &gb;
+
+	stopRequested = false;
+	restartRequested = false;
+
+	// a freshly loaded rom always starts at 1x
+	pacer.setSpeed(1.0);
+
+	if (gb.validRomLoaded)
+		stateSlots.open(gb.filePath);
+
+	rewind.clear();
+	rewinding = false;
+	framesSinceReport = 0;
+
+	thread = std::thread(&EmuThread::loop, this);
+}
+
+void EmuThread::stop()
+{
+	stopRequested = true;
+
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+
+	// lets the last save state writes finish
+	stateSlots.close();
+}
+
+bool EmuThread::restartPending()
+{
+	return restartRequested.load(std::memory_order_acquire);
+}
+
+void EmuThread::requestRestart(const std::string& rom, const std::string& save)
+{
+	restartRomPath = rom;
+	restartSavePath = save;
+	restartRequested.store(true, std::memory_order_release);
+}
+
+void EmuThread::sendCommand(const Command& command)
+{
+	pendingCommands.push_back(command);
+	flushCommands();
+}
+
+void EmuThread::flushCommands()
+{
+	while (!pendingCommands.empty() && commands.push(pendingCommands.front()))
+		pendingCommands.pop_front();
+}
+
+void EmuThread::processCommands()
+{
+	Command command;
+
+	while (commands.pop(command))
+	{
+		switch (command.type)
+		{
+		case CMD_LOAD_ROM:
+			requestRestart(command.path, "");
+			return;
+
+		case CMD_LOAD_SAVE:
+			requestRestart(gb->filePath, command.path);
+			return;
+
+		case CMD_SAVE:
+			if (gb->validRomLoaded)
+				gb->saveGame();
+			break;
+
+		case CMD_SAVE_AS:
+			if (gb->validRomLoaded)
+			{
+				gb->saveFilePath = command.path;
+				gb->saveGame();
+			}
+			break;
+
+		case CMD_SET_SPEED:
+			pacer.setSpeed(command.speed);
+			break;
+
+		case CMD_SAVE_STATE:
+			if (gb->validRomLoaded)
+				stateSlots.save(command.slot, *gb);
+			break;
+
+		case CMD_LOAD_STATE:
+			if (gb->validRomLoaded)
+				stateSlots.load(command.slot, *gb);
+			break;
+
+		case CMD_SET_REWIND:
+			rewinding = command.rewind;
+			break;
+
+		case CMD_SET_RUN_AHEAD:
+			runAhead.setFrames(command.frames);
+			break;
+		}
+	}
+}
+
+void EmuThread::processInputEvents()
+{
+	InputEvent event;
+
+	while (inputEvents.pop(event))
+	{
+		if (event.pressed)
+			gb->enableInputRegisterBits(event.button);
+		else
+			gb->disableInputRegisterBits(event.button);
+	}
+}
+
+void EmuThread::loop()
+{
+	pacer.reset();
+
+	while (!stopRequested.load(std::memory_order_relaxed))
+	{
+		processCommands();
+
+		if (restartPending())
+		{
+			break;
+		}
+
+		processInputEvents();
+
+		if (!gb->validRomLoaded)
+		{
+			// nothing to emulate, just wait for a load rom command
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			pacer.reset();
+			continue;
+		}
+
+		if (rewinding)
+		{
+			// each step back is drawn by emulating the frame after it again. At the end of the history the game
+			// just stays paused until the key is released.
+			if (rewind.stepBack(*gb))
+				gb->runFrame();
+		}
+		else
+		{
+			runAhead.runFrame(*gb);
+			rewind.capture(*gb);
+		}
+
+		pacer.waitForNextFrame();
+
+		// report pacing roughly every 5 seconds of emulated time
+		if (++framesSinceReport >= 300)
+		{
+			FramePacer::Stats stats = pacer.takeStats();
+
+			if (stats.frames > 0)
+			{
+				std::cout << "fps: " << 1.0 / stats.meanInterval
+					<< " (target " << 1.0 / pacer.targetInterval() << ")"
+					<< " jitter: " << stats.jitter * 1e6 << " us"
+					<< " max deviation: " << stats.maxDeviation * 1e6 << " us"
+					<< " late frames: " << stats.lateFrames << "\n";
+			}
+
+			framesSinceReport = 0;
+		}
+	}
+}
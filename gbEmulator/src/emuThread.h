@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <thread>
+
+#include "gb.h"
+#include "framePacer.h"
+#include "rewind.h"
+#include "runAhead.h"
+#include "saveStateSlots.h"
+#include "spscQueue.h"
+
+struct InputEvent
+{
+	Button button;
+	bool pressed;
+};
+
+enum CommandType
+{
+	CMD_LOAD_ROM,
+	CMD_LOAD_SAVE,
+	CMD_SAVE,
+	CMD_SAVE_AS,
+	CMD_SET_SPEED,
+	CMD_SAVE_STATE,
+	CMD_LOAD_STATE,
+	CMD_SET_REWIND,
+	CMD_SET_RUN_AHEAD,
+};
+
+struct Command
+{
+	CommandType type;
+	std::string path;
+	// CMD_SET_SPEED: emulation speed multiplier, 0 for unlimited
+	double speed = 0.0;
+	// CMD_SAVE_STATE, CMD_LOAD_STATE: 0 based slot
+	int slot = 0;
+	// CMD_SET_REWIND: true while the rewind key is held
+	bool rewind = false;
+	// CMD_SET_RUN_AHEAD: frames to run ahead, 0 turns it off
+	int frames = 0;
+};
+
+// Runs the emulator core on its own thread so drawing and UI work on the main thread never steal emulation time, and
+// vice versa. The main thread talks to it through lock-free single producer/single consumer queues: input events and
+// commands go in, finished frames come out through the PPU's triple buffer. Each side paces itself.
+class EmuThread
+{
+public:
+	~EmuThread();
+
+	void start(GameBoy& gb);
+
+	// asks the thread to stop and waits for it to exit
+	void stop();
+
+	// true once the thread has exited because a command asked for the emulator to be restarted with another rom/save.
+	// restartRomPath and restartSavePath are valid after that.
+	bool restartPending();
+
+	// main thread: queues a command, one that doesn't fit waits for flushCommands
+	void sendCommand(const Command& command);
+	// main thread, every ui tick: queues the waiting commands in order, as many as fit
+	void flushCommands();
+
+	// main thread -> emulation thread
+	SpscQueue<InputEvent, 64> inputEvents;
+	SpscQueue<Command, 16> commands;
+
+	std::string restartRomPath;
+	std::string restartSavePath;
+
+private:
+	void loop();
+	void processCommands();
+	void processInputEvents();
+	void requestRestart(const std::string& rom, const std::string& save);
+
+	GameBoy* gb = nullptr;
+	std::thread thread;
+
+	// main thread only: commands that didn't fit in the queue yet
+	std::deque<Command> pendingCommands;
+
+	FramePacer pacer;
+	// frames since the pacing stats were last printed
+	int framesSinceReport = 0;
+	SaveStateSlots stateSlots;
+
+	// captured after every frame, stepped back through instead while rewinding
+	Rewind rewind;
+	bool rewinding = false;
+
+	RunAhead runAhead;
+
+	std::atomic<bool> stopRequested = false;
+	std::atomic<bool> restartRequested = false;
+};
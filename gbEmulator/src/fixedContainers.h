@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed capacity stand-ins for the std::queue/std::vector the ppu uses for its fifos. They never allocate and are
+// trivially copyable, so the ppu state can be saved and restored with a memcpy. Same method names as the std
+// containers so the drawing code reads the same. Going over the capacity is a bug in the caller.
+
+// ring buffer, N must be a power of two
+template<typename T, size_t N>
+class FixedQueue
+{
+	static_assert((N & (N - 1)) == 0, "queue capacity must be a power of two");
+
+public:
+	bool empty() const { return count == 0; }
+	size_t size() const { return count; }
+
+	T& front() { return items[head]; }
+
+	void push(const T& item)
+	{
+		items[(head + count) & (N - 1)] = item;
+		count++;
+	}
+
+	void pop()
+	{
+		head = (head + 1) & (N - 1);
+		count--;
+	}
+
+	void clear()
+	{
+		head = 0;
+		count = 0;
+	}
+
+	// false for a head or count out of range, which only a damaged save state can hold
+	bool valid() const { return head < N && count <= N; }
+
+private:
+	T items[N]{};
+	uint32_t head = 0;
+	uint32_t count = 0;
+};
+
+template<typename T, size_t N>
+class FixedVector
+{
+public:
+	bool empty() const { return count == 0; }
+	size_t size() const { return count; }
+
+	T& operator[](size_t index) { return items[index]; }
+	T& front() { return items[0]; }
+
+	T* begin() { return items; }
+	T* end() { return items + count; }
+
+	void push_back(const T& item) { items[count++] = item; }
+	void clear() { count = 0; }
+
+	void erase(T* position)
+	{
+		for (T* item = position; item + 1 < end(); item++)
+			*item = *(item + 1);
+		count--;
+	}
+
+	// false for a count out of range, which only a damaged save state can hold
+	bool valid() const { return count <= N; }
+
+private:
+	T items[N]{};
+	uint32_t count = 0;
+};
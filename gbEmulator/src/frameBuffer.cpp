@@ -0,0 +1,42 @@
+#include "frameBuffer.h"
+#include "hash.h"
+
+FrameBuffer::FrameBuffer() {}
+
+uint8_t* FrameBuffer::writeBuffer()
+{
+	return buffers[writeIndex];
+}
+
+void FrameBuffer::publish()
+{
+	hashes[writeIndex] = hashBytes(buffers[writeIndex], sizeof(buffers[writeIndex]));
+
+	// the buffer we just finished becomes the ready one and we take over whatever was there before (either a frame the
+	// reader skipped or the one it released on its last acquire)
+	uint8_t previous = readyIndex.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+	writeIndex = previous & 3;
+}
+
+bool FrameBuffer::acquire()
+{
+	if (!(readyIndex.load(std::memory_order_relaxed) & FRESH_BIT))
+	{
+		return false;
+	}
+
+	uint8_t previous = readyIndex.exchange(readIndex, std::memory_order_acq_rel);
+	readIndex = previous & 3;
+
+	return true;
+}
+
+const uint8_t* FrameBuffer::readBuffer() const
+{
+	return buffers[readIndex];
+}
+
+uint64_t FrameBuffer::readHash() const
+{
+	return hashes[readIndex];
+}
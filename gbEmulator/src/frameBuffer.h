@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+
+#define LCD_WIDTH 160
+#define LCD_HEIGHT 144
+#define LCD_SIZE (LCD_WIDTH * LCD_HEIGHT)
+
+// Triple buffer used to hand finished frames from the PPU to whoever presents them (GL, headless capture, API
+// consumers). The writer owns one buffer, the reader owns another and the third one holds the latest completed frame.
+// Publishing and picking up a frame are a single atomic exchange, so neither side ever waits on the other and the
+// reader never sees a half drawn frame.
+class FrameBuffer
+{
+public:
+	FrameBuffer();
+
+	// writer side (PPU): buffer being drawn into, and hand it over once the frame is complete
+	uint8_t* writeBuffer();
+	void publish();
+
+	// reader side (presenter): swap in the latest completed frame. Returns false if nothing new was published since
+	// the last call, in which case readBuffer() still holds the previous frame.
+	bool acquire();
+	const uint8_t* readBuffer() const;
+
+	// hash of the frame in readBuffer(), computed once when it was published. Lets the presenter skip frames that are
+	// identical to the one it already shows without comparing pixels.
+	uint64_t readHash() const;
+
+private:
+	// low 2 bits of readyIndex hold the buffer index, this bit is set when the buffer holds a frame the reader hasn't seen
+	static constexpr uint8_t FRESH_BIT = 0b100;
+
+	uint8_t buffers[3][LCD_WIDTH * LCD_HEIGHT]{};
+	uint64_t hashes[3]{};
+
+	uint8_t writeIndex = 0;
+	uint8_t readIndex = 1;
+	std::atomic<uint8_t> readyIndex{ 2 };
+};
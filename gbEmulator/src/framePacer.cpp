@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include "framePacer.h"
+#include "gb.h"
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+FramePacer::FramePacer()
+{
+	setSpeed(1.0);
+}
+
+void FramePacer::setSpeed(double speed)
+{
+	this->speed = speed;
+	frameIntervalNs = speed > 0.0 ? (int64_t)std::llround(1e9 / (DMG_FRAME_RATE * speed)) : 0;
+	reset();
+}
+
+double FramePacer::getSpeed()
+{
+	return speed;
+}
+
+double FramePacer::targetInterval()
+{
+	return frameIntervalNs / 1e9;
+}
+
+void FramePacer::reset()
+{
+	deadlineNs = now() + frameIntervalNs;
+	lastWakeUpNs = 0;
+}
+
+int64_t FramePacer::now()
+{
+#ifndef _WIN32
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void FramePacer::sleepUntil(int64_t timeNs)
+{
+#ifndef _WIN32
+	timespec ts;
+	ts.tv_sec = timeNs / 1000000000;
+	ts.tv_nsec = timeNs % 1000000000;
+
+	// absolute deadline: a signal interrupting the sleep just means sleeping again until the same point in time
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) != 0)
+	{
+	}
+#else
+	std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(timeNs)));
+#endif
+}
+
+void FramePacer::waitForNextFrame()
+{
+	if (frameIntervalNs == 0)
+	{
+		return;
+	}
+
+	int64_t current = now();
+
+	if (deadlineNs - current > SPIN_WINDOW_NS)
+	{
+		sleepUntil(deadlineNs - SPIN_WINDOW_NS);
+	}
+
+	while ((current = now()) < deadlineNs)
+	{
+	}
+
+	if (current - deadlineNs > SPIN_WINDOW_NS)
+	{
+		statLateFrames++;
+	}
+
+	if (lastWakeUpNs != 0)
+	{
+		double interval = (current - lastWakeUpNs) / 1e9;
+		double deviation = std::abs(interval - targetInterval());
+
+		statFrames++;
+		statSum += interval;
+		statSumSquares += interval * interval;
+		statMaxDeviation = std::max(statMaxDeviation, deviation);
+	}
+
+	lastWakeUpNs = current;
+
+	// the next deadline is relative to the previous deadline, not to when we woke up, so the average rate stays exact.
+	// If we fell more than a couple of frames behind (host hiccup, breakpoint...) don't try to catch up in a burst.
+	deadlineNs += frameIntervalNs;
+
+	if (current - deadlineNs > 2 * frameIntervalNs)
+	{
+		deadlineNs = current + frameIntervalNs;
+	}
+}
+
+FramePacer::Stats FramePacer::takeStats()
+{
+	Stats stats;
+	stats.frames = statFrames;
+	stats.lateFrames = statLateFrames;
+	stats.maxDeviation = statMaxDeviation;
+
+	if (statFrames > 0)
+	{
+		stats.meanInterval = statSum / statFrames;
+		stats.jitter = std::sqrt(std::max(0.0, statSumSquares / statFrames - stats.meanInterval * stats.meanInterval));
+	}
+
+	statFrames = 0;
+	statSum = 0.0;
+	statSumSquares = 0.0;
+	statMaxDeviation = 0.0;
+	statLateFrames = 0;
+
+	return stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cinttypes>
+
+// Paces the emulation thread to the real DMG frame rate (times the selected speed) without burning a host core.
+// Deadlines are absolute, so errors never accumulate: the thread sleeps with clock_nanosleep until shortly before the
+// deadline and only spins for the last few hundred microseconds, where the scheduler's wake-up latency would
+// otherwise make it late.
+class FramePacer
+{
+public:
+	FramePacer();
+
+	// speed multiplier, 0 means run as fast as possible
+	void setSpeed(double speed);
+	double getSpeed();
+
+	// restart the schedule from now, e.g. after the emulator was paused or reloaded
+	void reset();
+
+	// blocks until the current frame's deadline and schedules the next one
+	void waitForNextFrame();
+
+	struct Stats
+	{
+		uint64_t frames = 0;
+		// frame intervals measured between consecutive wake-ups, in seconds
+		double meanInterval = 0.0;
+		double jitter = 0.0;       // standard deviation of the intervals
+		double maxDeviation = 0.0; // worst interval minus the target interval
+		uint64_t lateFrames = 0;   // frames that woke up more than the spin window after their deadline
+	};
+
+	// stats since the last call, then starts a new measurement window
+	Stats takeStats();
+
+	double targetInterval();
+
+private:
+	// how long before the deadline we stop sleeping and start spinning
+	static constexpr int64_t SPIN_WINDOW_NS = 300000;
+
+	double speed = 1.0;
+	int64_t frameIntervalNs;
+	int64_t deadlineNs = 0;
+	int64_t lastWakeUpNs = 0;
+
+	uint64_t statFrames = 0;
+	double statSum = 0.0;
+	double statSumSquares = 0.0;
+	double statMaxDeviation = 0.0;
+	uint64_t statLateFrames = 0;
+
+	static int64_t now();
+	static void sleepUntil(int64_t timeNs);
+};
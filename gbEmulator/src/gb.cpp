@@ -1,32 +1,15 @@
 
+#include <algorithm>
+#include <cstring>
 #include "gb.h"
 #include "mmu.h"
 
-#define JOYPAD_ADDRESS 0xFF00
 
-
-GameBoy::GameBoy(GLFWwindow* window)
-    : ppu(mmu), cpu(mmu, ppu), renderingManager(nullptr), window(window)
+GameBoy::GameBoy()
+    : ppu(mmu), bus{ mmu, ppu }, cpu(bus)
 {
-    // initialize glfw window;
-
-    renderingManager = new RenderingManager(*this);
-
-    // create shader program, vao, and display texture
-    renderingManager->init(window);
-    ppu.window = window;
-
-    ppu.displayTexture = renderingManager->displayTexture;
-    ppu.VAO = renderingManager->vao;
-    ppu.shaderProgram = renderingManager->shader;
-
-    // set joypad input registers to all 1's (off)
-    mmu.ioRegs[0] = 0b00001111;
-}
-
-GameBoy::~GameBoy()
-{
-    delete renderingManager;
+    // nothing selected, all button lines high (released)
+    mmu.ioRegs[0] = 0b00110000;
 }
 
 void GameBoy::readRom(const std::string rom, const std::string savePath)
@@ -40,10 +23,6 @@ void GameBoy::readRom(const std::string rom, const std::string savePath)
         int length = is.tellg();
         is.seekg(0, is.beg);
 
-        char* buffer = new char[length];
-
-        is.read(buffer, length);
-
         if (length <= 0)
         {
             std::cout << "Error: ROM is empty!" << "\n";
@@ -51,6 +30,10 @@ void GameBoy::readRom(const std::string rom, const std::string savePath)
             return;
         }
 
+        std::vector<uint8_t> buffer(length);
+
+        is.read(reinterpret_cast<char*>(buffer.data()), length);
+
         if (is)
             std::cout << "rom read successfully\n";
         else
@@ -58,28 +41,13 @@ void GameBoy::readRom(const std::string rom, const std::string savePath)
 
         std::cout << "rom length: " << length << "\n";
 
-        for (int i = 0; i < length; i++)
-        {
-            mmu.fullrom.push_back(buffer[i]);            
-        }
+        is.close();
 
-        checkCartridgeType();
-        checkRomSize();
-        checkSramSize();
+        if (!loadRom(buffer.data(), buffer.size()))
+            return;
 
         if (mmu.cartHasBattery)
             loadSave(savePath);
-        
-        // rom bank number can be 0 in MBC5, unlike in other MBC's
-        if (mmu.mbc == MBC5)
-            mmu.romBankNumber = 0;
-
-        mmu.eRam.resize(mmu.sRamSize);
-        
-        is.close();
-        delete[] buffer;
-        
-        validRomLoaded = true;
     }
     else
     {
@@ -88,200 +56,142 @@ void GameBoy::readRom(const std::string rom, const std::string savePath)
     }
 }
 
-void GameBoy::checkForInput(GLFWwindow* window)
+bool GameBoy::loadRom(const uint8_t* data, size_t size)
 {
-    uint8_t reg = mmu.read8(JOYPAD_ADDRESS);
+    std::ostream quiet(nullptr);
+    std::ostream& log = logCartridge ? std::cout : quiet;
 
-    ssba = !((reg >> 5) & 1);
-    dPad = !((reg >> 4) & 1);
-   
-    if (!ssba && !dPad)
+    // must at least hold the cartridge header
+    if (size < 0x150)
     {
-        mmu.write8(JOYPAD_ADDRESS, 0xFF);
-        return;
+        log << "Error: ROM is too small!" << "\n";
+        validRomLoaded = false;
+        return false;
     }
 
-    if (keyDown[GLFW_KEY_RIGHT] && dPad)
-    {
-        enableInputRegisterBits(BUTTON_RIGHT);
-    }
-    else if (dPad)
-    {
-        disableInputRegisterBits(BUTTON_RIGHT);
-    }
+    mmu.romImage = std::make_shared<const std::vector<uint8_t>>(data, data + size);
+    mmu.fullrom = mmu.romImage->data();
 
-    if (keyDown[GLFW_KEY_LEFT] && dPad)
-    {
-        enableInputRegisterBits(BUTTON_LEFT);
-    }
-    else if (dPad)
-    {
-        disableInputRegisterBits(BUTTON_LEFT);
-    }
+    mmu.romNumOfBanks = 0;
+    checkCartridgeType(log);
+    checkRomSize(log);
+    checkSramSize(log);
 
-    if (keyDown[GLFW_KEY_UP] && dPad)
-    {
-        enableInputRegisterBits(BUTTON_UP);
-    }
-    else if (dPad)
-    {
-        disableInputRegisterBits(BUTTON_UP);
-    }
-
-    if (keyDown[GLFW_KEY_DOWN] && dPad)
-    {
-        enableInputRegisterBits(BUTTON_DOWN);
-    }
-    else if (dPad)
-    {
-        disableInputRegisterBits(BUTTON_DOWN);
-    }
+    // every bank the header promises is read without bounds checks, and the first two always are
+    size_t expectedSize = std::max<size_t>(0x8000, (size_t)mmu.romNumOfBanks * 0x4000);
+    const char* error = nullptr;
+    if (mmu.romNumOfBanks == 0)
+        error = "Error: unknown ROM size!";
+    else if (size < expectedSize)
+        error = "Error: ROM is smaller than its header says!";
 
-    if (keyDown[GLFW_KEY_X] && ssba)
-    {
-        enableInputRegisterBits(BUTTON_A);
-    }
-    else if (ssba)
+    if (error)
     {
-        disableInputRegisterBits(BUTTON_A);
+        log << error << "\n";
+        mmu.romImage.reset();
+        mmu.fullrom = nullptr;
+        validRomLoaded = false;
+        return false;
     }
 
-    if (keyDown[GLFW_KEY_Z] && ssba)
-    {
-        enableInputRegisterBits(BUTTON_B);
-    }
-    else if (ssba)
-    {
-        disableInputRegisterBits(BUTTON_B);
-    }
+    // rom bank number can be 0 in MBC5, unlike in other MBC's
+    if (mmu.mbc == MBC5)
+        mmu.romBankNumber = 0;
 
-    if (keyDown[GLFW_KEY_BACKSPACE] && ssba)
-    {
-        enableInputRegisterBits(BUTTON_SELECT);
-    }
-    else if (ssba)
-    {
-        disableInputRegisterBits(BUTTON_SELECT);
-    }
+    mmu.eRam.assign(mmu.sRamSize, 0);
 
-    if (keyDown[GLFW_KEY_ENTER] && ssba)
-    {
-        enableInputRegisterBits(BUTTON_START);
-    }
-    else if (ssba)
-    {
-        disableInputRegisterBits(BUTTON_START);
-    }
+    validRomLoaded = true;
+    return true;
 }
 
-void GameBoy::enableInputRegisterBits(Button button)
+std::unique_ptr<GameBoy> GameBoy::clone() const
 {
-    uint8_t reg = mmu.read8(JOYPAD_ADDRESS);
-
-    if (button == BUTTON_A)
-    {
-        // using the cpu write functions because they prevent writing while a dma transfer is happening
-        reg = reg & ~(1);
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_B)
-    {
-        reg = reg & ~((uint8_t)(1 << 1));
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_SELECT)
-    {
-        reg = reg & ~((uint8_t)(1 << 2));
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_START)
-    {
-        reg = reg & ~((uint8_t)(1 << 3));
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_RIGHT)
-    {
-        reg = reg & ~((uint8_t)1);
+    auto child = std::make_unique<GameBoy>();
+    cloneInto(*child);
+    return child;
+}
 
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_LEFT)
-    {
-        reg = reg & ~((uint8_t)(1 << 1));
+void GameBoy::cloneInto(GameBoy& child) const
+{
+    // the mmu copies its state, the rom and external ram are shared pointers. Member by member so the 8 KiB of
+    // watchpoints are only copied when either side uses them, like the breakpoints below.
+    static_cast<MMUState&>(child.mmu) = mmu;
+    std::memcpy(child.mmu.bootrom, mmu.bootrom, sizeof(mmu.bootrom));
+    child.mmu.eRam = mmu.eRam;
+    child.mmu.romImage = mmu.romImage;
+    child.mmu.fullrom = mmu.fullrom;
+    child.mmu.mbc = mmu.mbc;
+    child.mmu.cartridgeHasRTC = mmu.cartridgeHasRTC;
+    child.mmu.cartridgeHasRumble = mmu.cartridgeHasRumble;
+    child.mmu.romNumOfBanks = mmu.romNumOfBanks;
+    child.mmu.sRamSize = mmu.sRamSize;
+    child.mmu.sRamNumOfBanks = mmu.sRamNumOfBanks;
+    child.mmu.cartHasBattery = mmu.cartHasBattery;
+    child.mmu.events = mmu.events;
+
+    if (mmu.watchpointCount || child.mmu.watchpointCount)
+        child.mmu.watchpoints = mmu.watchpoints;
+    child.mmu.watchpointCount = mmu.watchpointCount;
+    child.mmu.watchpointAddress = mmu.watchpointAddress;
+
+    static_cast<CPUState&>(child.cpu) = cpu;
+    static_cast<PPUState&>(child.ppu) = ppu;
+
+    // in vblank nothing of the next frame is drawn yet, otherwise the lines drawn so far have to come along. Without
+    // publishing the finished frame stays in LCD until the next one is drawn over it, and frames() views read it there.
+    if (ppu.ppuMode != VBLANK_1 || !ppu.publishFrames)
+        std::memcpy(child.ppu.LCD, ppu.LCD, LCD_SIZE);
+
+    child.validRomLoaded = validRomLoaded;
+    child.instructionCount = instructionCount;
+    child.translatedInstructionCount = translatedInstructionCount;
+    child.translated = translated;
+    child.haltedCycles = haltedCycles;
+    child.stopEvents = stopEvents;
+
+    if (breakpointCount || child.breakpointCount)
+        child.breakpoints = breakpoints;
+    child.breakpointCount = breakpointCount;
+}
 
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_UP)
-    {
-        reg = reg & ~((uint8_t)(1 << 2));
+static uint8_t buttonMask(Button button)
+{
+    switch (button)
+    {
+    case BUTTON_A:
+        return JOYPAD_A;
+    case BUTTON_B:
+        return JOYPAD_B;
+    case BUTTON_SELECT:
+        return JOYPAD_SELECT;
+    case BUTTON_START:
+        return JOYPAD_START;
+    case BUTTON_RIGHT:
+        return JOYPAD_RIGHT;
+    case BUTTON_LEFT:
+        return JOYPAD_LEFT;
+    case BUTTON_UP:
+        return JOYPAD_UP;
+    case BUTTON_DOWN:
+        return JOYPAD_DOWN;
+    }
+
+    return 0;
+}
 
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_DOWN)
-    {
-        reg = reg & ~((uint8_t)(1 << 3));
+void GameBoy::setButtons(uint8_t buttons)
+{
+    mmu.setButtons(buttons);
+}
 
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
+void GameBoy::enableInputRegisterBits(Button button)
+{
+    mmu.setButtons(mmu.joypadButtons | buttonMask(button));
 }
 
 void GameBoy::disableInputRegisterBits(Button button)
 {
-    uint8_t reg = mmu.read8(JOYPAD_ADDRESS);
-
-    if (button == BUTTON_A)
-    {
-        // using the cpu write functions because they prevent writing while a dma transfer is happening
-        reg = reg | 1;
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_B)
-    {
-        reg = reg | (1 << 1);
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_SELECT)
-    {
-        reg = reg | (1 << 2);
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_START)
-    {
-        reg = reg | (1 << 3);
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_RIGHT)
-    {
-        reg = reg | 1;
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_LEFT)
-    {
-        reg = reg | (1 << 1);
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_UP)
-    {
-        reg = reg | (1 << 2);
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
-    else if (button == BUTTON_DOWN)
-    {
-        reg = reg | (1 << 3);
-
-        mmu.write8(JOYPAD_ADDRESS, reg);
-    }
+    mmu.setButtons(mmu.joypadButtons & ~buttonMask(button));
 }
 
 
@@ -321,7 +231,7 @@ void GameBoy::saveGame()
     outputFileStream.open(saveName, std::ios::out | std::ios::binary);
 
     for (int i = 0; i < mmu.eRam.size(); i++)
-        outputFileStream.write((char*)&mmu.eRam[i], sizeof(uint8_t));
+        outputFileStream.write((const char*)mmu.eRam.data() + i, sizeof(uint8_t));
 
 
     std::cout << "saved file!: " << saveName << "\n";
@@ -364,10 +274,13 @@ void GameBoy::loadSave(std::string path)
             
         std::cout << "save file length: " << length << "\n";
 
-        for (int i = 0; i < length; i++)
+        // the cartridge ram was already sized from the header, extra bytes in the file are ignored
+        for (int i = 0; i < length && i < (int)mmu.eRam.size(); i++)
         {
-            mmu.eRam.push_back(buffer[i]);
+            mmu.eRam.write(i, buffer[i]);
         }
+
+        delete[] buffer;
     }
     else
     {
@@ -375,299 +288,313 @@ void GameBoy::loadSave(std::string path)
     }
 }
 
-bool GameBoy::run()
+static bool neverStop(const GameBoy&)
 {
-    double lastFrameTime = 0;   
-    double lastFrameTimeCycles = 0;
-    double lastUpdateTimeCycles = 0;
-   
-    while (!glfwWindowShouldClose(window) && !restartRequested)
-    {
-        double currentTime = glfwGetTime();
-        double deltaTime = currentTime - lastUpdateTimeCycles;
+    return false;
+}
 
-        if (validRomLoaded)
-        {
-            if (!isCPUHalted())
-            {
-                uint8_t opcode = fetch();
-                checkForInput(window);
-                decodeAndExecute(opcode);
-            }
-            else
-            {
-                cpu.AddCycle();
-            }
-            handleInterrupts();
-        }
-        
-        if ((currentTime - lastFrameTime) >= (1.0/60.0))
-        {
-            processInput();
+RunResult GameBoy::runFrame()
+{
+    if (activeMovie.mode == MOVIE_OFF)
+        return runLoop(CYCLES_PER_FRAME, stopEvents | EVENT_VBLANK, neverStop, false);
 
-            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT);
+    if (!activeMovie.inFrame)
+        movieFrameStart();
 
-            if (validRomLoaded)
-            {
-                glUseProgram(ppu.shaderProgram);
-                glBindTexture(GL_TEXTURE_2D, ppu.displayTexture);
-                glBindVertexArray(ppu.VAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-            }
+    RunResult result = runLoop(CYCLES_PER_FRAME, stopEvents | EVENT_VBLANK, neverStop, false);
 
-            renderingManager->renderUI();
+    activeMovie.inFrame = result.reason != STOP_VBLANK && result.reason != STOP_CYCLES;
+    if (!activeMovie.inFrame)
+        movieFrameEnd();
 
-            glfwSwapBuffers(window);
-            glfwPollEvents();
-            
-            lastFrameTime = currentTime;
-        }
+    return result;
+}
 
-        static int frameCount = 0;
-        if (cpu.tCycles >= 70224)
-        {
-            frameCount++;
-            while ((glfwGetTime() - lastUpdateTimeCycles) < fpsLimit)
-            {
-            }
-
-            if (frameCount >= 10)
-            {
-                std::cout << "actual fps: " << 1 / (glfwGetTime() - lastUpdateTimeCycles) << "\n";
-                frameCount = 0;
-            }
-
-            lastUpdateTimeCycles = glfwGetTime();
-            cpu.tCycles = cpu.tCycles - 70224;
-        }
+RunResult GameBoy::runCycles(uint64_t cycles)
+{
+    if (activeMovie.mode != MOVIE_OFF)
+        return refuseDuringMovie();
+
+    return runLoop(cycles, stopEvents, neverStop, false);
+}
+
+StopReason GameBoy::eventStopReason(uint8_t events)
+{
+    if (events & EVENT_WATCHPOINT)
+        return STOP_WATCHPOINT;
+    if (events & EVENT_SERIAL)
+        return STOP_SERIAL;
+    return STOP_VBLANK;
+}
+
+void GameBoy::addBreakpoint(uint16_t address)
+{
+    if (!breakpoints[address])
+    {
+        breakpoints[address] = true;
+        breakpointCount++;
     }
-    renderingManager->terminateUI();
-    
-    return false;
 }
 
-void GameBoy::processInput()
+void GameBoy::removeBreakpoint(uint16_t address)
 {
-    
-    for (int i = 32; i < 349; i++)
+    if (breakpoints[address])
     {
-        if (glfwGetKey(window, i) == GLFW_PRESS && !keyDown[i])
-        {
-            keyPressed[i] = true;
-        }
-        else
-        {
-            keyPressed[i] = false;
-        }
+        breakpoints[address] = false;
+        breakpointCount--;
+    }
+}
 
-        if (glfwGetKey(window, i) == GLFW_PRESS)
-        {
-            keyDown[i] = true;
-        }
-        else
-        {
-            keyDown[i] = false;
-        }
+void GameBoy::addWatchpoint(uint16_t address)
+{
+    if (!mmu.watchpoints[address])
+    {
+        mmu.watchpoints[address] = true;
+        mmu.watchpointCount++;
     }
+}
 
-    // game is saved automatically when the window closes, but there is also the option to save it manually
-    if (keyPressed[GLFW_KEY_F3])
+void GameBoy::removeWatchpoint(uint16_t address)
+{
+    if (mmu.watchpoints[address])
     {
-        std::cout << "SAVING..." << "\n";
-        saveGame();
-        std::cout << "DONE" << "\n";
+        mmu.watchpoints[address] = false;
+        mmu.watchpointCount--;
     }
-    
 }
 
+// ret, reti and ret cc. Returns go back after a call, which gb2cpp finds in the code, or to wherever an interrupt
+// came in, which is anywhere
+static bool isReturn(uint8_t opcode)
+{
+    return opcode == 0xC9 || opcode == 0xD9 || (opcode & 0xE7) == 0xC0;
+}
 
+void GameBoy::step()
+{
+    if (!isCPUHalted())
+    {
+        uint8_t opcode = fetch();
+        decodeAndExecute(opcode);
+        instructionCount++;
+    }
+    else
+    {
+        cpu.AddCycle();
+        haltedCycles += 4;
+    }
+    handleInterrupts();
+}
 
+void GameBoy::profileStep()
+{
+    if (isCPUHalted())
+    {
+        step();
+        return;
+    }
+
+    // the target of the last jump is where this fetch comes from, with its bank mapped
+    if (jumpPending)
+    {
+        int32_t offset = mmu.romOffset(cpu.PC);
+        if (offset >= 0)
+            jumpTargets->insert(offset);
+    }
+
+    uint16_t pc = cpu.PC;
+    uint8_t opcode = fetch();
+    decodeAndExecute(opcode);
+    instructionCount++;
+
+    jumpPending = opcode == 0xE9 || (!isReturn(opcode) && pc < 0x4000 && cpu.PC >= 0x4000 && cpu.PC < 0x8000);
+    handleInterrupts();
+}
 
-void GameBoy::checkCartridgeType()
+void GameBoy::checkCartridgeType(std::ostream& log)
 {
-    std::cout << "Cartridge type: ";
+    log << "Cartridge type: ";
     switch (mmu.fullrom[0x0147])
     {
     case 0x00:
-        std::cout << "ROM ONLY" << "\n";
+        log << "ROM ONLY" << "\n";
         mmu.mbc = MBC0;
         break;
     case 0x01:
-        std::cout << "MBC1" << "\n";
+        log << "MBC1" << "\n";
         mmu.mbc = MBC1;
         break;
     case 0x02:
-        std::cout << "MBC1+RAM" << "\n";
+        log << "MBC1+RAM" << "\n";
         mmu.mbc = MBC1;
         break;
     case 0x03:
-        std::cout << "MBC1+RAM+BATTERY" << "\n";
+        log << "MBC1+RAM+BATTERY" << "\n";
         mmu.cartHasBattery = true;
         mmu.mbc = MBC1;
         break;
     case 0x0F:
-        std::cout << "MBC3+TIMER+BATTERY" << "\n";
+        log << "MBC3+TIMER+BATTERY" << "\n";
         mmu.cartHasBattery = true;
         mmu.cartridgeHasRTC = true;
         mmu.mbc = MBC3;
         break;
     case 0x10:
-        std::cout << "MBC3+TIMER+RAM+BATTERY" << "\n";
+        log << "MBC3+TIMER+RAM+BATTERY" << "\n";
         mmu.cartHasBattery = true;
         mmu.cartridgeHasRTC = true;
         mmu.mbc = MBC3;
         break;
     case 0x11:
-        std::cout << "MBC3" << "\n";
+        log << "MBC3" << "\n";
         mmu.mbc = MBC3;
         break;
     case 0x12:
-        std::cout << "MBC3+RAM" << "\n";
+        log << "MBC3+RAM" << "\n";
         mmu.mbc = MBC3;
         break;
     case 0x13:
-        std::cout << "MBC3+RAM+BATTERY" << "\n";
+        log << "MBC3+RAM+BATTERY" << "\n";
         mmu.cartHasBattery = true;
         mmu.mbc = MBC3;
         break;
     case 0x19:
-        std::cout << "MBC5" << "\n";
+        log << "MBC5" << "\n";
         mmu.mbc = MBC5;
         break;
     case 0x1A:
-        std::cout << "MBC5+RAM" << "\n";
+        log << "MBC5+RAM" << "\n";
         mmu.mbc = MBC5;
         break;
     case 0x1B:
-        std::cout << "MBC5+RAM+BATTERY" << "\n";
+        log << "MBC5+RAM+BATTERY" << "\n";
         mmu.cartHasBattery = true;
         mmu.mbc = MBC5;
         break;
     case 0x1C:
-        std::cout << "MBC5+RUMBLE" << "\n";
+        log << "MBC5+RUMBLE" << "\n";
         mmu.cartridgeHasRumble = true;
         mmu.mbc = MBC5;
         break;
     case 0x1D:
-        std::cout << "MBC5+RUMBLE+RAM" << "\n";
+        log << "MBC5+RUMBLE+RAM" << "\n";
         mmu.cartridgeHasRumble = true;
         mmu.mbc = MBC5;
         break;
     case 0x1E:
-        std::cout << "MBC5+RUMBLE+RAM+BATTERY" << "\n";
+        log << "MBC5+RUMBLE+RAM+BATTERY" << "\n";
         mmu.cartHasBattery = true;
         mmu.cartridgeHasRumble = true;
         mmu.mbc = MBC5;
         break;
     }
 }
-void GameBoy::checkRomSize()
+void GameBoy::checkRomSize(std::ostream& log)
 {
-    std::cout << "Rom size: ";
+    log << "Rom size: ";
     switch (mmu.fullrom[0x0148])
     {
     case 0x00:
-        std::cout << "32 KiB" << "\n";
-        std::cout << "2 ROM banks" << "\n";
+        log << "32 KiB" << "\n";
+        log << "2 ROM banks" << "\n";
         mmu.romNumOfBanks = 2;
         break;
     case 0x01:
-        std::cout << "64 KiB" << "\n";
-        std::cout << "4 ROM banks" << "\n";
+        log << "64 KiB" << "\n";
+        log << "4 ROM banks" << "\n";
         mmu.romNumOfBanks = 4;
         break;
     case 0x02:
-        std::cout << "128 KiB" << "\n";
-        std::cout << "8 ROM banks" << "\n";
+        log << "128 KiB" << "\n";
+        log << "8 ROM banks" << "\n";
         mmu.romNumOfBanks = 8;
         break;
     case 0x03:
-        std::cout << "256 KiB" << "\n";
-        std::cout << "16 ROM banks" << "\n";
+        log << "256 KiB" << "\n";
+        log << "16 ROM banks" << "\n";
         mmu.romNumOfBanks = 16;
         break;
     case 0x04:
-        std::cout << "512 KiB" << "\n";
-        std::cout << "32 ROM banks" << "\n";
+        log << "512 KiB" << "\n";
+        log << "32 ROM banks" << "\n";
         mmu.romNumOfBanks = 32;
         break;
     case 0x05:
-        std::cout << "1 MiB" << "\n";
-        std::cout << "64 ROM banks" << "\n";
+        log << "1 MiB" << "\n";
+        log << "64 ROM banks" << "\n";
         mmu.romNumOfBanks = 64;
         break;
     case 0x06:
-        std::cout << "2 MiB" << "\n";
-        std::cout << "128 ROM banks" << "\n";
+        log << "2 MiB" << "\n";
+        log << "128 ROM banks" << "\n";
         mmu.romNumOfBanks = 128;
         break;
     case 0x07:
-        std::cout << "4 MiB" << "\n";
-        std::cout << "256 ROM banks" << "\n";
+        log << "4 MiB" << "\n";
+        log << "256 ROM banks" << "\n";
         mmu.romNumOfBanks = 256;
         break;
     case 0x08:
-        std::cout << "8 MiB" << "\n";
-        std::cout << "512 ROM banks" << "\n";
+        log << "8 MiB" << "\n";
+        log << "512 ROM banks" << "\n";
         mmu.romNumOfBanks = 512;
         break;
     case 0x52:
-        std::cout << "1.1 MiB" << "\n";
-        std::cout << "72 ROM banks" << "\n";
+        log << "1.1 MiB" << "\n";
+        log << "72 ROM banks" << "\n";
         mmu.romNumOfBanks = 72;
         break;
     case 0x53:
-        std::cout << "1.2 MiB" << "\n";
-        std::cout << "80 ROM banks" << "\n";
+        log << "1.2 MiB" << "\n";
+        log << "80 ROM banks" << "\n";
         mmu.romNumOfBanks = 80;
         break;
     case 0x54:
-        std::cout << "1.5 MiB" << "\n";
-        std::cout << "96 ROM banks" << "\n";
+        log << "1.5 MiB" << "\n";
+        log << "96 ROM banks" << "\n";
         mmu.romNumOfBanks = 96;
         break;
     }
 }
-void GameBoy::checkSramSize()
+void GameBoy::checkSramSize(std::ostream& log)
 {
 
-    std::cout << "SRAM size: ";
+    log << "SRAM size: ";
     switch (mmu.fullrom[0x0149])
     {
     case 0x00:
-        std::cout << "0 KiB" << "\n";
-        std::cout << "No SRAM" << "\n";
+        log << "0 KiB" << "\n";
+        log << "No SRAM" << "\n";
         mmu.sRamNumOfBanks = 0;
         mmu.sRamSize = 0x0;
         break;
     case 0x01:
-        std::cout << "--" << "\n";
-        std::cout << "Unused / 2KiB" << "\n";
+        log << "--" << "\n";
+        log << "Unused / 2KiB" << "\n";
         mmu.sRamNumOfBanks = 0;
         mmu.sRamSize = 0x800;
         break;
     case 0x02:
-        std::cout << "8 KiB" << "\n";
-        std::cout << "1 SRAM bank" << "\n";
+        log << "8 KiB" << "\n";
+        log << "1 SRAM bank" << "\n";
         mmu.sRamNumOfBanks = 1;
         mmu.sRamSize = 0x2000;
         break;
     case 0x03:
-        std::cout << "32 KiB" << "\n";
-        std::cout << "4 RAM banks" << "\n";
+        log << "32 KiB" << "\n";
+        log << "4 RAM banks" << "\n";
         mmu.sRamNumOfBanks = 4;
         mmu.sRamSize = 0x8000;
         break;
     case 0x04:
-        std::cout << "128 KiB" << "\n";
-        std::cout << "16 RAM banks" << "\n";
+        log << "128 KiB" << "\n";
+        log << "16 RAM banks" << "\n";
         mmu.sRamNumOfBanks = 16;
         mmu.sRamSize = 0x20000;
         break;
     case 0x05:
-        std::cout << "64 KiB" << "\n";
-        std::cout << "8 RAM banks" << "\n";
+        log << "64 KiB" << "\n";
+        log << "8 RAM banks" << "\n";
         mmu.sRamNumOfBanks = 8;
         mmu.sRamSize = 0x10000;
         break;
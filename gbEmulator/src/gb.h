@@ -4,13 +4,15 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
 
 #include "cpu.h"
 #include "mmu.h"
 #include "ppu.h"
-#include "renderingManager.h"
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
+#include "movie.h"
 
 enum Button
 {
@@ -24,14 +26,40 @@ enum Button
 	BUTTON_SELECT,
 };
 
+#define CYCLES_PER_FRAME 70224
+// DMG frame rate: 4194304 Hz clock / 70224 cycles per frame
+#define DMG_FRAME_RATE (4194304.0 / CYCLES_PER_FRAME)
+
+class TranslatedCode;
+
+// why a run call returned
+enum StopReason
+{
+	STOP_CYCLES,     // cycle budget used up
+	STOP_VBLANK,     // the ppu entered vblank
+	STOP_SERIAL,     // a byte was sent over the serial port (mmu.serialOut)
+	STOP_BREAKPOINT, // pc reached a breakpoint, the instruction there has not run yet
+	STOP_WATCHPOINT, // the cpu wrote to a watched address (mmu.watchpointAddress)
+	STOP_PREDICATE,  // the runUntil predicate returned true
+	STOP_MOVIE       // nothing ran, a movie is recording or playing and only runFrame goes on with it
+};
+
+struct RunResult
+{
+	uint64_t cycles; // t-cycles actually executed, can overshoot the budget by the rest of the last instruction
+	StopReason reason;
+};
+
 class GameBoy
 {
 public:
-	GameBoy(GLFWwindow* window);
-	~GameBoy();
+	GameBoy();
 
 	// pass empty string to savePath if no save file
 	void readRom(const std::string path, const std::string savePath);
+	// loads a rom image that is already in memory (the data is copied). Does not touch the filesystem, so this is
+	// what frontends without files (tools, bindings) use.
+	bool loadRom(const uint8_t* data, size_t size);
 	
 	uint8_t fetch();
 	void decodeAndExecute(uint8_t opcode);
@@ -39,19 +67,15 @@ public:
 	void handleInterrupts();
 	bool isCPUHalted();
 
-	void checkForInput(GLFWwindow* window);
-	void checkCartridgeType();
-	void checkRomSize();
-	void checkSramSize();
+	void checkCartridgeType(std::ostream& log);
+	void checkRomSize(std::ostream& log);
+	void checkSramSize(std::ostream& log);
 	
-	bool keyPressed[379];
-	bool keyDown[379];
-
+	// press/release a single button, or replace the whole JOYPAD_* bitmask at once. The joypad register is only
+	// computed when the game reads it, and pressing a button the game is polling requests the joypad interrupt.
 	void enableInputRegisterBits(Button button);
 	void disableInputRegisterBits(Button button);
-
-	bool ssba = false;
-	bool dPad = false;
+	void setButtons(uint8_t buttons);
 
 	std::string filePath;
 
@@ -59,23 +83,147 @@ public:
 	void saveGame();
 	void loadSave(std::string path);
 
-	bool run();
-
-	void processInput();
+	// Save states, the format is described in saveState.h. saveState reuses out's capacity, so saving into the same
+	// vector again doesn't allocate. Without includeFrame the half drawn frame is left out, loading such a state
+	// keeps whatever the ppu was drawing. loadState returns false and leaves everything as it was if the state is
+	// truncated, from another version or made with another rom. The pointer version writes saveStateSize bytes to out.
+	void saveState(std::vector<uint8_t>& out, bool includeFrame = true);
+	void saveState(uint8_t* out, bool includeFrame = true);
+	size_t saveStateSize(bool includeFrame = true) const;
+	bool loadState(const uint8_t* data, size_t size);
+	// Hash of the state the game can see: cpu registers, cycle count, mapper registers, the memory regions, the i/o
+	// registers and the cartridge ram, in a fixed order (STATE_HASH_VERSION, movie.h). Movies store it, so it stays
+	// the same across builds, machines and changes to the state structs. fullStateHash also covers the internals
+	// (ppu fifos and fetcher, timers, dma) byte for byte, for comparing instances of the same build.
+	uint64_t stateHash() const;
+	uint64_t fullStateHash() const;
+
+	// Branching for search. The clone carries on exactly like this instance would, but independently: it shares the
+	// rom and the external ram with it (the ram until either side writes to it) and copies the cpu, mmu and ppu
+	// state, plus the half drawn frame when the ppu is mid frame. File paths are not copied, the clone isn't tied to
+	// a save file. cloneInto reuses an existing instance, so repeated branching doesn't allocate.
+	std::unique_ptr<GameBoy> clone() const;
+	void cloneInto(GameBoy& child) const;
+
+	// Bounded stepping. Every call runs at least one instruction and checks its exit conditions after each one,
+	// so it returns within an instruction of the event. Nothing here allocates or reads the host clock, the result
+	// only depends on the emulated state.
+	// runFrame stops at the start of vblank, or after a frame worth of cycles if the lcd is off.
+	RunResult runFrame();
+	RunResult runCycles(uint64_t cycles);
+	// predicate is called as predicate(const GameBoy&) after every instruction
+	template<typename Predicate>
+	RunResult runUntil(Predicate predicate, uint64_t maxCycles = UINT64_MAX)
+	{
+		if (activeMovie.mode != MOVIE_OFF)
+			return refuseDuringMovie();
+
+		return runLoop(maxCycles, stopEvents, predicate, true);
+	}
+
+	// Movies (movie.h), recorded and played by runFrame. A frame is a runFrame call that returns STOP_VBLANK or
+	// STOP_CYCLES, calls stopped earlier by serial, breakpoints or watchpoints go on with the same frame. Recording
+	// keeps the buttons held when each frame starts and, every hashInterval frames, the state hash. Playback sets the
+	// buttons at the start of each frame, overriding setButtons, and compares the hashes: movieSession.desyncFrame is
+	// the first frame that didn't match. A movie recorded at power on (cpu.tCycles == 0, blank cartridge ram) only
+	// plays on a freshly loaded rom, others load their start state. Both return false, with a message, if the movie can't start here.
+	// Rewind and run-ahead load states behind the movie's back, so they don't mix with one. runCycles and
+	// runUntil would run part of a frame behind its back, so they run nothing and return STOP_MOVIE while one is active.
+	bool startRecording(Movie& movie, uint32_t hashInterval = MOVIE_DEFAULT_HASH_INTERVAL);
+	bool startPlayback(const Movie& movie);
+	void stopMovie();
+	const MovieSession& movieSession() const { return activeMovie; }
+
+	// Code translated ahead of time by gb2cpp (translatedCode.h). Its blocks run instead of the interpreter where they
+	// start at the pc in the rom bank mapped right now, and the emulation is exactly the same. loadTranslatedCode
+	// loads a plugin made from the loaded rom and returns false, with a message, for any other. Clones share it,
+	// setTranslatedCode(nullptr) goes back to interpreting everything.
+	bool loadTranslatedCode(const std::string& path);
+	void setTranslatedCode(std::shared_ptr<const TranslatedCode> code);
+	const std::shared_ptr<const TranslatedCode>& translatedCode() const { return translated; }
+
+	// while set, collects the rom offsets reached by jp hl and by jumps and calls from bank 0 into the switchable bank,
+	// the entry points gb2cpp can't find by following the code. Everything is interpreted meanwhile.
+	std::unordered_set<uint32_t>* jumpTargets = nullptr;
+
+	// totals since power on, for throughput reporting (cpu.tCycles is the cycle count)
+	uint64_t instructionCount = 0;
+	uint64_t translatedInstructionCount = 0;
+	uint64_t haltedCycles = 0;
+
+	// EVENT_* bits that also end runCycles and runUntil, runFrame always adds EVENT_VBLANK
+	uint8_t stopEvents = EVENT_WATCHPOINT;
+
+	void addBreakpoint(uint16_t address);
+	void removeBreakpoint(uint16_t address);
+	void addWatchpoint(uint16_t address);
+	void removeWatchpoint(uint16_t address);
 
 	bool validRomLoaded = false;
-
-	double fpsLimit = 1.0 / 60.0;
-
-	bool restartRequested = false;
-	bool loadSaveRequested = false;
+	// loadRom prints the cartridge type and sizes and why a rom was refused
+	bool logCartridge = true;
 
 	std::string saveFilePath = "";
 
-	GLFWwindow* window;
-
 	MMU mmu;
 	PPU ppu;
-	CPU cpu; 
-	RenderingManager* renderingManager;
+	SystemBus bus;
+	CPU<SystemBus> cpu; 
+
+private:
+	std::bitset<0x10000> breakpoints;
+	unsigned int breakpointCount = 0;
+
+	static StopReason eventStopReason(uint8_t events);
+
+	uint64_t romHash() const;
+	RunResult refuseDuringMovie() const;
+	void movieFrameStart();
+	void movieFrameEnd();
+	MovieSession activeMovie;
+
+	std::shared_ptr<const TranslatedCode> translated;
+	// executes one instruction (or one m-cycle while halted) and services interrupts
+	void step();
+
+	// set after a jump recorded into jumpTargets, the next fetch is from its target
+	bool jumpPending = false;
+	// step that also collects jumpTargets, runLoop uses it instead of step and translated code while they are set
+	void profileStep();
+
+	// runs translated blocks from the pc, false if there is no block to run there
+	bool runTranslated(uint64_t endCycles, uint8_t eventMask, bool stepOnly);
+
+	// stepOnly: predicate has to see every instruction
+	template<typename Predicate>
+	RunResult runLoop(uint64_t budget, uint8_t eventMask, Predicate& predicate, bool stepOnly)
+	{
+		uint64_t start = cpu.tCycles;
+		uint64_t end = budget > UINT64_MAX - start ? UINT64_MAX : start + budget;
+		mmu.events = 0;
+
+		while (true)
+		{
+			// translated blocks run as many instructions as they can before one of the checks below would stop, while
+			// profiling everything is interpreted
+			if (jumpTargets)
+				profileStep();
+			else if (!translated || !runTranslated(end, eventMask, stepOnly))
+				step();
+
+			uint64_t executed = cpu.tCycles - start;
+
+			if (mmu.events & eventMask)
+				return { executed, eventStopReason(mmu.events & eventMask) };
+
+			if (breakpointCount && breakpoints[cpu.PC])
+				return { executed, STOP_BREAKPOINT };
+
+			if (predicate(static_cast<const GameBoy&>(*this)))
+				return { executed, STOP_PREDICATE };
+
+			if (executed >= budget)
+				return { executed, STOP_CYCLES };
+		}
+	}
 };
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <cstring>
+#include "hash.h"
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xFF51AFD7ED558CCDull;
+	k ^= k >> 33;
+	k *= 0xC4CEB9FE1A85EC53ull;
+	k ^= k >> 33;
+
+	return k;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	// two independent lanes so the multiplies of consecutive words can overlap
+	uint64_t h1 = seed ^ 0x9E3779B97F4A7C15ull;
+	uint64_t h2 = seed ^ 0x87C37B91114253D5ull;
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16)
+	{
+		uint64_t k1, k2;
+		memcpy(&k1, bytes + i, 8);
+		memcpy(&k2, bytes + i + 8, 8);
+
+		h1 = rotl64(h1 ^ (k1 * 0x87C37B91114253D5ull), 31) * 0x4CF5AD432745937Full;
+		h2 = rotl64(h2 ^ (k2 * 0x4CF5AD432745937Full), 33) * 0x87C37B91114253D5ull;
+	}
+
+	uint64_t tail = 0;
+	for (size_t shift = 0; i < size; i++, shift += 8)
+	{
+		tail |= (uint64_t)bytes[i] << (shift % 64);
+
+		if (shift % 64 == 56)
+		{
+			h1 = rotl64(h1 ^ (tail * 0x87C37B91114253D5ull), 31) * 0x4CF5AD432745937Full;
+			tail = 0;
+		}
+	}
+
+	h2 ^= tail * 0x4CF5AD432745937Full;
+
+	return fmix64(h1 ^ fmix64(h2 ^ size));
+}
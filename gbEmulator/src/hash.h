@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+// Fast non-cryptographic 64 bit hash used to tell frames and memory snapshots apart. The output only depends on the
+// bytes hashed, so it can be stored (movies, baselines) and compared across runs and builds.
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
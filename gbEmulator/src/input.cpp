@@ -0,0 +1,133 @@
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "input.h"
+
+static const char* buttonNames[8] = { "A", "B", "UP", "DOWN", "LEFT", "RIGHT", "START", "SELECT" };
+
+InputManager::InputManager(EmuThread& emuThread)
+	: emuThread(emuThread)
+{
+	bindings[BUTTON_A] = GLFW_KEY_X;
+	bindings[BUTTON_B] = GLFW_KEY_Z;
+	bindings[BUTTON_UP] = GLFW_KEY_UP;
+	bindings[BUTTON_DOWN] = GLFW_KEY_DOWN;
+	bindings[BUTTON_LEFT] = GLFW_KEY_LEFT;
+	bindings[BUTTON_RIGHT] = GLFW_KEY_RIGHT;
+	bindings[BUTTON_START] = GLFW_KEY_ENTER;
+	bindings[BUTTON_SELECT] = GLFW_KEY_BACKSPACE;
+}
+
+void InputManager::setBinding(Button button, int key)
+{
+	bindings[button] = key;
+}
+
+int InputManager::getBinding(Button button)
+{
+	return bindings[button];
+}
+
+void InputManager::loadBindings(const std::string& path)
+{
+	std::ifstream file(path);
+
+	if (!file)
+	{
+		return;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string name;
+		int key;
+
+		if (!(stream >> name >> key))
+		{
+			continue;
+		}
+
+		for (int i = 0; i < 8; i++)
+		{
+			if (name == buttonNames[i])
+			{
+				bindings[i] = key;
+			}
+		}
+	}
+}
+
+void InputManager::flushButtons()
+{
+	for (int i = 0; i < 8; i++)
+	{
+		uint8_t mask = 1 << i;
+		if ((buttons & mask) == (sentButtons & mask))
+		{
+			continue;
+		}
+
+		bool pressed = (buttons & mask) != 0;
+		if (!emuThread.inputEvents.push({ (Button)i, pressed }))
+		{
+			return;
+		}
+
+		sentButtons ^= mask;
+	}
+}
+
+void InputManager::onKey(int key, int action, int mods)
+{
+	// key repeat doesn't change anything for the game
+	if (action == GLFW_REPEAT)
+	{
+		return;
+	}
+
+	double start = glfwGetTime();
+	bool pressed = action == GLFW_PRESS;
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (bindings[i] != key)
+		{
+			continue;
+		}
+
+		uint8_t mask = 1 << i;
+		buttons = pressed ? (buttons | mask) : (buttons & ~mask);
+	}
+
+	flushButtons();
+
+	// game is saved automatically when the window closes, but there is also the option to save it manually
+	if (key == GLFW_KEY_F3 && pressed)
+	{
+		std::cout << "SAVING..." << "\n";
+		emuThread.sendCommand({ CMD_SAVE });
+	}
+
+	// F5-F8 save states to slots 1-4, shift + F5-F8 loads them
+	if (key >= GLFW_KEY_F5 && key <= GLFW_KEY_F8 && pressed)
+	{
+		Command command{ (mods & GLFW_MOD_SHIFT) ? CMD_LOAD_STATE : CMD_SAVE_STATE };
+		command.slot = key - GLFW_KEY_F5;
+		emuThread.sendCommand(command);
+	}
+
+	// holding R runs the game backwards
+	if (key == GLFW_KEY_R)
+	{
+		Command command{ CMD_SET_REWIND };
+		command.rewind = pressed;
+		emuThread.sendCommand(command);
+	}
+
+	inputTime += glfwGetTime() - start;
+	inputEvents++;
+}
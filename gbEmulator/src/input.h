@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <cinttypes>
+
+#include "emuThread.h"
+
+// Keyboard handling for the frontend. GLFW calls onKey for every key event, so nothing is polled per frame: the
+// bound keys update a compact button bitmask and every press/release is forwarded to the emulation thread as an
+// edge event. Hotkeys are turned into commands.
+class InputManager
+{
+public:
+	InputManager(EmuThread& emuThread);
+
+	// mods are GLFW_MOD_* bits
+	void onKey(int key, int action, int mods);
+
+	// keys are GLFW key codes
+	void setBinding(Button button, int key);
+	int getBinding(Button button);
+
+	// sends the buttons that changed since the emulation thread was last told, as edge events. A full queue only
+	// delays them: called again from onKey and every ui tick until they fit.
+	void flushButtons();
+
+	// reads "<button> <glfw key code>" lines (e.g. "A 88"), buttons are A, B, UP, DOWN, LEFT, RIGHT, START, SELECT.
+	// Missing file or unknown lines keep the defaults.
+	void loadBindings(const std::string& path);
+
+	// buttons currently held, one bit per Button
+	uint8_t buttons = 0;
+
+	// host time spent handling key events, for the stats menu
+	double inputTime = 0.0;
+	uint64_t inputEvents = 0;
+
+private:
+	EmuThread& emuThread;
+
+	// buttons as far as the emulation thread was told
+	uint8_t sentButtons = 0;
+
+	int bindings[8];
+};
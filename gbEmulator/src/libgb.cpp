@@ -0,0 +1,123 @@
+#define GB_BUILDING_LIBRARY
+#include <memory>
+#include "libgb.h"
+#include "gb.h"
+
+static_assert(GB_LCD_WIDTH == LCD_WIDTH && GB_LCD_HEIGHT == LCD_HEIGHT, "frame size is part of the abi");
+static_assert(GB_BUTTON_A == JOYPAD_A && GB_BUTTON_B == JOYPAD_B && GB_BUTTON_SELECT == JOYPAD_SELECT
+	&& GB_BUTTON_START == JOYPAD_START && GB_BUTTON_RIGHT == JOYPAD_RIGHT && GB_BUTTON_LEFT == JOYPAD_LEFT
+	&& GB_BUTTON_UP == JOYPAD_UP && GB_BUTTON_DOWN == JOYPAD_DOWN, "buttons are passed through to the core");
+
+struct gb_s
+{
+	std::unique_ptr<GameBoy> core = std::make_unique<GameBoy>();
+};
+
+int gb_abi_version(void)
+{
+	return GB_ABI_VERSION;
+}
+
+gb_t* gb_create(void)
+{
+	return new gb_s();
+}
+
+void gb_destroy(gb_t* gb)
+{
+	delete gb;
+}
+
+int gb_load_rom_from_memory(gb_t* gb, const void* data, size_t size)
+{
+	// a fresh core is the only way back to power on
+	gb->core = std::make_unique<GameBoy>();
+	gb->core->logCartridge = false;
+	return gb->core->loadRom((const uint8_t*)data, size) ? 1 : 0;
+}
+
+int gb_step_frame(gb_t* gb)
+{
+	GameBoy& core = *gb->core;
+	if (!core.validRomLoaded)
+		return GB_STOP_ERROR;
+
+	RunResult result = core.runFrame();
+
+	// the reader side of the frame buffer is ours, gb_framebuffer hands out its buffer until the next acquire
+	core.ppu.frameBuffer.acquire();
+
+	return result.reason == STOP_VBLANK ? GB_STOP_VBLANK : GB_STOP_CYCLES;
+}
+
+void gb_set_buttons(gb_t* gb, uint8_t buttons)
+{
+	gb->core->setButtons(buttons);
+}
+
+const uint8_t* gb_framebuffer(gb_t* gb)
+{
+	return gb->core->ppu.frameBuffer.readBuffer();
+}
+
+uint8_t* gb_ram_view(gb_t* gb, int region, size_t* size)
+{
+	MMU& mmu = gb->core->mmu;
+	uint8_t* data = nullptr;
+	size_t length = 0;
+
+	switch (region)
+	{
+	case GB_RAM_WORK:
+		data = mmu.wRam;
+		length = sizeof(mmu.wRam);
+		break;
+	case GB_RAM_VIDEO:
+		data = mmu.vRam;
+		length = sizeof(mmu.vRam);
+		break;
+	case GB_RAM_HIGH:
+		data = mmu.hRam;
+		length = sizeof(mmu.hRam);
+		break;
+	case GB_RAM_OAM:
+		data = mmu.oam;
+		length = sizeof(mmu.oam);
+		break;
+	case GB_RAM_EXTERNAL:
+		// a gb_t is never cloned, so this doesn't copy anything
+		data = mmu.eRam.mutableData();
+		length = mmu.eRam.size();
+		break;
+	}
+
+	if (size)
+		*size = length;
+	return data;
+}
+
+size_t gb_state_size(gb_t* gb)
+{
+	if (!gb->core->validRomLoaded)
+		return 0;
+
+	return gb->core->saveStateSize();
+}
+
+size_t gb_save_state(gb_t* gb, void* buffer, size_t capacity)
+{
+	if (!gb->core->validRomLoaded)
+		return 0;
+
+	size_t size = gb->core->saveStateSize();
+	if (capacity < size)
+		return 0;
+
+	gb->core->saveState((uint8_t*)buffer);
+	return size;
+}
+
+int gb_load_state(gb_t* gb, const void* buffer, size_t size)
+{
+	return gb->core->loadState((const uint8_t*)buffer, size) ? 1 : 0;
+}
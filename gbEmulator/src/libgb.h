@@ -0,0 +1,90 @@
+#pragma once
+
+// libgb: plain C interface to the emulator core, for driving it from other languages and runtimes. Every function
+// takes the handle from gb_create. Nothing here allocates after gb_load_rom_from_memory: stepping, reading the frame
+// and ram, and saving and loading states into caller buffers only touch memory that already exists.
+//
+// An instance is not thread safe, but different instances can be used from different threads at the same time.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(GB_BUILDING_LIBRARY)
+#define GB_API __declspec(dllexport)
+#else
+#define GB_API __declspec(dllimport)
+#endif
+#else
+#define GB_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bumped whenever a function signature or the meaning of a value changes
+#define GB_ABI_VERSION 1
+
+#define GB_LCD_WIDTH 160
+#define GB_LCD_HEIGHT 144
+
+// gb_set_buttons bits, a set bit is a held button
+#define GB_BUTTON_A      0x01
+#define GB_BUTTON_B      0x02
+#define GB_BUTTON_SELECT 0x04
+#define GB_BUTTON_START  0x08
+#define GB_BUTTON_RIGHT  0x10
+#define GB_BUTTON_LEFT   0x20
+#define GB_BUTTON_UP     0x40
+#define GB_BUTTON_DOWN   0x80
+
+// why gb_step_frame returned
+#define GB_STOP_CYCLES 0  // a frame worth of cycles ran with the lcd off, the frame buffer didn't change
+#define GB_STOP_VBLANK 1  // a new frame is complete
+#define GB_STOP_ERROR  -1 // no rom loaded
+
+// gb_ram_view regions
+#define GB_RAM_WORK     0 // 0xc000-0xdfff
+#define GB_RAM_VIDEO    1 // 0x8000-0x9fff
+#define GB_RAM_HIGH     2 // 0xff80-0xfffe
+#define GB_RAM_OAM      3 // 0xfe00-0xfe9f
+#define GB_RAM_EXTERNAL 4 // cartridge ram, all banks, empty for carts without any
+
+typedef struct gb_s gb_t;
+
+GB_API int gb_abi_version(void);
+
+GB_API gb_t* gb_create(void);
+GB_API void gb_destroy(gb_t* gb);
+
+// copies the rom image. Loading another rom starts over from power on. Returns 1 on success, 0 if the image isn't
+// a rom the core can run, including one shorter than its header says. Nothing is printed either way.
+GB_API int gb_load_rom_from_memory(gb_t* gb, const void* data, size_t size);
+
+// runs until the next frame is complete, returns a GB_STOP_* value
+GB_API int gb_step_frame(gb_t* gb);
+
+// GB_BUTTON_* bits held from now on
+GB_API void gb_set_buttons(gb_t* gb, uint8_t buttons);
+
+// the last completed frame, GB_LCD_WIDTH * GB_LCD_HEIGHT grey levels, one byte per pixel, rows top to bottom. The
+// pointer stays valid and its contents unchanged until the next gb_step_frame.
+GB_API const uint8_t* gb_framebuffer(gb_t* gb);
+
+// points straight at a memory region of the emulated machine, size gets its length in bytes. Writes go to the
+// emulated memory. Valid until the next gb_load_rom_from_memory or gb_destroy.
+GB_API uint8_t* gb_ram_view(gb_t* gb, int region, size_t* size);
+
+// bytes gb_save_state writes, constant for a loaded rom, 0 without one
+GB_API size_t gb_state_size(gb_t* gb);
+// writes the whole machine state into buffer, returns the bytes written or 0 if capacity is less than gb_state_size
+// or no rom is loaded
+GB_API size_t gb_save_state(gb_t* gb, void* buffer, size_t capacity);
+// returns 1 if the state was loaded, 0 if it is damaged or from another rom or version, leaving the instance as it was.
+// The buttons held when the state was saved are part of it.
+GB_API int gb_load_state(gb_t* gb, const void* buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,881 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include "lockstepCore.h"
+#include "regs.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LOCKSTEP_SSE2
+#endif
+
+#define FLAG_Z 0x80
+#define FLAG_N 0x40
+#define FLAG_H 0x20
+#define FLAG_C 0x10
+
+// one byte per lane. Masks are 0xFF in the lanes they select and 0x00 elsewhere.
+#ifdef LOCKSTEP_SSE2
+typedef __m128i Lanes;
+
+static inline Lanes lanesLoad(const uint8_t* p) { return _mm_load_si128((const __m128i*)p); }
+static inline void lanesStore(uint8_t* p, Lanes v) { _mm_store_si128((__m128i*)p, v); }
+static inline Lanes lanesSplat(uint8_t value) { return _mm_set1_epi8((char)value); }
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm_add_epi8(a, b); }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return _mm_sub_epi8(a, b); }
+static inline Lanes lanesAnd(Lanes a, Lanes b) { return _mm_and_si128(a, b); }
+static inline Lanes lanesAndNot(Lanes mask, Lanes a) { return _mm_andnot_si128(mask, a); }
+static inline Lanes lanesOr(Lanes a, Lanes b) { return _mm_or_si128(a, b); }
+static inline Lanes lanesXor(Lanes a, Lanes b) { return _mm_xor_si128(a, b); }
+static inline Lanes lanesEqual(Lanes a, Lanes b) { return _mm_cmpeq_epi8(a, b); }
+
+// unsigned a < b
+static inline Lanes lanesBelow(Lanes a, Lanes b)
+{
+	return _mm_xor_si128(_mm_cmpeq_epi8(_mm_max_epu8(a, b), a), _mm_set1_epi8(-1));
+}
+
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline Lanes lanesShiftRight1(Lanes a) { return _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7F)); }
+static inline Lanes lanesTopBit(Lanes a) { return _mm_cmplt_epi8(a, _mm_setzero_si128()); }
+static inline uint32_t lanesBits(Lanes mask) { return (uint32_t)_mm_movemask_epi8(mask); }
+
+static inline Lanes lanesFromBits(uint32_t bits)
+{
+	// every byte of a half gets that half's 8 bits, then each byte keeps its own
+	const __m128i select = _mm_set1_epi64x((long long)0x8040201008040201ull);
+	__m128i spread = _mm_set_epi64x((long long)((bits >> 8 & 0xFF) * 0x0101010101010101ull),
+		(long long)((bits & 0xFF) * 0x0101010101010101ull));
+	return _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+}
+#else
+struct Lanes
+{
+	uint8_t v[LOCKSTEP_LANES];
+};
+
+template<typename Op>
+static inline Lanes lanesMap(Lanes a, Lanes b, Op op)
+{
+	Lanes out;
+	for (int i = 0; i < LOCKSTEP_LANES; i++)
+		out.v[i] = (uint8_t)op(a.v[i], b.v[i]);
+	return out;
+}
+
+static inline Lanes lanesLoad(const uint8_t* p)
+{
+	Lanes out;
+	std::memcpy(out.v, p, LOCKSTEP_LANES);
+	return out;
+}
+
+static inline void lanesStore(uint8_t* p, Lanes v) { std::memcpy(p, v.v, LOCKSTEP_LANES); }
+
+static inline Lanes lanesSplat(uint8_t value)
+{
+	Lanes out;
+	std::memset(out.v, value, LOCKSTEP_LANES);
+	return out;
+}
+
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return lanesMap(a, b, [](int x, int y) { return x + y; }); }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return lanesMap(a, b, [](int x, int y) { return x - y; }); }
+static inline Lanes lanesAnd(Lanes a, Lanes b) { return lanesMap(a, b, [](int x, int y) { return x & y; }); }
+static inline Lanes lanesAndNot(Lanes mask, Lanes a) { return lanesMap(mask, a, [](int x, int y) { return ~x & y; }); }
+static inline Lanes lanesOr(Lanes a, Lanes b) { return lanesMap(a, b, [](int x, int y) { return x | y; }); }
+static inline Lanes lanesXor(Lanes a, Lanes b) { return lanesMap(a, b, [](int x, int y) { return x ^ y; }); }
+
+static inline Lanes lanesEqual(Lanes a, Lanes b)
+{
+	return lanesMap(a, b, [](int x, int y) { return x == y ? 0xFF : 0; });
+}
+
+static inline Lanes lanesBelow(Lanes a, Lanes b)
+{
+	return lanesMap(a, b, [](int x, int y) { return x < y ? 0xFF : 0; });
+}
+
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b)
+{
+	return lanesOr(lanesAnd(mask, a), lanesAndNot(mask, b));
+}
+
+static inline Lanes lanesShiftRight1(Lanes a) { return lanesMap(a, a, [](int x, int) { return x >> 1; }); }
+static inline Lanes lanesTopBit(Lanes a) { return lanesMap(a, a, [](int x, int) { return x & 0x80 ? 0xFF : 0; }); }
+
+static inline uint32_t lanesBits(Lanes mask)
+{
+	uint32_t bits = 0;
+	for (int i = 0; i < LOCKSTEP_LANES; i++)
+		bits |= (uint32_t)(mask.v[i] >> 7) << i;
+	return bits;
+}
+
+static inline Lanes lanesFromBits(uint32_t bits)
+{
+	Lanes out;
+	for (int i = 0; i < LOCKSTEP_LANES; i++)
+		out.v[i] = (bits >> i) & 1 ? 0xFF : 0x00;
+	return out;
+}
+#endif
+
+// mask of the lanes where all of bits are set
+static inline Lanes lanesHas(Lanes value, uint8_t bits)
+{
+	return lanesEqual(lanesAnd(value, lanesSplat(bits)), lanesSplat(bits));
+}
+
+// ADD ADC SUB SBC AND XOR OR CP on A of every lane, same results and flags as CPU::decodeAndExecute
+static void alu(uint8_t operation, Lanes a, Lanes b, Lanes f, Lanes& result, Lanes& flags)
+{
+	Lanes carryIn = lanesAnd(lanesHas(f, FLAG_C), lanesSplat(1));
+	Lanes carry = lanesSplat(0);
+	Lanes half = lanesSplat(0);
+	uint8_t subtract = 0;
+
+	switch (operation)
+	{
+		case 0:
+			result = lanesAdd(a, b);
+			carry = lanesBelow(result, a);
+			break;
+
+		case 1:
+		{
+			Lanes sum = lanesAdd(a, b);
+			result = lanesAdd(sum, carryIn);
+			carry = lanesOr(lanesBelow(sum, a), lanesBelow(result, sum));
+			break;
+		}
+
+		case 2: case 7:
+			result = lanesSub(a, b);
+			carry = lanesBelow(a, b);
+			subtract = FLAG_N;
+			break;
+
+		case 3:
+		{
+			Lanes difference = lanesSub(a, b);
+			result = lanesSub(difference, carryIn);
+			carry = lanesOr(lanesBelow(a, b), lanesBelow(difference, carryIn));
+			subtract = FLAG_N;
+			break;
+		}
+
+		case 4:
+			result = lanesAnd(a, b);
+			half = lanesSplat(FLAG_H);
+			break;
+
+		case 5:
+			result = lanesXor(a, b);
+			break;
+
+		default:
+			result = lanesOr(a, b);
+			break;
+	}
+
+	if (operation < 4 || operation == 7)
+	{
+		// bit 4 of a ^ b ^ result is the carry (or borrow) into bit 4
+		Lanes nibbleCarry = lanesAnd(lanesXor(lanesXor(a, b), result), lanesSplat(0x10));
+		half = lanesAdd(nibbleCarry, nibbleCarry);
+	}
+
+	Lanes zero = lanesAnd(lanesEqual(result, lanesSplat(0)), lanesSplat(FLAG_Z));
+	flags = lanesOr(lanesOr(zero, half), lanesOr(lanesAnd(carry, lanesSplat(FLAG_C)), lanesAnd(f, lanesSplat(0x0F))));
+	flags = lanesOr(flags, lanesSplat(subtract));
+}
+
+// opcodes stepVector has a vector version of
+static const std::array<bool, 256> vectorOpcodes = []()
+{
+	std::array<bool, 256> table{};
+
+	for (int opcode : {
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+		0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+		0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x28, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+		0x30, 0x31, 0x32, 0x33, 0x37, 0x38, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+		0xC1, 0xC2, 0xC3, 0xC5, 0xC6, 0xC9, 0xCA, 0xCD, 0xCE,
+		0xD1, 0xD2, 0xD5, 0xD6, 0xDA, 0xDE,
+		0xE0, 0xE1, 0xE2, 0xE5, 0xE6, 0xEA, 0xEE,
+		0xF0, 0xF1, 0xF2, 0xF5, 0xF6, 0xFA, 0xFE })
+		table[opcode] = true;
+
+	// ld r, r and alu a, r, the (hl) forms included, but not halt
+	for (int opcode = 0x40; opcode < 0xC0; opcode++)
+		table[opcode] = opcode != 0x76;
+
+	return table;
+}();
+
+LockstepCore::LockstepCore()
+	: rom(std::make_unique<uint8_t[]>(0x8000)),
+	  ram(std::make_unique<uint8_t[]>((size_t)LOCKSTEP_RAM_SIZE * LOCKSTEP_LANES))
+{
+	scalarBus.rom = rom.get();
+
+	CPUState powerOn;
+	for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+	{
+		setLaneState(lane, powerOn);
+		until[lane] = 0;
+		waited[lane] = 0;
+	}
+}
+
+void LockstepCore::loadRom(const uint8_t* data, size_t size)
+{
+	size = std::min<size_t>(size, 0x8000);
+	std::memcpy(rom.get(), data, size);
+	std::memset(rom.get() + size, 0, 0x8000 - size);
+	std::memset(ram.get(), 0, (size_t)LOCKSTEP_RAM_SIZE * LOCKSTEP_LANES);
+
+	CPUState powerOn;
+	for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+		setLaneState(lane, powerOn);
+
+	counters = LockstepStats();
+}
+
+CPUState LockstepCore::laneState(size_t lane) const
+{
+	CPUState state;
+	for (int r = 0; r < 8; r++)
+		state.regs[r] = regs[r][lane];
+
+	state.SP = sp[lane];
+	state.PC = pc[lane];
+	state.IME = ime[lane];
+	state.updateIME = updateIme[lane];
+	state.HALT = halted[lane];
+	state.tCycles = tCycles[lane];
+	return state;
+}
+
+void LockstepCore::setLaneState(size_t lane, const CPUState& state)
+{
+	for (int r = 0; r < 8; r++)
+		regs[r][lane] = state.regs[r];
+
+	sp[lane] = state.SP;
+	pc[lane] = state.PC;
+	ime[lane] = state.IME;
+	updateIme[lane] = state.updateIME;
+	halted[lane] = state.HALT;
+	tCycles[lane] = state.tCycles;
+}
+
+uint8_t LockstepCore::readLane(size_t lane, uint16_t address) const
+{
+	return address < 0x8000 ? rom[address] : ram[lane * LOCKSTEP_RAM_SIZE + address - 0x8000];
+}
+
+void LockstepCore::writeLane(size_t lane, uint16_t address, uint8_t value)
+{
+	if (address >= 0x8000)
+		ram[lane * LOCKSTEP_RAM_SIZE + address - 0x8000] = value;
+}
+
+void LockstepCore::run(uint64_t cycles)
+{
+	active = 0;
+	for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+	{
+		until[lane] = tCycles[lane] + cycles;
+		active |= (LaneMask)(!halted[lane] && cycles) << lane;
+	}
+
+	while (active)
+	{
+		LaneMask group = pickGroup(active);
+		uint16_t address = pc[std::countr_zero(group)];
+
+		if (std::popcount(group) > 1 && canVectorize(address))
+		{
+			if (group == active)
+				runTogether(group, address);
+			else
+				finishStep(group, stepVector(group, address), 0);
+		}
+		else
+		{
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+				stepScalar(std::countr_zero(bits));
+		}
+
+		for (LaneMask bits = group; bits; bits &= bits - 1)
+		{
+			int lane = std::countr_zero(bits);
+			if (halted[lane] || tCycles[lane] >= until[lane])
+				active &= ~((LaneMask)1 << lane);
+		}
+	}
+}
+
+// Every lane of group is at address. As long as they stay together only the shared pc and the cycles spent since
+// are kept, the lanes' own pc and tCycles are brought up to date once they split, run out of cycles or reach an
+// instruction without a vector version.
+void LockstepCore::runTogether(LaneMask group, uint16_t address)
+{
+	uint64_t budget = UINT64_MAX;
+	for (LaneMask bits = group; bits; bits &= bits - 1)
+	{
+		int lane = std::countr_zero(bits);
+		budget = std::min(budget, until[lane] - tCycles[lane]);
+	}
+
+	uint64_t spent = 0;
+	do
+	{
+		VectorStep step = stepVector(group, address);
+
+		if (step.pcPerLane)
+		{
+			address = pc[std::countr_zero(group)];
+
+			bool together = true;
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+				together = together && pc[std::countr_zero(bits)] == address;
+
+			if (!together)
+			{
+				finishStep(group, step, spent);
+				return;
+			}
+
+			spent += step.cycles;
+		}
+		else if (step.taken == 0)
+		{
+			address = step.next;
+			spent += step.cycles;
+		}
+		else if (step.taken == group)
+		{
+			address = step.target;
+			spent += step.takenCycles;
+		}
+		else
+		{
+			finishStep(group, step, spent);
+			return;
+		}
+	}
+	while (spent < budget && canVectorize(address));
+
+	for (LaneMask bits = group; bits; bits &= bits - 1)
+	{
+		int lane = std::countr_zero(bits);
+		pc[lane] = address;
+		tCycles[lane] += spent;
+	}
+}
+
+// moves the lanes of group on after step, plus spent cycles from before it
+void LockstepCore::finishStep(LaneMask group, const VectorStep& step, uint64_t spent)
+{
+	for (LaneMask bits = group; bits; bits &= bits - 1)
+	{
+		int lane = std::countr_zero(bits);
+		bool jumped = (step.taken >> lane) & 1;
+
+		if (!step.pcPerLane)
+			pc[lane] = jumped ? step.target : step.next;
+		tCycles[lane] += spent + (jumped ? step.takenCycles : step.cycles);
+	}
+}
+
+LockstepCore::LaneMask LockstepCore::pickGroup(LaneMask pending)
+{
+	auto lanesAt = [&](uint16_t address)
+	{
+		LaneMask lanes = 0;
+		for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+			lanes |= (LaneMask)(pc[lane] == address) << lane;
+		return lanes & pending;
+	};
+
+	LaneMask group = lanesAt(pc[std::countr_zero(pending)]);
+	if (group == pending)
+	{
+		if (waiting)
+		{
+			std::memset(waited, 0, sizeof(waited));
+			waiting = false;
+		}
+		return group;
+	}
+
+	// the lanes apart go lowest pc first, a lane that waited too long goes first instead
+	uint16_t lowest = 0xFFFF;
+	int starved = -1;
+	for (LaneMask bits = pending; bits; bits &= bits - 1)
+	{
+		int lane = std::countr_zero(bits);
+		lowest = std::min(lowest, pc[lane]);
+		if (starved < 0 && waited[lane] >= LOCKSTEP_MAX_WAIT)
+			starved = lane;
+	}
+
+	group = lanesAt(starved >= 0 ? pc[starved] : lowest);
+
+	for (LaneMask bits = pending; bits; bits &= bits - 1)
+	{
+		int lane = std::countr_zero(bits);
+		waited[lane] = (group >> lane) & 1 ? 0 : waited[lane] + 1;
+	}
+	waiting = true;
+
+	return group;
+}
+
+bool LockstepCore::canVectorize(uint16_t address) const
+{
+	// the instruction has to come from the shared rom, so every lane sees the same bytes
+	return address < 0x8000 - 2 && vectorOpcodes[rom[address]];
+}
+
+void LockstepCore::stepScalar(size_t lane)
+{
+	CPU<LaneBus>& cpu = scalarCpu;
+	scalarBus.ram = laneRam(lane);
+
+	for (int r = 0; r < 8; r++)
+		cpu.regs[r] = regs[r][lane];
+	cpu.SP = sp[lane];
+	cpu.PC = pc[lane];
+	cpu.IME = ime[lane];
+	cpu.updateIME = updateIme[lane];
+	cpu.HALT = false;
+	cpu.tCycles = tCycles[lane];
+
+	cpu.decodeAndExecute(cpu.fetch8());
+
+	for (int r = 0; r < 8; r++)
+		regs[r][lane] = cpu.regs[r];
+	sp[lane] = cpu.SP;
+	pc[lane] = cpu.PC;
+	ime[lane] = cpu.IME;
+	updateIme[lane] = cpu.updateIME;
+	halted[lane] = cpu.HALT;
+	tCycles[lane] = cpu.tCycles;
+
+	counters.scalarSteps++;
+}
+
+// runs the instruction at address for every lane of group, ret sets the lanes' pc, everything else is left to the
+// caller in the returned step
+LockstepCore::VectorStep LockstepCore::stepVector(LaneMask group, uint16_t address)
+{
+	uint8_t opcode = rom[address];
+	uint8_t u8 = rom[address + 1];
+	uint16_t u16 = u8 | (rom[address + 2] << 8);
+
+	Lanes mask = lanesFromBits(group);
+	Lanes f = lanesLoad(regs[REG_F]);
+
+	auto setReg = [&](int r, Lanes value) { lanesStore(regs[r], lanesSelect(mask, value, lanesLoad(regs[r]))); };
+	auto pair = [&](int hi, size_t lane) { return (uint16_t)((regs[hi][lane] << 8) | regs[hi + 1][lane]); };
+	auto setPair = [&](int hi, size_t lane, uint16_t value)
+	{
+		regs[hi][lane] = value >> 8;
+		regs[hi + 1][lane] = value & 0xFF;
+	};
+
+	// a pending ei takes effect before the instruction, like in CPU::decodeAndExecute
+	Lanes pendingIme = lanesAnd(mask, lanesLoad(updateIme));
+	lanesStore(ime, lanesOr(lanesLoad(ime), lanesAnd(pendingIme, lanesSplat(1))));
+	lanesStore(updateIme, lanesAndNot(mask, lanesLoad(updateIme)));
+
+	// where the lanes go and what it costs them, lanes in taken go to target for takenCycles instead
+	uint16_t next = address + 1;
+	uint32_t cycles = 4;
+	uint16_t target = 0;
+	uint32_t takenCycles = 0;
+	LaneMask taken = 0;
+	bool pcPerLane = false;
+
+	auto condition = [&](uint8_t cc)
+	{
+		LaneMask set = lanesBits(lanesHas(f, cc < 2 ? FLAG_Z : FLAG_C));
+		return (cc & 1 ? set : ~set) & group;
+	};
+
+	switch (opcode)
+	{
+		// NOP
+		case 0x00:
+			break;
+
+		// LD r16, u16
+		case 0x01: case 0x11: case 0x21: case 0x31:
+		{
+			uint8_t r16 = (opcode >> 4) & 3;
+			if (r16 == 3)
+			{
+				for (LaneMask bits = group; bits; bits &= bits - 1)
+					sp[std::countr_zero(bits)] = u16;
+			}
+			else
+			{
+				setReg(r16 * 2, lanesSplat(u16 >> 8));
+				setReg(r16 * 2 + 1, lanesSplat(u16 & 0xFF));
+			}
+
+			next = address + 3;
+			cycles = 12;
+			break;
+		}
+
+		// LD (r16), A and LD A, (r16), hl+ and hl- for r16 2 and 3
+		case 0x02: case 0x12: case 0x22: case 0x32:
+		case 0x0A: case 0x1A: case 0x2A: case 0x3A:
+		{
+			uint8_t r16 = (opcode >> 4) & 3;
+			bool load = opcode & 0x08;
+
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+			{
+				size_t lane = std::countr_zero(bits);
+				uint16_t pointer = pair(r16 < 2 ? r16 * 2 : REG_H, lane);
+
+				if (load)
+					regs[REG_A][lane] = readLane(lane, pointer);
+				else
+					writeLane(lane, pointer, regs[REG_A][lane]);
+
+				if (r16 == 2)
+					setPair(REG_H, lane, pointer + 1);
+				else if (r16 == 3)
+					setPair(REG_H, lane, pointer - 1);
+			}
+
+			cycles = 8;
+			break;
+		}
+
+		// INC r16 and DEC r16
+		case 0x03: case 0x13: case 0x23: case 0x33:
+		case 0x0B: case 0x1B: case 0x2B: case 0x3B:
+		{
+			uint8_t r16 = (opcode >> 4) & 3;
+			bool decrement = opcode & 0x08;
+
+			if (r16 == 3)
+			{
+				for (LaneMask bits = group; bits; bits &= bits - 1)
+					sp[std::countr_zero(bits)] += decrement ? -1 : 1;
+			}
+			else
+			{
+				Lanes lo = lanesLoad(regs[r16 * 2 + 1]);
+				Lanes hi = lanesLoad(regs[r16 * 2]);
+
+				// the high byte moves when the low byte wraps, the equal mask is -1
+				if (decrement)
+				{
+					hi = lanesAdd(hi, lanesEqual(lo, lanesSplat(0)));
+					lo = lanesSub(lo, lanesSplat(1));
+				}
+				else
+				{
+					lo = lanesAdd(lo, lanesSplat(1));
+					hi = lanesSub(hi, lanesEqual(lo, lanesSplat(0)));
+				}
+
+				setReg(r16 * 2, hi);
+				setReg(r16 * 2 + 1, lo);
+			}
+
+			cycles = 8;
+			break;
+		}
+
+		// INC r8
+		case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C:
+		{
+			uint8_t r8 = (opcode >> 3) & 7;
+			Lanes value = lanesAdd(lanesLoad(regs[r8]), lanesSplat(1));
+
+			Lanes zero = lanesAnd(lanesEqual(value, lanesSplat(0)), lanesSplat(FLAG_Z));
+			Lanes half = lanesAnd(lanesEqual(lanesAnd(value, lanesSplat(0x0F)), lanesSplat(0)), lanesSplat(FLAG_H));
+
+			setReg(r8, value);
+			setReg(REG_F, lanesOr(lanesAnd(f, lanesSplat(0x1F)), lanesOr(zero, half)));
+			break;
+		}
+
+		// DEC r8
+		case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D:
+		{
+			uint8_t r8 = (opcode >> 3) & 7;
+			Lanes before = lanesLoad(regs[r8]);
+			Lanes value = lanesSub(before, lanesSplat(1));
+
+			Lanes zero = lanesAnd(lanesEqual(value, lanesSplat(0)), lanesSplat(FLAG_Z));
+			Lanes half = lanesAnd(lanesEqual(lanesAnd(before, lanesSplat(0x0F)), lanesSplat(0)), lanesSplat(FLAG_H));
+
+			setReg(r8, value);
+			setReg(REG_F, lanesOr(lanesAnd(f, lanesSplat(0x1F)), lanesOr(lanesSplat(FLAG_N), lanesOr(zero, half))));
+			break;
+		}
+
+		// LD r8, u8
+		case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E:
+			setReg((opcode >> 3) & 7, lanesSplat(u8));
+			next = address + 2;
+			cycles = 8;
+			break;
+
+		// RLCA, RRCA, RLA and RRA
+		case 0x07: case 0x0F: case 0x17: case 0x1F:
+		{
+			Lanes a = lanesLoad(regs[REG_A]);
+			bool right = opcode & 0x08;
+			bool throughCarry = opcode & 0x10;
+
+			Lanes carry = right ? lanesEqual(lanesAnd(a, lanesSplat(1)), lanesSplat(1)) : lanesTopBit(a);
+			Lanes in = throughCarry ? lanesHas(f, FLAG_C) : carry;
+
+			if (right)
+				a = lanesOr(lanesShiftRight1(a), lanesAnd(in, lanesSplat(0x80)));
+			else
+				a = lanesOr(lanesAdd(a, a), lanesAnd(in, lanesSplat(1)));
+
+			setReg(REG_A, a);
+			setReg(REG_F, lanesOr(lanesAnd(f, lanesSplat(0x0F)), lanesAnd(carry, lanesSplat(FLAG_C))));
+			break;
+		}
+
+		// JR i8
+		case 0x18:
+			next = address + 2 + (int8_t)u8;
+			cycles = 12;
+			break;
+
+		// JR cc, i8
+		case 0x20: case 0x28: case 0x30: case 0x38:
+			taken = condition((opcode >> 3) & 3);
+			target = address + 2 + (int8_t)u8;
+			next = address + 2;
+			cycles = 8;
+			takenCycles = 12;
+			break;
+
+		// CPL
+		case 0x2F:
+			setReg(REG_A, lanesXor(lanesLoad(regs[REG_A]), lanesSplat(0xFF)));
+			setReg(REG_F, lanesOr(f, lanesSplat(FLAG_N | FLAG_H)));
+			break;
+
+		// SCF
+		case 0x37:
+			setReg(REG_F, lanesOr(lanesAnd(f, lanesSplat(0x8F)), lanesSplat(FLAG_C)));
+			break;
+
+		// CCF
+		case 0x3F:
+			setReg(REG_F, lanesXor(lanesAnd(f, lanesSplat(0x9F)), lanesSplat(FLAG_C)));
+			break;
+
+		// POP r16
+		case 0xC1: case 0xD1: case 0xE1: case 0xF1:
+		{
+			uint8_t r16 = (opcode >> 4) & 3;
+			int hi = r16 == 3 ? REG_A : r16 * 2;
+			int lo = r16 == 3 ? REG_F : r16 * 2 + 1;
+
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+			{
+				size_t lane = std::countr_zero(bits);
+				uint8_t low = readLane(lane, sp[lane]++);
+				regs[lo][lane] = r16 == 3 ? low & 0xF0 : low;
+				regs[hi][lane] = readLane(lane, sp[lane]++);
+			}
+
+			cycles = 12;
+			break;
+		}
+
+		// PUSH r16
+		case 0xC5: case 0xD5: case 0xE5: case 0xF5:
+		{
+			uint8_t r16 = (opcode >> 4) & 3;
+			int hi = r16 == 3 ? REG_A : r16 * 2;
+			int lo = r16 == 3 ? REG_F : r16 * 2 + 1;
+
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+			{
+				size_t lane = std::countr_zero(bits);
+				writeLane(lane, --sp[lane], regs[hi][lane]);
+				writeLane(lane, --sp[lane], r16 == 3 ? regs[lo][lane] & 0xF0 : regs[lo][lane]);
+			}
+
+			cycles = 16;
+			break;
+		}
+
+		// JP cc, u16
+		case 0xC2: case 0xCA: case 0xD2: case 0xDA:
+			taken = condition((opcode >> 3) & 3);
+			target = u16;
+			next = address + 3;
+			cycles = 12;
+			takenCycles = 16;
+			break;
+
+		// JP u16
+		case 0xC3:
+			next = u16;
+			cycles = 16;
+			break;
+
+		// CALL u16
+		case 0xCD:
+		{
+			uint16_t back = address + 3;
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+			{
+				size_t lane = std::countr_zero(bits);
+				writeLane(lane, --sp[lane], back >> 8);
+				writeLane(lane, --sp[lane], back & 0xFF);
+			}
+
+			next = u16;
+			cycles = 24;
+			break;
+		}
+
+		// RET
+		case 0xC9:
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+			{
+				size_t lane = std::countr_zero(bits);
+				uint8_t lsb = readLane(lane, sp[lane]++);
+				uint8_t msb = readLane(lane, sp[lane]++);
+				pc[lane] = (msb << 8) | lsb;
+			}
+
+			pcPerLane = true;
+			cycles = 16;
+			break;
+
+		// LD (FF00+u8), A, LD (FF00+C), A and LD (u16), A
+		case 0xE0: case 0xE2: case 0xEA:
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+			{
+				size_t lane = std::countr_zero(bits);
+				uint16_t pointer = opcode == 0xEA ? u16 : 0xFF00 | (opcode == 0xE0 ? u8 : regs[REG_C][lane]);
+				writeLane(lane, pointer, regs[REG_A][lane]);
+			}
+
+			next = address + (opcode == 0xEA ? 3 : opcode == 0xE0 ? 2 : 1);
+			cycles = opcode == 0xEA ? 16 : opcode == 0xE0 ? 12 : 8;
+			break;
+
+		// LD A, (FF00+u8), LD A, (FF00+C) and LD A, (u16)
+		case 0xF0: case 0xF2: case 0xFA:
+			for (LaneMask bits = group; bits; bits &= bits - 1)
+			{
+				size_t lane = std::countr_zero(bits);
+				uint16_t pointer = opcode == 0xFA ? u16 : 0xFF00 | (opcode == 0xF0 ? u8 : regs[REG_C][lane]);
+				regs[REG_A][lane] = readLane(lane, pointer);
+			}
+
+			next = address + (opcode == 0xFA ? 3 : opcode == 0xF0 ? 2 : 1);
+			cycles = opcode == 0xFA ? 16 : opcode == 0xF0 ? 12 : 8;
+			break;
+
+		// ALU A, u8
+		case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+		{
+			uint8_t operation = (opcode >> 3) & 7;
+			Lanes result, flags;
+			alu(operation, lanesLoad(regs[REG_A]), lanesSplat(u8), f, result, flags);
+
+			if (operation != 7)
+				setReg(REG_A, result);
+			setReg(REG_F, flags);
+
+			next = address + 2;
+			cycles = 8;
+			break;
+		}
+
+		// LD r8, r8 (0x40-0x7F) and ALU A, r8 (0x80-0xBF), (hl) operands included
+		default:
+		{
+			uint8_t src = opcode & 7;
+			Lanes value;
+
+			if (src == 6)
+			{
+				alignas(16) uint8_t loaded[LOCKSTEP_LANES] = {};
+				for (LaneMask bits = group; bits; bits &= bits - 1)
+				{
+					size_t lane = std::countr_zero(bits);
+					loaded[lane] = readLane(lane, pair(REG_H, lane));
+				}
+
+				value = lanesLoad(loaded);
+				cycles = 8;
+			}
+			else
+			{
+				value = lanesLoad(regs[src]);
+			}
+
+			if (opcode < 0x80)
+			{
+				uint8_t dest = (opcode >> 3) & 7;
+				if (dest == 6)
+				{
+					for (LaneMask bits = group; bits; bits &= bits - 1)
+					{
+						size_t lane = std::countr_zero(bits);
+						writeLane(lane, pair(REG_H, lane), regs[src][lane]);
+					}
+					cycles = 8;
+				}
+				else
+				{
+					setReg(dest, value);
+				}
+			}
+			else
+			{
+				uint8_t operation = (opcode >> 3) & 7;
+				Lanes result, flags;
+				alu(operation, lanesLoad(regs[REG_A]), value, f, result, flags);
+
+				if (operation != 7)
+					setReg(REG_A, result);
+				setReg(REG_F, flags);
+			}
+			break;
+		}
+	}
+
+	counters.vectorSteps++;
+	counters.vectorLaneSteps += std::popcount(group);
+
+	VectorStep step;
+	step.next = next;
+	step.cycles = cycles;
+	step.taken = taken;
+	step.target = target;
+	step.takenCycles = takenCycles;
+	step.pcPerLane = pcPerLane;
+	return step;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "cpu.h"
+
+// lanes of a LockstepCore, one 128 bit register holds an 8 bit cpu register of every lane
+#define LOCKSTEP_LANES 16
+#define LOCKSTEP_RAM_SIZE 0x8000
+// steps a lane waits for the lanes behind it before it gets a turn of its own
+#define LOCKSTEP_MAX_WAIT 64
+
+struct LockstepStats
+{
+	// instructions issued once for every lane at the same pc, and how many lanes they ran for in total
+	uint64_t vectorSteps = 0;
+	uint64_t vectorLaneSteps = 0;
+	// instructions run one lane at a time on the scalar cpu
+	uint64_t scalarSteps = 0;
+};
+
+// Experimental cpu only core that runs LOCKSTEP_LANES copies of one program with different data, for when many
+// instances of a rom spend most of their time at the same pc. The cpu state is kept as structure of arrays, one
+// 16 byte row per 8 bit register, and an instruction that all lanes at a pc are about to execute is decoded once and
+// executed for all of them with SSE2. A lane whose pc differs from the others falls out to the scalar CPU<LaneBus>
+// and rejoins the group when its pc matches again. To get lanes back together after a branch the lanes at the lowest
+// pc run first, which lines them up at the end of an if and at the exit of a loop; lanes ahead wait for at most
+// LOCKSTEP_MAX_WAIT steps. Instructions without a vector version (cb prefix, daa, rst, interrupts and a few more) and
+// code outside the rom always run lane by lane.
+//
+// Memory is the rom's first 32 KiB at 0x0000-0x7FFF, shared and read only, and a page of LOCKSTEP_RAM_SIZE bytes per
+// lane at 0x8000-0xFFFF (LaneBus). There is no ppu, timer, mbc or interrupt, so this runs compute kernels rather than
+// games, and a lane that halts stays halted. Every lane ends up in exactly the state the scalar cpu would leave it in.
+class LockstepCore
+{
+public:
+	LockstepCore();
+
+	// maps the first 32 KiB of the image at 0x0000, every lane starts at 0x0100 with the cpu's power on registers
+	void loadRom(const uint8_t* data, size_t size);
+
+	// registers, sp, pc, ime, halt and tCycles of a lane, the rest of CPUState is left at its defaults
+	CPUState laneState(size_t lane) const;
+	void setLaneState(size_t lane, const CPUState& state);
+
+	// the lane's memory at 0x8000-0xFFFF
+	uint8_t* laneRam(size_t lane) { return ram.get() + lane * LOCKSTEP_RAM_SIZE; }
+
+	// runs every lane until it has executed at least cycles t-cycles more or halted
+	void run(uint64_t cycles);
+
+	const LockstepStats& stats() const { return counters; }
+
+private:
+	// bit i for lane i
+	typedef uint32_t LaneMask;
+
+	// where an instruction run by stepVector sends its lanes and what it costs them
+	struct VectorStep
+	{
+		uint16_t next;
+		uint32_t cycles;
+		// lanes that took a conditional branch, they go to target for takenCycles instead
+		LaneMask taken = 0;
+		uint16_t target = 0;
+		uint32_t takenCycles = 0;
+		// ret, every lane's pc was loaded from its own stack
+		bool pcPerLane = false;
+	};
+
+	LaneMask pickGroup(LaneMask pending);
+	bool canVectorize(uint16_t address) const;
+	void runTogether(LaneMask group, uint16_t address);
+	VectorStep stepVector(LaneMask group, uint16_t address);
+	void finishStep(LaneMask group, const VectorStep& step, uint64_t spent);
+	void stepScalar(size_t lane);
+
+	uint8_t readLane(size_t lane, uint16_t address) const;
+	void writeLane(size_t lane, uint16_t address, uint8_t value);
+
+	// regs[REG_*][lane]
+	alignas(16) uint8_t regs[8][LOCKSTEP_LANES];
+	alignas(16) uint8_t ime[LOCKSTEP_LANES];
+	alignas(16) uint8_t updateIme[LOCKSTEP_LANES];
+	uint16_t sp[LOCKSTEP_LANES];
+	uint16_t pc[LOCKSTEP_LANES];
+	uint64_t tCycles[LOCKSTEP_LANES];
+	bool halted[LOCKSTEP_LANES];
+
+	// end of the current run per lane, the lanes that haven't reached it or halted, and how many steps each lane has
+	// waited for the others
+	uint64_t until[LOCKSTEP_LANES];
+	LaneMask active = 0;
+	uint32_t waited[LOCKSTEP_LANES];
+	bool waiting = false;
+
+	std::unique_ptr<uint8_t[]> rom;
+	std::unique_ptr<uint8_t[]> ram;
+
+	LaneBus scalarBus;
+	CPU<LaneBus> scalarCpu{ scalarBus };
+
+	LockstepStats counters;
+};
@@ -127,6 +127,10 @@ uint8_t MMU::read8(uint16_t address)
 	{
 		return 0xFF;
 	}
+	else if (address == JOYPAD_ADDRESS)
+	{
+		return readJoypad();
+	}
 	else if (address >= 0xFF00 && address <= 0xFF7F)
 	{
 		return ioRegs[address - 0xFF00];
@@ -238,6 +242,9 @@ void MMU::write8(uint16_t address, uint8_t value)
 			{
 				romBankNumber = value & 127;
 			}
+
+			// banks past the end of the rom mirror the ones below, like the unconnected address lines on a cartridge
+			romBankNumber %= romNumOfBanks;
 		}
 
 		if (address >= 0x4000 && address <= 0x5FFF)
@@ -292,12 +299,12 @@ void MMU::write8(uint16_t address, uint8_t value)
 
 		if (address >= 0x2000 && address <= 0x2FFF)
 		{
-			romBankNumber = (romBankNumber & ~(0xFF)) | value;
+			romBankNumber = ((romBankNumber & ~(0xFF)) | value) % romNumOfBanks;
 		}
 
 		if (address >= 0x3000 && address <= 0x3FFF)
 		{
-			romBankNumber = (romBankNumber & ~(1 << 8)) | ((value & 1) << 8);
+			romBankNumber = ((romBankNumber & ~(1 << 8)) | ((value & 1) << 8)) % romNumOfBanks;
 		}
 
 		if (address >= 0x4000 && address <= 0x5FFF)
@@ -329,7 +336,7 @@ void MMU::write8(uint16_t address, uint8_t value)
 	{
 		if (mbc == MBC0)
 		{
-			eRam[address - 0xA000] = value;
+			eRam.write(address - 0xA000, value);
 		}
 		else if (mbc == MBC1)
 		{
@@ -337,17 +344,17 @@ void MMU::write8(uint16_t address, uint8_t value)
 			{
 				if (sRamSize == 0x800 || sRamSize == 0x2000)
 				{
-					eRam[(address - 0xA000) % sRamSize] = value;
+					eRam.write((address - 0xA000) % sRamSize, value);
 				}
 				else if (sRamSize == 0x8000)
 				{
 					if (modeFlag == 1)
 					{
-						eRam[0x2000 * ramBankNumber + (address - 0xA000)] = value;
+						eRam.write(0x2000 * ramBankNumber + (address - 0xA000), value);
 					}
 					else
 					{
-						eRam[address - 0xA000] = value;
+						eRam.write(address - 0xA000, value);
 					}
 				}
 			}
@@ -387,7 +394,7 @@ void MMU::write8(uint16_t address, uint8_t value)
 				}
 				else
 				{
-					eRam[0x2000 * ramBankNumber + (address - 0xA000)] = value;
+					eRam.write(0x2000 * ramBankNumber + (address - 0xA000), value);
 				}
 			}
 		}
@@ -395,7 +402,7 @@ void MMU::write8(uint16_t address, uint8_t value)
 		{
 			if (sRamEnabled)
 			{
-				eRam[0x2000 * ramBankNumber + (address - 0xA000)] = value;
+				eRam.write(0x2000 * ramBankNumber + (address - 0xA000), value);
 			}
 		}
 	}
@@ -411,6 +418,12 @@ void MMU::write8(uint16_t address, uint8_t value)
 	{					
 		oam[address - 0xFE00] = value;				
 	}												
+	else if (address == JOYPAD_ADDRESS)
+	{
+		// only the select bits are writable, the button lines are computed on read
+		ioRegs[0] = value & 0x30;
+		updateJoypadLines();
+	}
 	else if (address >= 0xFF00 && address <= 0xFF7F)
 	{
 		ioRegs[address - 0xFF00] = value;
@@ -425,6 +438,44 @@ void MMU::write8(uint16_t address, uint8_t value)
 	}
 }
 
+void MMU::setButtons(uint8_t buttons)
+{
+	joypadButtons = buttons;
+	updateJoypadLines();
+}
+
+uint8_t MMU::readJoypad()
+{
+	uint8_t select = ioRegs[0] & 0x30;
+	uint8_t pressed = 0;
+
+	// bit 5 low selects the action buttons, bit 4 low selects the d-pad. Pressed buttons pull their line low.
+	if (!(select & 0x20))
+	{
+		pressed |= joypadButtons & 0x0F;
+	}
+
+	if (!(select & 0x10))
+	{
+		pressed |= joypadButtons >> 4;
+	}
+
+	return 0xC0 | select | (~pressed & 0x0F);
+}
+
+void MMU::updateJoypadLines()
+{
+	uint8_t lines = readJoypad() & 0x0F;
+
+	// the joypad interrupt is requested when any of the selected lines goes from high to low
+	if (joypadLines & ~lines)
+	{
+		requestInterrupt(JOYPAD);
+	}
+
+	joypadLines = lines;
+}
+
 void MMU::requestInterrupt(Interrupt type)
 {
 	uint8_t IF = read8(IF_ADDRESS);
@@ -457,6 +508,34 @@ bool MMU::isInterruptEnabled(Interrupt type)
 	return (IE >> type) & 1;
 }
 
+int32_t MMU::romOffset(uint16_t address)
+{
+	uint32_t offset;
+
+	if (address <= 0x3FFF)
+		offset = mbc == MBC1 && modeFlag != 0 ? 0x4000 * getMBC1ZeroBankNumber() + address : address;
+	else if (address <= 0x7FFF)
+	{
+		switch (mbc)
+		{
+		case MBC1:
+			offset = 0x4000 * getMBC1HighBankNumber() + (address - 0x4000);
+			break;
+		case MBC3:
+		case MBC5:
+			offset = 0x4000 * romBankNumber + (address - 0x4000);
+			break;
+		default:
+			offset = address;
+			break;
+		}
+	}
+	else
+		return -1;
+
+	return romImage && offset < romImage->size() ? (int32_t)offset : -1;
+}
+
 void MMU::dmaTransfer(unsigned int count)
 {
 	uint8_t value = read8(dmaSource + (count - 1));
@@ -1,6 +1,11 @@
 #pragma once 
 #include <cinttypes>
 #include <vector>
+#include <bitset>
+#include <memory>
+
+#include "cowBuffer.h"
+#include "saveState.h"
 
 #define DIV_ADDRESS 0xFF04
 #define TIMA_ADDRESS 0xFF05
@@ -8,6 +13,25 @@
 #define TAC_ADDRESS 0xFF07
 #define IF_ADDRESS 0xFF0F
 #define IE_ADDRESS 0xFFFF
+#define JOYPAD_ADDRESS 0xFF00
+#define SB_ADDRESS 0xFF01
+#define SC_ADDRESS 0xFF02
+#define SERIAL_TRANSFER_CYCLES 4096
+
+// button bitmask, laid out like the joypad register: low nibble is the action buttons, high nibble the d-pad
+#define JOYPAD_A      0x01
+#define JOYPAD_B      0x02
+#define JOYPAD_SELECT 0x04
+#define JOYPAD_START  0x08
+#define JOYPAD_RIGHT  0x10
+#define JOYPAD_LEFT   0x20
+#define JOYPAD_UP     0x40
+#define JOYPAD_DOWN   0x80
+
+// events raised while emulating, GameBoy's run functions stop on the ones they are asked to watch
+#define EVENT_VBLANK     0x01
+#define EVENT_SERIAL     0x02
+#define EVENT_WATCHPOINT 0x04
 
 enum Interrupt
 {
@@ -26,59 +50,39 @@ enum MBC
 	MBC5
 };
 
-class MMU
+// Memory and mapper registers that change while the game runs, what a save state has to restore. Rom, cartridge
+// type and the external ram (a vector sized by the cartridge) stay in MMU. The padding is spelled out like in CPUState.
+struct MMUState
 {
-public:
-
-	uint8_t testArray[0x10000];
-
-	uint8_t bootrom[0x0100]; // --> this overlaps the rom when the program starts up and then handles control over to the actual 
-	// cartridge rom at pc = 0x100. At the beginning when pc is at 0x00 - 0x100 range read boot rom array. Once pc reaches 0x100 subsequent memory
-	// reads the cartridge array. Could probably be done with just a bool ex: if(pc == 0x0100 && !bootromDone) bootromDone = true
-	
-	uint8_t rom0[0x4000]; // 16 KiB ROM bank 00 and 16 KiB ROM Bank 01NN 
-
-	uint8_t romBanks[0x4000];
-
-	uint8_t vRam[0x2000]; // 8 KiB Video RAM (VRAM)
-	std::vector<uint8_t> eRam; // --> external ram can have variable size depending on mbc
-	uint8_t wRam[0x2000]; // 8 KiB Work RAM(WRAM)
+	uint8_t vRam[0x2000]{}; // 8 KiB Video RAM (VRAM)
+	uint8_t wRam[0x2000]{}; // 8 KiB Work RAM(WRAM)
 
 	// 0xE000 - 0xFDFF --> echo ram just read from wram --> wRam[address - 0xE000]
 
-	uint8_t oam[0x00A0];  // Object attribute memory (OAM)
-	uint8_t ioRegs[0x0080]; // I/O Registers
-	uint8_t hRam[0x007F]; // High RAM (HRAM)
-	uint8_t ie[0x0001]; // --> FFFF interrupt enable register (IE)
-
-	std::vector<uint8_t> fullrom;
+	uint8_t oam[0x00A0]{};  // Object attribute memory (OAM)
+	uint8_t ioRegs[0x0080]{}; // I/O Registers
+	uint8_t hRam[0x007F]{}; // High RAM (HRAM)
+	uint8_t ie[0x0001]{}; // --> FFFF interrupt enable register (IE)
 
-	MBC mbc;
-	
 	bool sRamEnabled = false;
+	uint8_t padding0 = 0;
 	
 	uint16_t romBankNumber = 1;
 	uint8_t ramBankNumber = 0;
+	uint8_t padding1 = 0;
 	uint16_t highBankNumber = 0;
 	uint16_t zeroBankNumber = 0;
 	bool modeFlag = 0;
 
 	uint8_t mappedRTCRegister = 0;
 
-	bool cartridgeHasRTC = false;
-	bool cartridgeHasRumble = false;
-
 	bool rumbleEnabled = false;
+	uint8_t padding2[3]{};
 
 	unsigned int rtcCycleCounter = 0;
 
-	unsigned int romNumOfBanks = 0;
-	unsigned int sRamSize = 0;
-	unsigned int sRamNumOfBanks = 0;
-
-	bool cartHasBattery = false;
-
 	uint8_t lastLatchWrite = 0;
+	uint8_t padding3 = 0;
 
 	struct RTC
 	{
@@ -92,6 +96,7 @@ public:
 		uint8_t dl = 0;
 		// bit 0 --> bit 8 of the day counter | bit 6 --> timer halt bit | bit 7 --> day counter carry bit
 		uint8_t dh = 0;
+		uint8_t padding = 0;
 		// whole 9-bit rtc day counter;
 		uint16_t rtcDayCounter = 0;
 	} rtc;
@@ -107,13 +112,68 @@ public:
 
 	bool latchOccurred = false;
 
+	// buttons currently held (JOYPAD_* bits). The joypad register is only built from this when 0xFF00 is read, so the
+	// frontend can change it at any time without touching the register.
+	uint8_t joypadButtons = 0;
+	// P10-P13 as seen on the last update, used to detect the high to low transitions that raise the joypad interrupt
+	uint8_t joypadLines = 0x0F;
+
+	// last byte the game started sending over the serial port
+	uint8_t serialOut = 0;
+
+	bool dmaTransferRequested = false;
+	unsigned int dmaDelay = 0;
+	uint16_t dmaSource = 0;
+	uint8_t padding4[2]{};
+};
+
+// GameBoy::cloneInto copies the members outside MMUState one by one, a new one has to be added there
+class MMU : public MMUState
+{
+public:
+
+	uint8_t bootrom[0x0100]{}; // --> this overlaps the rom when the program starts up and then handles control over to the actual 
+	// cartridge rom at pc = 0x100. At the beginning when pc is at 0x00 - 0x100 range read boot rom array. Once pc reaches 0x100 subsequent memory
+	// reads the cartridge array. Could probably be done with just a bool ex: if(pc == 0x0100 && !bootromDone) bootromDone = true
+	
+	// external ram can have variable size depending on mbc. Clones share it until one of them writes to it.
+	CowBuffer eRam;
+
+	// the rom is never written, so clones share it. fullrom points at its bytes and is what reads go through.
+	std::shared_ptr<const std::vector<uint8_t>> romImage;
+	const uint8_t* fullrom = nullptr;
+
+	MBC mbc = MBC0;
+	
+	bool cartridgeHasRTC = false;
+	bool cartridgeHasRumble = false;
+
+	unsigned int romNumOfBanks = 0;
+	unsigned int sRamSize = 0;
+	unsigned int sRamNumOfBanks = 0;
+
+	bool cartHasBattery = false;
+
+	void setButtons(uint8_t buttons);
+	uint8_t readJoypad();
+	void updateJoypadLines();
+
+	// EVENT_* bits raised since the run loop last cleared them
+	uint8_t events = 0;
+
+	// cpu writes to these addresses raise EVENT_WATCHPOINT
+	std::bitset<0x10000> watchpoints;
+	unsigned int watchpointCount = 0;
+	uint16_t watchpointAddress = 0;
+
 	// whenever we read using pc increase pc --> read8(PC++)
 	uint8_t read8(uint16_t address);
 	void write8(uint16_t address, uint8_t value);
 
-	bool dmaTransferRequested = false;
-	unsigned int dmaDelay = 0;
-	uint16_t dmaSource;
+	// where in the rom image a read of address lands with the banks mapped right now, -1 outside 0x0000-0x7FFF or
+	// past the end of the image. Updates the mbc1 bank numbers exactly like read8 does.
+	int32_t romOffset(uint16_t address);
+
 	void dmaTransfer(unsigned int count);
 
 	// sets the corresponding bit in IF
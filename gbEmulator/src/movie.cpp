@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "gb.h"
+#include "hash.h"
+#include "movie.h"
+
+std::vector<uint8_t> Movie::serialize() const
+{
+	MovieHeader header{};
+	header.magic = MOVIE_MAGIC;
+	header.version = MOVIE_VERSION;
+	header.romHash = romHash;
+	header.frameCount = (uint32_t)buttons.size();
+	header.hashInterval = hashInterval;
+	header.startStateSize = (uint32_t)startState.size();
+	header.hashCount = (uint32_t)stateHashes.size();
+
+	std::vector<uint8_t> out(sizeof(header) + startState.size() + buttons.size()
+		+ stateHashes.size() * sizeof(uint64_t));
+
+	uint8_t* p = out.data();
+	std::memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+
+	if (!startState.empty())
+		std::memcpy(p, startState.data(), startState.size());
+	p += startState.size();
+
+	if (!buttons.empty())
+		std::memcpy(p, buttons.data(), buttons.size());
+	p += buttons.size();
+
+	if (!stateHashes.empty())
+		std::memcpy(p, stateHashes.data(), stateHashes.size() * sizeof(uint64_t));
+
+	return out;
+}
+
+bool Movie::deserialize(const uint8_t* data, size_t size)
+{
+	MovieHeader header;
+	if (size < sizeof(header))
+		return false;
+
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != MOVIE_MAGIC || header.version != MOVIE_VERSION)
+		return false;
+
+	uint64_t expectedSize = sizeof(header) + (uint64_t)header.startStateSize + header.frameCount
+		+ (uint64_t)header.hashCount * sizeof(uint64_t);
+	if (size != expectedSize)
+		return false;
+
+	const uint8_t* p = data + sizeof(header);
+
+	romHash = header.romHash;
+	hashInterval = header.hashInterval;
+
+	startState.assign(p, p + header.startStateSize);
+	p += header.startStateSize;
+
+	buttons.assign(p, p + header.frameCount);
+	p += header.frameCount;
+
+	stateHashes.resize(header.hashCount);
+	if (header.hashCount)
+		std::memcpy(stateHashes.data(), p, header.hashCount * sizeof(uint64_t));
+
+	return true;
+}
+
+bool Movie::save(const std::string& path) const
+{
+	std::vector<uint8_t> data = serialize();
+
+	std::ofstream os(path, std::ios::binary);
+	os.write((const char*)data.data(), data.size());
+	return (bool)os;
+}
+
+bool Movie::load(const std::string& path)
+{
+	std::ifstream is(path, std::ios::binary);
+	if (!is)
+		return false;
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+	return deserialize(data.data(), data.size());
+}
+
+// power on with blank cartridge ram, a battery save loaded with the rom has to go in the movie as a start state
+static bool atPowerOn(const GameBoy& gb)
+{
+	const CowBuffer& ram = gb.mmu.eRam;
+	return gb.cpu.tCycles == 0 && std::all_of(ram.data(), ram.data() + ram.size(), [](uint8_t b) { return b == 0; });
+}
+
+uint64_t GameBoy::romHash() const
+{
+	return mmu.romImage ? hashBytes(mmu.romImage->data(), mmu.romImage->size()) : 0;
+}
+
+bool GameBoy::startRecording(Movie& movie, uint32_t hashInterval)
+{
+	if (!validRomLoaded)
+		return false;
+
+	movie.romHash = romHash();
+	movie.hashInterval = hashInterval;
+	movie.buttons.clear();
+	movie.stateHashes.clear();
+
+	// at power on the rom is all it takes to get back here, otherwise the state goes in the movie
+	if (atPowerOn(*this))
+		movie.startState.clear();
+	else
+		saveState(movie.startState);
+
+	activeMovie = MovieSession();
+	activeMovie.mode = MOVIE_RECORDING;
+	activeMovie.recording = &movie;
+	return true;
+}
+
+bool GameBoy::startPlayback(const Movie& movie)
+{
+	if (!validRomLoaded)
+		return false;
+
+	if (movie.romHash != romHash())
+	{
+		std::cout << "movie: recorded with a different rom\n";
+		return false;
+	}
+
+	if (movie.startState.empty())
+	{
+		// there is no way back to power on, a fresh instance has to play these
+		if (!atPowerOn(*this))
+		{
+			std::cout << "movie: starts at power on with blank cartridge ram, play it on a freshly loaded rom\n";
+			return false;
+		}
+	}
+	else if (!loadState(movie.startState.data(), movie.startState.size()))
+	{
+		std::cout << "movie: the start state doesn't load\n";
+		return false;
+	}
+
+	activeMovie = MovieSession();
+	activeMovie.mode = MOVIE_PLAYING;
+	activeMovie.playing = &movie;
+	return true;
+}
+
+void GameBoy::stopMovie()
+{
+	activeMovie.mode = MOVIE_OFF;
+	activeMovie.recording = nullptr;
+	activeMovie.playing = nullptr;
+}
+
+RunResult GameBoy::refuseDuringMovie() const
+{
+	std::cout << "movie: only runFrame runs while a movie is recording or playing\n";
+	return { 0, STOP_MOVIE };
+}
+
+void GameBoy::movieFrameStart()
+{
+	if (activeMovie.mode == MOVIE_RECORDING)
+	{
+		activeMovie.recording->buttons.push_back(mmu.joypadButtons);
+		return;
+	}
+
+	const Movie& movie = *activeMovie.playing;
+	if (activeMovie.frame < movie.frames())
+	{
+		setButtons(movie.buttons[activeMovie.frame]);
+	}
+	else if (!activeMovie.finished)
+	{
+		activeMovie.finished = true;
+		setButtons(0);
+	}
+}
+
+void GameBoy::movieFrameEnd()
+{
+	uint32_t frame = activeMovie.frame++;
+
+	uint32_t interval = activeMovie.mode == MOVIE_RECORDING
+		? activeMovie.recording->hashInterval
+		: activeMovie.playing->hashInterval;
+	if (interval == 0 || (frame + 1) % interval != 0)
+		return;
+
+	if (activeMovie.mode == MOVIE_RECORDING)
+	{
+		activeMovie.recording->stateHashes.push_back(stateHash());
+		return;
+	}
+
+	const Movie& movie = *activeMovie.playing;
+	size_t index = (frame + 1) / interval - 1;
+
+	if (activeMovie.desyncFrame < 0 && index < movie.stateHashes.size() && stateHash() != movie.stateHashes[index])
+	{
+		activeMovie.desyncFrame = frame;
+		std::cout << "movie: desync, the state after frame " << frame << " doesn't match the recording\n";
+	}
+}
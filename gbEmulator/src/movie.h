@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Movie file layout: a MovieHeader, the start state (a save state, none for movies that start at power on), one
+// JOYPAD_* byte per frame and then hashCount state hashes. Hash k is GameBoy::stateHash() after frame
+// (k + 1) * hashInterval - 1, so playback can tell where it stopped matching the recording.
+#define MOVIE_MAGIC   0x564D4247 // "GBMV"
+#define MOVIE_VERSION 2
+
+// hashed first by GameBoy::stateHash, bump it (and MOVIE_VERSION) whenever what that hash covers changes
+#define STATE_HASH_VERSION 1
+
+// one hash a second, 8 bytes against the 60 bytes of buttons
+#define MOVIE_DEFAULT_HASH_INTERVAL 60
+
+struct MovieHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	// hashBytes of the whole rom image
+	uint64_t romHash;
+	uint32_t frameCount;
+	uint32_t hashInterval; // 0 for no hashes
+	uint32_t startStateSize; // 0 for power on
+	uint32_t hashCount;
+};
+
+class Movie
+{
+public:
+	uint64_t romHash = 0;
+	// save state the movie starts from, empty when it starts at power on
+	std::vector<uint8_t> startState;
+	// JOYPAD_* buttons held during each frame
+	std::vector<uint8_t> buttons;
+	uint32_t hashInterval = 0;
+	std::vector<uint64_t> stateHashes;
+
+	size_t frames() const { return buttons.size(); }
+
+	std::vector<uint8_t> serialize() const;
+	// false if data is truncated or not a version MOVIE_VERSION movie, the movie is left as it was then
+	bool deserialize(const uint8_t* data, size_t size);
+
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+};
+
+enum MovieMode
+{
+	MOVIE_OFF,
+	MOVIE_RECORDING,
+	MOVIE_PLAYING
+};
+
+// what GameBoy keeps about the movie it is recording or playing
+struct MovieSession
+{
+	MovieMode mode = MOVIE_OFF;
+	Movie* recording = nullptr;
+	const Movie* playing = nullptr;
+
+	// frames completed since the movie started
+	uint32_t frame = 0;
+	// a runFrame call stopped before the end of the frame (serial, breakpoint, watchpoint), the next one goes on
+	// with the same frame and its buttons
+	bool inFrame = false;
+	// first frame whose state hash didn't match the movie's, -1 while playback is in sync
+	int64_t desyncFrame = -1;
+	// playback went past the movie's last frame, nothing is pressed from there on
+	bool finished = false;
+};
@@ -1,5 +1,4 @@
 #include <iostream>
-#include <glad/glad.h>
 #include "ppu.h"
 
 #define OAM_START_ADDRESS 0xFE00
@@ -9,12 +8,10 @@
 #define STAT_ADDRESS 0xFF41
 
 PPU::PPU(MMU& mmu) 
-	: mmu(mmu), window(window)
+	: mmu(mmu)
 {
+	LCD = frameBuffer.writeBuffer();
 	setLY(0);
-	oamByteBuffer.reserve(4);
-	spPixelFIFO.reserve(8);
-	spritesBuffer.reserve(10);
 };
 
 void PPU::statInterruptCheck()
@@ -265,13 +262,6 @@ void PPU::setSTATCoincidenceFlag(bool b)
 	mmu.write8(STAT_ADDRESS, stat);
 }
 
-void PPU::draw()
-{
-	glBindTexture(GL_TEXTURE_2D, displayTexture);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 160, 144, GL_RED, GL_UNSIGNED_BYTE, &LCD[0]);
-	glBindTexture(GL_TEXTURE_2D, 0);
-}
-
 void PPU::oamScan()
 {
 	if (scanlineCycles <= 80 && ppuMode != VBLANK_1)
@@ -441,9 +431,16 @@ void PPU::prepareNextScanline()
 
 void PPU::enterVBlank()
 {
-	draw();
+	// hand the finished frame over to the presenter and start drawing the next one into a free buffer
+	if (publishFrames)
+	{
+		frameBuffer.publish();
+		LCD = frameBuffer.writeBuffer();
+	}
+
 	setMode(VBLANK_1);
 	mmu.requestInterrupt(VBLANK);
+	mmu.events |= EVENT_VBLANK;
 	windowLineCounter = 0;
 	wyEqualLyThisFrame = false;
 	wyEqualLy = false;
@@ -2,13 +2,11 @@
 
 #include <iostream>
 #include <vector>
-#include <queue>
 #include <memory>
 #include "mmu.h"
-
-#define GLFW_INCLUDE_NONE
-
-#include <GLFW/glfw3.h>
+#include "frameBuffer.h"
+#include "fixedContainers.h"
+#include "saveState.h"
 
 enum MODE
 {
@@ -28,15 +26,18 @@ enum PALETTE
 	BGP
 };
 
+// Pixel, Sprite and PPUState spell out their padding like CPUState
 struct Pixel
 {
 	// color number (ignoring the palette) --> color value from tile data
-	uint8_t colorNum;
-	PALETTE palette;
-	uint8_t xPos;
+	uint8_t colorNum = 0;
+	uint8_t padding0[3]{};
+	PALETTE palette = OBP0;
+	uint8_t xPos = 0;
 	
 	// for CGB there is also a sprite priority thing
-	uint8_t backgroundPrio; // only relevant for sprites keeps the value of bit7 (obj to bg prio) of the sprite flags
+	uint8_t backgroundPrio = 0; // only relevant for sprites keeps the value of bit7 (obj to bg prio) of the sprite flags
+	uint8_t padding1[2]{};
 };
 
 
@@ -55,12 +56,14 @@ struct Sprite
 
 	uint8_t yPos; // byte 0
 	uint8_t xPos; // byte 1
+	uint8_t padding0[2]{};
 	unsigned int tileNum; // byte 2
 
 	uint8_t height;
 
 	// byte 3
 	SpriteFlags flags;
+	uint8_t padding1[3]{};
 };
 
 enum DRAWINGSTATE
@@ -77,16 +80,11 @@ enum DRAWINGSTATE
 	SP_FETCH_TILE_HIGH_AND_PUSH,
 };
 
-class PPU
+// everything the ppu needs to carry on from where it was, kept apart from the frame buffer and the mmu reference so
+// save states can copy it in one go
+struct PPUState
 {
-public:
-	PPU(MMU& mmu);
-
-	void tick();
-
-	void statInterruptCheck();
-
-	std::vector<Sprite> spritesBuffer;
+	FixedVector<Sprite, 10> spritesBuffer;
 	unsigned int oamScanCounter = 0;
 
 	unsigned int bgFetchTileNumCycles = 0;
@@ -102,28 +100,26 @@ public:
 	DRAWINGSTATE bgDrawingState = BG_FETCH_TILE_NUM;
 	DRAWINGSTATE spDrawingState = SP_FETCH_TILE_NUM;
 
-	unsigned int currentBgTileNumber;
+	unsigned int currentBgTileNumber = 0;
 	unsigned int fetcherXPositionCounter = 0;
 
 	int scanlineDrawnPixels = 0;
 
 	MODE ppuMode = OAM_SCAN_2;
 
-	std::queue<Pixel> bgPixelFIFO;
+	FixedQueue<Pixel, 16> bgPixelFIFO;
 	// using a vector instead of a queue because we have to replace transparent obj pixels with opaque ones
-	std::vector<Pixel> spPixelFIFO;
+	FixedVector<Pixel, 8> spPixelFIFO;
 
-	std::vector<uint8_t> oamByteBuffer;
+	FixedVector<uint8_t, 4> oamByteBuffer;
 
-	Sprite spriteBeingFetched;
-	uint16_t spFetchFirstByteAddress;
-	uint8_t spFetchFirstByte;
-	uint8_t spFetchSecondByte;
+	Sprite spriteBeingFetched{};
+	uint16_t spFetchFirstByteAddress = 0;
+	uint8_t spFetchFirstByte = 0;
+	uint8_t spFetchSecondByte = 0;
 
 	bool displayDisabled = false;
 
-	void setMode(MODE mode);
-
 	bool displayWasEnabledBefore = false;
 
 	bool lycEqualLy = false;
@@ -132,15 +128,61 @@ public:
 	bool oldStat = false;
 	bool curStat = true;
 
-	unsigned int shaderProgram;
-	unsigned int displayTexture;
-	unsigned int VAO;
-
 	bool lastSpriteTall = false;
+	uint8_t padding0 = 0;
 
 	// count scanline cycles;
 	int scanlineCycles = 0;
 
+	uint16_t bgFetchFirstByteAddress = 0;
+	bool firstBgFetch = true;
+	bool spriteFound = false;
+	bool displayOff = false;
+
+	uint8_t bgFetchFirstByte = 0;
+	uint8_t bgFetchSecondByte = 0;
+	uint8_t padding1 = 0;
+
+	unsigned int windowLineCounter = 0;
+
+	int pixelsToBeDiscarded = 0;
+	int numOfPixelsDiscarded = 0;
+
+	int LX = 0;
+
+	bool wyEqualLy = false;
+	bool wyEqualLyThisFrame = false;
+	bool resetForWindowFetch = false;
+	bool windowPixelWasDrawn = false;
+	bool calculateDiscardedPixels = true;
+
+	bool spriteFetchEnabled = false;
+
+	bool discardPixels = true;
+	uint8_t padding2 = 0;
+
+	int hBlankDuration = 0;
+	bool exittedDrawingMode = false;
+	bool firstHBlankCycle = true;
+	uint8_t padding3[2]{};
+	unsigned int currentSpTileNumber = 0;
+
+	FixedQueue<Pixel, 32> bgFetchBuffer;
+
+	int vBlankCycleCounter = 0;
+};
+
+class PPU : public PPUState
+{
+public:
+	PPU(MMU& mmu);
+
+	void tick();
+
+	void statInterruptCheck();
+
+	void setMode(MODE mode);
+
 	bool isDisplayEnabled();
 	bool windowTileMapSelect();
 	bool isWindowDisplayEnabled();
@@ -175,16 +217,6 @@ public:
 	void firstBgFetchDiscard();
 	void pushToLCD();
 
-	uint16_t bgFetchFirstByteAddress;
-	bool firstBgFetch = true;
-	bool spriteFound = false;
-	bool displayOff = false;
-
-	uint8_t bgFetchFirstByte;
-	uint8_t bgFetchSecondByte;
-
-	unsigned int windowLineCounter = 0;
-
 	uint8_t getSCX();
 	uint8_t getSCY();
 	uint8_t getLY();
@@ -198,39 +230,16 @@ public:
 
 	uint8_t getPixelColor(PALETTE p, uint8_t colorID);
 
-	uint8_t LCD[160 * 144];
+	// finished frames are published here at the start of VBlank, LCD points to the buffer currently being drawn
+	FrameBuffer frameBuffer;
+	uint8_t* LCD;
 
-	int pixelsToBeDiscarded = 0;
-	int numOfPixelsDiscarded = 0;
-
-	int LX = 0;
-
-	bool wyEqualLy = false;
-	bool wyEqualLyThisFrame = false;
-	bool resetForWindowFetch = false;
-	bool windowPixelWasDrawn = false;
-	bool calculateDiscardedPixels = true;
-
-	bool spriteFetchEnabled = false;
-
-	bool discardPixels = true;
-
-	int hBlankDuration = 0;
-	bool exittedDrawingMode = false;
-	bool firstHBlankCycle = true;
-	unsigned int currentSpTileNumber;
-
-	std::queue<Pixel> bgFetchBuffer;
-
-	GLFWwindow* window;
-
-	int vBlankCycleCounter = 0;
+	// frame skipping: while false finished frames are neither hashed nor published, the next frame is drawn over them.
+	// Not part of save states, it belongs to whoever drives the core.
+	bool publishFrames = true;
 
 	uint8_t colors[4] =  { 227, 152, 78, 20 };
 
-	void draw();
-
 private:
 	MMU& mmu;
 };
-
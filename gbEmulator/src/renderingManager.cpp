@@ -1,4 +1,5 @@
 #include <imgui.h>
+#include <imgui_internal.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include "renderingManager.h"
@@ -6,19 +7,24 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <cstdlib>
 #include <glad/glad.h>
 #include <tinyfiledialogs.h>
 
-#include "gb.h"
+#include "app.h"
 
-RenderingManager::RenderingManager(GameBoy& gb) : gb(gb) {}
+RenderingManager::RenderingManager(App& app) : app(app) {}
 
 void RenderingManager::init(GLFWwindow* window)
 {
 	createShaderProgram();
 	createVAO();
 	createDisplayTexture();
+    createUploadBuffers();
     initUI(window);
+
+    glGenQueries(1, &gpuTimerQuery);
 }
 
 
@@ -28,6 +34,115 @@ RenderingManager::~RenderingManager()
     glDeleteBuffers(1, &vbo);
     glDeleteProgram(shader);
     glDeleteTextures(1, &displayTexture);
+    glDeleteQueries(1, &gpuTimerQuery);
+
+    for (int i = 0; i < UPLOAD_RING_SIZE; i++)
+    {
+        if (uploadFences[i])
+            glDeleteSync((GLsync)uploadFences[i]);
+    }
+
+    if (uploadBuffer)
+    {
+        if (persistentMapping)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &uploadBuffer);
+    }
+}
+
+void RenderingManager::createUploadBuffers()
+{
+    const GLsizeiptr slotSize = LCD_WIDTH * LCD_HEIGHT;
+    const GLsizeiptr ringSize = slotSize * UPLOAD_RING_SIZE;
+
+    // pick the best path the context supports. GB_UPLOAD_PATH=direct|mapped|persistent overrides it, which is handy
+    // to compare the paths on a given driver
+    bool canMap = GLAD_GL_VERSION_3_2;
+    bool canPersist = GLAD_GL_VERSION_4_4 && glBufferStorage != nullptr;
+
+    uploadPath = canPersist ? UPLOAD_PERSISTENT_PBO : canMap ? UPLOAD_MAPPED_PBO : UPLOAD_DIRECT;
+
+    if (const char* forced = std::getenv("GB_UPLOAD_PATH"))
+    {
+        std::string path = forced;
+
+        if (path == "direct")
+            uploadPath = UPLOAD_DIRECT;
+        else if (path == "mapped" && canMap)
+            uploadPath = UPLOAD_MAPPED_PBO;
+        else if (path == "persistent" && canPersist)
+            uploadPath = UPLOAD_PERSISTENT_PBO;
+        else
+            std::cout << "GB_UPLOAD_PATH=" << path << " is not supported by this context, using " << uploadPathName() << "\n";
+    }
+
+    if (uploadPath != UPLOAD_DIRECT)
+    {
+        glGenBuffers(1, &uploadBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+
+        if (uploadPath == UPLOAD_PERSISTENT_PBO)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringSize, nullptr, flags);
+            persistentMapping = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringSize, flags);
+
+            if (!persistentMapping)
+            {
+                // some drivers advertise buffer storage but refuse the mapping, fall back to mapping every frame
+                glDeleteBuffers(1, &uploadBuffer);
+                glGenBuffers(1, &uploadBuffer);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+                uploadPath = UPLOAD_MAPPED_PBO;
+            }
+        }
+
+        if (uploadPath == UPLOAD_MAPPED_PBO)
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, ringSize, nullptr, GL_STREAM_DRAW);
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    std::cout << "Frame upload path: " << uploadPathName() << "\n";
+}
+
+void RenderingManager::waitForUploadSlot(int slot)
+{
+    if (!uploadFences[slot])
+    {
+        return;
+    }
+
+    GLsync fence = (GLsync)uploadFences[slot];
+
+    // with a ring of 3 the GPU is normally long done with this slot, only count it as a stall if we actually wait
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        stats.uploadStalls++;
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    }
+
+    glDeleteSync(fence);
+    uploadFences[slot] = nullptr;
+}
+
+const char* RenderingManager::uploadPathName()
+{
+    switch (uploadPath)
+    {
+    case UPLOAD_MAPPED_PBO:
+        return "mapped PBO";
+    case UPLOAD_PERSISTENT_PBO:
+        return "persistent PBO";
+    default:
+        return "direct";
+    }
 }
 
 void RenderingManager::createDisplayTexture()
@@ -35,13 +150,194 @@ void RenderingManager::createDisplayTexture()
     glGenTextures(1, &displayTexture);
     glBindTexture(GL_TEXTURE_2D, displayTexture);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, 160, 144, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, LCD_WIDTH, LCD_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+// exponential moving average so the stats follow the current load without keeping a history around
+static void updateAverage(double& average, double sample)
+{
+    average = average == 0.0 ? sample : average * 0.95 + sample * 0.05;
+}
+
+bool RenderingManager::uploadFrame(FrameBuffer& frameBuffer)
+{
+    if (!frameBuffer.acquire())
+    {
+        return false;
+    }
+
+    // menus, text boxes and pauses keep producing the exact same frame, no need to send it to the GPU again
+    if (displayTextureValid && frameBuffer.readHash() == displayedFrameHash)
+    {
+        stats.uploadsSkipped++;
+        return false;
+    }
+
+    double uploadStart = glfwGetTime();
+
+    glBindTexture(GL_TEXTURE_2D, displayTexture);
+
+    if (uploadPath != UPLOAD_DIRECT)
+    {
+        const GLsizeiptr slotSize = LCD_WIDTH * LCD_HEIGHT;
+        GLintptr offset = uploadSlot * slotSize;
+
+        waitForUploadSlot(uploadSlot);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+
+        uint8_t* slotMemory;
+        if (uploadPath == UPLOAD_PERSISTENT_PBO)
+        {
+            slotMemory = persistentMapping + offset;
+        }
+        else
+        {
+            // the fence already guarantees the GPU is done with this slot, so the driver doesn't need to synchronise
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+            slotMemory = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, slotSize, flags);
+        }
+
+        if (slotMemory)
+        {
+            memcpy(slotMemory, frameBuffer.readBuffer(), slotSize);
+
+            if (uploadPath == UPLOAD_MAPPED_PBO)
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            // with a pixel unpack buffer bound the data argument is an offset into the buffer
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LCD_WIDTH, LCD_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, (void*)offset);
+
+            uploadFences[uploadSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            uploadSlot = (uploadSlot + 1) % UPLOAD_RING_SIZE;
+        }
+        else
+        {
+            std::cout << "Failed to map pixel buffer, uploading frames directly" << "\n";
+            uploadPath = UPLOAD_DIRECT;
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (uploadPath == UPLOAD_DIRECT)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LCD_WIDTH, LCD_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, frameBuffer.readBuffer());
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    updateAverage(stats.avgUploadCpuTime, glfwGetTime() - uploadStart);
+    stats.uploads++;
+
+    displayedFrameHash = frameBuffer.readHash();
+    displayTextureValid = true;
+
+    return true;
+}
+
+bool RenderingManager::needsRedraw(bool frameChanged)
+{
+    // any mouse/keyboard/focus event queued for ImGui since the last frame may change what the UI looks like
+    if (GImGui->InputEventsQueue.Size > 0)
+    {
+        uiSettleFrames = 3;
+    }
+
+    bool uiActive = ImGui::GetIO().WantCaptureMouse || ImGui::IsPopupOpen("", ImGuiPopupFlags_AnyPopupId);
+
+    if (frameChanged || forceRedraw || uiActive || uiSettleFrames > 0)
+    {
+        return true;
+    }
+
+    stats.redrawsSkipped++;
+    return false;
+}
+
+void RenderingManager::redraw(bool drawScreen)
+{
+    double redrawStart = glfwGetTime();
+
+    // read back the gpu time of the previous redraw without stalling, it is only used for the stats
+    if (gpuTimerPending)
+    {
+        GLuint available = 0;
+        glGetQueryObjectuiv(gpuTimerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (available)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(gpuTimerQuery, GL_QUERY_RESULT, &elapsed);
+            updateAverage(stats.avgRedrawGpuTime, elapsed / 1e9);
+            gpuTimerPending = false;
+        }
+    }
+
+    if (!gpuTimerPending)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, gpuTimerQuery);
+    }
+
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (drawScreen)
+    {
+        glUseProgram(shader);
+        glBindTexture(GL_TEXTURE_2D, displayTexture);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    renderUI();
+
+    if (!gpuTimerPending)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuTimerPending = true;
+    }
+
+    updateAverage(stats.avgRedrawCpuTime, glfwGetTime() - redrawStart);
+    stats.redraws++;
+
+    forceRedraw = false;
+
+    if (uiSettleFrames > 0)
+    {
+        uiSettleFrames--;
+    }
+}
+
+void RenderingManager::renderStatsMenu()
+{
+    if (ImGui::BeginMenu("Stats"))
+    {
+        double uploadTimeSaved = stats.uploadsSkipped * stats.avgUploadCpuTime;
+        double redrawCpuTimeSaved = stats.redrawsSkipped * stats.avgRedrawCpuTime;
+        double redrawGpuTimeSaved = stats.redrawsSkipped * stats.avgRedrawGpuTime;
+
+        ImGui::Text("Uploads: %llu (skipped %llu)", (unsigned long long)stats.uploads, (unsigned long long)stats.uploadsSkipped);
+        ImGui::Text("Redraws: %llu (skipped %llu)", (unsigned long long)stats.redraws, (unsigned long long)stats.redrawsSkipped);
+        ImGui::Separator();
+        ImGui::Text("Upload path: %s (%llu stalls)", uploadPathName(), (unsigned long long)stats.uploadStalls);
+        ImGui::Text("Upload: %.3f ms cpu", stats.avgUploadCpuTime * 1000.0);
+        ImGui::Text("Redraw: %.3f ms cpu, %.3f ms gpu", stats.avgRedrawCpuTime * 1000.0, stats.avgRedrawGpuTime * 1000.0);
+        ImGui::Text("Saved: %.1f ms cpu, %.1f ms gpu", (uploadTimeSaved + redrawCpuTimeSaved) * 1000.0, redrawGpuTimeSaved * 1000.0);
+        ImGui::Separator();
+        ImGui::Text("Input: %llu key events, %.3f us/frame", (unsigned long long)app.input.inputEvents,
+            stats.redraws + stats.redrawsSkipped > 0 ? app.input.inputTime * 1e6 / (stats.redraws + stats.redrawsSkipped) : 0.0);
+        ImGui::EndMenu();
+    }
+}
+
 void RenderingManager::createShaderProgram()
 {
     std::string vertexCode;
@@ -139,6 +435,10 @@ void  RenderingManager::renderUI()
 
     if (ImGui::BeginMainMenuBar())
     {
+        GameBoy& gb = *app.gb;
+        EmuThread& emuThread = app.emuThread;
+
+        // everything that touches the emulator is queued as a command for the emulation thread
         if (ImGui::BeginMenu("File"))
         {
             if (ImGui::MenuItem("Load rom...")) 
@@ -148,15 +448,7 @@ void  RenderingManager::renderUI()
 
                 if (filePath)
                 {
-                    if (!gb.validRomLoaded)
-                    {   
-                        gb.readRom(filePath, "");
-                    }
-                    else
-                    {
-                        gb.restartRequested = true;
-                        gb.filePath = filePath;
-                    }
+                    emuThread.sendCommand({ CMD_LOAD_ROM, filePath });
                 }
                 else 
                 {
@@ -169,9 +461,7 @@ void  RenderingManager::renderUI()
 
                 if (filePath)
                 {
-                    gb.saveFilePath = filePath;
-                    gb.restartRequested = true;
-                    gb.loadSaveRequested = true;
+                    emuThread.sendCommand({ CMD_LOAD_SAVE, filePath });
                 }
                 else
                 {
@@ -180,13 +470,13 @@ void  RenderingManager::renderUI()
             }
             if (ImGui::MenuItem("Save as..."))
             {
+                // filePath is only written before the emulation thread starts, so it is safe to read here
                 std::string defaultName = gb.filePath + "_save";
                 const char* filename = tinyfd_saveFileDialog("Save File As", defaultName.c_str(), 0, nullptr, NULL);
 
                 if (filename != NULL) {
                     printf("Selected file: %s\n", filename);  
-                    gb.saveFilePath = filename;
-                    gb.saveGame();
+                    emuThread.sendCommand({ CMD_SAVE_AS, filename });
                 }
                 else {
                     printf("No file selected.\n");
@@ -194,7 +484,7 @@ void  RenderingManager::renderUI()
             }
             if (ImGui::MenuItem("Save"))
             {
-                gb.saveGame();
+                emuThread.sendCommand({ CMD_SAVE });
             }
             ImGui::EndMenu();
         }
@@ -202,22 +492,38 @@ void  RenderingManager::renderUI()
         {
             if (ImGui::MenuItem("1x"))
             {
-                gb.fpsLimit = 1.0 / 60.0;
+                emuThread.sendCommand({ CMD_SET_SPEED, "", 1.0 });
             }
             if (ImGui::MenuItem("2x"))
             {
-                gb.fpsLimit = 1.0 / 120.0;
+                emuThread.sendCommand({ CMD_SET_SPEED, "", 2.0 });
             }
             if (ImGui::MenuItem("4x"))
             {
-                gb.fpsLimit = 1.0 / 240.0;
+                emuThread.sendCommand({ CMD_SET_SPEED, "", 4.0 });
             }
             if (ImGui::MenuItem("MAX."))
             {
-                gb.fpsLimit = 0.0;
+                emuThread.sendCommand({ CMD_SET_SPEED, "", 0.0 });
+            }
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("Run-ahead"))
+        {
+            const char* labels[] = { "Off", "1 frame", "2 frames", "3 frames" };
+            for (int frames = 0; frames < 4; frames++)
+            {
+                if (ImGui::MenuItem(labels[frames], nullptr, runAheadFrames == frames))
+                {
+                    runAheadFrames = frames;
+                    Command command{ CMD_SET_RUN_AHEAD };
+                    command.frames = frames;
+                    emuThread.sendCommand(command);
+                }
             }
             ImGui::EndMenu();
         }
+        renderStatsMenu();
         ImGui::EndMainMenuBar();
     }
 
@@ -1,11 +1,15 @@
 #pragma once 
 
-class GameBoy;
+#include <cinttypes>
+
+class App;
+class FrameBuffer;
+struct GLFWwindow;
 
 class RenderingManager
 {
 public:
-	RenderingManager(GameBoy& gb);
+	RenderingManager(App& app);
 
 	~RenderingManager();
 
@@ -16,13 +20,79 @@ public:
 	unsigned int displayTexture;
 	unsigned int vbo;
 
+	// uploads the latest frame published by the PPU. Returns false if there was no new frame or if it is identical to
+	// the one already in the display texture, in which case the upload is skipped.
+	bool uploadFrame(FrameBuffer& frameBuffer);
+
+	// true if anything on screen could have changed since the last redraw: a new frame, UI interaction, a resize...
+	bool needsRedraw(bool frameChanged);
+
+	// clears the screen and draws the display texture (if drawScreen is set) and the UI on top of it
+	void redraw(bool drawScreen);
+
+	// set when the window contents have to be redrawn even though nothing changed (resize, expose)
+	bool forceRedraw = true;
+
+	struct Stats
+	{
+		uint64_t uploads = 0;
+		uint64_t uploadsSkipped = 0;
+		uint64_t redraws = 0;
+		uint64_t redrawsSkipped = 0;
+
+		// uploads that had to wait for the GPU to release the pixel buffer they wanted to reuse
+		uint64_t uploadStalls = 0;
+
+		// running averages in seconds, used to estimate how much host time the skipped work would have cost
+		double avgUploadCpuTime = 0.0;
+		double avgRedrawCpuTime = 0.0;
+		double avgRedrawGpuTime = 0.0;
+	} stats;
+
 	void initUI(GLFWwindow* window);
 	void renderUI();
 	void terminateUI();
 
 private:
-	GameBoy& gb;
+	App& app;
 	void createShaderProgram();
 	void createVAO();
 	void createDisplayTexture();
-};
\ No newline at end of file
+
+	// how frames get from client memory into the display texture. The pixel buffer paths stream through a ring of
+	// buffers so the driver can copy a frame while the next one is being written, instead of stalling on
+	// glTexSubImage2D from client memory (slow on software stacks like llvmpipe).
+	enum UploadPath
+	{
+		UPLOAD_DIRECT,          // glTexSubImage2D from client memory
+		UPLOAD_MAPPED_PBO,      // glMapBufferRange with GL_MAP_UNSYNCHRONIZED_BIT every frame (GL 3.2)
+		UPLOAD_PERSISTENT_PBO,  // buffer mapped once with GL_MAP_PERSISTENT_BIT (GL 4.4 / ARB_buffer_storage)
+	};
+
+	static constexpr int UPLOAD_RING_SIZE = 3;
+
+	UploadPath uploadPath = UPLOAD_DIRECT;
+	unsigned int uploadBuffer = 0;
+	uint8_t* persistentMapping = nullptr;
+	// fences marking when the GPU is done reading each slot of the ring
+	void* uploadFences[UPLOAD_RING_SIZE]{};
+	int uploadSlot = 0;
+
+	void createUploadBuffers();
+	void waitForUploadSlot(int slot);
+	const char* uploadPathName();
+
+	uint64_t displayedFrameHash = 0;
+	bool displayTextureValid = false;
+
+	// ImGui needs a few frames after an input event to settle hover/active states
+	int uiSettleFrames = 0;
+
+	unsigned int gpuTimerQuery = 0;
+	bool gpuTimerPending = false;
+
+	// run-ahead frames last sent to the emulation thread, for the menu check mark
+	int runAheadFrames = 0;
+
+	void renderStatsMenu();
+};
@@ -0,0 +1,234 @@
+#include <bit>
+#include <cstring>
+#include "rewind.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define REWIND_SSE2
+#endif
+
+// a literal ends at the first run of this many unchanged bytes, shorter runs cost more as tokens than as literals
+#define MIN_UNCHANGED_RUN 8
+
+// first index from i on where a and b differ, or size. This is where capture spends its time, the 16 byte compare
+// lets the unchanged stretches (nearly all of the state) go by quickly.
+static size_t skipUnchanged(const uint8_t* a, const uint8_t* b, size_t i, size_t size)
+{
+#ifdef REWIND_SSE2
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+		unsigned int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+
+		if (equal != 0xFFFF)
+			return i + std::countr_zero(~equal);
+	}
+#endif
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t x, y;
+		memcpy(&x, a + i, 8);
+		memcpy(&y, b + i, 8);
+
+		if (x != y)
+			return i + std::countr_zero(x ^ y) / 8; // little endian
+	}
+
+	while (i < size && a[i] == b[i])
+		i++;
+
+	return i;
+}
+
+static uint8_t* writeVarint(uint8_t* out, size_t value)
+{
+	while (value >= 0x80)
+	{
+		*out++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (uint8_t)value;
+	return out;
+}
+
+static const uint8_t* readVarint(const uint8_t* in, const uint8_t* end, size_t& value)
+{
+	value = 0;
+	for (int shift = 0; in < end; shift += 7)
+	{
+		uint8_t byte = *in++;
+		value |= (size_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			break;
+	}
+	return in;
+}
+
+size_t encodeDelta(const uint8_t* current, const uint8_t* previous, size_t size, uint8_t* out)
+{
+	uint8_t* start = out;
+	size_t i = 0;
+
+	while (i < size)
+	{
+		size_t unchangedStart = i;
+		i = skipUnchanged(current, previous, i, size);
+		size_t unchanged = i - unchangedStart;
+
+		if (i == size)
+			break; // trailing unchanged bytes don't need a token
+
+		size_t literalStart = i;
+		while (i < size)
+		{
+			if (i + MIN_UNCHANGED_RUN <= size)
+			{
+				uint64_t x, y;
+				memcpy(&x, current + i, 8);
+				memcpy(&y, previous + i, 8);
+				if (x == y)
+					break;
+			}
+			else if (current[i] == previous[i])
+			{
+				break;
+			}
+			i++;
+		}
+
+		out = writeVarint(out, unchanged);
+		out = writeVarint(out, i - literalStart);
+		for (size_t j = literalStart; j < i; j++)
+			*out++ = current[j] ^ previous[j];
+	}
+
+	return out - start;
+}
+
+void applyDelta(const uint8_t* delta, size_t deltaSize, uint8_t* state)
+{
+	const uint8_t* end = delta + deltaSize;
+	size_t position = 0;
+
+	while (delta < end)
+	{
+		size_t unchanged, changed;
+		delta = readVarint(delta, end, unchanged);
+		delta = readVarint(delta, end, changed);
+
+		position += unchanged;
+		for (size_t i = 0; i < changed; i++)
+			state[position + i] ^= delta[i];
+
+		position += changed;
+		delta += changed;
+	}
+}
+
+Rewind::Rewind(size_t budgetBytes, uint32_t maxFrames)
+	: ring(budgetBytes),
+	  records(maxFrames)
+{
+}
+
+void Rewind::clear()
+{
+	firstRecord = 0;
+	recordCount = 0;
+	usedBytes = 0;
+	newest.clear();
+}
+
+size_t Rewind::memoryUsed() const
+{
+	return usedBytes + newest.capacity() + current.capacity() + encoded.capacity() + records.size() * sizeof(Record);
+}
+
+void Rewind::dropOldest()
+{
+	usedBytes -= record(0).size;
+	firstRecord = (firstRecord + 1) % records.size();
+	recordCount--;
+}
+
+// finds room for size bytes after the newest delta, dropping old ones until there is
+uint32_t Rewind::reserve(uint32_t size)
+{
+	if (records.empty())
+		return UINT32_MAX;
+
+	if (recordCount == records.size())
+		dropOldest();
+
+	while (recordCount > 0)
+	{
+		Record& newestRecord = record(recordCount - 1);
+		uint32_t freeStart = newestRecord.offset + newestRecord.size;
+		uint32_t oldestStart = record(0).offset;
+
+		if (oldestStart <= newestRecord.offset)
+		{
+			// [oldest ... newest] free space at the end of the ring and at its start
+			if (ring.size() - freeStart >= size)
+				return freeStart;
+			if (oldestStart >= size)
+				return 0;
+		}
+		else if (oldestStart - freeStart >= size)
+		{
+			// [... newest] free [oldest ...]
+			return freeStart;
+		}
+
+		dropOldest();
+	}
+
+	return size <= ring.size() ? 0 : UINT32_MAX;
+}
+
+void Rewind::capture(GameBoy& gb)
+{
+	gb.saveState(current, false);
+
+	if (newest.size() != current.size())
+	{
+		// first capture, or another rom: nothing to make a delta against
+		clear();
+		newest.swap(current);
+		return;
+	}
+
+	encoded.resize(2 * current.size() + 16);
+	uint32_t size = (uint32_t)encodeDelta(current.data(), newest.data(), current.size(), encoded.data());
+
+	uint32_t offset = reserve(size);
+	if (offset == UINT32_MAX)
+	{
+		// a single delta bigger than the whole budget, the history can't go past this frame
+		clear();
+		newest.swap(current);
+		return;
+	}
+
+	memcpy(ring.data() + offset, encoded.data(), size);
+	record(recordCount) = { offset, size };
+	recordCount++;
+	usedBytes += size;
+
+	newest.swap(current);
+}
+
+bool Rewind::stepBack(GameBoy& gb)
+{
+	if (recordCount == 0)
+		return false;
+
+	Record& last = record(recordCount - 1);
+	applyDelta(ring.data() + last.offset, last.size, newest.data());
+
+	usedBytes -= last.size;
+	recordCount--;
+
+	return gb.loadState(newest.data(), newest.size());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gb.h"
+
+#define REWIND_DEFAULT_BUDGET (16 * 1024 * 1024)
+#define REWIND_DEFAULT_MAX_FRAMES (60 * 60 * 5)
+
+// Rewind history. capture() is called once per frame and stores the new save state as the XOR with the previous one,
+// run length encoded: between two frames most of the state doesn't change, so a delta is mostly zeros and encodes
+// to a few hundred bytes. The newest state is kept whole, and since XOR is its own inverse stepping back is applying
+// the newest delta to it, so no keyframes are needed. The frame being drawn is not part of the snapshots, rewinding
+// shows the frames as they are emulated again from the restored states.
+//
+// Deltas live in one preallocated ring of budgetBytes, the oldest ones are dropped when it or the maxFrames
+// descriptors run out. Nothing allocates after the first capture.
+class Rewind
+{
+public:
+	Rewind(size_t budgetBytes = REWIND_DEFAULT_BUDGET, uint32_t maxFrames = REWIND_DEFAULT_MAX_FRAMES);
+
+	void capture(GameBoy& gb);
+
+	// restores the state captured before the newest one and makes it the newest. False when there is no history left.
+	bool stepBack(GameBoy& gb);
+
+	void clear();
+
+	// frames that can be stepped back
+	uint32_t frames() const { return recordCount; }
+	// delta bytes in the ring
+	size_t deltaBytes() const { return usedBytes; }
+	// everything held, deltas plus the whole newest state and scratch buffers
+	size_t memoryUsed() const;
+
+private:
+	struct Record
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	Record& record(uint32_t index) { return records[(firstRecord + index) % records.size()]; }
+	void dropOldest();
+	uint32_t reserve(uint32_t size);
+
+	std::vector<uint8_t> ring;
+	std::vector<Record> records;
+	uint32_t firstRecord = 0;
+	uint32_t recordCount = 0;
+	size_t usedBytes = 0;
+
+	std::vector<uint8_t> newest;
+	std::vector<uint8_t> current;
+	std::vector<uint8_t> encoded;
+};
+
+// XOR delta codec used by Rewind. The delta is a list of (unchanged byte count, changed byte count, changed bytes
+// XOR previous) with the counts as LEB128 varints. encodeDelta needs 2 * size + 16 bytes in out at most.
+size_t encodeDelta(const uint8_t* current, const uint8_t* previous, size_t size, uint8_t* out);
+// XORs the delta into state, which turns either side of the delta into the other one
+void applyDelta(const uint8_t* delta, size_t deltaSize, uint8_t* state);
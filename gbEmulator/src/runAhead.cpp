@@ -0,0 +1,35 @@
+#include <algorithm>
+#include "runAhead.h"
+
+void RunAhead::setFrames(int frames)
+{
+	this->frames = std::clamp(frames, 0, RUN_AHEAD_MAX_FRAMES);
+}
+
+RunResult RunAhead::runFrame(GameBoy& gb)
+{
+	if (frames == 0)
+		return gb.runFrame();
+
+	gb.ppu.publishFrames = false;
+	RunResult result = gb.runFrame();
+
+	// a breakpoint or watchpoint stopped the real frame, whoever set it wants to look at this state
+	if (result.reason != STOP_VBLANK && result.reason != STOP_CYCLES)
+	{
+		gb.ppu.publishFrames = true;
+		return result;
+	}
+
+	// the frame image is left out, the real frame ended at vblank (or with the lcd off) so there is nothing half drawn
+	gb.saveState(state, false);
+
+	for (int i = 1; i < frames; i++)
+		gb.runFrame();
+
+	gb.ppu.publishFrames = true;
+	gb.runFrame();
+
+	gb.loadState(state.data(), state.size());
+	return result;
+}
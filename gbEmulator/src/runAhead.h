@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "gb.h"
+
+#define RUN_AHEAD_MAX_FRAMES 4
+
+// Run-ahead hides the game's own input lag. Most games read the joypad in one frame and only show the result one or
+// more frames later, so runFrame emulates the real frame without showing it, saves the state, emulates frames more
+// frames with the same buttons held and presents the last of them, then loads the state back. What is on screen is
+// then what the game would show frames frames from now if the buttons stay the same, which they nearly always do at
+// 60 Hz. The real timeline is the same as without run-ahead, only the presented frames change.
+//
+// Frames that aren't presented skip publishing (PPU::publishFrames), the cost is frames extra emulated frames plus a
+// save and a load, both a couple of microseconds.
+class RunAhead
+{
+public:
+	// 0 turns run-ahead off, clamped to RUN_AHEAD_MAX_FRAMES
+	void setFrames(int frames);
+	int getFrames() const { return frames; }
+
+	// emulates one real frame, returns how it ended
+	RunResult runFrame(GameBoy& gb);
+
+private:
+	int frames = 0;
+	std::vector<uint8_t> state;
+};
@@ -0,0 +1,249 @@
+#include <cstring>
+#include <type_traits>
+#include "gb.h"
+#include "hash.h"
+#include "regs.h"
+#include "saveState.h"
+
+static_assert(std::is_trivially_copyable_v<CPUState>, "CPUState is saved with memcpy");
+static_assert(std::is_trivially_copyable_v<MMUState>, "MMUState is saved with memcpy");
+static_assert(std::is_trivially_copyable_v<PPUState>, "PPUState is saved with memcpy");
+// every byte is a member, so equal states save to equal bytes. Adding a member that leaves a gap needs a padding one.
+static_assert(std::has_unique_object_representations_v<CPUState>, "CPUState has padding");
+static_assert(std::has_unique_object_representations_v<MMUState>, "MMUState has padding");
+static_assert(std::has_unique_object_representations_v<PPUState>, "PPUState has padding");
+
+static void romIdentity(const MMU& mmu, char* title, uint16_t& checksum)
+{
+	std::memcpy(title, &mmu.fullrom[0x134], 16);
+	checksum = mmu.fullrom[0x14E] << 8 | mmu.fullrom[0x14F];
+}
+
+static void appendChunk(uint8_t* out, size_t& offset, uint32_t tag, const void* data, uint32_t size)
+{
+	SaveStateChunk chunk{ tag, size };
+	std::memcpy(out + offset, &chunk, sizeof(chunk));
+	offset += sizeof(chunk);
+
+	if (size > 0)
+		std::memcpy(out + offset, data, size);
+	offset += size;
+}
+
+// The state structs are base classes, and the compiler is allowed to put members of CPU/MMU/PPU in their tail
+// padding, so they are read into a copy and restored by assignment instead of a memcpy over the base.
+template<typename State>
+static State read(const uint8_t* data)
+{
+	State loaded;
+	std::memcpy(&loaded, data, sizeof(State));
+	return loaded;
+}
+
+// the counts, indices and enums the mmu and ppu use without checking, only a damaged state has them out of range
+static bool validState(const MMUState& mmu, const PPUState& ppu, unsigned int romNumOfBanks)
+{
+	if (mmu.romBankNumber >= romNumOfBanks)
+		return false;
+
+	if (!ppu.spritesBuffer.valid() || !ppu.bgPixelFIFO.valid() || !ppu.spPixelFIFO.valid()
+		|| !ppu.oamByteBuffer.valid() || !ppu.bgFetchBuffer.valid())
+		return false;
+
+	if ((unsigned int)ppu.ppuMode > DRAWING_3 || (unsigned int)ppu.bgDrawingState > SP_FETCH_TILE_HIGH_AND_PUSH
+		|| (unsigned int)ppu.spDrawingState > SP_FETCH_TILE_HIGH_AND_PUSH)
+		return false;
+
+	// pixels go to LCD at LX 8-167 of lines (LY, 0xFF44) 0-143
+	uint8_t ly = mmu.ioRegs[0x44];
+	return ppu.LX >= 0 && ppu.LX <= 168 && (ppu.ppuMode != DRAWING_3 || ly < LCD_HEIGHT);
+}
+
+size_t GameBoy::saveStateSize(bool includeFrame) const
+{
+	const int chunkCount = includeFrame ? 5 : 4;
+
+	return sizeof(SaveStateHeader) + chunkCount * sizeof(SaveStateChunk) + sizeof(CPUState) + sizeof(MMUState)
+		+ sizeof(PPUState) + mmu.eRam.size() + (includeFrame ? LCD_SIZE : 0);
+}
+
+void GameBoy::saveState(std::vector<uint8_t>& out, bool includeFrame)
+{
+	out.resize(saveStateSize(includeFrame));
+	saveState(out.data(), includeFrame);
+}
+
+void GameBoy::saveState(uint8_t* out, bool includeFrame)
+{
+	const uint32_t eRamSize = (uint32_t)mmu.eRam.size();
+	const int chunkCount = includeFrame ? 5 : 4;
+
+	SaveStateHeader header{};
+	header.magic = SAVE_STATE_MAGIC;
+	header.version = SAVE_STATE_VERSION;
+	romIdentity(mmu, header.title, header.romChecksum);
+	header.chunkCount = chunkCount;
+	std::memcpy(out, &header, sizeof(header));
+
+	size_t offset = sizeof(header);
+	appendChunk(out, offset, CHUNK_CPU, static_cast<const CPUState*>(&cpu), sizeof(CPUState));
+	appendChunk(out, offset, CHUNK_MMU, static_cast<const MMUState*>(&mmu), sizeof(MMUState));
+	appendChunk(out, offset, CHUNK_PPU, static_cast<const PPUState*>(&ppu), sizeof(PPUState));
+	appendChunk(out, offset, CHUNK_ERAM, mmu.eRam.data(), eRamSize);
+	if (includeFrame)
+		appendChunk(out, offset, CHUNK_LCD, ppu.LCD, LCD_SIZE);
+}
+
+bool GameBoy::loadState(const uint8_t* data, size_t size)
+{
+	if (!validRomLoaded || size < sizeof(SaveStateHeader))
+		return false;
+
+	SaveStateHeader header;
+	std::memcpy(&header, data, sizeof(header));
+
+	char title[16];
+	uint16_t checksum;
+	romIdentity(mmu, title, checksum);
+
+	if (header.magic != SAVE_STATE_MAGIC || header.version != SAVE_STATE_VERSION)
+	{
+		std::cout << "save state: not a version " << SAVE_STATE_VERSION << " save state\n";
+		return false;
+	}
+
+	if (std::memcmp(header.title, title, sizeof(title)) != 0 || header.romChecksum != checksum)
+	{
+		std::cout << "save state: made with a different rom\n";
+		return false;
+	}
+
+	// find every chunk and check its size before touching anything, a bad state leaves the emulator as it was
+	const uint8_t* cpuData = nullptr;
+	const uint8_t* mmuData = nullptr;
+	const uint8_t* ppuData = nullptr;
+	const uint8_t* eRamData = nullptr;
+	const uint8_t* lcdData = nullptr;
+
+	size_t offset = sizeof(header);
+	for (int i = 0; i < header.chunkCount; i++)
+	{
+		SaveStateChunk chunk;
+		if (size - offset < sizeof(chunk))
+			return false;
+
+		std::memcpy(&chunk, data + offset, sizeof(chunk));
+		offset += sizeof(chunk);
+
+		if (size - offset < chunk.size)
+			return false;
+
+		const uint8_t* chunkData = data + offset;
+		offset += chunk.size;
+
+		const uint8_t** target = nullptr;
+		size_t expectedSize = 0;
+
+		switch (chunk.tag)
+		{
+		case CHUNK_CPU:
+			target = &cpuData;
+			expectedSize = sizeof(CPUState);
+			break;
+		case CHUNK_MMU:
+			target = &mmuData;
+			expectedSize = sizeof(MMUState);
+			break;
+		case CHUNK_PPU:
+			target = &ppuData;
+			expectedSize = sizeof(PPUState);
+			break;
+		case CHUNK_ERAM:
+			target = &eRamData;
+			expectedSize = mmu.eRam.size();
+			break;
+		case CHUNK_LCD:
+			target = &lcdData;
+			expectedSize = LCD_SIZE;
+			break;
+		default:
+			continue;
+		}
+
+		if (chunk.size != expectedSize)
+		{
+			std::cout << "save state: chunk " << std::string((const char*)&chunk.tag, 4) << " has the wrong size\n";
+			return false;
+		}
+
+		*target = chunkData;
+	}
+
+	if (!cpuData || !mmuData || !ppuData || !eRamData)
+	{
+		std::cout << "save state: missing chunks\n";
+		return false;
+	}
+
+	MMUState mmuState = read<MMUState>(mmuData);
+	PPUState ppuState = read<PPUState>(ppuData);
+	if (!validState(mmuState, ppuState, mmu.romNumOfBanks))
+	{
+		std::cout << "save state: damaged\n";
+		return false;
+	}
+
+	static_cast<CPUState&>(cpu) = read<CPUState>(cpuData);
+	static_cast<MMUState&>(mmu) = mmuState;
+	static_cast<PPUState&>(ppu) = ppuState;
+	if (!mmu.eRam.empty())
+		std::memcpy(mmu.eRam.mutableData(), eRamData, mmu.eRam.size());
+	if (lcdData)
+		std::memcpy(ppu.LCD, lcdData, LCD_SIZE);
+
+	mmu.events = 0;
+
+	return true;
+}
+
+uint64_t GameBoy::stateHash() const
+{
+	// registers little endian, in an order of their own, so moving or adding struct members doesn't change the hash
+	uint8_t registers[32];
+	size_t size = 0;
+	auto put = [&](uint64_t value, int bytes)
+	{
+		for (int i = 0; i < bytes; i++)
+			registers[size++] = (uint8_t)(value >> (8 * i));
+	};
+
+	put(STATE_HASH_VERSION, 4);
+	for (int reg : { REG_A, REG_F, REG_B, REG_C, REG_D, REG_E, REG_H, REG_L })
+		put(cpu.regs[reg], 1);
+	put(cpu.SP, 2);
+	put(cpu.PC, 2);
+	put(cpu.IME, 1);
+	put(cpu.HALT, 1);
+	put(cpu.tCycles, 8);
+	put(mmu.romBankNumber, 2);
+	put(mmu.ramBankNumber, 1);
+	put(mmu.sRamEnabled, 1);
+	put(mmu.modeFlag, 1);
+
+	uint64_t hash = hashBytes(registers, size);
+	hash = hashBytes(mmu.vRam, sizeof(mmu.vRam), hash);
+	hash = hashBytes(mmu.wRam, sizeof(mmu.wRam), hash);
+	hash = hashBytes(mmu.oam, sizeof(mmu.oam), hash);
+	hash = hashBytes(mmu.ioRegs, sizeof(mmu.ioRegs), hash);
+	hash = hashBytes(mmu.hRam, sizeof(mmu.hRam), hash);
+	hash = hashBytes(mmu.ie, sizeof(mmu.ie), hash);
+	return hashBytes(mmu.eRam.data(), mmu.eRam.size(), hash);
+}
+
+uint64_t GameBoy::fullStateHash() const
+{
+	uint64_t hash = hashBytes(static_cast<const CPUState*>(&cpu), sizeof(CPUState));
+	hash = hashBytes(static_cast<const MMUState*>(&mmu), sizeof(MMUState), hash);
+	hash = hashBytes(static_cast<const PPUState*>(&ppu), sizeof(PPUState), hash);
+	return hashBytes(mmu.eRam.data(), mmu.eRam.size(), hash);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// Save state layout: a SaveStateHeader followed by chunks, each one a SaveStateChunk and then size bytes of data.
+// The chunks are CPUState, MMUState and PPUState copied as they are in memory, the external ram and the frame the
+// ppu is drawing (optional, rewind leaves it out), so saving and loading are a handful of memcpys. Because of that a
+// state only loads into a build with the same struct layout: bump SAVE_STATE_VERSION whenever one of those structs
+// changes (a chunk whose size doesn't match is rejected as well). Chunks with unknown tags are skipped, so optional
+// ones can be added later.
+#define SAVE_STATE_MAGIC   0x53534247 // "GBSS"
+#define SAVE_STATE_VERSION 1
+
+constexpr uint32_t saveStateTag(const char (&name)[5])
+{
+	return (uint32_t)name[0] | (uint32_t)name[1] << 8 | (uint32_t)name[2] << 16 | (uint32_t)name[3] << 24;
+}
+
+#define CHUNK_CPU  saveStateTag("CPU ")
+#define CHUNK_MMU  saveStateTag("MMU ")
+#define CHUNK_PPU  saveStateTag("PPU ")
+#define CHUNK_ERAM saveStateTag("ERAM")
+#define CHUNK_LCD  saveStateTag("LCD ")
+
+struct SaveStateHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	// cartridge title and global checksum from the rom header, a state only loads into the rom it was made with
+	char title[16];
+	uint16_t romChecksum;
+	uint16_t chunkCount;
+};
+
+struct SaveStateChunk
+{
+	uint32_t tag;
+	uint32_t size;
+};
@@ -0,0 +1,134 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include "saveStateSlots.h"
+
+SaveStateSlots::~SaveStateSlots()
+{
+	close();
+}
+
+void SaveStateSlots::open(const std::string& romPath)
+{
+	close();
+
+	this->romPath = romPath;
+	stopping = false;
+
+	for (int i = 0; i < SAVE_STATE_SLOTS; i++)
+	{
+		slots[i].clear();
+		slotLoaded[i] = false;
+		slotDirty[i] = false;
+	}
+
+	thread = std::thread(&SaveStateSlots::worker, this);
+}
+
+void SaveStateSlots::close()
+{
+	if (!thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+
+	thread.join();
+}
+
+std::string SaveStateSlots::slotPath(int slot) const
+{
+	return romPath + ".state" + std::to_string(slot + 1);
+}
+
+void SaveStateSlots::save(int slot, GameBoy& gb)
+{
+	gb.saveState(scratch);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// the slot's old buffer becomes the next scratch buffer
+		slots[slot].swap(scratch);
+		slotLoaded[slot] = true;
+		slotDirty[slot] = true;
+	}
+	wake.notify_one();
+
+	std::cout << "saved state " << slot + 1 << "\n";
+}
+
+bool SaveStateSlots::load(int slot, GameBoy& gb)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (slots[slot].empty())
+	{
+		std::cout << "state " << slot + 1 << (slotLoaded[slot] ? " is empty\n" : " is still being read\n");
+		return false;
+	}
+
+	if (!gb.loadState(slots[slot].data(), slots[slot].size()))
+		return false;
+
+	std::cout << "loaded state " << slot + 1 << "\n";
+	return true;
+}
+
+void SaveStateSlots::worker()
+{
+	// read the existing slots first, a slot saved in the meantime is newer than its file
+	for (int i = 0; i < SAVE_STATE_SLOTS; i++)
+	{
+		std::ifstream is(slotPath(i), std::ifstream::binary);
+		std::vector<uint8_t> data;
+		if (is)
+			data.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!slotLoaded[i])
+		{
+			slots[i].swap(data);
+			slotLoaded[i] = true;
+		}
+	}
+
+	std::vector<uint8_t> pending;
+
+	while (true)
+	{
+		int slot = -1;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			auto findDirty = [&]()
+			{
+				for (int i = 0; i < SAVE_STATE_SLOTS; i++)
+				{
+					if (slotDirty[i])
+						return i;
+				}
+				return -1;
+			};
+
+			wake.wait(lock, [&]() { return stopping || findDirty() >= 0; });
+
+			slot = findDirty();
+			if (slot < 0)
+				return;
+
+			// copy so the emulation thread can save to the slot again while the file is written
+			pending = slots[slot];
+			slotDirty[slot] = false;
+		}
+
+		std::ofstream os(slotPath(slot), std::ofstream::binary | std::ofstream::trunc);
+		os.write((const char*)pending.data(), pending.size());
+
+		if (!os)
+			std::cout << "could not write " << slotPath(slot) << "\n";
+	}
+}
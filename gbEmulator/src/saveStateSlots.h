@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gb.h"
+
+#define SAVE_STATE_SLOTS 4
+
+// The frontend's save state slots. Every slot is kept in memory as well as in "<rom path>.state<n>", so saving and
+// loading on the emulation thread only copy memory. A background thread reads the slot files when a rom is opened
+// and writes a slot's file whenever it changes.
+class SaveStateSlots
+{
+public:
+	~SaveStateSlots();
+
+	// starts the io thread and reads whatever slot files exist for the rom, closing the previous one first
+	void open(const std::string& romPath);
+	// finishes pending writes and stops the io thread
+	void close();
+
+	// emulation thread, slot is 0 based
+	void save(int slot, GameBoy& gb);
+	bool load(int slot, GameBoy& gb);
+
+private:
+	void worker();
+	std::string slotPath(int slot) const;
+
+	std::string romPath;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread thread;
+	bool stopping = false;
+
+	// guarded by mutex
+	std::vector<uint8_t> slots[SAVE_STATE_SLOTS];
+	bool slotLoaded[SAVE_STATE_SLOTS]{};
+	bool slotDirty[SAVE_STATE_SLOTS]{};
+
+	// emulation thread only, saving into it doesn't allocate once it has grown to the state size
+	std::vector<uint8_t> scratch;
+};
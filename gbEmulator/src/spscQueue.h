@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. Each side only writes its own
+// index, so push and pop never block; they just fail when the queue is full or empty.
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	// producer side. Returns false if the queue is full
+	bool push(T value)
+	{
+		size_t tail = tailIndex.load(std::memory_order_relaxed);
+
+		if (tail - cachedHead == Capacity)
+		{
+			cachedHead = headIndex.load(std::memory_order_acquire);
+
+			if (tail - cachedHead == Capacity)
+				return false;
+		}
+
+		slots[tail & (Capacity - 1)] = std::move(value);
+		tailIndex.store(tail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// consumer side. Returns false if the queue is empty
+	bool pop(T& value)
+	{
+		size_t head = headIndex.load(std::memory_order_relaxed);
+
+		if (head == cachedTail)
+		{
+			cachedTail = tailIndex.load(std::memory_order_acquire);
+
+			if (head == cachedTail)
+				return false;
+		}
+
+		value = std::move(slots[head & (Capacity - 1)]);
+		headIndex.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+private:
+	T slots[Capacity];
+
+	// consumer owned: its index and its last view of the producer's one. Kept on separate cache lines from the
+	// producer's so the two threads don't keep stealing the line from each other.
+	alignas(64) std::atomic<size_t> headIndex{ 0 };
+	size_t cachedTail = 0;
+
+	// producer owned
+	alignas(64) std::atomic<size_t> tailIndex{ 0 };
+	size_t cachedHead = 0;
+};
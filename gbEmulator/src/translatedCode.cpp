@@ -0,0 +1,155 @@
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "gb.h"
+#include "translatedCode.h"
+
+// builds outside CMake (the Visual Studio project) don't know the hash of the core's sources, 0 makes them refuse
+// every plugin
+#ifndef GB_CORE_BUILD_ID
+#define GB_CORE_BUILD_ID 0ull
+#endif
+
+static void* openLibrary(const std::string& path)
+{
+#if defined(_WIN32)
+	return (void*)LoadLibraryA(path.c_str());
+#else
+	return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void* findSymbol(void* library, const char* name)
+{
+#if defined(_WIN32)
+	return (void*)GetProcAddress((HMODULE)library, name);
+#else
+	return dlsym(library, name);
+#endif
+}
+
+static void closeLibrary(void* library)
+{
+#if defined(_WIN32)
+	FreeLibrary((HMODULE)library);
+#else
+	dlclose(library);
+#endif
+}
+
+TranslatedCode::~TranslatedCode()
+{
+	// the block tables point into the library
+	banks.clear();
+	if (library)
+		closeLibrary(library);
+}
+
+std::shared_ptr<const TranslatedCode> TranslatedCode::load(const std::string& path, uint64_t romHash)
+{
+	std::shared_ptr<TranslatedCode> code(new TranslatedCode());
+
+	code->library = openLibrary(path);
+	if (!code->library)
+	{
+		std::cout << "translated code: can't load " << path << "\n";
+		return nullptr;
+	}
+
+	auto moduleFunction = (TranslatedModuleFunction)findSymbol(code->library, TRANSLATED_MODULE_SYMBOL);
+	const TranslatedModule* module = moduleFunction ? moduleFunction() : nullptr;
+	if (!module)
+	{
+		std::cout << "translated code: " << path << " wasn't made by gb2cpp\n";
+		return nullptr;
+	}
+
+	if (module->abiVersion != TRANSLATED_ABI_VERSION || module->cpuSize != sizeof(CPU<SystemBus>)
+		|| module->mmuSize != sizeof(MMU) || GB_CORE_BUILD_ID == 0 || module->coreBuildId != GB_CORE_BUILD_ID)
+	{
+		std::cout << "translated code: " << path << " was built against another version of the core\n";
+		return nullptr;
+	}
+
+	if (module->romHash != romHash)
+	{
+		std::cout << "translated code: " << path << " was made from a different rom\n";
+		return nullptr;
+	}
+
+	for (uint32_t i = 0; i < module->blockCount; i++)
+	{
+		const TranslatedEntry& entry = module->blocks[i];
+		size_t bank = entry.romOffset >> 14;
+
+		if (bank >= code->banks.size())
+			code->banks.resize(bank + 1);
+		if (!code->banks[bank])
+			code->banks[bank] = std::make_unique<TranslatedBlock[]>(0x4000);
+
+		code->banks[bank][entry.romOffset & 0x3FFF] = entry.block;
+	}
+	code->count = module->blockCount;
+
+	return code;
+}
+
+bool GameBoy::loadTranslatedCode(const std::string& path)
+{
+	if (!validRomLoaded)
+		return false;
+
+	std::shared_ptr<const TranslatedCode> code = TranslatedCode::load(path, romHash());
+	if (!code)
+		return false;
+
+	translated = std::move(code);
+	return true;
+}
+
+void GameBoy::setTranslatedCode(std::shared_ptr<const TranslatedCode> code)
+{
+	translated = std::move(code);
+}
+
+bool GameBoy::runTranslated(uint64_t endCycles, uint8_t eventMask, bool stepOnly)
+{
+	// a halted cpu only ticks, during dma the interpreter fetches 0xFF from the rom
+	if (cpu.HALT || mmu.dmaTransferRequested)
+		return false;
+
+	int32_t offset = mmu.romOffset(cpu.PC);
+	if (offset < 0)
+		return false;
+
+	// blocks are made for bank 0 at 0x0000 and the other banks at 0x4000, mbc5 can map bank 0 at 0x4000 and mbc1
+	// in mode 1 another bank at 0x0000
+	if ((cpu.PC >= 0x4000) != (offset >= 0x4000))
+		return false;
+
+	TranslatedBlock block = translated->block(offset);
+	if (!block)
+		return false;
+
+	// the ei from before takes effect now, blocks end at ei so this is the only place it can be pending
+	if (cpu.updateIME)
+	{
+		cpu.IME = 1;
+		cpu.updateIME = 0;
+	}
+
+	TranslatedContext context{ cpu, mmu, instructionCount, translatedInstructionCount, endCycles, eventMask,
+		stepOnly || breakpointCount != 0 };
+
+	while (block)
+		block = block(context).block;
+
+	return true;
+}
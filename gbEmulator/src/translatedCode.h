@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "mmu.h"
+#include "regs.h"
+
+// Ahead of time translated rom code. gb2cpp turns the code of a rom into C++ with one function per basic block, which
+// is built into a plugin (a shared library exporting TRANSLATED_MODULE_SYMBOL). GameBoy runs a block instead of the
+// interpreter whenever the pc is at the start of one in the rom bank mapped right now. A block does every m-cycle
+// through the same CPU functions the interpreter uses (AddCycle, read8, write8), so the emulation doesn't change, it
+// only skips fetching and decoding. Code in ram, anything gb2cpp didn't find and oam dma time are interpreted.
+// Those functions are compiled into the plugin too, so it only loads into a core built from the same sources.
+
+// bumped whenever TranslatedContext, the module table or the helpers below change, plugins built before don't load
+#define TRANSLATED_ABI_VERSION 2
+#define TRANSLATED_MODULE_SYMBOL "gbTranslatedModule"
+
+#if defined(_WIN32)
+#define TRANSLATED_EXPORT extern "C" __declspec(dllexport)
+#else
+#define TRANSLATED_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+#define FLAG_Z 0x80
+#define FLAG_N 0x40
+#define FLAG_H 0x20
+#define FLAG_C 0x10
+
+struct TranslatedContext;
+struct TranslatedJump;
+typedef TranslatedJump (*TranslatedBlock)(TranslatedContext& c);
+
+// a block ends by naming the block that runs next, or nullptr to go back to GameBoy's run loop
+struct TranslatedJump
+{
+	TranslatedBlock block;
+};
+
+// what a block runs against, set up by GameBoy for every run of blocks
+struct TranslatedContext
+{
+	CPU<SystemBus>& cpu;
+	MMU& mmu;
+	uint64_t& instructionCount;
+	uint64_t& translatedInstructionCount;
+
+	// the run loop's stop conditions: its cycle budget ends at endCycles, and with stepOnly (breakpoints or a
+	// predicate) it checks after every instruction
+	uint64_t endCycles;
+	uint8_t eventMask;
+	bool stepOnly;
+
+	// Finishes an instruction like GameBoy::step and says whether the block can go on with the instruction at pc. It
+	// can't when an interrupt was dispatched, dma started or the run loop would stop here.
+	bool next(uint16_t pc)
+	{
+		instructionCount++;
+		translatedInstructionCount++;
+		cpu.handleInterrupts();
+
+		return cpu.PC == pc && !stepOnly && cpu.tCycles < endCycles && !(mmu.events & eventMask)
+			&& !mmu.dmaTransferRequested;
+	}
+
+	// the same after an instruction that wrote memory, the write may have switched the rom bank the block came from
+	bool nextAfterWrite(uint16_t pc, int32_t romOffset)
+	{
+		return next(pc) && mmu.romOffset(pc) == romOffset;
+	}
+};
+
+struct TranslatedEntry
+{
+	uint32_t romOffset;
+	TranslatedBlock block;
+};
+
+// The table a plugin hands out, checked against the loaded rom and this build of the core before any block runs.
+// coreBuildId is GB_CORE_BUILD_ID, which CMake computes from the core's sources for gbcore and every plugin.
+struct TranslatedModule
+{
+	uint32_t abiVersion;
+	uint32_t cpuSize;
+	uint32_t mmuSize;
+	uint64_t coreBuildId;
+	uint64_t romHash;
+	uint32_t blockCount;
+	const TranslatedEntry* blocks;
+};
+
+typedef const TranslatedModule* (*TranslatedModuleFunction)();
+
+// A loaded plugin, shared by every instance running the rom (clones keep it). Blocks are looked up by their offset
+// in the rom image, so the same address in different banks finds different code.
+class TranslatedCode
+{
+public:
+	~TranslatedCode();
+
+	// loads a plugin built from gb2cpp's output, nullptr with a message if it can't be loaded or was made for another
+	// rom or another version of the core
+	static std::shared_ptr<const TranslatedCode> load(const std::string& path, uint64_t romHash);
+
+	TranslatedBlock block(int32_t romOffset) const
+	{
+		size_t bank = (uint32_t)romOffset >> 14;
+		return bank < banks.size() && banks[bank] ? banks[bank][romOffset & 0x3FFF] : nullptr;
+	}
+
+	size_t blockCount() const { return count; }
+
+private:
+	TranslatedCode() = default;
+
+	void* library = nullptr;
+	// one table of 0x4000 entries per rom bank that has blocks
+	std::vector<std::unique_ptr<TranslatedBlock[]>> banks;
+	size_t count = 0;
+};
+
+// Instruction helpers for generated code. They do exactly what CPU::decodeAndExecute does for the same opcode,
+// minus the fetches, and leave the m-cycles to the caller.
+namespace translated
+{
+	typedef CPU<SystemBus> Cpu;
+
+	// the m-cycles the interpreter spends fetching an opcode and its operands, the bytes themselves are in the code
+	template<int Count>
+	inline void fetch(Cpu& cpu)
+	{
+		for (int i = 0; i < Count; i++)
+			cpu.AddCycle();
+	}
+
+	inline uint16_t pair(const Cpu& cpu, int hi) { return (uint16_t)(cpu.regs[hi] << 8 | cpu.regs[hi + 1]); }
+
+	inline void setPair(Cpu& cpu, int hi, uint16_t value)
+	{
+		cpu.regs[hi] = value >> 8;
+		cpu.regs[hi + 1] = value & 0xFF;
+	}
+
+	// Z, N, H and C, the low nibble of F is kept like the interpreter's setFlag functions do
+	inline void setFlags(Cpu& cpu, bool z, bool n, bool h, bool c)
+	{
+		cpu.regs[REG_F] = (cpu.regs[REG_F] & 0x0F) | (z ? FLAG_Z : 0) | (n ? FLAG_N : 0) | (h ? FLAG_H : 0)
+			| (c ? FLAG_C : 0);
+	}
+
+	inline bool carry(const Cpu& cpu) { return cpu.regs[REG_F] & FLAG_C; }
+
+	// cc as in the opcode: nz, z, nc, c
+	template<int Condition>
+	inline bool condition(const Cpu& cpu)
+	{
+		uint8_t flag = cpu.regs[REG_F] & (Condition < 2 ? FLAG_Z : FLAG_C);
+		return Condition & 1 ? flag != 0 : flag == 0;
+	}
+
+	// add, adc, sub, sbc, and, xor, or, cp
+	template<int Operation>
+	inline void alu(Cpu& cpu, uint8_t value)
+	{
+		uint8_t& a = cpu.regs[REG_A];
+		unsigned int c = carry(cpu);
+
+		if constexpr (Operation == 0)
+		{
+			setFlags(cpu, (uint8_t)(a + value) == 0, false, (a & 0x0F) + (value & 0x0F) > 0x0F, a + value > 0xFF);
+			a += value;
+		}
+		else if constexpr (Operation == 1)
+		{
+			setFlags(cpu, (uint8_t)(a + value + c) == 0, false, (a & 0x0F) + (value & 0x0F) + c > 0x0F,
+				a + value + c > 0xFF);
+			a += value + c;
+		}
+		else if constexpr (Operation == 2 || Operation == 7)
+		{
+			setFlags(cpu, a == value, true, (a & 0x0F) < (value & 0x0F), a < value);
+			if constexpr (Operation == 2)
+				a -= value;
+		}
+		else if constexpr (Operation == 3)
+		{
+			setFlags(cpu, (uint8_t)(a - value - c) == 0, true, (a & 0x0F) < (value & 0x0F) + c, a < value + c);
+			a -= value + c;
+		}
+		else if constexpr (Operation == 4)
+		{
+			a &= value;
+			setFlags(cpu, a == 0, false, true, false);
+		}
+		else if constexpr (Operation == 5)
+		{
+			a ^= value;
+			setFlags(cpu, a == 0, false, false, false);
+		}
+		else
+		{
+			a |= value;
+			setFlags(cpu, a == 0, false, false, false);
+		}
+	}
+
+	// inc and dec leave C alone
+	inline uint8_t inc(Cpu& cpu, uint8_t value)
+	{
+		uint8_t result = value + 1;
+		cpu.regs[REG_F] = (cpu.regs[REG_F] & (FLAG_C | 0x0F)) | (result == 0 ? FLAG_Z : 0)
+			| ((value & 0x0F) == 0x0F ? FLAG_H : 0);
+		return result;
+	}
+
+	inline uint8_t dec(Cpu& cpu, uint8_t value)
+	{
+		uint8_t result = value - 1;
+		cpu.regs[REG_F] = (cpu.regs[REG_F] & (FLAG_C | 0x0F)) | (result == 0 ? FLAG_Z : 0) | FLAG_N
+			| ((value & 0x0F) == 0 ? FLAG_H : 0);
+		return result;
+	}
+
+	// add hl, rr leaves Z alone
+	inline void addHl(Cpu& cpu, uint16_t value)
+	{
+		uint16_t hl = pair(cpu, REG_H);
+		cpu.regs[REG_F] = (cpu.regs[REG_F] & (FLAG_Z | 0x0F)) | ((hl & 0xFFF) + (value & 0xFFF) > 0xFFF ? FLAG_H : 0)
+			| ((uint32_t)hl + value > 0xFFFF ? FLAG_C : 0);
+		setPair(cpu, REG_H, hl + value);
+	}
+
+	// rlca, rrca, rla, rra
+	template<int Operation>
+	inline void rotateA(Cpu& cpu)
+	{
+		uint8_t a = cpu.regs[REG_A];
+		unsigned int c = carry(cpu);
+		bool out = Operation & 1 ? a & 1 : a >> 7;
+
+		if constexpr (Operation == 0)
+			a = (a << 1) | out;
+		else if constexpr (Operation == 1)
+			a = (a >> 1) | (out << 7);
+		else if constexpr (Operation == 2)
+			a = (a << 1) | c;
+		else
+			a = (a >> 1) | (c << 7);
+
+		cpu.regs[REG_A] = a;
+		setFlags(cpu, false, false, false, out);
+	}
+
+	inline void cpl(Cpu& cpu)
+	{
+		cpu.regs[REG_A] = ~cpu.regs[REG_A];
+		cpu.regs[REG_F] |= FLAG_N | FLAG_H;
+	}
+
+	inline void scf(Cpu& cpu) { cpu.regs[REG_F] = (cpu.regs[REG_F] & (FLAG_Z | 0x0F)) | FLAG_C; }
+
+	inline void ccf(Cpu& cpu) { cpu.regs[REG_F] = (cpu.regs[REG_F] & (FLAG_Z | 0x0F)) | (~cpu.regs[REG_F] & FLAG_C); }
+
+	inline void push(Cpu& cpu, uint16_t value)
+	{
+		cpu.write8(--cpu.SP, value >> 8);
+		cpu.write8(--cpu.SP, value & 0xFF);
+	}
+
+	inline uint16_t pop(Cpu& cpu)
+	{
+		uint8_t lsb = cpu.read8(cpu.SP++);
+		uint8_t msb = cpu.read8(cpu.SP++);
+		return (uint16_t)(msb << 8 | lsb);
+	}
+}
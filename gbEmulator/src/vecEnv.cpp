@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "vecEnv.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ENV_SSE2
+#endif
+
+// where an output pixel samples the source: the first of the two source pixels and the weight of the second, out of
+// 256. Pixel centers line up, like the usual image resizers.
+struct Sample
+{
+	int index;
+	unsigned int weight;
+};
+
+struct DownsampleTables
+{
+	Sample columns[OBS_84_SIZE];
+	Sample rows[OBS_84_SIZE];
+	// the column weights as pmaddwd operands, first source then second source for each output pixel
+	alignas(16) int16_t columnWeights[OBS_84_SIZE * 2];
+
+	DownsampleTables()
+	{
+		makeSamples(LCD_WIDTH, columns);
+		makeSamples(LCD_HEIGHT, rows);
+
+		for (int x = 0; x < OBS_84_SIZE; x++)
+		{
+			columnWeights[x * 2] = (int16_t)(256 - columns[x].weight);
+			columnWeights[x * 2 + 1] = (int16_t)columns[x].weight;
+		}
+	}
+
+	static void makeSamples(int in, Sample* samples)
+	{
+		for (int i = 0; i < OBS_84_SIZE; i++)
+		{
+			double x = std::clamp((i + 0.5) * in / OBS_84_SIZE - 0.5, 0.0, (double)(in - 1));
+			int first = std::min((int)x, in - 2);
+			samples[i] = { first, (unsigned int)std::lround((x - first) * 256) };
+		}
+	}
+};
+
+static const DownsampleTables tables;
+
+template<bool Simd>
+static void blendRows(const uint8_t* a, const uint8_t* b, unsigned int weight, uint8_t* out)
+{
+	int x = 0;
+
+#ifdef ENV_SSE2
+	if constexpr (Simd)
+	{
+		// 16 bit lanes hold at most 255 * 256 + 128, so nothing overflows
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i weightA = _mm_set1_epi16((short)(256 - weight));
+		const __m128i weightB = _mm_set1_epi16((short)weight);
+		const __m128i round = _mm_set1_epi16(128);
+
+		for (; x + 16 <= LCD_WIDTH; x += 16)
+		{
+			__m128i rowA = _mm_loadu_si128((const __m128i*)(a + x));
+			__m128i rowB = _mm_loadu_si128((const __m128i*)(b + x));
+
+			__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(rowA, zero), weightA),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(rowB, zero), weightB));
+			__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(rowA, zero), weightA),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(rowB, zero), weightB));
+
+			low = _mm_srli_epi16(_mm_add_epi16(low, round), 8);
+			high = _mm_srli_epi16(_mm_add_epi16(high, round), 8);
+			_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(low, high));
+		}
+	}
+#endif
+
+	for (; x < LCD_WIDTH; x++)
+		out[x] = (uint8_t)((a[x] * (256 - weight) + b[x] * weight + 128) >> 8);
+}
+
+#ifdef ENV_SSE2
+// the two source pixels of 4 output pixels, as 8 bytes in output order
+static inline __m128i gatherPairs(const uint8_t* row, const Sample* columns)
+{
+	uint64_t pairs = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		uint16_t pair;
+		std::memcpy(&pair, row + columns[i].index, 2);
+		pairs |= (uint64_t)pair << (i * 16);
+	}
+
+	return _mm_loadl_epi64((const __m128i*)&pairs);
+}
+#endif
+
+template<bool Simd>
+static void blendColumns(const uint8_t* row, uint8_t* out)
+{
+	int x = 0;
+
+#ifdef ENV_SSE2
+	if constexpr (Simd)
+	{
+		// the sources are gathered with plain loads, pmaddwd then does both multiplies and the add of 4 pixels
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi32(128);
+
+		for (; x + 8 <= OBS_84_SIZE; x += 8)
+		{
+			__m128i low = _mm_unpacklo_epi8(gatherPairs(row, tables.columns + x), zero);
+			__m128i high = _mm_unpacklo_epi8(gatherPairs(row, tables.columns + x + 4), zero);
+
+			low = _mm_madd_epi16(low, _mm_load_si128((const __m128i*)(tables.columnWeights + x * 2)));
+			high = _mm_madd_epi16(high, _mm_load_si128((const __m128i*)(tables.columnWeights + x * 2 + 8)));
+
+			low = _mm_srli_epi32(_mm_add_epi32(low, round), 8);
+			high = _mm_srli_epi32(_mm_add_epi32(high, round), 8);
+
+			__m128i pixels = _mm_packs_epi32(low, high);
+			_mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(pixels, pixels));
+		}
+	}
+#endif
+
+	for (; x < OBS_84_SIZE; x++)
+	{
+		const Sample& sample = tables.columns[x];
+		unsigned int a = row[sample.index];
+		unsigned int b = row[sample.index + 1];
+		out[x] = (uint8_t)((a * (256 - sample.weight) + b * sample.weight + 128) >> 8);
+	}
+}
+
+// vertical pass over whole rows first, then the horizontal one on the 84 rows left
+template<bool Simd>
+static void downsample(const uint8_t* frame, uint8_t* out)
+{
+	uint8_t rows[OBS_84_SIZE][LCD_WIDTH];
+
+	for (int y = 0; y < OBS_84_SIZE; y++)
+	{
+		const Sample& sample = tables.rows[y];
+		const uint8_t* a = frame + sample.index * LCD_WIDTH;
+		blendRows<Simd>(a, a + LCD_WIDTH, sample.weight, rows[y]);
+	}
+
+	for (int y = 0; y < OBS_84_SIZE; y++)
+		blendColumns<Simd>(rows[y], out + y * OBS_84_SIZE);
+}
+
+void downsampleFrame84(const uint8_t* frame, uint8_t* out)
+{
+	downsample<true>(frame, out);
+}
+
+void downsampleFrame84Scalar(const uint8_t* frame, uint8_t* out)
+{
+	downsample<false>(frame, out);
+}
+
+VecEnv::VecEnv(const EnvConfig& config)
+	: config(config),
+	  batch(config.envs, config.threads, config.pinThreads),
+	  episodeFrames(config.envs, 0)
+{
+}
+
+bool VecEnv::loadRom(const uint8_t* data, size_t size)
+{
+	if (config.envs == 0 || !batch.loadRom(data, size))
+		return false;
+
+	GameBoy& first = batch.instance(0);
+	for (int i = 0; i < config.startFrames; i++)
+		first.runFrame();
+
+	// with the frame, so a reset env has its observation right away
+	first.saveState(startState);
+	return true;
+}
+
+size_t VecEnv::observationSize() const
+{
+	return config.observation == OBS_FULL ? LCD_SIZE : OBS_84_SIZE * OBS_84_SIZE;
+}
+
+void VecEnv::resetEnv(size_t env)
+{
+	GameBoy& gb = batch.instance(env);
+	gb.loadState(startState.data(), startState.size());
+	episodeFrames[env] = 0;
+}
+
+void VecEnv::observe(size_t env, uint8_t* observations)
+{
+	const uint8_t* frame = batch.frames()[env];
+	uint8_t* out = observations + env * observationSize();
+
+	if (config.observation == OBS_FULL)
+		std::memcpy(out, frame, LCD_SIZE);
+	else
+		downsampleFrame84(frame, out);
+}
+
+void VecEnv::reset(uint8_t* observations)
+{
+	batch.forEach([&](size_t env)
+	{
+		resetEnv(env);
+		observe(env, observations);
+	});
+}
+
+void VecEnv::step(const uint8_t* actions, uint8_t* observations, float* rewards, uint8_t* dones)
+{
+	batch.forEach([&](size_t env)
+	{
+		GameBoy& gb = batch.instance(env);
+		gb.setButtons(actions[env]);
+
+		for (int i = 0; i < config.frameSkip; i++)
+			gb.runFrame();
+		episodeFrames[env] += config.frameSkip;
+
+		bool done = config.maxEpisodeFrames > 0 && episodeFrames[env] >= config.maxEpisodeFrames;
+		if (config.done && config.done(gb, env))
+			done = true;
+
+		rewards[env] = config.reward ? config.reward(gb, env) : 0.0f;
+		dones[env] = done;
+
+		if (done)
+			resetEnv(env);
+
+		observe(env, observations);
+	});
+}
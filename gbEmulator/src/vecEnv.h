@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "batchRunner.h"
+
+#define OBS_84_SIZE 84
+
+enum EnvObservation
+{
+	OBS_FULL,  // LCD_WIDTH * LCD_HEIGHT grey levels per env, as the ppu draws them
+	OBS_84X84, // OBS_84_SIZE * OBS_84_SIZE grey levels per env, bilinear downsampled
+};
+
+struct EnvConfig
+{
+	size_t envs = 8;
+	// worker threads, 0 for every hardware thread
+	unsigned int threads = 0;
+	bool pinThreads = true;
+
+	// frames every action is held for (action repeat), the observation is the last of them
+	int frameSkip = 4;
+	EnvObservation observation = OBS_84X84;
+
+	// frames run after power on before the start snapshot that reset goes back to is taken, to get past boot screens
+	int startFrames = 0;
+	// episodes end after this many frames, 0 for no limit
+	int maxEpisodeFrames = 0;
+
+	// called on the worker running env after each step, to compute the reward and whether the episode ended from the
+	// game's ram. Either can be empty (no reward, episodes only end by maxEpisodeFrames).
+	std::function<float(const GameBoy& gb, size_t env)> reward;
+	std::function<bool(const GameBoy& gb, size_t env)> done;
+};
+
+// Vectorized environment for agent training, on top of a BatchRunner so the envs are spread over the cores. Actions
+// are one JOYPAD_* bitmask of held buttons per env, the same bits as BatchRunner::setButtons, movies and libgb's
+// GB_BUTTON_*. Everything is written into caller provided batch arrays: observations is envs * observationSize() bytes,
+// rewards and dones have one entry per env.
+//
+// An env whose episode ended is reset inside step, and the observation step returns for it is the first one of the
+// new episode (its done flag tells the episode before ended). The start snapshot is taken once, so a reset is a
+// single loadState.
+class VecEnv
+{
+public:
+	VecEnv(const EnvConfig& config);
+
+	bool loadRom(const uint8_t* data, size_t size);
+
+	size_t size() const { return config.envs; }
+	unsigned int threads() const { return batch.threads(); }
+	size_t observationSize() const;
+	GameBoy& instance(size_t env) { return batch.instance(env); }
+
+	// puts every env back to the start snapshot
+	void reset(uint8_t* observations);
+	void step(const uint8_t* actions, uint8_t* observations, float* rewards, uint8_t* dones);
+
+private:
+	void resetEnv(size_t env);
+	void observe(size_t env, uint8_t* observations);
+
+	EnvConfig config;
+	BatchRunner batch;
+
+	std::vector<uint8_t> startState;
+	std::vector<int> episodeFrames;
+};
+
+// 160x144 frame to 84x84, fixed point bilinear with the two passes rounded to 8 bits. With SSE2 the vertical pass
+// blends whole rows 16 pixels at a time and the horizontal one 8 output pixels at a time with pmaddwd. The scalar
+// version is the reference the tests compare it with.
+void downsampleFrame84(const uint8_t* frame, uint8_t* out);
+void downsampleFrame84Scalar(const uint8_t* frame, uint8_t* out);
@@ -0,0 +1,299 @@
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "verifier.h"
+#include "regs.h"
+
+Verifier::Verifier(const VerifyConfig& config)
+	: config(config), referenceSide(std::make_unique<GameBoy>()), fastSide(std::make_unique<GameBoy>()),
+	spare(std::make_unique<GameBoy>()), referenceRing(config.traceWindow), fastRing(config.traceWindow)
+{
+	// without publishing ppu.LCD is the one frame buffer, finished frames stay in it until they are drawn over, and
+	// clones and save states carry it along
+	for (GameBoy* gb : { referenceSide.get(), fastSide.get(), spare.get() })
+		gb->ppu.publishFrames = false;
+}
+
+static bool sameFrame(const GameBoy& reference, const GameBoy& fast)
+{
+	return std::memcmp(reference.ppu.LCD, fast.ppu.LCD, LCD_SIZE) == 0;
+}
+
+bool Verifier::loadRom(const uint8_t* data, size_t size)
+{
+	if (!referenceSide->loadRom(data, size) || !fastSide->loadRom(data, size) || !spare->loadRom(data, size))
+		return false;
+
+	if (config.engines & VERIFY_TRANSLATED)
+	{
+		if (!fastSide->loadTranslatedCode(config.translatedPath))
+			return false;
+		spare->setTranslatedCode(fastSide->translatedCode());
+	}
+
+	frameCount = 0;
+	diverged = false;
+	return true;
+}
+
+bool Verifier::loadState(const uint8_t* data, size_t size)
+{
+	return referenceSide->loadState(data, size) && fastSide->loadState(data, size);
+}
+
+void Verifier::applyEngines()
+{
+	if (config.engines & VERIFY_CLONE)
+	{
+		fastSide->cloneInto(*spare);
+		std::swap(fastSide, spare);
+	}
+
+	if (config.engines & VERIFY_SAVE_STATE)
+	{
+		fastSide->saveState(scratch);
+		spare->loadState(scratch.data(), scratch.size());
+		std::swap(fastSide, spare);
+	}
+
+	if (config.fastFrameHook)
+		config.fastFrameHook(*fastSide, frameCount);
+}
+
+bool Verifier::runFrame(uint8_t buttons)
+{
+	if (diverged)
+		return false;
+
+	referenceSide->saveState(frameStart);
+	applyEngines();
+
+	if (config.perInstruction)
+	{
+		if (!stepFrame(buttons))
+			return false;
+
+		frameCount++;
+		return true;
+	}
+
+	referenceSide->setButtons(buttons);
+	fastSide->setButtons(buttons);
+	referenceSide->runFrame();
+	fastSide->runFrame();
+
+	if (referenceSide->fullStateHash() != fastSide->fullStateHash() || !sameFrame(*referenceSide, *fastSide))
+	{
+		// how the frame ended, kept in case running it again doesn't go wrong
+		Divergence atEnd;
+		atEnd.frame = frameCount;
+		referenceSide->saveState(atEnd.referenceState);
+		fastSide->saveState(atEnd.fastState);
+		atEnd.differences = describeDifferences(*referenceSide, *fastSide);
+
+		referenceSide->loadState(frameStart.data(), frameStart.size());
+		fastSide->loadState(frameStart.data(), frameStart.size());
+		applyEngines();
+
+		if (stepFrame(buttons))
+		{
+			found = std::move(atEnd);
+			diverged = true;
+		}
+		return false;
+	}
+
+	frameCount++;
+	return true;
+}
+
+// the frame ends where runFrame would end it: at the start of vblank, or after a frame worth of cycles
+static bool frameEnded(const GameBoy& gb, uint64_t startCycles)
+{
+	return (gb.mmu.events & EVENT_VBLANK) || gb.cpu.tCycles - startCycles >= CYCLES_PER_FRAME;
+}
+
+bool Verifier::stepFrame(uint8_t buttons)
+{
+	auto oneInstruction = [](const GameBoy&) { return true; };
+
+	referenceSide->setButtons(buttons);
+	fastSide->setButtons(buttons);
+	uint64_t referenceStart = referenceSide->cpu.tCycles;
+	uint64_t fastStart = fastSide->cpu.tCycles;
+
+	for (uint64_t instruction = 0; ; instruction++)
+	{
+		referenceSide->runUntil(oneInstruction);
+		fastSide->runUntil(oneInstruction);
+		uint64_t referenceHash = referenceSide->fullStateHash();
+		uint64_t fastHash = fastSide->fullStateHash();
+		record(*referenceSide, instruction, referenceHash, referenceRing);
+		record(*fastSide, instruction, fastHash, fastRing);
+
+		bool referenceEnded = frameEnded(*referenceSide, referenceStart);
+		if (referenceHash != fastHash || !sameFrame(*referenceSide, *fastSide)
+			|| referenceEnded != frameEnded(*fastSide, fastStart))
+		{
+			diverge((int64_t)instruction);
+			return false;
+		}
+
+		if (referenceEnded)
+			return true;
+	}
+}
+
+void Verifier::record(const GameBoy& gb, uint64_t instruction, uint64_t stateHash, std::vector<TraceEntry>& ring)
+{
+	if (ring.empty())
+		return;
+
+	TraceEntry& entry = ring[instruction % ring.size()];
+	entry.instruction = instruction;
+	entry.cycles = gb.cpu.tCycles;
+	entry.pc = gb.cpu.PC;
+	entry.sp = gb.cpu.SP;
+	std::memcpy(entry.regs, gb.cpu.regs, sizeof(entry.regs));
+	entry.ime = gb.cpu.IME;
+	entry.halted = gb.cpu.HALT;
+	entry.stateHash = stateHash;
+}
+
+// the ring in order, oldest first
+static std::vector<TraceEntry> unroll(const std::vector<TraceEntry>& ring, uint64_t last)
+{
+	std::vector<TraceEntry> trace;
+	if (ring.empty())
+		return trace;
+
+	uint64_t first = last + 1 > ring.size() ? last + 1 - ring.size() : 0;
+	for (uint64_t i = first; i <= last; i++)
+		trace.push_back(ring[i % ring.size()]);
+	return trace;
+}
+
+void Verifier::diverge(int64_t instruction)
+{
+	found = Divergence();
+	found.frame = frameCount;
+	found.instruction = instruction;
+	referenceSide->saveState(found.referenceState);
+	fastSide->saveState(found.fastState);
+	found.referenceTrace = unroll(referenceRing, (uint64_t)instruction);
+	found.fastTrace = unroll(fastRing, (uint64_t)instruction);
+	found.differences = describeDifferences(*referenceSide, *fastSide);
+	diverged = true;
+}
+
+template<typename T>
+static void compareField(std::string& out, const char* name, T reference, T fast)
+{
+	if (reference == fast)
+		return;
+
+	char line[128];
+	std::snprintf(line, sizeof(line), "%s: 0x%llx vs 0x%llx\n", name, (unsigned long long)reference,
+		(unsigned long long)fast);
+	out += line;
+}
+
+// how many bytes differ and the first of them, at its address from base
+static void compareBytes(std::string& out, const char* name, const uint8_t* reference, const uint8_t* fast,
+	size_t size, uint32_t base)
+{
+	size_t count = 0;
+	size_t first = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		if (reference[i] != fast[i] && count++ == 0)
+			first = i;
+	}
+
+	if (count == 0)
+		return;
+
+	char line[128];
+	std::snprintf(line, sizeof(line), "%s: %zu bytes differ, first at 0x%04X (0x%02X vs 0x%02X)\n", name, count,
+		(unsigned int)(base + first), reference[first], fast[first]);
+	out += line;
+}
+
+// how many pixels differ and the first of them, ppu.LCD holds the rows bottom up
+static void compareFrame(std::string& out, const uint8_t* reference, const uint8_t* fast)
+{
+	size_t count = 0;
+	size_t first = 0;
+	for (size_t i = 0; i < LCD_SIZE; i++)
+	{
+		if (reference[i] != fast[i] && count++ == 0)
+			first = i;
+	}
+
+	if (count == 0)
+		return;
+
+	char line[128];
+	std::snprintf(line, sizeof(line), "frame: %zu pixels differ, first at %zu,%zu (%u vs %u)\n", count,
+		first % LCD_WIDTH, (size_t)LCD_HEIGHT - 1 - first / LCD_WIDTH, reference[first], fast[first]);
+	out += line;
+}
+
+std::string describeDifferences(const GameBoy& reference, const GameBoy& fast)
+{
+	static const char* regNames[8] = { "b", "c", "d", "e", "h", "l", "f", "a" };
+
+	std::string out;
+	const CPUState& a = reference.cpu;
+	const CPUState& b = fast.cpu;
+
+	for (int i = 0; i < 8; i++)
+		compareField(out, regNames[i], a.regs[i], b.regs[i]);
+	compareField(out, "sp", a.SP, b.SP);
+	compareField(out, "pc", a.PC, b.PC);
+	compareField(out, "ime", a.IME, b.IME);
+	compareField(out, "ime pending", a.updateIME, b.updateIME);
+	compareField(out, "halt", a.HALT, b.HALT);
+	compareField(out, "tCycles", a.tCycles, b.tCycles);
+	compareField(out, "div", a.DIV, b.DIV);
+	compareField(out, "divCycles", a.divCycles, b.divCycles);
+	compareField(out, "lastANDResult", a.lastANDResult, b.lastANDResult);
+	compareField(out, "tima reload", a.timaReloadPending, b.timaReloadPending);
+	compareField(out, "serial transfer", a.serialTransferActive, b.serialTransferActive);
+	compareField(out, "serialCycles", a.serialCycles, b.serialCycles);
+
+	const MMUState& x = reference.mmu;
+	const MMUState& y = fast.mmu;
+
+	compareBytes(out, "vRam", x.vRam, y.vRam, sizeof(x.vRam), 0x8000);
+	compareBytes(out, "wRam", x.wRam, y.wRam, sizeof(x.wRam), 0xC000);
+	compareBytes(out, "oam", x.oam, y.oam, sizeof(x.oam), 0xFE00);
+	compareBytes(out, "ioRegs", x.ioRegs, y.ioRegs, sizeof(x.ioRegs), 0xFF00);
+	compareBytes(out, "hRam", x.hRam, y.hRam, sizeof(x.hRam), 0xFF80);
+	compareBytes(out, "ie", x.ie, y.ie, sizeof(x.ie), 0xFFFF);
+	compareField(out, "romBankNumber", x.romBankNumber, y.romBankNumber);
+	compareField(out, "ramBankNumber", x.ramBankNumber, y.ramBankNumber);
+	compareField(out, "joypadButtons", x.joypadButtons, y.joypadButtons);
+	compareField(out, "dma", x.dmaTransferRequested, y.dmaTransferRequested);
+
+	// everything after ie: mbc, rtc, joypad, serial and dma state, offsets into the rest of MMUState
+	const uint8_t* xBytes = reinterpret_cast<const uint8_t*>(&x);
+	const uint8_t* yBytes = reinterpret_cast<const uint8_t*>(&y);
+	size_t rest = (x.ie + 1) - xBytes;
+	compareBytes(out, "mmu registers", xBytes + rest, yBytes + rest, sizeof(MMUState) - rest, 0);
+
+	const CowBuffer& xRam = reference.mmu.eRam;
+	const CowBuffer& yRam = fast.mmu.eRam;
+	if (xRam.size() != yRam.size())
+		compareField(out, "eRam size", xRam.size(), yRam.size());
+	else
+		compareBytes(out, "eRam offset", xRam.data(), yRam.data(), xRam.size(), 0);
+
+	// offsets into PPUState, its registers the game sees are in ioRegs
+	compareBytes(out, "ppu state", reinterpret_cast<const uint8_t*>(static_cast<const PPUState*>(&reference.ppu)),
+		reinterpret_cast<const uint8_t*>(static_cast<const PPUState*>(&fast.ppu)), sizeof(PPUState), 0);
+	compareFrame(out, reference.ppu.LCD, fast.ppu.LCD);
+
+	return out;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gb.h"
+
+// fast paths a Verifier checks against the interpreter, any combination of them
+#define VERIFY_TRANSLATED 0x01 // code translated by gb2cpp (translatedCode.h)
+#define VERIFY_CLONE      0x02 // the fast side goes on as a clone of itself every frame (GameBoy::cloneInto)
+#define VERIFY_SAVE_STATE 0x04 // the fast side goes on from a save state of itself every frame
+
+struct VerifyConfig
+{
+	uint32_t engines = VERIFY_CLONE | VERIFY_SAVE_STATE;
+	// plugin made from the rom by gb2cpp, needed for VERIFY_TRANSLATED
+	std::string translatedPath;
+
+	// compares after every instruction instead of every frame, slower but a frame that ends in the same state after
+	// going wrong in the middle doesn't get through
+	bool perInstruction = false;
+	// instructions kept before the divergence, for each side
+	size_t traceWindow = 32;
+
+	// called on the fast side at the start of every frame, after the engines are applied. For testing the verifier
+	// itself: a hook that changes the state is a divergence the verifier has to find.
+	std::function<void(GameBoy& fast, uint64_t frame)> fastFrameHook;
+};
+
+// one instruction of a side, as it was after the instruction ran
+struct TraceEntry
+{
+	// instructions since the start of the frame, 0 is the first one
+	uint64_t instruction = 0;
+	// cpu.tCycles
+	uint64_t cycles = 0;
+	uint16_t pc = 0;
+	uint16_t sp = 0;
+	uint8_t regs[8]{};
+	bool ime = false;
+	bool halted = false;
+	// GameBoy::fullStateHash
+	uint64_t stateHash = 0;
+};
+
+struct Divergence
+{
+	// frames run before the one that diverged
+	uint64_t frame = 0;
+	// first instruction of the frame after which the state hashes differ, -1 when the frame only differs at its end
+	// and running it again one instruction at a time didn't (the difference depends on where runFrame returns)
+	int64_t instruction = -1;
+	// save states of both sides right after the instruction, or at the end of the frame without one
+	std::vector<uint8_t> referenceState;
+	std::vector<uint8_t> fastState;
+	// the last traceWindow instructions of each side up to and including the diverging one
+	std::vector<TraceEntry> referenceTrace;
+	std::vector<TraceEntry> fastTrace;
+	// what differs, one line per cpu field, memory region, state block or the frame
+	std::string differences;
+};
+
+// Runs the reference interpreter and a fast path side by side on the same rom and buttons and compares the full state
+// hash (GameBoy::fullStateHash) and the frame in ppu.LCD after every frame, or every instruction in the strict
+// setting. The sides don't publish frames, so ppu.LCD holds the finished frame at the end of one. When a frame ends
+// differently it is run again from a snapshot taken at its start, one instruction at a time on both sides, to find
+// the first instruction that went wrong. Once the sides diverged runFrame does nothing more.
+class Verifier
+{
+public:
+	Verifier(const VerifyConfig& config);
+
+	// false if the rom doesn't load or the translated code can't be loaded for it
+	bool loadRom(const uint8_t* data, size_t size);
+	// puts both sides in a save state, like the start state of a movie
+	bool loadState(const uint8_t* data, size_t size);
+
+	// runs a frame with buttons (JOYPAD_* bitmask) held on both sides, false once they diverged
+	bool runFrame(uint8_t buttons);
+
+	// set when runFrame returned false
+	const Divergence* divergence() const { return diverged ? &found : nullptr; }
+	uint64_t frames() const { return frameCount; }
+
+	GameBoy& reference() { return *referenceSide; }
+	GameBoy& fast() { return *fastSide; }
+
+private:
+	VerifyConfig config;
+
+	std::unique_ptr<GameBoy> referenceSide;
+	std::unique_ptr<GameBoy> fastSide;
+	// the instance the fast side is cloned or loaded into next, swapped with it
+	std::unique_ptr<GameBoy> spare;
+
+	uint64_t frameCount = 0;
+	bool diverged = false;
+	Divergence found;
+
+	std::vector<uint8_t> frameStart;
+	std::vector<uint8_t> scratch;
+	// rings of the last traceWindow instructions
+	std::vector<TraceEntry> referenceRing;
+	std::vector<TraceEntry> fastRing;
+
+	void applyEngines();
+	// runs the frame on both sides one instruction at a time, false with found filled in at the first difference
+	bool stepFrame(uint8_t buttons);
+	void record(const GameBoy& gb, uint64_t instruction, uint64_t stateHash, std::vector<TraceEntry>& ring);
+	void diverge(int64_t instruction);
+};
+
+// the lines of Divergence::differences for two states, the frame line only means something for instances that don't
+// publish frames (PPU::publishFrames)
+std::string describeDifferences(const GameBoy& reference, const GameBoy& fast);
@@ -0,0 +1,84 @@
+// batchRunnerTest: instances stepped by a BatchRunner on several threads end up exactly where the same instances run
+// one by one do, whichever worker ran each frame, and the strided views point at each instance's frame and ram.
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "batchRunner.h"
+#include "gb.h"
+#include "testRoms.h"
+
+#define INSTANCES 7
+#define THREADS 3
+#define TEST_FRAMES 100
+
+// every instance holds A for a different pattern of frames, so their screens and ram differ
+static uint8_t buttonsAt(size_t instance, int frame)
+{
+	return ((frame / (int)(instance + 2)) % 2) ? JOYPAD_A : 0;
+}
+
+int main()
+{
+	std::vector<uint8_t> rom = buildInputLagRom();
+
+	BatchRunner batch(INSTANCES, THREADS);
+	check(batch.size() == INSTANCES && batch.threads() == THREADS, "instance and thread counts");
+	check(batch.loadRom(rom.data(), rom.size()), "rom loads into every instance");
+
+	std::vector<std::unique_ptr<GameBoy>> single;
+	for (size_t i = 0; i < INSTANCES; i++)
+	{
+		single.push_back(std::make_unique<GameBoy>());
+		single.back()->loadRom(rom.data(), rom.size());
+	}
+
+	bool sameFrames = true;
+	bool sameRam = true;
+
+	for (int frame = 0; frame < TEST_FRAMES; frame++)
+	{
+		for (size_t i = 0; i < INSTANCES; i++)
+		{
+			batch.setButtons(i, buttonsAt(i, frame));
+			single[i]->setButtons(buttonsAt(i, frame));
+			single[i]->runFrame();
+		}
+
+		batch.stepFrame();
+
+		StridedView frames = batch.frames();
+		StridedView workRam = batch.workRam();
+		StridedView highRam = batch.highRam();
+
+		for (size_t i = 0; i < INSTANCES; i++)
+		{
+			FrameBuffer& frameBuffer = single[i]->ppu.frameBuffer;
+			if (frameBuffer.acquire())
+				sameFrames &= std::memcmp(frames[i], frameBuffer.readBuffer(), LCD_SIZE) == 0;
+
+			sameRam &= std::memcmp(workRam[i], single[i]->mmu.wRam, workRam.size) == 0;
+			sameRam &= std::memcmp(highRam[i], single[i]->mmu.hRam, highRam.size) == 0;
+		}
+	}
+
+	check(sameFrames, "frames match instances run on their own");
+	check(sameRam, "ram matches instances run on their own");
+
+	// the rom draws one shade over the whole screen, white while A showed up two frames ago
+	StridedView frames = batch.frames();
+	bool different = false;
+	for (size_t i = 1; i < INSTANCES; i++)
+		different |= frames[i][0] != frames[0][0];
+	check(different, "inputs reach their own instance");
+
+	check(batch.workRam()[3] == batch.instance(3).mmu.wRam, "ram view points into the instance");
+	check(frames[5] == batch.instance(5).ppu.LCD, "frame view is what the ppu draws into");
+
+	if (failures == 0)
+		std::printf("all batch runner checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
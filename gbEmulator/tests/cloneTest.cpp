@@ -0,0 +1,138 @@
+// cloneTest: a clone made in the middle of a frame carries on exactly like its parent, shares the rom and the
+// external ram until it writes to it, and outlives its parent. cloneInto over an instance that ran something else
+// gives the same clone, and a clone made in vblank without publishing has the finished frame.
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "gb.h"
+#include "hash.h"
+#include "testRoms.h"
+
+#define WARMUP_FRAMES 30
+#define TEST_FRAMES 20
+
+static uint64_t stateHash(GameBoy& gb)
+{
+	gb.ppu.frameBuffer.acquire();
+	uint64_t hash = hashBytes(gb.ppu.frameBuffer.readBuffer(), LCD_SIZE);
+	hash = hashBytes(gb.mmu.wRam, sizeof(gb.mmu.wRam), hash);
+	hash = hashBytes(gb.mmu.eRam.data(), gb.mmu.eRam.size(), hash);
+	return hash ^ gb.cpu.tCycles;
+}
+
+// frame and ram hashes of the next TEST_FRAMES frames
+static std::vector<uint64_t> play(GameBoy& gb)
+{
+	std::vector<uint64_t> hashes;
+	for (int i = 0; i < TEST_FRAMES; i++)
+	{
+		gb.runFrame();
+		hashes.push_back(stateHash(gb));
+	}
+	return hashes;
+}
+
+static std::unique_ptr<GameBoy> startGame()
+{
+	std::vector<uint8_t> rom = buildBusyRom('C');
+	auto gb = std::make_unique<GameBoy>();
+	gb->loadRom(rom.data(), rom.size());
+
+	for (int i = 0; i < WARMUP_FRAMES; i++)
+		gb->runFrame();
+
+	// half way down the screen, so the frame the clone finishes has lines drawn by the parent
+	gb->runCycles(CYCLES_PER_FRAME / 2);
+	return gb;
+}
+
+static void testSameTimeline()
+{
+	std::unique_ptr<GameBoy> parent = startGame();
+	std::unique_ptr<GameBoy> child = parent->clone();
+
+	check(child->mmu.fullrom == parent->mmu.fullrom, "the rom is shared");
+	check(child->mmu.eRam.data() == parent->mmu.eRam.data() && parent->mmu.eRam.shared(), "external ram is shared");
+
+	std::vector<uint8_t> parentRam(parent->mmu.eRam.data(), parent->mmu.eRam.data() + parent->mmu.eRam.size());
+
+	// the timer interrupt writes to external ram every couple of thousand cycles
+	child->runCycles(20000);
+	check(child->mmu.eRam.data() != parent->mmu.eRam.data(), "a write gives the clone its own external ram");
+	check(!parent->mmu.eRam.shared(), "the parent's ram is its own again");
+	check(std::memcmp(parent->mmu.eRam.data(), parentRam.data(), parentRam.size()) == 0,
+		"the clone's writes don't reach the parent");
+
+	child->mmu.write8(0xC123, 0x5A);
+	parent->mmu.write8(0xC123, 0xA5);
+	check(child->mmu.read8(0xC123) == 0x5A, "work ram is the clone's own");
+
+	// a fresh clone from the same point plays the parent's frames
+	std::unique_ptr<GameBoy> twin = startGame();
+	std::unique_ptr<GameBoy> twinClone = twin->clone();
+	twin.reset();
+
+	std::vector<uint64_t> expected = play(*startGame());
+	check(play(*twinClone) == expected, "a clone made mid frame plays the same frames, after its parent is gone");
+}
+
+static void testCloneInto()
+{
+	std::unique_ptr<GameBoy> parent = startGame();
+
+	// an instance with its own history, another rom and its own breakpoints
+	std::vector<uint8_t> otherRom = buildInputLagRom();
+	GameBoy reused;
+	reused.loadRom(otherRom.data(), otherRom.size());
+	reused.addBreakpoint(0x0150);
+	reused.addWatchpoint(0xC000);
+	for (int i = 0; i < 5; i++)
+		reused.runFrame();
+
+	parent->cloneInto(reused);
+	check(reused.mmu.watchpointCount == 0 && reused.mmu.watchpoints.none(), "cloneInto clears the old watchpoints");
+	std::vector<uint64_t> fromReused = play(reused);
+	check(fromReused == play(*parent), "cloneInto over a used instance plays the parent's frames");
+
+	// and brings the parent's along
+	parent->addWatchpoint(0xC123);
+	parent->cloneInto(reused);
+	check(reused.mmu.watchpointCount == 1 && reused.mmu.watchpoints[0xC123], "cloneInto copies watchpoints in use");
+}
+
+// without publishing the frame a BatchRunner view shows is in ppu.LCD, a clone made at vblank needs it too
+static void testUnpublishedFrame()
+{
+	std::vector<uint8_t> rom = buildBusyRom('C');
+	GameBoy parent;
+	parent.ppu.publishFrames = false;
+	parent.loadRom(rom.data(), rom.size());
+	for (int i = 0; i < WARMUP_FRAMES; i++)
+		parent.runFrame();
+
+	std::vector<uint8_t> otherRom = buildInputLagRom();
+	GameBoy child;
+	child.ppu.publishFrames = false;
+	child.loadRom(otherRom.data(), otherRom.size());
+	for (int i = 0; i < 5; i++)
+		child.runFrame();
+
+	check(parent.ppu.ppuMode == VBLANK_1, "the parent is in vblank");
+	parent.cloneInto(child);
+	check(std::memcmp(child.ppu.LCD, parent.ppu.LCD, LCD_SIZE) == 0, "a clone made in vblank has the finished frame");
+}
+
+int main()
+{
+	testSameTimeline();
+	testCloneInto();
+	testUnpublishedFrame();
+
+	if (failures == 0)
+		std::printf("all clone checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
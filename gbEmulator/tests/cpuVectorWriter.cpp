@@ -0,0 +1,157 @@
+// cpuVectorWriter: writes hand-written cpu test vectors in the packed format (testVectors.h), so cputest checks
+// something without the SingleStepTests corpus. handwritten.gbv holds vectors that have to pass, handwrittenWrong.gbv
+// a deliberately wrong one next to a right one, to check that cputest reports mismatches. handwrittenBadRange.gbv has
+// an opcode range past its last vector, like a truncated file, which cputest has to refuse.
+//
+// usage: cpuVectorWriter <directory>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bus.h"
+#include "testVectors.h"
+
+struct NamedVector
+{
+	int opcode;
+	Vector vector;
+};
+
+// registers in the order a, b, c, d, e, f, h, l
+static VectorState state(uint16_t pc, uint16_t sp, std::initializer_list<uint8_t> regs,
+	std::initializer_list<VectorRam> ram)
+{
+	VectorState s{};
+	s.pc = pc;
+	s.sp = sp;
+
+	uint8_t* targets[8] = { &s.a, &s.b, &s.c, &s.d, &s.e, &s.f, &s.h, &s.l };
+	int i = 0;
+	for (uint8_t value : regs)
+		*targets[i++] = value;
+
+	for (const VectorRam& entry : ram)
+		s.ram[s.ramCount++] = entry;
+	return s;
+}
+
+static VectorCycle read(uint16_t address, uint8_t value) { return { address, value, BUS_READ }; }
+static VectorCycle write(uint16_t address, uint8_t value) { return { address, value, BUS_WRITE }; }
+static VectorCycle idle() { return { 0, 0, BUS_IDLE }; }
+
+static NamedVector vector(int opcode, const char* name, const VectorState& initial, const VectorState& final,
+	std::initializer_list<VectorCycle> cycles)
+{
+	NamedVector named{};
+	named.opcode = opcode;
+	std::strncpy(named.vector.name, name, sizeof(named.vector.name) - 1);
+	named.vector.initial = initial;
+	named.vector.final = final;
+	for (const VectorCycle& cycle : cycles)
+		named.vector.cycles[named.vector.cycleCount++] = cycle;
+	return named;
+}
+
+static std::vector<NamedVector> rightVectors()
+{
+	return {
+		// nop
+		vector(0x00, "00 0000",
+			state(0x1000, 0xFFFE, {}, { { 0x1000, 0x00 } }),
+			state(0x1001, 0xFFFE, {}, { { 0x1000, 0x00 } }),
+			{ read(0x1000, 0x00) }),
+		// ld a, 0x42
+		vector(0x3E, "3e 0000",
+			state(0x2000, 0xFFFE, {}, { { 0x2000, 0x3E }, { 0x2001, 0x42 } }),
+			state(0x2002, 0xFFFE, { 0x42 }, { { 0x2000, 0x3E }, { 0x2001, 0x42 } }),
+			{ read(0x2000, 0x3E), read(0x2001, 0x42) }),
+		// push bc, the idle m-cycle decrements sp before the writes
+		vector(0xC5, "c5 0000",
+			state(0x3000, 0xFFFE, { 0x00, 0x12, 0x34 }, { { 0x3000, 0xC5 } }),
+			state(0x3001, 0xFFFC, { 0x00, 0x12, 0x34 }, { { 0x3000, 0xC5 }, { 0xFFFD, 0x12 }, { 0xFFFC, 0x34 } }),
+			{ read(0x3000, 0xC5), idle(), write(0xFFFD, 0x12), write(0xFFFC, 0x34) }),
+		// swap a
+		vector(0x137, "cb 37 0000",
+			state(0x4000, 0xFFFE, { 0xAB }, { { 0x4000, 0xCB }, { 0x4001, 0x37 } }),
+			state(0x4002, 0xFFFE, { 0xBA }, { { 0x4000, 0xCB }, { 0x4001, 0x37 } }),
+			{ read(0x4000, 0xCB), read(0x4001, 0x37) }),
+		// xor a sets Z and clears the other flags
+		vector(0xAF, "af 0000",
+			state(0x5000, 0xFFFE, { 0x5A, 0, 0, 0, 0, 0x70 }, { { 0x5000, 0xAF } }),
+			state(0x5001, 0xFFFE, { 0x00, 0, 0, 0, 0, 0x80 }, { { 0x5000, 0xAF } }),
+			{ read(0x5000, 0xAF) }),
+		// jr +2, taken jumps spend an idle m-cycle
+		vector(0x18, "18 0000",
+			state(0x6000, 0xFFFE, {}, { { 0x6000, 0x18 }, { 0x6001, 0x02 } }),
+			state(0x6004, 0xFFFE, {}, { { 0x6000, 0x18 }, { 0x6001, 0x02 } }),
+			{ read(0x6000, 0x18), read(0x6001, 0x02), idle() }),
+	};
+}
+
+static std::vector<NamedVector> wrongVectors()
+{
+	return {
+		vector(0x3E, "3e 0000",
+			state(0x2000, 0xFFFE, {}, { { 0x2000, 0x3E }, { 0x2001, 0x42 } }),
+			state(0x2002, 0xFFFE, { 0x42 }, { { 0x2000, 0x3E }, { 0x2001, 0x42 } }),
+			{ read(0x2000, 0x3E), read(0x2001, 0x42) }),
+		// ld a, 0x43 can't leave 0x44 in a
+		vector(0x3E, "3e 0001",
+			state(0x2000, 0xFFFE, {}, { { 0x2000, 0x3E }, { 0x2001, 0x43 } }),
+			state(0x2002, 0xFFFE, { 0x44 }, { { 0x2000, 0x3E }, { 0x2001, 0x43 } }),
+			{ read(0x2000, 0x3E), read(0x2001, 0x43) }),
+	};
+}
+
+// pastTheEnd makes the last opcode's range claim one vector more than the file has
+static bool writeVectors(const std::string& path, std::vector<NamedVector> vectors, bool pastTheEnd = false)
+{
+	std::stable_sort(vectors.begin(), vectors.end(),
+		[](const NamedVector& a, const NamedVector& b) { return a.opcode < b.opcode; });
+
+	VectorFileHeader header{};
+	header.magic = VECTOR_MAGIC;
+	header.version = VECTOR_VERSION;
+	header.vectorCount = (uint32_t)vectors.size();
+
+	for (uint32_t i = 0; i < vectors.size(); i++)
+	{
+		VectorRange& range = header.opcodes[vectors[i].opcode];
+		if (range.count++ == 0)
+			range.first = i;
+	}
+
+	if (pastTheEnd)
+		header.opcodes[vectors.back().opcode].count++;
+
+	std::ofstream os(path, std::ofstream::binary);
+	os.write((const char*)&header, sizeof(header));
+	for (const NamedVector& named : vectors)
+		os.write((const char*)&named.vector, sizeof(named.vector));
+	return (bool)os;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::cerr << "usage: cpuVectorWriter <directory>\n";
+		return 2;
+	}
+
+	std::string directory = argv[1];
+	if (!writeVectors(directory + "/handwritten.gbv", rightVectors())
+		|| !writeVectors(directory + "/handwrittenWrong.gbv", wrongVectors())
+		|| !writeVectors(directory + "/handwrittenBadRange.gbv", rightVectors(), true))
+	{
+		std::cerr << "cpuVectorWriter: could not write to " << directory << "\n";
+		return 2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,364 @@
+// cputest: checks every instruction against the SingleStepTests sm83 vectors packed by gbvecpack. The cpu runs on
+// FlatTestBus, a flat 64 KiB memory that logs every m-cycle. Opcodes are handed out to one worker (with its own
+// cpu and memory) per core, and the first mismatching vector of each opcode is reported with the expected and
+// actual registers, memory and bus activity.
+//
+// usage: cputest <vector file> [--jobs N] [--opcode hex]   (cb prefixed opcodes are 0x1xx, e.g. 17c is cb 7c)
+//
+// Exit code is 0 if everything passed, 1 on mismatches and 77 (skipped under ctest) when the vector file is missing.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "cpu.h"
+#include "regs.h"
+#include "testVectors.h"
+
+#define EXIT_SKIPPED 77
+
+// read only view of the vector file, mapped where possible
+class VectorFile
+{
+public:
+	~VectorFile()
+	{
+#ifndef _WIN32
+		if (mapping)
+			munmap(mapping, mappingSize);
+#endif
+	}
+
+	bool open(const char* path)
+	{
+#ifndef _WIN32
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			mappingSize = info.st_size;
+			mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping == MAP_FAILED)
+				mapping = nullptr;
+		}
+		::close(fd);
+
+		if (mapping)
+		{
+			data = (const uint8_t*)mapping;
+			size = mappingSize;
+			return true;
+		}
+#endif
+		std::ifstream is(path, std::ifstream::binary);
+		if (!is)
+			return false;
+
+		buffer.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+		data = buffer.data();
+		size = buffer.size();
+		return true;
+	}
+
+	const VectorFileHeader* header() const { return (const VectorFileHeader*)data; }
+	const Vector* vectors() const { return (const Vector*)(data + sizeof(VectorFileHeader)); }
+
+	bool valid() const
+	{
+		if (size < sizeof(VectorFileHeader) || header()->magic != VECTOR_MAGIC || header()->version != VECTOR_VERSION
+			|| size < sizeof(VectorFileHeader) + (uint64_t)header()->vectorCount * sizeof(Vector))
+			return false;
+
+		// a truncated or stale file can point opcodes past its vectors
+		for (const VectorRange& range : header()->opcodes)
+		{
+			if ((uint64_t)range.first + range.count > header()->vectorCount)
+				return false;
+		}
+		return true;
+	}
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+	void* mapping = nullptr;
+	size_t mappingSize = 0;
+	std::vector<uint8_t> buffer;
+};
+
+// everything one worker thread needs
+struct TestMachine
+{
+	FlatTestBus bus;
+	CPU<FlatTestBus> cpu{ bus };
+};
+
+struct OpcodeResult
+{
+	uint32_t tested = 0;
+	uint32_t failed = 0;
+	std::string report;
+};
+
+static void loadState(TestMachine& machine, const VectorState& state)
+{
+	CPU<FlatTestBus>& cpu = machine.cpu;
+	cpu.PC = state.pc;
+	cpu.SP = state.sp;
+	cpu.regs[REG_A] = state.a;
+	cpu.regs[REG_B] = state.b;
+	cpu.regs[REG_C] = state.c;
+	cpu.regs[REG_D] = state.d;
+	cpu.regs[REG_E] = state.e;
+	cpu.regs[REG_F] = state.f;
+	cpu.regs[REG_H] = state.h;
+	cpu.regs[REG_L] = state.l;
+	cpu.IME = state.ime;
+	cpu.updateIME = false;
+	cpu.HALT = false;
+
+	machine.bus.memory[IE_ADDRESS] = state.ie;
+	for (int i = 0; i < state.ramCount; i++)
+		machine.bus.memory[state.ram[i].address] = state.ram[i].value;
+}
+
+// puts the memory the vector touched back to zero for the next one
+static void clearMemory(FlatTestBus& bus, const Vector& vector)
+{
+	for (int i = 0; i < vector.initial.ramCount; i++)
+		bus.memory[vector.initial.ram[i].address] = 0;
+	for (int i = 0; i < vector.final.ramCount; i++)
+		bus.memory[vector.final.ram[i].address] = 0;
+	for (unsigned int i = 0; i < bus.logSize; i++)
+		bus.memory[bus.log[i].address] = 0;
+	bus.memory[IE_ADDRESS] = 0;
+}
+
+static bool matches(TestMachine& machine, const Vector& vector)
+{
+	const VectorState& state = vector.final;
+	CPU<FlatTestBus>& cpu = machine.cpu;
+	FlatTestBus& bus = machine.bus;
+
+	bool pass = cpu.PC == state.pc && cpu.SP == state.sp && cpu.regs[REG_A] == state.a && cpu.regs[REG_B] == state.b
+		&& cpu.regs[REG_C] == state.c && cpu.regs[REG_D] == state.d && cpu.regs[REG_E] == state.e
+		&& cpu.regs[REG_F] == state.f && cpu.regs[REG_H] == state.h && cpu.regs[REG_L] == state.l
+		&& cpu.IME == (bool)state.ime && bus.memory[IE_ADDRESS] == state.ie;
+
+	for (int i = 0; i < state.ramCount; i++)
+		pass &= bus.memory[state.ram[i].address] == state.ram[i].value;
+
+	pass &= bus.logSize == vector.cycleCount;
+	for (unsigned int i = 0; pass && i < vector.cycleCount; i++)
+	{
+		const VectorCycle& expected = vector.cycles[i];
+		const FlatTestBus::Cycle& actual = bus.log[i];
+
+		pass &= expected.type == actual.type;
+		if (expected.type != BUS_IDLE)
+			pass &= expected.address == actual.address && expected.value == actual.value;
+	}
+
+	return pass;
+}
+
+static std::string formatCycle(uint8_t type, uint16_t address, uint8_t value)
+{
+	char text[32];
+	if (type == BUS_IDLE)
+		std::snprintf(text, sizeof(text), "---");
+	else
+		std::snprintf(text, sizeof(text), "%s %04x %02x", type == BUS_READ ? "r" : "w", address, value);
+	return text;
+}
+
+static std::string describeMismatch(TestMachine& machine, const Vector& vector)
+{
+	const VectorState& e = vector.final;
+	CPU<FlatTestBus>& cpu = machine.cpu;
+	FlatTestBus& bus = machine.bus;
+	std::string report;
+	char line[160];
+
+	std::snprintf(line, sizeof(line), "  vector \"%s\"\n", vector.name);
+	report += line;
+
+	auto reg = [&](const char* name, unsigned int expected, unsigned int actual)
+	{
+		std::snprintf(line, sizeof(line), "    %-4s expected %04x  actual %04x%s\n", name, expected, actual,
+			expected == actual ? "" : "  <--");
+		report += line;
+	};
+
+	reg("pc", e.pc, cpu.PC);
+	reg("sp", e.sp, cpu.SP);
+	reg("a", e.a, cpu.regs[REG_A]);
+	reg("f", e.f, cpu.regs[REG_F]);
+	reg("b", e.b, cpu.regs[REG_B]);
+	reg("c", e.c, cpu.regs[REG_C]);
+	reg("d", e.d, cpu.regs[REG_D]);
+	reg("e", e.e, cpu.regs[REG_E]);
+	reg("h", e.h, cpu.regs[REG_H]);
+	reg("l", e.l, cpu.regs[REG_L]);
+	reg("ime", e.ime, cpu.IME);
+	reg("ie", e.ie, bus.memory[IE_ADDRESS]);
+
+	for (int i = 0; i < e.ramCount; i++)
+	{
+		uint8_t actual = bus.memory[e.ram[i].address];
+		std::snprintf(line, sizeof(line), "    [%04x] expected %02x    actual %02x%s\n", e.ram[i].address, e.ram[i].value,
+			actual, actual == e.ram[i].value ? "" : "    <--");
+		report += line;
+	}
+
+	report += "    bus      expected        actual\n";
+	unsigned int cycles = std::max<unsigned int>(vector.cycleCount, bus.logSize);
+	for (unsigned int i = 0; i < cycles; i++)
+	{
+		std::string expected = i < vector.cycleCount
+			? formatCycle(vector.cycles[i].type, vector.cycles[i].address, vector.cycles[i].value) : "";
+		std::string actual = i < bus.logSize
+			? formatCycle(bus.log[i].type, bus.log[i].address, bus.log[i].value) : "";
+		std::snprintf(line, sizeof(line), "    m%-6u %-15s %s\n", i + 1, expected.c_str(), actual.c_str());
+		report += line;
+	}
+
+	return report;
+}
+
+static OpcodeResult runOpcode(TestMachine& machine, const Vector* vectors, const VectorRange& range)
+{
+	OpcodeResult result;
+
+	for (uint32_t i = range.first; i < range.first + range.count; i++)
+	{
+		const Vector& vector = vectors[i];
+
+		loadState(machine, vector.initial);
+		machine.bus.logSize = 0;
+
+		uint8_t opcode = machine.cpu.fetch8();
+		machine.cpu.decodeAndExecute(opcode);
+
+		result.tested++;
+		if (!matches(machine, vector))
+		{
+			if (result.failed++ == 0)
+				result.report = describeMismatch(machine, vector);
+		}
+
+		clearMemory(machine.bus, vector);
+	}
+
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = nullptr;
+	unsigned int jobs = 0;
+	int onlyOpcode = -1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--jobs" && i + 1 < argc)
+			jobs = std::atoi(argv[++i]);
+		else if (arg == "--opcode" && i + 1 < argc)
+			onlyOpcode = std::strtol(argv[++i], nullptr, 16);
+		else if (!path && arg[0] != '-')
+			path = argv[i];
+		else
+		{
+			std::fprintf(stderr, "usage: cputest <vector file> [--jobs N] [--opcode hex]\n");
+			return 2;
+		}
+	}
+
+	VectorFile file;
+	if (!path || !file.open(path))
+	{
+		std::printf("cputest: no vector file%s%s, skipping. Create one with gbvecpack from the SingleStepTests sm83 "
+			"json files.\n", path ? " at " : "", path ? path : "");
+		return EXIT_SKIPPED;
+	}
+
+	if (!file.valid())
+	{
+		std::fprintf(stderr, "cputest: %s is not a version %d vector file or is damaged\n", path, VECTOR_VERSION);
+		return 2;
+	}
+
+	const VectorFileHeader* header = file.header();
+
+	std::vector<int> opcodes;
+	for (int index = 0; index < VECTOR_OPCODES; index++)
+	{
+		if (header->opcodes[index].count > 0 && (onlyOpcode < 0 || onlyOpcode == index))
+			opcodes.push_back(index);
+	}
+
+	std::vector<OpcodeResult> results(VECTOR_OPCODES);
+	std::atomic<size_t> next{ 0 };
+
+	if (jobs == 0)
+		jobs = std::max(1u, std::thread::hardware_concurrency());
+	jobs = std::min<unsigned int>(jobs, std::max<size_t>(opcodes.size(), 1));
+
+	auto worker = [&]()
+	{
+		auto machine = std::make_unique<TestMachine>();
+
+		for (size_t i = next++; i < opcodes.size(); i = next++)
+		{
+			int index = opcodes[i];
+			results[index] = runOpcode(*machine, file.vectors(), header->opcodes[index]);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < jobs; i++)
+		threads.emplace_back(worker);
+	for (std::thread& thread : threads)
+		thread.join();
+
+	uint64_t tested = 0;
+	int failedOpcodes = 0;
+
+	for (int index : opcodes)
+	{
+		const OpcodeResult& result = results[index];
+		tested += result.tested;
+
+		if (result.failed == 0)
+			continue;
+
+		failedOpcodes++;
+		std::printf("FAIL %s%02x: %u of %u vectors\n%s\n", index < 0x100 ? "" : "cb ", index & 0xFF, result.failed,
+			result.tested, result.report.c_str());
+	}
+
+	std::printf("%zu opcodes, %llu vectors, %d opcodes failed (%u threads)\n", opcodes.size(),
+		(unsigned long long)tested, failedOpcodes, jobs);
+
+	return failedOpcodes == 0 ? 0 : 1;
+}
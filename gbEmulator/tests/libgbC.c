@@ -0,0 +1,60 @@
+// the part of libgbTest written in C, so the header and the library are checked from a C compiler
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libgb.h"
+
+// runs rom for a while, saves, runs on, loads the state back and checks the same frames follow. Returns the name of
+// the first check that failed, or 0.
+const char* libgbFromC(const void* rom, size_t romSize)
+{
+	if (gb_abi_version() != GB_ABI_VERSION)
+		return "abi version";
+
+	gb_t* gb = gb_create();
+	if (!gb_load_rom_from_memory(gb, rom, romSize))
+		return "load rom";
+
+	for (int i = 0; i < 30; i++)
+		gb_step_frame(gb);
+
+	size_t stateSize = gb_state_size(gb);
+	unsigned char* state = malloc(stateSize);
+	unsigned char* frame = malloc(GB_LCD_WIDTH * GB_LCD_HEIGHT);
+	const char* failed = 0;
+
+	if (gb_save_state(gb, state, stateSize - 1) != 0)
+		failed = "save into a buffer that is too small";
+	else if (gb_save_state(gb, state, stateSize) != stateSize)
+		failed = "save state";
+
+	gb_set_buttons(gb, GB_BUTTON_A);
+	for (int i = 0; i < 5 && !failed; i++)
+	{
+		if (gb_step_frame(gb) != GB_STOP_VBLANK)
+			failed = "frames end at vblank";
+	}
+	memcpy(frame, gb_framebuffer(gb), GB_LCD_WIDTH * GB_LCD_HEIGHT);
+
+	// held buttons are part of the state, loading it releases A again
+	if (!failed && !gb_load_state(gb, state, stateSize))
+		failed = "load state";
+
+	gb_set_buttons(gb, GB_BUTTON_A);
+
+	for (int i = 0; i < 5 && !failed; i++)
+		gb_step_frame(gb);
+
+	if (!failed && memcmp(frame, gb_framebuffer(gb), GB_LCD_WIDTH * GB_LCD_HEIGHT) != 0)
+		failed = "same frames after loading the state";
+
+	size_t workRamSize = 0;
+	if (!failed && (!gb_ram_view(gb, GB_RAM_WORK, &workRamSize) || workRamSize != 0x2000))
+		failed = "work ram view";
+
+	free(frame);
+	free(state);
+	gb_destroy(gb);
+	return failed;
+}
@@ -0,0 +1,179 @@
+// libgbTest: the C interface works from C (libgbC.c), and stepping, saving and loading through it never allocate.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include "gb.h"
+#include "libgb.h"
+#include "romBuilder.h"
+#include "saveState.h"
+#include "testRoms.h"
+
+extern "C" const char* libgbFromC(const void* rom, size_t romSize);
+
+static std::atomic<uint64_t> allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations++;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+// four banks that start with 0xb0 + their number. The code maps bank 6, copies the start of 0x4000 to 0xc000, sets
+// bit 8 of the bank number (mbc5) or maps bank 0x7f (mbc3) and copies it to 0xc001. A cartridge with four banks
+// ignores the bank bits it doesn't have.
+static std::vector<uint8_t> buildBankMirrorRom(uint8_t cartType)
+{
+	RomBuilder b(cartType, 0x01);
+	for (uint8_t bank = 0; bank < 4; bank++)
+		b.rom[bank * 0x4000] = 0xB0 + bank;
+
+	b.org(0x150).emit({ 0x3E, 0x06, 0xEA, 0x00, 0x20 }); // ld a, 6 / ld (0x2000), a
+	b.emit({ 0xFA, 0x00, 0x40, 0xEA, 0x00, 0xC0 }); // ld a, (0x4000) / ld (0xc000), a
+	if (cartType == 0x19)
+		b.emit({ 0x3E, 0x01, 0xEA, 0x00, 0x30 }); // ld a, 1 / ld (0x3000), a
+	else
+		b.emit({ 0x3E, 0x7F, 0xEA, 0x00, 0x20 }); // ld a, 0x7f / ld (0x2000), a
+	b.emit({ 0xFA, 0x00, 0x40, 0xEA, 0x01, 0xC0 }); // ld a, (0x4000) / ld (0xc001), a
+	b.emit({ 0x18, 0xFE }); // jr to itself
+	return b.rom;
+}
+
+static void testBankMirrors(uint8_t cartType, uint8_t expectedSecond, const char* what)
+{
+	std::vector<uint8_t> rom = buildBankMirrorRom(cartType);
+	gb_t* gb = gb_create();
+	check(gb_load_rom_from_memory(gb, rom.data(), rom.size()) == 1, "bank mirror rom loads");
+	gb_step_frame(gb);
+
+	const uint8_t* wRam = gb_ram_view(gb, GB_RAM_WORK, nullptr);
+	check(wRam[0] == 0xB2 && wRam[1] == expectedSecond, what);
+	gb_destroy(gb);
+}
+
+static void testMisuse()
+{
+	gb_t* gb = gb_create();
+	std::vector<uint8_t> state(1 << 20);
+	check(gb_state_size(gb) == 0, "no state size without a rom");
+	check(gb_save_state(gb, state.data(), state.size()) == 0, "no save state without a rom");
+	check(gb_load_state(gb, state.data(), state.size()) == 0, "no load state without a rom");
+
+	// the header says 64 KiB
+	std::vector<uint8_t> rom = buildBankMirrorRom(0x19);
+	check(gb_load_rom_from_memory(gb, rom.data(), 0x150) == 0, "a rom of only the header is rejected");
+	check(gb_load_rom_from_memory(gb, rom.data(), 0x8000) == 0, "a rom shorter than its header says is rejected");
+	check(gb_step_frame(gb) == GB_STOP_ERROR && gb_state_size(gb) == 0, "and leaves no rom loaded");
+
+	std::vector<uint8_t> unknownSize = rom;
+	unknownSize[0x148] = 0x30;
+	check(gb_load_rom_from_memory(gb, unknownSize.data(), unknownSize.size()) == 0, "an unknown rom size is rejected");
+
+	// loading says nothing on stdout, whether the rom is good or not
+	std::ostringstream captured;
+	std::streambuf* stdoutBuffer = std::cout.rdbuf(captured.rdbuf());
+	gb_load_rom_from_memory(gb, rom.data(), 0x8000);
+	gb_load_rom_from_memory(gb, rom.data(), rom.size());
+	std::cout.rdbuf(stdoutBuffer);
+	check(captured.str().empty(), "loading a rom prints nothing");
+
+	gb_destroy(gb);
+}
+
+// a state with a field out of range, not just cut short, is refused and the instance runs on
+static void testDamagedState()
+{
+	std::vector<uint8_t> rom = buildBusyRom('L');
+	gb_t* gb = gb_create();
+	gb_load_rom_from_memory(gb, rom.data(), rom.size());
+	gb_step_frame(gb);
+
+	std::vector<uint8_t> state(gb_state_size(gb));
+	gb_save_state(gb, state.data(), state.size());
+
+	// the chunks are saved in the order cpu, mmu, ppu, the count is the last member of a FixedVector
+	size_t ppu = sizeof(SaveStateHeader) + 3 * sizeof(SaveStateChunk) + sizeof(CPUState) + sizeof(MMUState);
+	uint32_t count = 0x7FFF0000;
+	std::memcpy(state.data() + ppu + offsetof(PPUState, spPixelFIFO) + sizeof(PPUState::spPixelFIFO) - sizeof(count),
+		&count, sizeof(count));
+
+	check(gb_load_state(gb, state.data(), state.size()) == 0, "a state with a damaged fifo count is refused");
+	check(gb_step_frame(gb) == GB_STOP_VBLANK, "and the instance runs on");
+	gb_destroy(gb);
+}
+
+int main()
+{
+	std::vector<uint8_t> lagRom = buildInputLagRom();
+	const char* failed = libgbFromC(lagRom.data(), lagRom.size());
+	if (failed)
+	{
+		std::printf("FAIL from C: %s\n", failed);
+		failures++;
+	}
+
+	std::vector<uint8_t> rom = buildBusyRom('L');
+	gb_t* gb = gb_create();
+	check(gb_load_rom_from_memory(gb, rom.data(), rom.size()) == 1, "load rom");
+	check(gb_load_rom_from_memory(gb, rom.data(), 0x100) == 0, "too small a rom is rejected");
+	check(gb_step_frame(gb) == GB_STOP_ERROR, "no stepping without a rom");
+	gb_load_rom_from_memory(gb, rom.data(), rom.size());
+
+	size_t eRamSize = 0;
+	uint8_t* eRam = gb_ram_view(gb, GB_RAM_EXTERNAL, &eRamSize);
+	check(eRamSize == 0x2000, "external ram view has the cartridge's size");
+
+	std::vector<uint8_t> state(gb_state_size(gb));
+
+	// everything that runs per frame is timed against the allocation counter
+	uint64_t before = allocations;
+	for (int i = 0; i < 120; i++)
+	{
+		gb_set_buttons(gb, (uint8_t)i);
+		gb_step_frame(gb);
+		check(gb_framebuffer(gb) != nullptr, "frame buffer");
+
+		size_t size = 0;
+		check(gb_ram_view(gb, GB_RAM_WORK, &size) != nullptr, "work ram view");
+
+		if (i % 10 == 0)
+			check(gb_save_state(gb, state.data(), state.size()) == state.size(), "save state");
+		if (i % 10 == 5)
+			check(gb_load_state(gb, state.data(), state.size()) == 1, "load state");
+	}
+	check(allocations == before, "stepping, reading and states don't allocate");
+
+	// the timer interrupt of the rom counts in external ram
+	check(eRam[0] != 0, "external ram view sees the game's writes");
+
+	gb_destroy(gb);
+
+	testMisuse();
+	testDamagedState();
+	testBankMirrors(0x19, 0xB2, "mbc5 ignores the bank bits past the rom");
+	testBankMirrors(0x11, 0xB3, "mbc3 ignores the bank bits past the rom");
+
+	if (failures == 0)
+		std::printf("all libgb checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+// lockstepTest: every lane of a LockstepCore ends up exactly where the scalar cpu takes the same program from the same
+// state, on random code with data dependent branches and calls, across several runs. Lanes that split on an if get
+// back together behind it, so most instructions still go to all lanes at once.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "lockstepCore.h"
+#include "romBuilder.h"
+#include "testRoms.h"
+
+#define RUN_CYCLES 200000
+
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom()
+{
+	seed = seed * 1664525 + 1013904223;
+	return seed >> 8;
+}
+
+static int instructionLength(uint8_t opcode)
+{
+	switch (opcode)
+	{
+		case 0x01: case 0x08: case 0x11: case 0x21: case 0x31: case 0xC2: case 0xC3: case 0xC4: case 0xCA: case 0xCC:
+		case 0xCD: case 0xD2: case 0xD4: case 0xDA: case 0xDC: case 0xEA: case 0xFA:
+			return 3;
+
+		case 0x06: case 0x0E: case 0x10: case 0x16: case 0x18: case 0x1E: case 0x20: case 0x26: case 0x28: case 0x2E:
+		case 0x30: case 0x36: case 0x38: case 0x3E: case 0xC6: case 0xCB: case 0xCE: case 0xD6: case 0xDE: case 0xE0:
+		case 0xE6: case 0xE8: case 0xEE: case 0xF0: case 0xF6: case 0xF8: case 0xFE:
+			return 2;
+
+		default:
+			return 1;
+	}
+}
+
+// any instruction that doesn't jump, halt or move sp far
+static std::vector<uint8_t> randomInstruction()
+{
+	static const uint8_t excluded[] = {
+		0x10, 0x18, 0x20, 0x28, 0x30, 0x31, 0x38, 0x76, 0xC0, 0xC2, 0xC3, 0xC4, 0xC7, 0xC8, 0xC9, 0xCA, 0xCC, 0xCD,
+		0xCF, 0xD0, 0xD2, 0xD3, 0xD4, 0xD7, 0xD8, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDF, 0xE3, 0xE4, 0xE7, 0xE8, 0xE9,
+		0xEB, 0xEC, 0xED, 0xEF, 0xF4, 0xF7, 0xF9, 0xFC, 0xFD, 0xFF };
+
+	uint8_t opcode;
+	do
+		opcode = (uint8_t)nextRandom();
+	while (std::memchr(excluded, opcode, sizeof(excluded)));
+
+	std::vector<uint8_t> bytes{ opcode };
+	for (int i = 1; i < instructionLength(opcode); i++)
+		bytes.push_back((uint8_t)nextRandom());
+	return bytes;
+}
+
+// a loop of random instructions, some skipped by a conditional jr or jp on the flags, with calls to a subroutine
+static std::vector<uint8_t> buildRandomRom()
+{
+	RomBuilder b;
+
+	uint16_t subroutine = 0x4000;
+	b.org(subroutine);
+	for (int i = 0; i < 6; i++)
+		b.emit({ (uint8_t)(0x80 + nextRandom() % 0x40) }); // alu a, r8
+	b.emit({ 0xC9 });
+
+	b.org(0x150);
+	uint16_t loop = b.here();
+	for (int i = 0; i < 600; i++)
+	{
+		std::vector<uint8_t> instruction = randomInstruction();
+		uint32_t kind = nextRandom() % 16;
+
+		if (kind < 2)
+		{
+			uint8_t jr = (uint8_t)(0x20 + (nextRandom() % 4) * 8);
+			b.jr(jr, b.here() + 2 + (uint16_t)instruction.size());
+		}
+		else if (kind == 2)
+		{
+			uint8_t jp = (uint8_t)(0xC2 + (nextRandom() % 4) * 8);
+			uint16_t skip = b.here() + 3 + (uint16_t)instruction.size();
+			b.emit({ jp, (uint8_t)(skip & 0xFF), (uint8_t)(skip >> 8) });
+		}
+		else if (kind == 3)
+		{
+			b.call(subroutine);
+		}
+
+		b.emit(instruction);
+	}
+	b.jp(loop);
+	return b.rom;
+}
+
+static CPUState randomCpuState()
+{
+	CPUState state;
+	for (int r = 0; r < 8; r++)
+		state.regs[r] = (uint8_t)nextRandom();
+	state.regs[6] &= 0xF0;
+	state.SP = 0xD000 + nextRandom() % 0x2000;
+	state.PC = 0x150;
+	return state;
+}
+
+struct ScalarLane
+{
+	LaneBus bus;
+	std::vector<uint8_t> ram;
+	CPU<LaneBus> cpu{ bus };
+};
+
+static bool sameState(const CPUState& a, const CPUState& b)
+{
+	return std::memcmp(a.regs, b.regs, sizeof(a.regs)) == 0 && a.SP == b.SP && a.PC == b.PC && a.IME == b.IME
+		&& a.updateIME == b.updateIME && a.HALT == b.HALT && a.tCycles == b.tCycles;
+}
+
+// runs rom on a LockstepCore and on one scalar cpu per lane, every lane starting from its own random state and ram,
+// and compares them after every run
+static void compareWithScalar(const std::vector<uint8_t>& rom, int runs, const char* what, LockstepStats& stats)
+{
+	auto core = std::make_unique<LockstepCore>();
+	core->loadRom(rom.data(), rom.size());
+
+	std::vector<std::unique_ptr<ScalarLane>> lanes;
+	for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+	{
+		auto scalar = std::make_unique<ScalarLane>();
+		scalar->ram.resize(LOCKSTEP_RAM_SIZE);
+		for (uint8_t& byte : scalar->ram)
+			byte = (uint8_t)nextRandom();
+		scalar->bus.rom = rom.data();
+		scalar->bus.ram = scalar->ram.data();
+
+		CPUState start = randomCpuState();
+		static_cast<CPUState&>(scalar->cpu) = start;
+		core->setLaneState(lane, start);
+		std::memcpy(core->laneRam(lane), scalar->ram.data(), LOCKSTEP_RAM_SIZE);
+
+		lanes.push_back(std::move(scalar));
+	}
+
+	bool same = true;
+	for (int run = 0; run < runs; run++)
+	{
+		core->run(RUN_CYCLES);
+
+		for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+		{
+			// a run goes on from where the lane stopped, the last instruction may have gone past the end of the one
+			// before
+			CPU<LaneBus>& cpu = lanes[lane]->cpu;
+			uint64_t until = cpu.tCycles + RUN_CYCLES;
+			while (!cpu.HALT && cpu.tCycles < until)
+				cpu.decodeAndExecute(cpu.fetch8());
+
+			same = same && sameState(core->laneState(lane), cpu)
+				&& std::memcmp(core->laneRam(lane), lanes[lane]->ram.data(), LOCKSTEP_RAM_SIZE) == 0;
+		}
+	}
+
+	check(same, what);
+	stats = core->stats();
+}
+
+static void testRandomCode()
+{
+	std::vector<uint8_t> rom = buildRandomRom();
+	LockstepStats stats;
+	compareWithScalar(rom, 3, "random code matches the scalar cpu on every lane", stats);
+
+	uint64_t laneSteps = stats.vectorLaneSteps + stats.scalarSteps;
+	check(laneSteps > 0 && stats.vectorLaneSteps * 2 > laneSteps, "most of the random code runs on all lanes at once");
+}
+
+// walks a table that differs per lane and does extra work on odd entries
+static std::vector<uint8_t> buildBranchyRom()
+{
+	RomBuilder b;
+	b.emit({ 0x21, 0x00, 0xC0 }); // ld hl, 0xc000
+	uint16_t loop = b.here();
+	b.emit({ 0x2A, 0xE6, 0x01 }); // ld a, (hl+) / and 1
+	uint16_t branch = b.here();
+	b.emit({ 0x28, 0x00 }); // jr z, skip
+	b.emit({ 0x80, 0xA9, 0x14, 0x15, 0x04 }); // add b / xor c / inc d / dec d / inc b
+	uint16_t skip = b.here();
+	b.rom[branch + 1] = (uint8_t)(skip - (branch + 2));
+	b.emit({ 0x1C, 0x7D, 0xFE, 0x80 }); // inc e / ld a, l / cp 0x80
+	b.jr(0x20, loop);
+	b.emit({ 0x2E, 0x00 }); // ld l, 0
+	b.jr(0x18, loop);
+	return b.rom;
+}
+
+static void testReconverge()
+{
+	std::vector<uint8_t> rom = buildBranchyRom();
+	LockstepStats stats;
+	compareWithScalar(rom, 1, "branchy code matches the scalar cpu on every lane", stats);
+
+	// the lanes with an odd entry run the if on their own (7 or 8 of them on average) and the rest of the loop goes
+	// to all of them, about 12 lanes per step. Only one run, as the lanes that finish it last would start the next one
+	// out of step with the others.
+	double lanesPerStep = (double)stats.vectorLaneSteps / std::max<uint64_t>(stats.vectorSteps, 1);
+	check(stats.scalarSteps * 100 < stats.vectorLaneSteps, "lanes that split on the if don't fall back to scalar");
+	check(lanesPerStep > 11.0, "lanes get back together after the if");
+}
+
+int main()
+{
+	testRandomCode();
+	testReconverge();
+
+	if (failures == 0)
+		std::printf("all lockstep checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+// movieTest: movies recorded at power on and from a save state play back in sync on fresh instances and survive a
+// round trip through the file format, a changed input is caught at the next hashed frame, and movies refuse to play
+// on the wrong rom or where they can't start. The state hash only covers what the game can see, and runCycles and
+// runUntil don't run behind a movie's back.
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "gb.h"
+#include "movie.h"
+#include "testRoms.h"
+
+#define MOVIE_FRAMES 120
+#define HASH_INTERVAL 10
+
+static std::unique_ptr<GameBoy> loadGame(const std::vector<uint8_t>& rom)
+{
+	auto gb = std::make_unique<GameBoy>();
+	gb->loadRom(rom.data(), rom.size());
+	return gb;
+}
+
+// records MOVIE_FRAMES frames of pseudo random presses of A, returns the state hash at the end
+static uint64_t record(GameBoy& gb, Movie& movie)
+{
+	gb.startRecording(movie, HASH_INTERVAL);
+
+	uint32_t random = 7;
+	for (int i = 0; i < MOVIE_FRAMES; i++)
+	{
+		random = random * 1664525 + 1013904223;
+		gb.setButtons((random >> 28) & 1 ? JOYPAD_A : 0);
+		gb.runFrame();
+	}
+
+	gb.stopMovie();
+	return gb.stateHash();
+}
+
+// plays the whole movie, returns the state hash at the end
+static uint64_t play(GameBoy& gb, const Movie& movie)
+{
+	for (size_t i = 0; i < movie.frames(); i++)
+	{
+		// playback owns the buttons, this is overridden
+		gb.setButtons(JOYPAD_START);
+		gb.runFrame();
+	}
+
+	return gb.stateHash();
+}
+
+static void testPowerOn()
+{
+	std::vector<uint8_t> rom = buildInputLagRom();
+	Movie movie;
+	uint64_t recorded = record(*loadGame(rom), movie);
+
+	check(movie.startState.empty(), "a movie recorded at power on has no start state");
+	check(movie.frames() == MOVIE_FRAMES && movie.stateHashes.size() == MOVIE_FRAMES / HASH_INTERVAL,
+		"a button byte per frame and a hash every interval");
+
+	Movie loaded;
+	std::vector<uint8_t> data = movie.serialize();
+	check(loaded.deserialize(data.data(), data.size()), "the movie deserializes");
+	check(loaded.buttons == movie.buttons && loaded.stateHashes == movie.stateHashes
+		&& loaded.romHash == movie.romHash && loaded.hashInterval == movie.hashInterval, "round trip keeps everything");
+	check(!loaded.deserialize(data.data(), data.size() - 1), "a truncated movie is rejected");
+
+	std::unique_ptr<GameBoy> gb = loadGame(rom);
+	check(gb->startPlayback(loaded), "playback starts on a fresh instance");
+	check(play(*gb, loaded) == recorded, "playback ends in the recorded state");
+	check(gb->movieSession().desyncFrame == -1, "no desync");
+
+	// past the end nothing is pressed
+	gb->runFrame();
+	check(gb->movieSession().finished && gb->mmu.joypadButtons == 0, "playback ends with the movie");
+
+	check(!gb->startPlayback(loaded), "a power on movie doesn't play on an instance that already ran");
+}
+
+static void testFromState()
+{
+	std::vector<uint8_t> rom = buildBusyRom('M');
+	std::unique_ptr<GameBoy> recorder = loadGame(rom);
+	for (int i = 0; i < 30; i++)
+		recorder->runFrame();
+
+	Movie movie;
+	uint64_t recorded = record(*recorder, movie);
+	check(!movie.startState.empty(), "a movie that starts after power on carries a start state");
+
+	// an instance that ran something else goes back to the start state
+	std::unique_ptr<GameBoy> gb = loadGame(rom);
+	for (int i = 0; i < 7; i++)
+		gb->runFrame();
+
+	check(gb->startPlayback(movie), "playback loads the start state");
+	check(play(*gb, movie) == recorded && gb->movieSession().desyncFrame == -1, "playback from a state stays in sync");
+
+	std::unique_ptr<GameBoy> other = loadGame(buildBusyRom('N'));
+	check(!other->startPlayback(movie), "a movie doesn't play on another rom");
+}
+
+static void testDesync()
+{
+	std::vector<uint8_t> rom = buildInputLagRom();
+	Movie movie;
+	record(*loadGame(rom), movie);
+
+	// the rom keeps what it read from the joypad for two frames, so A flipped in frame 57 is still in the state when
+	// frame 59 is hashed
+	movie.buttons[57] ^= JOYPAD_A;
+
+	std::unique_ptr<GameBoy> gb = loadGame(rom);
+	gb->startPlayback(movie);
+	play(*gb, movie);
+	check(gb->movieSession().desyncFrame == 59, "the desync is reported at the first hashed frame after it");
+}
+
+// the hash of the power on state of the input lag rom, stored in movies: it only changes with STATE_HASH_VERSION
+#define POWER_ON_STATE_HASH 0x620b500b28ca9357ull
+
+static void testStateHash()
+{
+	std::unique_ptr<GameBoy> gb = loadGame(buildInputLagRom());
+	check(gb->stateHash() == POWER_ON_STATE_HASH, "the power on state hashes as it always did");
+
+	gb->runCycles(1000);
+	uint64_t visible = gb->stateHash();
+	uint64_t full = gb->fullStateHash();
+
+	gb->ppu.oamScanCounter ^= 1;
+	check(gb->stateHash() == visible && gb->fullStateHash() != full, "ppu internals are only in the full hash");
+
+	gb->mmu.wRam[0x100] ^= 1;
+	check(gb->stateHash() != visible, "work ram is in the state hash");
+}
+
+static void testOnlyFrames()
+{
+	std::unique_ptr<GameBoy> gb = loadGame(buildInputLagRom());
+	Movie movie;
+	gb->startRecording(movie, HASH_INTERVAL);
+	gb->runFrame();
+
+	uint64_t cycles = gb->cpu.tCycles;
+	RunResult result = gb->runCycles(1000);
+	check(result.reason == STOP_MOVIE && result.cycles == 0 && gb->cpu.tCycles == cycles,
+		"runCycles doesn't run while recording");
+	result = gb->runUntil([](const GameBoy&) { return true; });
+	check(result.reason == STOP_MOVIE && gb->cpu.tCycles == cycles, "and neither does runUntil");
+
+	gb->stopMovie();
+	check(gb->runCycles(1000).reason == STOP_CYCLES, "they run again once the movie stopped");
+	check(movie.frames() == 1, "and the movie only has the frame runFrame ran");
+}
+
+int main()
+{
+	testPowerOn();
+	testFromState();
+	testDesync();
+	testStateHash();
+	testOnlyFrames();
+
+	if (failures == 0)
+		std::printf("all movie checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+// rewindTest: the XOR delta codec round trips on awkward inputs, stepping back through the rewind history lands on
+// states that replay the same frames as the first time, and the memory budget is respected.
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "gb.h"
+#include "rewind.h"
+#include "testRoms.h"
+
+static bool deltaRoundTrips(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+	std::vector<uint8_t> delta(2 * a.size() + 16);
+	delta.resize(encodeDelta(b.data(), a.data(), a.size(), delta.data()));
+
+	std::vector<uint8_t> forward = a;
+	applyDelta(delta.data(), delta.size(), forward.data());
+	std::vector<uint8_t> backward = b;
+	applyDelta(delta.data(), delta.size(), backward.data());
+
+	return forward == b && backward == a;
+}
+
+static void testCodec()
+{
+	std::mt19937 random(1234);
+
+	for (size_t size : { 0, 1, 7, 8, 15, 16, 17, 31, 100, 4099 })
+	{
+		std::vector<uint8_t> a(size);
+		for (uint8_t& byte : a)
+			byte = (uint8_t)random();
+
+		std::vector<uint8_t> same = a;
+		check(deltaRoundTrips(a, same), "identical buffers");
+
+		std::vector<uint8_t> different = a;
+		for (uint8_t& byte : different)
+			byte = ~byte;
+		check(deltaRoundTrips(a, different), "every byte changed");
+
+		// sparse changes, including ones closer together than a worthwhile unchanged run
+		std::vector<uint8_t> sparse = a;
+		for (size_t i = 0; i < size; i += 1 + random() % 12)
+			sparse[i] ^= 1 + random() % 255;
+		check(deltaRoundTrips(a, sparse), "sparse changes");
+
+		if (size > 0)
+		{
+			std::vector<uint8_t> last = a;
+			last[size - 1] ^= 0x80;
+			check(deltaRoundTrips(a, last), "change in the last byte");
+		}
+	}
+}
+
+static uint64_t nextFrameHash(GameBoy& gb)
+{
+	gb.runFrame();
+	gb.ppu.frameBuffer.acquire();
+	return gb.ppu.frameBuffer.readHash();
+}
+
+static void testHistory()
+{
+	std::vector<uint8_t> rom = buildBusyRom('A');
+	auto gb = std::make_unique<GameBoy>();
+	gb->loadRom(rom.data(), rom.size());
+
+	for (int i = 0; i < 20; i++)
+		gb->runFrame();
+
+	Rewind rewind;
+	std::vector<uint64_t> hashes;
+	for (int i = 0; i < 300; i++)
+	{
+		rewind.capture(*gb);
+		hashes.push_back(nextFrameHash(*gb));
+	}
+
+	check(rewind.frames() == 299, "every capture after the first is a step back");
+
+	// newest capture is 299, 100 steps back is capture 199
+	bool stepped = true;
+	for (int i = 0; i < 100; i++)
+		stepped &= rewind.stepBack(*gb);
+	check(stepped, "step back 100 frames");
+
+	bool same = true;
+	for (int i = 199; i < 300; i++)
+		same &= nextFrameHash(*gb) == hashes[i];
+	check(same, "frames after rewinding match the first run");
+
+	// history keeps going from the restored state
+	rewind.capture(*gb);
+	check(rewind.frames() == 200, "capture after rewinding extends the restored history");
+}
+
+static void testBudget()
+{
+	std::vector<uint8_t> rom = buildBusyRom('A');
+	auto gb = std::make_unique<GameBoy>();
+	gb->loadRom(rom.data(), rom.size());
+
+	const size_t budget = 64 * 1024;
+	Rewind rewind(budget, 1000);
+
+	for (int i = 0; i < 600; i++)
+	{
+		rewind.capture(*gb);
+		gb->runFrame();
+	}
+
+	uint32_t frames = rewind.frames();
+	check(frames > 0 && frames < 599, "old frames are dropped to stay in the budget");
+	check(rewind.deltaBytes() <= budget, "deltas fit in the budget");
+
+	uint32_t steps = 0;
+	while (rewind.stepBack(*gb))
+		steps++;
+	check(steps == frames, "every kept frame can be stepped back to");
+
+	Rewind fewFrames(budget, 10);
+	for (int i = 0; i < 50; i++)
+	{
+		fewFrames.capture(*gb);
+		gb->runFrame();
+	}
+	check(fewFrames.frames() == 10, "frame limit");
+}
+
+int main()
+{
+	testCodec();
+	testHistory();
+	testBudget();
+
+	if (failures == 0)
+		std::printf("all rewind checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// runAheadTest: with run-ahead the game's real timeline doesn't change, the presented frames are the ones the game
+// shows frames later, and the input lag measured in presented frames goes down by one per run-ahead frame until the
+// frame right after a press already shows it.
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "gb.h"
+#include "hash.h"
+#include "runAhead.h"
+#include "testRoms.h"
+
+#define WARMUP_FRAMES 10
+#define TEST_FRAMES 120
+
+// buttons held during frame i: a press every 16 frames, held for 5 or 6 of them
+static uint8_t buttonsAt(int frame)
+{
+	return (frame % 16) < 5 + (frame / 16) % 2 ? JOYPAD_A : 0;
+}
+
+struct Run
+{
+	// hash of the real state and of the presented frame after each frame
+	std::vector<uint64_t> states;
+	std::vector<uint64_t> frames;
+};
+
+static std::unique_ptr<GameBoy> startGame()
+{
+	std::vector<uint8_t> rom = buildInputLagRom();
+	auto gb = std::make_unique<GameBoy>();
+	gb->loadRom(rom.data(), rom.size());
+
+	for (int i = 0; i < WARMUP_FRAMES; i++)
+		gb->runFrame();
+
+	return gb;
+}
+
+static Run play(int runAheadFrames)
+{
+	std::unique_ptr<GameBoy> gb = startGame();
+	RunAhead runAhead;
+	runAhead.setFrames(runAheadFrames);
+
+	Run run;
+	std::vector<uint8_t> state;
+
+	for (int i = 0; i < TEST_FRAMES; i++)
+	{
+		gb->setButtons(buttonsAt(i));
+		runAhead.runFrame(*gb);
+
+		gb->saveState(state, false);
+		run.states.push_back(hashBytes(state.data(), state.size()));
+
+		check(gb->ppu.frameBuffer.acquire(), "a frame is presented every frame");
+		run.frames.push_back(gb->ppu.frameBuffer.readHash());
+	}
+
+	return run;
+}
+
+// presented frames from pressing A until the screen turns white
+static int inputLag(int runAheadFrames)
+{
+	std::unique_ptr<GameBoy> gb = startGame();
+	RunAhead runAhead;
+	runAhead.setFrames(runAheadFrames);
+
+	gb->setButtons(JOYPAD_A);
+
+	for (int frame = 1; frame <= 10; frame++)
+	{
+		runAhead.runFrame(*gb);
+		gb->ppu.frameBuffer.acquire();
+
+		if (gb->ppu.frameBuffer.readBuffer()[0] == gb->ppu.colors[0])
+			return frame;
+	}
+
+	return -1;
+}
+
+int main()
+{
+	Run reference = play(0);
+
+	for (int runAheadFrames = 1; runAheadFrames <= RUN_AHEAD_MAX_FRAMES; runAheadFrames++)
+	{
+		Run run = play(runAheadFrames);
+		check(run.states == reference.states, "run-ahead doesn't change the real timeline");
+
+		// the presented frame is the one the game shows runAheadFrames later, as long as the buttons didn't change
+		// in between
+		bool ahead = true;
+		for (int i = 0; i + runAheadFrames < TEST_FRAMES; i++)
+		{
+			bool sameButtons = true;
+			for (int j = 1; j <= runAheadFrames; j++)
+				sameButtons &= buttonsAt(i + j) == buttonsAt(i);
+
+			if (sameButtons)
+				ahead &= run.frames[i] == reference.frames[i + runAheadFrames];
+		}
+		check(ahead, "presented frames are the frames ahead");
+	}
+
+	// the rom shows a press on the third frame after it
+	int lag = inputLag(0);
+	check(lag == 3, "input lag without run-ahead");
+
+	for (int runAheadFrames = 0; runAheadFrames <= RUN_AHEAD_MAX_FRAMES; runAheadFrames++)
+	{
+		int frames = inputLag(runAheadFrames);
+		std::printf("run-ahead %d: input shows after %d frame%s\n", runAheadFrames, frames, frames == 1 ? "" : "s");
+
+		if (runAheadFrames > 0)
+			check(frames == std::max(1, lag - runAheadFrames), "each run-ahead frame takes one frame of lag away");
+	}
+
+	if (failures == 0)
+		std::printf("all run-ahead checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// saveStateTest: save state round trips. A rom that keeps the ppu, timer, interrupts and external ram busy is saved
+// in the middle of a scanline, then the frames that follow are compared between the original run, the same
+// GameBoy after loading the state and a fresh GameBoy that only got the rom and the state. Also checks that bad
+// states are rejected without touching the emulator, and prints how long saving and loading take.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "gb.h"
+#include "hash.h"
+#include "saveState.h"
+#include "testRoms.h"
+
+#define FRAMES_AFTER_SAVE 120
+#define TIMING_ITERATIONS 2000
+
+struct Trace
+{
+	std::vector<uint64_t> frameHashes;
+	uint64_t tCycles = 0;
+	uint64_t memoryHash = 0;
+};
+
+static Trace runFrames(GameBoy& gb, int frames)
+{
+	Trace trace;
+	for (int i = 0; i < frames; i++)
+	{
+		gb.runFrame();
+		gb.ppu.frameBuffer.acquire();
+		trace.frameHashes.push_back(gb.ppu.frameBuffer.readHash());
+	}
+
+	trace.tCycles = gb.cpu.tCycles;
+	trace.memoryHash = hashBytes(gb.mmu.wRam, sizeof(gb.mmu.wRam)) ^ hashBytes(gb.mmu.eRam.data(), gb.mmu.eRam.size());
+	return trace;
+}
+
+// where the ppu chunk's data starts, the chunks are saved in the order cpu, mmu, ppu
+static size_t ppuChunk(const std::vector<uint8_t>& state)
+{
+	size_t offset = sizeof(SaveStateHeader) + 3 * sizeof(SaveStateChunk) + sizeof(CPUState) + sizeof(MMUState);
+	SaveStateChunk chunk;
+	std::memcpy(&chunk, state.data() + offset - sizeof(chunk), sizeof(chunk));
+	check(chunk.tag == CHUNK_PPU, "the ppu chunk is the third one");
+	return offset;
+}
+
+static bool sameTrace(const Trace& a, const Trace& b)
+{
+	return a.frameHashes == b.frameHashes && a.tCycles == b.tCycles && a.memoryHash == b.memoryHash;
+}
+
+int main()
+{
+	std::vector<uint8_t> rom = buildBusyRom('A');
+
+	auto gb = std::make_unique<GameBoy>();
+	gb->loadRom(rom.data(), rom.size());
+
+	for (int i = 0; i < 30; i++)
+		gb->runFrame();
+	// somewhere in the middle of a scanline, so the fifos and fetchers have something in them
+	gb->runCycles(12345);
+
+	std::vector<uint8_t> state;
+	gb->saveState(state);
+
+	Trace original = runFrames(*gb, FRAMES_AFTER_SAVE);
+	check(gb->mmu.eRam[0] != 0, "the timer interrupt writes to external ram");
+
+	check(gb->loadState(state.data(), state.size()), "load into the same GameBoy");
+	Trace reloaded = runFrames(*gb, FRAMES_AFTER_SAVE);
+	check(sameTrace(original, reloaded), "same frames after loading into the same GameBoy");
+
+	auto fresh = std::make_unique<GameBoy>();
+	fresh->loadRom(rom.data(), rom.size());
+	check(fresh->loadState(state.data(), state.size()), "load into a fresh GameBoy");
+	Trace freshTrace = runFrames(*fresh, FRAMES_AFTER_SAVE);
+	check(sameTrace(original, freshTrace), "same frames after loading into a fresh GameBoy");
+
+	// saving again right after a load gives the same emulated state back
+	std::vector<uint8_t> again;
+	fresh->loadState(state.data(), state.size());
+	fresh->saveState(again);
+	check(fresh->loadState(again.data(), again.size()), "load a state saved after a load");
+	check(sameTrace(original, runFrames(*fresh, FRAMES_AFTER_SAVE)), "same frames after a second round trip");
+
+	// bad states are rejected and leave the emulator alone
+	uint64_t cyclesBefore = fresh->cpu.tCycles;
+
+	check(!fresh->loadState(state.data(), state.size() - 1), "truncated state is rejected");
+
+	std::vector<uint8_t> badVersion = state;
+	badVersion[4]++;
+	check(!fresh->loadState(badVersion.data(), badVersion.size()), "state from another version is rejected");
+
+	std::vector<uint8_t> otherRom = buildBusyRom('B');
+	auto other = std::make_unique<GameBoy>();
+	other->loadRom(otherRom.data(), otherRom.size());
+	check(!other->loadState(state.data(), state.size()), "state from another rom is rejected");
+
+	// counts and enums the ppu trusts, out of range they would have it write past its buffers
+	size_t ppu = ppuChunk(state);
+	std::vector<uint8_t> badCount = state;
+	uint32_t count = 0x7FFF0000;
+	// the count is the last member of a FixedVector
+	std::memcpy(badCount.data() + ppu + offsetof(PPUState, spPixelFIFO) + sizeof(PPUState::spPixelFIFO) - sizeof(count),
+		&count, sizeof(count));
+	check(!fresh->loadState(badCount.data(), badCount.size()), "state with a fifo count past its capacity is rejected");
+
+	std::vector<uint8_t> badMode = state;
+	MODE mode = (MODE)7;
+	std::memcpy(badMode.data() + ppu + offsetof(PPUState, ppuMode), &mode, sizeof(mode));
+	check(!fresh->loadState(badMode.data(), badMode.size()), "state with an unknown ppu mode is rejected");
+
+	check(fresh->cpu.tCycles == cyclesBefore, "rejected states don't change the emulator");
+
+	// timing, in memory only
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < TIMING_ITERATIONS; i++)
+		gb->saveState(state);
+	auto saved = std::chrono::steady_clock::now();
+	for (int i = 0; i < TIMING_ITERATIONS; i++)
+		gb->loadState(state.data(), state.size());
+	auto loaded = std::chrono::steady_clock::now();
+
+	double saveUs = std::chrono::duration<double, std::micro>(saved - start).count() / TIMING_ITERATIONS;
+	double loadUs = std::chrono::duration<double, std::micro>(loaded - saved).count() / TIMING_ITERATIONS;
+	std::printf("state size %zu bytes, save %.1f us, load %.1f us\n", state.size(), saveUs, loadUs);
+
+	if (failures == 0)
+		std::printf("all save state checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
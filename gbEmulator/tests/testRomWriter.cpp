@@ -0,0 +1,29 @@
+// testRomWriter: writes the test roms translateTest runs to files, for gb2cpp to translate at build time.
+//
+// usage: testRomWriter <directory>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "fileIo.h"
+#include "testRoms.h"
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::cerr << "usage: testRomWriter <directory>\n";
+		return 2;
+	}
+
+	std::string directory = argv[1];
+	if (!writeFile(directory + "/busy.gb", buildBusyRom('T')) || !writeFile(directory + "/banked.gb", buildBankedRom())
+		|| !writeFile(directory + "/randomCode.gb", buildRandomCodeRom(RANDOM_CODE_SEED)))
+	{
+		std::cerr << "testRomWriter: could not write to " << directory << "\n";
+		return 2;
+	}
+
+	return 0;
+}
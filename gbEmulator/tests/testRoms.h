@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+#include "romBuilder.h"
+
+// checks and roms shared by the tests
+
+// a test passes when this is still 0 at the end, every failed check prints what it checked
+inline int failures = 0;
+
+inline void check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		std::printf("FAIL %s\n", what);
+		failures++;
+	}
+}
+
+// mbc1 with battery ram. Window, sprites and per line scrolling on screen, the timer interrupt counts in external
+// ram and the main loop keeps changing work ram.
+inline std::vector<uint8_t> buildBusyRom(char titleChar)
+{
+	RomBuilder b(0x03, 0x01);
+	b.rom[0x149] = 0x02; // 8 KiB ram
+	b.rom[0x134] = titleChar;
+
+	std::vector<uint8_t> oam;
+	for (int i = 0; i < 40; i++)
+	{
+		oam.push_back(16 + (i / 10) * 32);
+		oam.push_back(8 + (i % 10) * 16);
+		oam.push_back(1 + i % 3);
+		oam.push_back((i & 1) ? 0x20 : 0x00);
+	}
+	b.place(0x1000, oam);
+
+	std::vector<uint8_t> tileMap(0x400);
+	for (size_t i = 0; i < tileMap.size(); i++)
+		tileMap[i] = (uint8_t)(i * 7);
+	b.place(0x1100, tileMap);
+
+	b.org(0x40).emit({ 0xF5, 0xF0, 0x42, 0x3C, 0xE0, 0x42, 0xF1, 0xD9 }); // vblank: scy++
+	b.org(0x48).emit({ 0xF5, 0xF0, 0x43, 0x3C, 0xE0, 0x43, 0xF1, 0xD9 }); // stat: scx++
+	b.org(0x50).emit({ 0xF5, 0xE5, 0x21, 0x00, 0xA0, 0x34, 0xE1, 0xF1, 0xD9 }); // timer: inc (0xa000)
+
+	b.org(0x150).prologue();
+	b.emit({ 0x3E, 0x0A, 0xEA, 0x00, 0x00 }); // enable external ram
+	b.memset(0x8000, 0x3C, 0x1000);
+	b.memcpy(0x9800, 0x1100, 0x400);
+	b.memcpy(0x9C00, 0x1100, 0x400);
+	b.memcpy(0xFE00, 0x1000, 160);
+	b.writeIo(0x48, 0xE4).writeIo(0x49, 0xD2);
+	b.writeIo(0x4A, 40).writeIo(0x4B, 47);
+	b.writeIo(0x41, 0x08);
+	b.writeIo(0x06, 0x80).writeIo(0x07, 0x05); // tma, timer on at 262144 Hz
+	b.writeIo(0x40, 0xF3).writeIo(0xFF, 0x07).emit({ 0xFB }); // lcd, window, objects, ie = vblank | stat | timer
+
+	b.emit({ 0x21, 0x00, 0xC0 }); // ld hl, 0xc000
+	uint16_t loop = b.here();
+	b.emit({ 0x34, 0x23, 0x7C, 0xFE, 0xD0 }); // inc (hl) / inc hl / ld a, h / cp 0xd0
+	b.jr(0x20, loop);
+	b.emit({ 0x26, 0xC0 }); // ld h, 0xc0
+	b.jr(0x18, loop);
+	return b.rom;
+}
+
+// Shows whether A is held with two frames of lag, like a game that reads the joypad and shows the result later: the
+// vblank handler reads the joypad into a two entry queue in hram and sets the palette from the oldest entry. The
+// whole background is tile 0 in color 3, so the screen is black (0xe4) or white (0x1b).
+inline std::vector<uint8_t> buildInputLagRom()
+{
+	RomBuilder b;
+	b.org(0x40).emit({ 0xD9 }); // vblank: reti
+
+	b.org(0x150).prologue();
+	b.memset(0x8000, 0xFF, 16);
+	b.memset(0x9800, 0x00, 0x400);
+	b.writeIo(0x80, 0xE4).writeIo(0x81, 0xE4);
+	b.writeIo(0x40, 0x91).writeIo(0x0F, 0x00).writeIo(0xFF, 0x01).emit({ 0xFB }); // lcd, ie = vblank
+
+	uint16_t loop = b.here();
+	b.emit({ 0x76 }); // halt
+	b.emit({ 0xF0, 0x81, 0xE0, 0x47 }); // ldh a, (0x81) / ldh (bgp), a
+	b.emit({ 0xF0, 0x80, 0xE0, 0x81 }); // ldh a, (0x80) / ldh (0x81), a
+	b.writeIo(0x00, 0x10).emit({ 0xF0, 0x00, 0xE6, 0x01 }); // select the buttons / ldh a, (joyp) / and 1
+	b.emit({ 0x3E, 0xE4, 0x20, 0x02, 0x3E, 0x1B }); // ld a, 0xe4 / jr nz, +2 / ld a, 0x1b
+	b.emit({ 0xE0, 0x80 }); // ldh (0x80), a
+	b.jr(0x18, loop);
+	return b.rom;
+}
+
+// mbc1 with code in three banks. The main loop in bank 0 calls into every bank, dispatches through a jump table with
+// jp hl and calls a routine it copied to work ram; vblank and timer interrupts count in hram. Bank 1 switches to bank
+// 2 in the middle of its routine and carries on with bank 2's code at the next address, bank 3 calls back into bank 0.
+inline std::vector<uint8_t> buildBankedRom()
+{
+	RomBuilder b(0x01, 0x01);
+
+	b.org(0x40).emit({ 0xF5, 0xF0, 0x90, 0x3C, 0xE0, 0x90, 0xF1, 0xD9 }); // vblank: (0xff90)++
+	b.org(0x50).emit({ 0xF5, 0xF0, 0x91, 0x3C, 0xE0, 0x91, 0xF1, 0xD9 }); // timer: (0xff91)++
+
+	b.place(0x1000, { 0x21, 0x00, 0xC4, 0x34, 0x7E, 0x07, 0x77, 0xC9 }); // ld hl, 0xc400 / inc (hl) / rlca it / ret
+	b.place(0x0900, { 0x21, 0x10, 0xC4, 0x35, 0xC9 }); // called from bank 3: dec (0xc410)
+
+	b.org(0x150).prologue();
+	b.memcpy(0xC100, 0x1000, 8);
+	b.writeIo(0x06, 0x00).writeIo(0x07, 0x05); // timer at 262144 Hz
+	b.writeIo(0x40, 0x91).writeIo(0x0F, 0x00).writeIo(0xFF, 0x05).emit({ 0xFB }); // lcd, ie = vblank | timer
+
+	uint16_t loop = b.here();
+	for (uint8_t bank = 1; bank <= 3; bank++)
+		b.emit({ 0x3E, bank, 0xEA, 0x00, 0x20 }).call(0x4000); // ld a, bank / ld (0x2000), a / call 0x4000
+
+	// ld a, (0xff92) / inc a / and 3 / ld (0xff92), a / add a, a / ld e, a / ld d, 0 / ld hl, table / add hl, de /
+	// ld a, (hl+) / ld h, (hl) / ld l, a / jp hl
+	b.emit({ 0xF0, 0x92, 0x3C, 0xE6, 0x03, 0xE0, 0x92, 0x87, 0x5F, 0x16, 0x00, 0x21, 0x00, 0x08, 0x19 });
+	b.emit({ 0x2A, 0x66, 0x6F, 0xE9 });
+	uint16_t back = b.here();
+	b.call(0xC100);
+	b.jp(loop);
+
+	b.place(0x0800, { 0x10, 0x08, 0x20, 0x08, 0x30, 0x08, 0x40, 0x08 });
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		// ld hl, 0xc200 + i / inc (hl) / ld a, (hl) / add a, i / ld (hl), a / jp back
+		b.org(0x0810 + i * 0x10).emit({ 0x21, i, 0xC2, 0x34, 0x7E, 0xC6, i, 0x77 }).jp(back);
+	}
+
+	// bank 1: mixes 0xc300-0xc33f, then switches to bank 2 with the write ending at 0x4100
+	b.org(0x4000).emit({ 0x21, 0x00, 0xC3, 0x06, 0x40 }); // ld hl, 0xc300 / ld b, 0x40
+	b.emit({ 0x7E, 0x80, 0x0F, 0x22, 0x05, 0x20, 0xF9 }); // ld a, (hl) / add a, b / rrca / ld (hl+), a / dec b / jr nz
+	b.jp(0x40FB);
+	b.org(0x40FB).emit({ 0x3E, 0x02, 0xEA, 0x00, 0x20 }); // ld a, 2 / ld (0x2000), a
+	b.org(0x4100).emit({ 0x3E, 0x55, 0xEA, 0xF3, 0xC3, 0xC9 }); // never runs: bank 2 is mapped by now
+
+	// bank 2: sums 0xc300-0xc33f into 0xc3f0 and goes on at 0x4100
+	b.org(0x8000).emit({ 0x21, 0x00, 0xC3, 0x06, 0x40, 0xAF }); // ld hl, 0xc300 / ld b, 0x40 / xor a
+	b.emit({ 0x86, 0x23, 0x05, 0x20, 0xFB, 0xEA, 0xF0, 0xC3 }); // add a, (hl) / inc hl / dec b / jr nz / ld (0xc3f0), a
+	b.jp(0x4100);
+	b.org(0x8100).emit({ 0xFA, 0xF2, 0xC3, 0x3C, 0xEA, 0xF2, 0xC3, 0xC9 }); // (0xc3f2)++ / ret
+
+	// bank 3: cb prefixed shifts on a counter in bc, a push and pop and a call back into bank 0
+	b.org(0xC000).emit({ 0xFA, 0xF4, 0xC3, 0x47, 0xCB, 0x20, 0xCB, 0x19 }); // ld a, (0xc3f4) / ld b, a / sla b / rr c
+	b.emit({ 0xC5, 0xF1, 0x27, 0x78, 0x3C }); // push bc / pop af / daa / ld a, b / inc a
+	b.emit({ 0xEA, 0xF4, 0xC3 }); // ld (0xc3f4), a
+	b.call(0x0900);
+	b.emit({ 0xC9 });
+	return b.rom;
+}
+
+// seed of the random code rom translateTest and testRomWriter build
+#define RANDOM_CODE_SEED 12345
+
+// Straight line code made of random register, alu, cb, stack and load instructions in four routines the main loop
+// keeps calling, with short conditional jumps over some of them, and a timer interrupt landing anywhere. h stays
+// 0xc0, so every (hl) access is in work ram, and stores go to 0xc800-0xcfff.
+inline std::vector<uint8_t> buildRandomCodeRom(uint32_t seed)
+{
+	RomBuilder b;
+	uint32_t random = seed;
+	auto next = [&random](uint32_t range)
+	{
+		random = random * 1664525 + 1013904223;
+		return (random >> 8) % range;
+	};
+
+	b.org(0x50).emit({ 0xF5, 0xE5, 0x21, 0xFE, 0xC0, 0x34, 0xE1, 0xF1, 0xD9 }); // timer: inc (0xc0fe)
+
+	b.org(0x150).prologue();
+	b.writeIo(0x06, 0xF0).writeIo(0x07, 0x05);
+	b.writeIo(0x40, 0x91).writeIo(0x0F, 0x00).writeIo(0xFF, 0x04).emit({ 0xFB }); // lcd, ie = timer
+	b.emit({ 0x21, 0x00, 0xC0 }); // ld hl, 0xc000
+
+	uint16_t loop = b.here();
+	for (uint16_t routine = 0; routine < 4; routine++)
+		b.call(0x1000 + routine * 0x800);
+	b.jr(0x18, loop);
+
+	for (uint16_t routine = 0; routine < 4; routine++)
+	{
+		std::vector<std::vector<uint8_t>> code;
+		while (code.size() < 150)
+		{
+			uint8_t r = next(8);
+			if (r == 4 || r == 6)
+				r = 7; // never h, (hl) comes from its own cases
+
+			uint8_t pair = next(2) << 4; // bc or de
+			uint16_t store = 0xC800 + next(0x800);
+
+			switch (next(16))
+			{
+			case 0: code.push_back({ (uint8_t)(0x40 | r << 3 | next(8)) }); break; // ld r, r/(hl) (0x76 fixed below)
+			case 1: code.push_back({ (uint8_t)(0x06 | r << 3), (uint8_t)next(256) }); break; // ld r, n
+			case 2: code.push_back({ (uint8_t)(0x70 | next(8)) }); break; // ld (hl), r
+			case 3: code.push_back({ (uint8_t)(0x04 | next(8) << 3 | next(2)) }); break; // inc/dec r/(hl)
+			case 4: case 5: code.push_back({ (uint8_t)(0x80 | next(64)) }); break; // alu a, r/(hl)
+			case 6: code.push_back({ (uint8_t)(0xC6 | next(8) << 3), (uint8_t)next(256) }); break; // alu a, n
+			case 7: code.push_back({ (uint8_t)(0x07 | next(8) << 3) }); break; // rotates, daa, cpl, scf, ccf
+			case 8:
+			{
+				uint8_t operation = next(256);
+				if ((operation & 7) == 4 && (operation < 0x40 || operation >= 0x80))
+					operation++; // h stays
+				code.push_back({ 0xCB, operation });
+				break;
+			}
+			case 9: code.push_back({ (uint8_t)(0x03 | pair | next(2) << 3) }); break; // inc/dec bc/de
+			case 10: code.push_back({ (uint8_t)(0x01 | pair), (uint8_t)next(256), (uint8_t)next(256) }); break; // ld rr, nn
+			case 11: // push rr / pop bc, de or af
+				code.push_back({ (uint8_t)(0xC5 | next(4) << 4), (uint8_t)(0xC1 | (next(3) == 2 ? 0x30 : pair)) });
+				break;
+			case 12: code.push_back({ 0x36, (uint8_t)next(256) }); break; // ld (hl), n
+			case 13: // ld a, (nn) from rom or work ram
+				code.push_back({ 0xFA, (uint8_t)next(256), (uint8_t)(next(0x20) | next(2) * 0xC0) });
+				break;
+			case 14: code.push_back({ 0xEA, RomBuilder::lo(store), RomBuilder::hi(store) }); break; // ld (nn), a
+			default: code.push_back({ 0x08, RomBuilder::lo(store), RomBuilder::hi(store) }); break; // ld (nn), sp
+			}
+
+			if (code.back()[0] == 0x76)
+				code.back()[0] = 0x7E; // halt, ld a, (hl) instead
+			if ((code.back()[0] & 0xF8) == 0x60 || code.back()[0] == 0x24 || code.back()[0] == 0x25)
+				code.back()[0] = 0x00; // nothing writes h
+		}
+
+		b.org(0x1000 + routine * 0x800);
+		for (size_t i = 0, skipEnd = 0; i < code.size(); i++)
+		{
+			// now and then jr cc over the next one to three instructions, never into another jump's range
+			if (i >= skipEnd && next(8) == 0 && i + 3 < code.size())
+			{
+				size_t skipped = 0;
+				skipEnd = i + 1 + next(3);
+				for (size_t j = i; j < skipEnd; j++)
+					skipped += code[j].size();
+				b.emit({ (uint8_t)(0x20 | next(4) << 3), (uint8_t)skipped });
+			}
+			b.emit(code[i]);
+		}
+		b.emit({ 0xC9 });
+	}
+	return b.rom;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cinttypes>
+
+// Binary form of the SingleStepTests sm83 json vectors, written by gbvecpack and read by cputest. The whole corpus is
+// one little endian file that is mapped as is: a header with the range of vectors for each opcode, followed by
+// fixed size vectors, so nothing has to be parsed or allocated at test time.
+
+#define VECTOR_MAGIC 0x31564247 // "GBV1"
+#define VECTOR_VERSION 1
+#define VECTOR_MAX_RAM 8
+#define VECTOR_MAX_CYCLES 8
+// 0x00-0xFF are the base opcodes, 0x100-0x1FF the cb prefixed ones
+#define VECTOR_OPCODES 0x200
+
+struct VectorRam
+{
+	uint16_t address;
+	uint8_t value;
+	uint8_t pad = 0;
+};
+
+struct VectorState
+{
+	uint16_t pc;
+	uint16_t sp;
+	uint8_t a, b, c, d, e, f, h, l;
+	uint8_t ime;
+	uint8_t ie;
+	uint8_t ramCount;
+	uint8_t pad;
+	VectorRam ram[VECTOR_MAX_RAM];
+};
+
+struct VectorCycle
+{
+	uint16_t address;
+	uint8_t value;
+	uint8_t type; // BUS_IDLE, BUS_READ or BUS_WRITE
+};
+
+struct Vector
+{
+	char name[16];
+	VectorState initial;
+	VectorState final;
+	uint8_t cycleCount;
+	uint8_t pad[3];
+	VectorCycle cycles[VECTOR_MAX_CYCLES];
+};
+
+struct VectorRange
+{
+	uint32_t first;
+	uint32_t count;
+};
+
+struct VectorFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vectorCount;
+	uint32_t pad;
+	VectorRange opcodes[VECTOR_OPCODES];
+};
+
+static_assert(sizeof(VectorState) == 48, "vector layout is part of the file format");
+static_assert(sizeof(Vector) == 148, "vector layout is part of the file format");
+static_assert(sizeof(VectorFileHeader) == 16 + 8 * VECTOR_OPCODES, "vector layout is part of the file format");
@@ -0,0 +1,142 @@
+// translateTest: the test roms translated by gb2cpp at build time run exactly like the interpreter, frame by frame,
+// in runs cut at odd cycle counts, up to a breakpoint and through movie playback, with most instructions in
+// translated code. A plugin made from another rom or built against other core sources is refused.
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gb.h"
+#include "movie.h"
+#include "testRoms.h"
+#include "translatedCode.h"
+
+#define FRAMES 150
+
+static std::unique_ptr<GameBoy> loadGame(const std::vector<uint8_t>& rom, const char* plugin)
+{
+	auto gb = std::make_unique<GameBoy>();
+	gb->loadRom(rom.data(), rom.size());
+	if (plugin)
+		check(gb->loadTranslatedCode(plugin), "the plugin loads");
+	return gb;
+}
+
+static void testFrames(const std::vector<uint8_t>& rom, const char* plugin)
+{
+	auto interpreted = loadGame(rom, nullptr);
+	auto translated = loadGame(rom, plugin);
+
+	bool same = true;
+	for (int i = 0; i < FRAMES && same; i++)
+	{
+		interpreted->runFrame();
+		translated->runFrame();
+		same = interpreted->fullStateHash() == translated->fullStateHash();
+	}
+	check(same, "every frame matches the interpreter");
+
+	// budgets that end in the middle of blocks
+	for (uint64_t cycles = 1; cycles < 20000 && same; cycles = cycles * 3 + 1)
+	{
+		RunResult a = interpreted->runCycles(cycles);
+		RunResult b = translated->runCycles(cycles);
+		same = a.cycles == b.cycles && a.reason == b.reason && interpreted->fullStateHash() == translated->fullStateHash();
+	}
+	check(same, "runs of odd cycle counts match the interpreter");
+
+	check(translated->instructionCount == interpreted->instructionCount, "the same instructions ran");
+	check(translated->translatedInstructionCount > translated->instructionCount / 2,
+		"most instructions ran in translated code");
+	check(interpreted->translatedInstructionCount == 0, "nothing is translated without a plugin");
+}
+
+// stops in the middle of a block with a breakpoint, and with a predicate
+static void testStops(const std::vector<uint8_t>& rom, const char* plugin)
+{
+	auto interpreted = loadGame(rom, nullptr);
+	auto translated = loadGame(rom, plugin);
+
+	// wherever the interpreter is after a few thousand instructions
+	auto probe = loadGame(rom, nullptr);
+	probe->runUntil([](const GameBoy& gb) { return gb.instructionCount == 5000; });
+	uint16_t address = probe->cpu.PC;
+
+	interpreted->addBreakpoint(address);
+	translated->addBreakpoint(address);
+	RunResult a = interpreted->runFrame();
+	RunResult b = translated->runFrame();
+	check(b.reason == STOP_BREAKPOINT, "the breakpoint is hit in translated code");
+	check(a.reason == b.reason && a.cycles == b.cycles && interpreted->fullStateHash() == translated->fullStateHash(),
+		"a breakpoint stops both at the same instruction");
+	interpreted->removeBreakpoint(address);
+	translated->removeBreakpoint(address);
+
+	uint64_t target = interpreted->instructionCount + 1000;
+	interpreted->runUntil([target](const GameBoy& gb) { return gb.instructionCount == target; });
+	translated->runUntil([target](const GameBoy& gb) { return gb.instructionCount == target; });
+	check(translated->instructionCount == target && interpreted->fullStateHash() == translated->fullStateHash(),
+		"runUntil sees every instruction");
+}
+
+static void testMovie(const std::vector<uint8_t>& rom, const char* plugin)
+{
+	auto recorder = loadGame(rom, nullptr);
+	Movie movie;
+	recorder->startRecording(movie, 10);
+
+	uint32_t random = 3;
+	for (int i = 0; i < FRAMES; i++)
+	{
+		random = random * 1664525 + 1013904223;
+		recorder->setButtons((random >> 24) & 0xFF);
+		recorder->runFrame();
+	}
+	recorder->stopMovie();
+
+	auto player = loadGame(rom, plugin);
+	check(player->startPlayback(movie), "playback starts");
+	for (size_t i = 0; i < movie.frames(); i++)
+		player->runFrame();
+
+	check(player->movieSession().desyncFrame == -1, "the movie plays back in sync on translated code");
+	check(player->stateHash() == recorder->stateHash(), "and ends in the recorded state");
+}
+
+static void testRefused()
+{
+	std::vector<uint8_t> rom = buildInputLagRom();
+	GameBoy gb;
+	gb.loadRom(rom.data(), rom.size());
+
+	check(!gb.loadTranslatedCode(TRANSLATED_BUSY), "a plugin made from another rom is refused");
+	check(!gb.translatedCode(), "and nothing is loaded");
+	check(!gb.loadTranslatedCode("no such plugin"), "a missing plugin is refused");
+
+	std::vector<uint8_t> busyRom = buildBusyRom('T');
+	GameBoy busy;
+	busy.loadRom(busyRom.data(), busyRom.size());
+	check(!busy.loadTranslatedCode(TRANSLATED_OTHER_CORE), "a plugin built against other core sources is refused");
+
+	auto translated = loadGame(busyRom, TRANSLATED_BUSY);
+	check(translated->translatedCode() && translated->translatedCode()->blockCount() > 0, "the plugin has blocks");
+	std::unique_ptr<GameBoy> clone = translated->clone();
+	check(clone->translatedCode() == translated->translatedCode(), "clones share the translated code");
+}
+
+int main()
+{
+	testFrames(buildBusyRom('T'), TRANSLATED_BUSY);
+	testFrames(buildBankedRom(), TRANSLATED_BANKED);
+	testFrames(buildRandomCodeRom(RANDOM_CODE_SEED), TRANSLATED_RANDOM_CODE);
+
+	testStops(buildRandomCodeRom(RANDOM_CODE_SEED), TRANSLATED_RANDOM_CODE);
+	testMovie(buildBankedRom(), TRANSLATED_BANKED);
+	testRefused();
+
+	if (failures == 0)
+		std::printf("all translated code checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+// vecEnvTest: the SSE2 downsampling matches the scalar reference, actions are held for frameSkip frames, rewards and
+// done flags come from the game's ram and finished episodes start over from the start snapshot.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "gb.h"
+#include "vecEnv.h"
+#include "testRoms.h"
+
+#define ENVS 5
+
+static void testDownsample()
+{
+	std::mt19937 random(99);
+	std::vector<uint8_t> frame(LCD_SIZE);
+	std::vector<uint8_t> simd(OBS_84_SIZE * OBS_84_SIZE);
+	std::vector<uint8_t> scalar(OBS_84_SIZE * OBS_84_SIZE);
+
+	bool same = true;
+	for (int i = 0; i < 20; i++)
+	{
+		for (uint8_t& pixel : frame)
+			pixel = (uint8_t)random();
+
+		downsampleFrame84(frame.data(), simd.data());
+		downsampleFrame84Scalar(frame.data(), scalar.data());
+		same &= simd == scalar;
+	}
+	check(same, "simd downsampling matches the scalar one");
+
+	// flat stays flat, including the edge values
+	for (uint8_t value : { 0, 20, 255 })
+	{
+		std::fill(frame.begin(), frame.end(), value);
+		downsampleFrame84(frame.data(), simd.data());
+		check(std::count(simd.begin(), simd.end(), value) == (long)simd.size(), "flat frame stays flat");
+	}
+
+	// left half black, right half white: the middle column is the only one in between
+	for (int y = 0; y < LCD_HEIGHT; y++)
+		for (int x = 0; x < LCD_WIDTH; x++)
+			frame[y * LCD_WIDTH + x] = x < LCD_WIDTH / 2 ? 0 : 255;
+	downsampleFrame84(frame.data(), simd.data());
+	check(simd[0] == 0 && simd[OBS_84_SIZE - 1] == 255 && simd[41] < simd[42], "edges survive");
+
+	const int runs = 20000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < runs; i++)
+		downsampleFrame84(frame.data(), simd.data());
+	double simdNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < runs; i++)
+		downsampleFrame84Scalar(frame.data(), scalar.data());
+	double scalarNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+
+	std::printf("downsample 160x144 -> 84x84: %.0f ns (scalar %.0f ns)\n", simdNs, scalarNs);
+}
+
+// the input lag rom keeps the palette it will show in hram, 0x1b once it has seen A
+static float sawA(const GameBoy& gb, size_t)
+{
+	return gb.mmu.hRam[0] == 0x1B ? 1.0f : 0.0f;
+}
+
+static void testSteps()
+{
+	std::vector<uint8_t> rom = buildInputLagRom();
+
+	EnvConfig config;
+	config.envs = ENVS;
+	config.threads = 2;
+	config.frameSkip = 3;
+	config.observation = OBS_FULL;
+	config.startFrames = 10;
+	config.maxEpisodeFrames = 12;
+	config.reward = sawA;
+
+	VecEnv env(config);
+	check(env.loadRom(rom.data(), rom.size()), "rom loads");
+
+	std::vector<uint8_t> observations(ENVS * env.observationSize());
+	std::vector<uint8_t> startObservations(observations.size());
+	std::vector<float> rewards(ENVS);
+	std::vector<uint8_t> dones(ENVS);
+
+	env.reset(startObservations.data());
+
+	// the same game run by hand, with env 1's actions
+	auto reference = std::make_unique<GameBoy>();
+	reference->loadRom(rom.data(), rom.size());
+	for (int i = 0; i < config.startFrames; i++)
+		reference->runFrame();
+
+	// A on the odd envs only
+	uint8_t actions[ENVS];
+	for (int i = 0; i < ENVS; i++)
+		actions[i] = (i & 1) ? JOYPAD_A : 0;
+
+	env.step(actions, observations.data(), rewards.data(), dones.data());
+
+	reference->enableInputRegisterBits(BUTTON_A);
+	for (int i = 0; i < config.frameSkip; i++)
+		reference->runFrame();
+	reference->ppu.frameBuffer.acquire();
+
+	check(std::memcmp(observations.data() + env.observationSize(), reference->ppu.frameBuffer.readBuffer(),
+		LCD_SIZE) == 0, "a step is frameSkip frames with the action held");
+	check(rewards[1] == 1.0f && rewards[0] == 0.0f, "rewards come from ram");
+	check(dones[0] == 0 && dones[1] == 0, "episodes go on");
+
+	// 12 frame episodes are 4 steps, the fourth one ends them and starts over
+	for (int i = 0; i < 3; i++)
+	{
+		env.step(actions, observations.data(), rewards.data(), dones.data());
+		check(dones[1] == (i == 2), "episode ends at maxEpisodeFrames");
+	}
+	check(std::memcmp(observations.data(), startObservations.data(), observations.size()) == 0,
+		"a finished episode starts over from the snapshot");
+
+	// a reset env has nothing held, A has to be pressed again
+	actions[1] = JOYPAD_A;
+	env.step(actions, observations.data(), rewards.data(), dones.data());
+	check(rewards[1] == 1.0f, "actions apply after a reset");
+
+	// the same bits as setButtons, not 1 << Button
+	actions[0] = JOYPAD_START | JOYPAD_DOWN;
+	env.step(actions, observations.data(), rewards.data(), dones.data());
+	check(env.instance(0).mmu.joypadButtons == (JOYPAD_START | JOYPAD_DOWN), "actions are JOYPAD_* masks");
+}
+
+int main()
+{
+	testDownsample();
+	testSteps();
+
+	if (failures == 0)
+		std::printf("all vector env checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// verifyTest: the verifier finds nothing wrong with the clone, save state and translated code paths, per frame or
+// per instruction, and a fast side changed behind its back, in its state or only in the pixels it draws, is reported
+// at the frame and instruction it went wrong, with the states and traces of both sides.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gb.h"
+#include "testRoms.h"
+#include "verifier.h"
+
+#define FRAMES 120
+#define BAD_FRAME 20
+
+static bool run(Verifier& verifier, int frames)
+{
+	uint32_t random = 7;
+	for (int i = 0; i < frames; i++)
+	{
+		random = random * 1664525 + 1013904223;
+		if (!verifier.runFrame((random >> 24) & 0xFF))
+			return false;
+	}
+	return true;
+}
+
+static void testMatches(const std::vector<uint8_t>& rom, const VerifyConfig& config, int frames, const char* what)
+{
+	Verifier verifier(config);
+	check(verifier.loadRom(rom.data(), rom.size()), "the rom loads");
+	bool matched = run(verifier, frames);
+
+	if (!matched)
+		std::printf("%s diverged:\n%s", what, verifier.divergence()->differences.c_str());
+	check(matched && !verifier.divergence(), what);
+	check(verifier.frames() == (uint64_t)frames, "every frame was counted");
+	check(verifier.reference().fullStateHash() == verifier.fast().fullStateHash(), "both sides end in the same state");
+}
+
+static void testDivergence(bool perInstruction)
+{
+	VerifyConfig config;
+	config.engines = VERIFY_CLONE;
+	config.perInstruction = perInstruction;
+	config.traceWindow = 8;
+	// the busy rom never writes 0xd800
+	config.fastFrameHook = [](GameBoy& fast, uint64_t frame)
+	{
+		if (frame == BAD_FRAME)
+			fast.mmu.wRam[0x1800] ^= 0x5A;
+	};
+
+	std::vector<uint8_t> rom = buildBusyRom('V');
+	Verifier verifier(config);
+	verifier.loadRom(rom.data(), rom.size());
+
+	check(!run(verifier, FRAMES), "a changed fast side diverges");
+	check(!verifier.runFrame(0) && verifier.frames() == BAD_FRAME, "and nothing runs after that");
+
+	const Divergence* divergence = verifier.divergence();
+	check(divergence != nullptr, "the divergence is reported");
+	if (!divergence)
+		return;
+
+	check(divergence->frame == BAD_FRAME, "in the frame the hook changed");
+	check(divergence->instruction == 0, "after the frame's first instruction");
+	check(divergence->differences.find("wRam: 1 bytes differ, first at 0xD800 (") != std::string::npos,
+		"the difference names the changed byte");
+	check(divergence->referenceTrace.size() == 1 && divergence->fastTrace.size() == 1,
+		"the traces end at the diverging instruction");
+	check(divergence->referenceTrace.back().pc == divergence->fastTrace.back().pc
+		&& divergence->referenceTrace.back().stateHash != divergence->fastTrace.back().stateHash,
+		"the traces show the same instruction with different states");
+
+	// the dumped states are the two sides at the divergence
+	GameBoy reference;
+	GameBoy fast;
+	reference.loadRom(rom.data(), rom.size());
+	fast.loadRom(rom.data(), rom.size());
+	check(reference.loadState(divergence->referenceState.data(), divergence->referenceState.size())
+		&& fast.loadState(divergence->fastState.data(), divergence->fastState.size()), "the dumped states load");
+	check(reference.fullStateHash() == divergence->referenceTrace.back().stateHash
+		&& fast.fullStateHash() == divergence->fastTrace.back().stateHash, "and are where the traces end");
+	check(reference.mmu.wRam[0x1800] != fast.mmu.wRam[0x1800], "with the changed byte");
+}
+
+// a fast side that draws other pixels from the same state is only caught by the frame comparison
+static void testFrameDivergence(bool perInstruction)
+{
+	VerifyConfig config;
+	config.engines = VERIFY_CLONE;
+	config.perInstruction = perInstruction;
+	// the shades aren't part of the state, only the pixels drawn with them differ
+	config.fastFrameHook = [](GameBoy& fast, uint64_t frame)
+	{
+		if (frame == BAD_FRAME)
+		{
+			for (uint8_t& color : fast.ppu.colors)
+				color ^= 0xFF;
+		}
+	};
+
+	std::vector<uint8_t> rom = buildBusyRom('V');
+	Verifier verifier(config);
+	verifier.loadRom(rom.data(), rom.size());
+
+	check(!run(verifier, FRAMES), "a fast side drawing other pixels diverges");
+
+	const Divergence* divergence = verifier.divergence();
+	if (!divergence)
+		return;
+
+	check(divergence->frame == BAD_FRAME, "in the frame the hook changed the shades");
+	check(divergence->instruction >= 0, "at the instruction that drew the first pixel");
+	check(divergence->differences.compare(0, 7, "frame: ") == 0
+		&& divergence->differences.find('\n') == divergence->differences.size() - 1,
+		"and only the frame differs");
+}
+
+// runFrame on the fast side stopping early ends the frame in another state, but the state never differs instruction by
+// instruction
+static void testEarlyStop()
+{
+	VerifyConfig config;
+	config.engines = VERIFY_SAVE_STATE;
+
+	std::vector<uint8_t> rom = buildBusyRom('V');
+
+	// where the reference is 1000 instructions into the bad frame
+	GameBoy probe;
+	probe.loadRom(rom.data(), rom.size());
+	for (int i = 0; i < BAD_FRAME; i++)
+		probe.runFrame();
+	uint64_t target = probe.instructionCount + 1000;
+	probe.runUntil([target](const GameBoy& gb) { return gb.instructionCount == target; });
+	uint16_t pc = probe.cpu.PC;
+
+	// a breakpoint stops the fast side's runFrame there without changing anything
+	config.fastFrameHook = [pc](GameBoy& fast, uint64_t frame)
+	{
+		if (frame == BAD_FRAME)
+			fast.addBreakpoint(pc);
+	};
+
+	Verifier verifier(config);
+	verifier.loadRom(rom.data(), rom.size());
+	run(verifier, BAD_FRAME + 1);
+
+	check(verifier.divergence() && verifier.divergence()->instruction == -1,
+		"a frame that only ends differently is reported without an instruction");
+	if (verifier.divergence())
+	{
+		check(verifier.divergence()->differences.find("tCycles") != std::string::npos,
+			"with the end of frame states");
+		check(verifier.divergence()->referenceTrace.empty(), "and no trace");
+	}
+}
+
+int main()
+{
+	VerifyConfig config;
+	testMatches(buildBusyRom('V'), config, FRAMES, "clones and save states match the interpreter");
+
+	config.perInstruction = true;
+	testMatches(buildBusyRom('V'), config, 5, "clones and save states match per instruction");
+
+	config = VerifyConfig();
+	config.engines = VERIFY_TRANSLATED | VERIFY_CLONE;
+	config.translatedPath = TRANSLATED_RANDOM_CODE;
+	testMatches(buildRandomCodeRom(RANDOM_CODE_SEED), config, FRAMES, "translated code matches the interpreter");
+
+	config.translatedPath = TRANSLATED_BANKED;
+	config.perInstruction = true;
+	testMatches(buildBankedRom(), config, 5, "translated code matches per instruction");
+
+	config.translatedPath = TRANSLATED_BUSY;
+	Verifier wrongPlugin(config);
+	std::vector<uint8_t> rom = buildBankedRom();
+	check(!wrongPlugin.loadRom(rom.data(), rom.size()), "a plugin made from another rom is refused");
+
+	testDivergence(false);
+	testDivergence(true);
+	testFrameDivergence(false);
+	testFrameDivergence(true);
+	testEarlyStop();
+
+	if (failures == 0)
+		std::printf("all verifier checks passed\n");
+
+	return failures == 0 ? 0 : 1;
+}
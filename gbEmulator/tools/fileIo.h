@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// whole file reads and writes for the tools and tests, an empty vector when the file can't be read
+
+inline std::vector<uint8_t> readFile(const std::filesystem::path& path)
+{
+	std::ifstream is(path, std::ifstream::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+inline bool writeFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+{
+	std::ofstream os(path, std::ofstream::binary);
+	os.write((const char*)data.data(), data.size());
+	return (bool)os;
+}
@@ -0,0 +1,720 @@
+// gb2cpp: ahead of time translator from a rom to C++, for roms that are run all the time. It follows the code from
+// the entry point and the rst and interrupt vectors through every static jump and call, bank by bank, and writes one
+// C++ function per basic block (translatedCode.h). Built into a plugin (gb_add_translated_rom in CMakeLists.txt) it is
+// loaded with GameBoy::loadTranslatedCode or gbrun --translated.
+//
+// usage: gb2cpp <rom> -o <out.cpp> [--movie file] [--frames N]
+//
+// Jump tables (jp hl) and jumps from bank 0 into the switchable bank can't be followed statically. gb2cpp first runs
+// the rom in the interpreter and records where those went: it plays --movie if given, otherwise it runs --frames
+// frames (default 600) with nothing pressed. Play something that goes through the parts of the game that matter, code
+// nothing reached is still interpreted when it runs.
+//
+// A block charges the same m-cycles as the interpreter through the same CPU functions (AddCycle, read8, write8), and
+// runs the instructions it doesn't have a translation of through CPU::decodeAndExecute, so translated and interpreted
+// runs are identical down to the state hash.
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "gb.h"
+#include "fileIo.h"
+#include "hash.h"
+#include "movie.h"
+
+#define DEFAULT_PROFILE_FRAMES 600
+
+struct Options
+{
+	std::string romPath;
+	std::string outPath;
+	std::string moviePath;
+	uint64_t frames = DEFAULT_PROFILE_FRAMES;
+};
+
+static void printUsage()
+{
+	std::cerr << "usage: gb2cpp <rom> -o <out.cpp> [--movie file] [--frames N]\n";
+}
+
+static bool parseArgs(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "-o" && hasValue)
+			options.outPath = argv[++i];
+		else if (arg == "--movie" && hasValue)
+			options.moviePath = argv[++i];
+		else if (arg == "--frames" && hasValue)
+			options.frames = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg[0] != '-' && options.romPath.empty())
+			options.romPath = arg;
+		else
+			return false;
+	}
+
+	return !options.romPath.empty() && !options.outPath.empty();
+}
+
+// runs the rom in the interpreter and collects the targets of jumps that aren't in the code
+static bool profile(const std::vector<uint8_t>& rom, const Options& options, std::unordered_set<uint32_t>& targets)
+{
+	GameBoy gb;
+	if (!gb.loadRom(rom.data(), rom.size()))
+		return false;
+
+	Movie movie;
+	uint64_t frames = options.frames;
+
+	if (!options.moviePath.empty())
+	{
+		if (!movie.load(options.moviePath))
+		{
+			std::cerr << "gb2cpp: " << options.moviePath << " isn't a movie\n";
+			return false;
+		}
+
+		if (!gb.startPlayback(movie))
+			return false;
+		frames = movie.frames();
+	}
+
+	gb.jumpTargets = &targets;
+	for (uint64_t frame = 0; frame < frames;)
+	{
+		RunResult result = gb.runFrame();
+		if (result.reason == STOP_VBLANK || result.reason == STOP_CYCLES)
+			frame++;
+	}
+	gb.jumpTargets = nullptr;
+
+	std::cerr << "gb2cpp: profiled " << frames << " frames, " << targets.size() << " jump targets\n";
+	return true;
+}
+
+// how execution goes on after an instruction
+enum Flow
+{
+	FLOW_NEXT,        // the next instruction
+	FLOW_JUMP,        // jr, jp: the target only
+	FLOW_BRANCH,      // jr cc, jp cc: the target or the next instruction
+	FLOW_CALL,        // call, call cc, rst: the target, and the next instruction once it returns
+	FLOW_RETURN,      // ret, reti, jp hl: somewhere only known at run time
+	FLOW_RETURN_COND, // ret cc: somewhere else or the next instruction
+	FLOW_PAUSE        // halt, stop and ei: the next instruction, after the run loop had a look
+};
+
+struct Instruction
+{
+	uint32_t offset;
+	uint16_t address;
+	uint8_t opcode;
+	uint8_t u8;
+	uint16_t u16;
+	int length;
+	Flow flow;
+	uint16_t target; // FLOW_JUMP, FLOW_BRANCH and FLOW_CALL
+};
+
+// lengths as CPU::decodeAndExecute fetches them: stop takes no operand there
+static int instructionLength(uint8_t opcode)
+{
+	switch (opcode)
+	{
+	case 0x01: case 0x08: case 0x11: case 0x21: case 0x31: case 0xC2: case 0xC3: case 0xC4: case 0xCA: case 0xCC:
+	case 0xCD: case 0xD2: case 0xD4: case 0xDA: case 0xDC: case 0xEA: case 0xFA:
+		return 3;
+
+	case 0x06: case 0x0E: case 0x16: case 0x18: case 0x1E: case 0x20: case 0x26: case 0x28: case 0x2E: case 0x30:
+	case 0x36: case 0x38: case 0x3E: case 0xC6: case 0xCB: case 0xCE: case 0xD6: case 0xDE: case 0xE0: case 0xE6:
+	case 0xE8: case 0xEE: case 0xF0: case 0xF6: case 0xF8: case 0xFE:
+		return 2;
+
+	default:
+		return 1;
+	}
+}
+
+class Translator
+{
+public:
+	Translator(const std::vector<uint8_t>& rom) : rom(rom) {}
+
+	void addEntry(uint32_t offset)
+	{
+		if (offset < rom.size() && !straddles(offset))
+		{
+			leaders.insert(offset);
+			pending.push_back(offset);
+		}
+	}
+
+	// follows the code from every entry, every instruction start reached becomes known and every jump target and
+	// return address a leader
+	void trace()
+	{
+		while (!pending.empty())
+		{
+			uint32_t offset = pending.back();
+			pending.pop_back();
+
+			while (offset < rom.size() && !straddles(offset) && visited.insert(offset).second)
+			{
+				Instruction instruction = decode(offset);
+
+				if (instruction.flow == FLOW_JUMP || instruction.flow == FLOW_BRANCH || instruction.flow == FLOW_CALL)
+				{
+					int64_t target = resolve(offset, instruction.target);
+					if (target >= 0)
+						addEntry((uint32_t)target);
+				}
+
+				if (instruction.flow == FLOW_JUMP || instruction.flow == FLOW_RETURN)
+					break;
+
+				int64_t next = following(instruction);
+				if (next < 0)
+					break;
+
+				if (instruction.flow != FLOW_NEXT)
+					addEntry((uint32_t)next);
+				offset = (uint32_t)next;
+			}
+		}
+	}
+
+	void emit(std::string& out, uint64_t romHash, const std::string& romName);
+
+	size_t blockCount() const { return leaders.size(); }
+	// instructions that can be entered, known after emit
+	size_t instructionCount() const { return entryCount; }
+
+private:
+	const std::vector<uint8_t>& rom;
+	std::set<uint32_t> leaders;
+	std::unordered_set<uint32_t> visited;
+	std::vector<uint32_t> pending;
+	size_t entryCount = 0;
+
+	// where gb2cpp places an offset in the address space: bank 0 at 0x0000, every other bank at 0x4000
+	static uint16_t addressOf(uint32_t offset)
+	{
+		return offset < 0x4000 ? (uint16_t)offset : (uint16_t)(0x4000 | (offset & 0x3FFF));
+	}
+
+	uint8_t byteAt(uint32_t offset) const { return offset < rom.size() ? rom[offset] : 0xFF; }
+
+	// an instruction whose operands are in the next bank's space reads whatever is mapped there, leave it to the
+	// interpreter
+	bool straddles(uint32_t offset) const
+	{
+		return ((offset + instructionLength(byteAt(offset)) - 1) >> 14) != (offset >> 14);
+	}
+
+	Instruction decode(uint32_t offset) const
+	{
+		Instruction instruction{};
+		instruction.offset = offset;
+		instruction.address = addressOf(offset);
+		instruction.opcode = byteAt(offset);
+		instruction.u8 = byteAt(offset + 1);
+		instruction.u16 = (uint16_t)(instruction.u8 | byteAt(offset + 2) << 8);
+		instruction.length = instructionLength(instruction.opcode);
+
+		uint8_t opcode = instruction.opcode;
+		uint16_t next = (uint16_t)(instruction.address + instruction.length);
+
+		if (opcode == 0x18 || opcode == 0xC3)
+			instruction.flow = FLOW_JUMP;
+		else if ((opcode & 0xE7) == 0x20 || (opcode & 0xE7) == 0xC2)
+			instruction.flow = FLOW_BRANCH;
+		else if (opcode == 0xCD || (opcode & 0xE7) == 0xC4 || (opcode & 0xC7) == 0xC7)
+			instruction.flow = FLOW_CALL;
+		else if (opcode == 0xC9 || opcode == 0xD9 || opcode == 0xE9)
+			instruction.flow = FLOW_RETURN;
+		else if ((opcode & 0xE7) == 0xC0)
+			instruction.flow = FLOW_RETURN_COND;
+		else if (opcode == 0x76 || opcode == 0x10 || opcode == 0xFB)
+			instruction.flow = FLOW_PAUSE;
+		else
+			instruction.flow = FLOW_NEXT;
+
+		if (opcode == 0x18 || (opcode & 0xE7) == 0x20)
+			instruction.target = (uint16_t)(next + (int8_t)instruction.u8);
+		else if ((opcode & 0xC7) == 0xC7)
+			instruction.target = opcode & 0x38;
+		else
+			instruction.target = instruction.u16;
+
+		return instruction;
+	}
+
+	// the offset of the next instruction, -1 if it is past the end of the bank (the other side may map anything)
+	int64_t following(const Instruction& instruction) const
+	{
+		uint32_t next = instruction.offset + instruction.length;
+		if ((next >> 14) != (instruction.offset >> 14))
+			return -1;
+		return next;
+	}
+
+	// Where a jump from offset to address lands, -1 when that depends on the bank mapped at run time. Within the
+	// same half of the rom area it is the same bank; bank 0 is assumed at 0x0000, and from bank 0 the switchable half
+	// is only known in a 32 KiB rom, the profile has the rest.
+	int64_t resolve(uint32_t offset, uint16_t address) const
+	{
+		int64_t target;
+
+		if (address < 0x4000)
+			target = address;
+		else if (address < 0x8000 && offset >= 0x4000)
+			target = (offset & ~0x3FFFu) | (address & 0x3FFF);
+		else if (address < 0x8000)
+			target = rom.size() <= 0x8000 ? address : -1;
+		else
+			target = -1;
+
+		return target >= 0 && (uint64_t)target < rom.size() ? target : -1;
+	}
+
+	// a chained block has to be in the same half of the address space, a jump to the other half goes back through
+	// GameBoy to find the bank mapped there
+	int64_t chainTarget(const Instruction& instruction, uint16_t address) const
+	{
+		if ((address & 0xC000) != (instruction.address & 0xC000))
+			return -1;
+
+		int64_t target = resolve(instruction.offset, address);
+		return target >= 0 && leaders.count((uint32_t)target) ? target : -1;
+	}
+
+	std::vector<Instruction> blockAt(uint32_t leader) const;
+	void emitBlock(std::string& out, uint32_t leader);
+	void emitInstruction(std::string& out, const Instruction& instruction, bool last);
+	void emitExit(std::string& out, const Instruction& instruction, uint16_t address, bool wrote,
+		const char* indent);
+};
+
+static std::string format(const char* pattern, ...)
+{
+	char buffer[512];
+	va_list args;
+	va_start(args, pattern);
+	std::vsnprintf(buffer, sizeof(buffer), pattern, args);
+	va_end(args);
+	return buffer;
+}
+
+// the entry point at an instruction, and the function of the block starting at one
+static std::string blockName(uint32_t offset)
+{
+	return format("block_%06x", offset);
+}
+
+static std::string runName(uint32_t offset)
+{
+	return format("run_%06x", offset);
+}
+
+// regs index for the r8 field of an opcode, (hl) has none
+static const char* reg8[8] = { "REG_B", "REG_C", "REG_D", "REG_E", "REG_H", "REG_L", nullptr, "REG_A" };
+// high register of the rr field, sp has none
+static const char* reg16[4] = { "REG_B", "REG_D", "REG_H", nullptr };
+
+#define HL "translated::pair(cpu, REG_H)"
+
+static std::string r8(int index)
+{
+	return format("cpu.regs[%s]", reg8[index]);
+}
+
+static std::string r16(int index)
+{
+	return reg16[index] ? format("translated::pair(cpu, %s)", reg16[index]) : "cpu.SP";
+}
+
+static std::string setR16(int index, const std::string& value)
+{
+	return reg16[index] ? format("translated::setPair(cpu, %s, %s);", reg16[index], value.c_str())
+		: format("cpu.SP = %s;", value.c_str());
+}
+
+// ends the block at address: chains to its block when it has one in the same bank, otherwise goes back to GameBoy
+void Translator::emitExit(std::string& out, const Instruction& instruction, uint16_t address, bool wrote,
+	const char* indent)
+{
+	int64_t target = chainTarget(instruction, address);
+
+	if (target < 0)
+	{
+		out += format("%sc.next(0x%04x);\n%sreturn {};\n", indent, address, indent);
+		return;
+	}
+
+	if (wrote)
+		out += format("%sif (!c.nextAfterWrite(0x%04x, 0x%06x))\n", indent, address, (uint32_t)target);
+	else
+		out += format("%sif (!c.next(0x%04x))\n", indent, address);
+	out += format("%s\treturn {};\n%sreturn { %s };\n", indent, indent, blockName((uint32_t)target).c_str());
+}
+
+void Translator::emitInstruction(std::string& out, const Instruction& instruction, bool last)
+{
+	uint8_t opcode = instruction.opcode;
+	uint8_t u8 = instruction.u8;
+	uint16_t u16 = instruction.u16;
+	uint16_t next = (uint16_t)(instruction.address + instruction.length);
+	int dst = (opcode >> 3) & 7;
+	int src = opcode & 7;
+	int rr = (opcode >> 4) & 3;
+	int cc = (opcode >> 3) & 3;
+
+	out += format("\t// %04x:", instruction.address);
+	for (int i = 0; i < instruction.length; i++)
+		out += format(" %02x", byteAt(instruction.offset + i));
+	out += "\n";
+
+	std::string body;
+	bool wrote = false;
+	bool translatedOpcode = true;
+
+	if (opcode == 0x00)
+	{
+	}
+	else if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76)
+	{
+		if (dst == 6)
+		{
+			body = format("cpu.write8(" HL ", %s);", r8(src).c_str());
+			wrote = true;
+		}
+		else if (src == 6)
+			body = format("%s = cpu.read8(" HL ");", r8(dst).c_str());
+		else
+			body = format("%s = %s;", r8(dst).c_str(), r8(src).c_str());
+	}
+	else if ((opcode & 0xC7) == 0x06)
+	{
+		if (dst == 6)
+		{
+			body = format("cpu.write8(" HL ", 0x%02x);", u8);
+			wrote = true;
+		}
+		else
+			body = format("%s = 0x%02x;", r8(dst).c_str(), u8);
+	}
+	else if ((opcode & 0xCF) == 0x01)
+		body = setR16(rr, format("0x%04x", u16));
+	else if ((opcode & 0xCF) == 0x02)
+	{
+		body = format("cpu.write8(%s, cpu.regs[REG_A]);", rr < 2 ? r16(rr).c_str() : HL);
+		if (rr >= 2)
+			body += format("\n\ttranslated::setPair(cpu, REG_H, " HL " %s 1);", rr == 2 ? "+" : "-");
+		wrote = true;
+	}
+	else if ((opcode & 0xCF) == 0x0A)
+	{
+		body = format("cpu.regs[REG_A] = cpu.read8(%s);", rr < 2 ? r16(rr).c_str() : HL);
+		if (rr >= 2)
+			body += format("\n\ttranslated::setPair(cpu, REG_H, " HL " %s 1);", rr == 2 ? "+" : "-");
+	}
+	else if ((opcode & 0xC7) == 0x03)
+	{
+		std::string value = r16(rr) + ((opcode & 0x08) ? " - 1" : " + 1");
+		body = setR16(rr, value) + "\n\tcpu.AddCycle();";
+	}
+	else if ((opcode & 0xC6) == 0x04)
+	{
+		const char* function = opcode & 1 ? "dec" : "inc";
+		if (dst == 6)
+		{
+			body = format("cpu.write8(" HL ", translated::%s(cpu, cpu.read8(" HL ")));", function);
+			wrote = true;
+		}
+		else
+			body = format("%s = translated::%s(cpu, %s);", r8(dst).c_str(), function, r8(dst).c_str());
+	}
+	else if ((opcode & 0xE7) == 0x07)
+		body = format("translated::rotateA<%d>(cpu);", opcode >> 3);
+	else if (opcode == 0x2F)
+		body = "translated::cpl(cpu);";
+	else if (opcode == 0x37)
+		body = "translated::scf(cpu);";
+	else if (opcode == 0x3F)
+		body = "translated::ccf(cpu);";
+	else if ((opcode & 0xCF) == 0x09)
+		body = format("translated::addHl(cpu, %s);\n\tcpu.AddCycle();", r16(rr).c_str());
+	else if (opcode >= 0x80 && opcode < 0xC0)
+		body = format("translated::alu<%d>(cpu, %s);", dst, src == 6 ? "cpu.read8(" HL ")" : r8(src).c_str());
+	else if ((opcode & 0xC7) == 0xC6)
+		body = format("translated::alu<%d>(cpu, 0x%02x);", dst, u8);
+	else if ((opcode & 0xCF) == 0xC1)
+	{
+		if (rr == 3)
+			body = "{\n\t\tuint16_t value = translated::pop(cpu);\n\t\tcpu.regs[REG_A] = value >> 8;\n"
+				"\t\tcpu.regs[REG_F] = value & 0xF0;\n\t}";
+		else
+			body = setR16(rr, "translated::pop(cpu)");
+	}
+	else if ((opcode & 0xCF) == 0xC5)
+	{
+		std::string value = rr == 3 ? "(uint16_t)(cpu.regs[REG_A] << 8 | (cpu.regs[REG_F] & 0xF0))" : r16(rr);
+		body = format("cpu.AddCycle();\n\ttranslated::push(cpu, %s);", value.c_str());
+		wrote = true;
+	}
+	else if (opcode == 0xE0 || opcode == 0xE2 || opcode == 0xEA)
+	{
+		std::string address = opcode == 0xE0 ? format("0x%04x", 0xFF00 | u8)
+			: opcode == 0xEA ? format("0x%04x", u16) : "0xFF00 | cpu.regs[REG_C]";
+		body = format("cpu.write8(%s, cpu.regs[REG_A]);", address.c_str());
+		wrote = true;
+	}
+	else if (opcode == 0xF0 || opcode == 0xF2 || opcode == 0xFA)
+	{
+		std::string address = opcode == 0xF0 ? format("0x%04x", 0xFF00 | u8)
+			: opcode == 0xFA ? format("0x%04x", u16) : "0xFF00 | cpu.regs[REG_C]";
+		body = format("cpu.regs[REG_A] = cpu.read8(%s);", address.c_str());
+	}
+	else if (opcode == 0xF9)
+		body = "cpu.SP = " HL ";\n\tcpu.AddCycle();";
+	else if (instruction.flow == FLOW_NEXT || instruction.flow == FLOW_PAUSE)
+		translatedOpcode = false;
+
+	if (instruction.flow == FLOW_NEXT || instruction.flow == FLOW_PAUSE)
+	{
+		if (translatedOpcode)
+		{
+			out += format("\ttranslated::fetch<%d>(cpu);\n", instruction.length);
+			if (!body.empty())
+				out += "\t" + body + "\n";
+			out += format("\tcpu.PC = 0x%04x;\n", next);
+		}
+		else
+		{
+			// everything else, cb prefixed instructions among them, is run by the interpreter from the opcode on
+			out += format("\tcpu.PC = 0x%04x;\n\tcpu.AddCycle();\n\tcpu.decodeAndExecute(0x%02x);\n",
+				(uint16_t)(instruction.address + 1), opcode);
+			wrote = true;
+		}
+
+		if (instruction.flow == FLOW_PAUSE)
+			out += "\tc.next(cpu.PC);\n\treturn {};\n";
+		else if (last)
+			emitExit(out, instruction, next, wrote, "\t");
+		else
+		{
+			int64_t following = this->following(instruction);
+			if (wrote)
+				out += format("\tif (!c.nextAfterWrite(0x%04x, 0x%06x))\n", next, (uint32_t)following);
+			else
+				out += format("\tif (!c.next(0x%04x))\n", next);
+			out += "\t\treturn {};\n";
+		}
+		return;
+	}
+
+	// control flow, exactly the m-cycles of the interpreter's version in the same order
+	out += format("\ttranslated::fetch<%d>(cpu);\n", instruction.length);
+	uint16_t target = instruction.target;
+	std::string condition = format("translated::condition<%d>(cpu)", cc);
+
+	switch (instruction.flow)
+	{
+	case FLOW_JUMP:
+		out += format("\tcpu.AddCycle();\n\tcpu.PC = 0x%04x;\n", target);
+		emitExit(out, instruction, target, false, "\t");
+		break;
+
+	case FLOW_BRANCH:
+		out += format("\tif (%s)\n\t{\n\t\tcpu.AddCycle();\n\t\tcpu.PC = 0x%04x;\n", condition.c_str(), target);
+		emitExit(out, instruction, target, false, "\t\t");
+		out += format("\t}\n\tcpu.PC = 0x%04x;\n", next);
+		emitExit(out, instruction, next, false, "\t");
+		break;
+
+	case FLOW_CALL:
+	{
+		bool always = opcode == 0xCD || (opcode & 0xC7) == 0xC7;
+		const char* indent = always ? "\t" : "\t\t";
+
+		if (!always)
+			out += format("\tif (%s)\n\t{\n", condition.c_str());
+		out += format("%stranslated::push(cpu, 0x%04x);\n%scpu.PC = 0x%04x;\n%scpu.AddCycle();\n", indent, next,
+			indent, target, indent);
+		emitExit(out, instruction, target, true, indent);
+
+		if (!always)
+		{
+			out += format("\t}\n\tcpu.PC = 0x%04x;\n", next);
+			emitExit(out, instruction, next, false, "\t");
+		}
+		break;
+	}
+
+	case FLOW_RETURN:
+		if (opcode == 0xE9)
+			out += "\tcpu.PC = " HL ";\n";
+		else
+			out += format("\tcpu.PC = translated::pop(cpu);\n%s\tcpu.AddCycle();\n",
+				opcode == 0xD9 ? "\tcpu.IME = 1;\n" : "");
+		out += "\tc.next(cpu.PC);\n\treturn {};\n";
+		break;
+
+	case FLOW_RETURN_COND:
+		out += format("\tcpu.AddCycle();\n\tif (%s)\n\t{\n\t\tcpu.PC = translated::pop(cpu);\n\t\tcpu.AddCycle();\n"
+			"\t\tc.next(cpu.PC);\n\t\treturn {};\n\t}\n\tcpu.PC = 0x%04x;\n", condition.c_str(), next);
+		emitExit(out, instruction, next, false, "\t");
+		break;
+
+	default:
+		break;
+	}
+}
+
+std::vector<Instruction> Translator::blockAt(uint32_t leader) const
+{
+	std::vector<Instruction> block;
+
+	uint32_t offset = leader;
+	while (true)
+	{
+		block.push_back(decode(offset));
+		int64_t next = following(block.back());
+
+		// a block runs to its first jump, or up to the next block, or to the end of the bank
+		if (block.back().flow != FLOW_NEXT || next < 0 || leaders.count((uint32_t)next) || straddles((uint32_t)next))
+			return block;
+
+		offset = (uint32_t)next;
+	}
+}
+
+// One function per block, which can be entered at any of its instructions: the interpreter comes back from an
+// interrupt anywhere. Every instruction gets an entry function that calls it with its index.
+void Translator::emitBlock(std::string& out, uint32_t leader)
+{
+	std::vector<Instruction> block = blockAt(leader);
+
+	out += format("TranslatedJump %s(TranslatedContext& c, int%s)\n{\n\ttranslated::Cpu& cpu = c.cpu;\n\n",
+		runName(leader).c_str(), block.size() > 1 ? " entry" : "");
+
+	if (block.size() > 1)
+	{
+		out += "\tswitch (entry)\n\t{\n";
+		for (size_t i = 1; i < block.size(); i++)
+			out += format("\tcase %zu: goto at_%06x;\n", i, block[i].offset);
+		out += "\t}\n\n";
+	}
+
+	for (size_t i = 0; i < block.size(); i++)
+	{
+		if (i > 0)
+			out += format("\nat_%06x:\n", block[i].offset);
+		emitInstruction(out, block[i], i + 1 == block.size());
+	}
+
+	out += "}\n\n";
+}
+
+void Translator::emit(std::string& out, uint64_t romHash, const std::string& romName)
+{
+	// the block and index every instruction is entered at, the first block wins where decodings overlap
+	std::map<uint32_t, std::pair<uint32_t, size_t>> entries;
+	for (uint32_t leader : leaders)
+	{
+		std::vector<Instruction> block = blockAt(leader);
+		for (size_t i = 0; i < block.size(); i++)
+			entries.emplace(block[i].offset, std::make_pair(leader, i));
+	}
+	entryCount = entries.size();
+
+	out += format("// generated by gb2cpp from %s: %zu blocks, %zu instructions. Don't edit, run gb2cpp again.\n\n",
+		romName.c_str(), leaders.size(), entries.size());
+	out += "#include \"translatedCode.h\"\n\n";
+	out += "#ifndef GB_CORE_BUILD_ID\n#error \"build with gb_add_translated_rom, it defines GB_CORE_BUILD_ID\"\n#endif\n\n";
+	out += "namespace\n{\n\n";
+
+	for (const auto& entry : entries)
+		out += format("TranslatedJump %s(TranslatedContext& c);\n", blockName(entry.first).c_str());
+	out += "\n";
+
+	for (uint32_t leader : leaders)
+		emitBlock(out, leader);
+
+	for (const auto& entry : entries)
+	{
+		out += format("TranslatedJump %s(TranslatedContext& c)\n{\n\treturn %s(c, %zu);\n}\n\n",
+			blockName(entry.first).c_str(), runName(entry.second.first).c_str(), entry.second.second);
+	}
+
+	out += "const TranslatedEntry blocks[] = {\n";
+	for (const auto& entry : entries)
+		out += format("\t{ 0x%06x, %s },\n", entry.first, blockName(entry.first).c_str());
+	out += "};\n\n";
+
+	out += format("const TranslatedModule module = { TRANSLATED_ABI_VERSION, sizeof(CPU<SystemBus>), sizeof(MMU),\n"
+		"\tGB_CORE_BUILD_ID, 0x%016llxull, %zu, blocks };\n\n}\n\n", (unsigned long long)romHash, entries.size());
+	out += "TRANSLATED_EXPORT const TranslatedModule* gbTranslatedModule()\n{\n\treturn &module;\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseArgs(argc, argv, options))
+	{
+		printUsage();
+		return 2;
+	}
+
+	std::vector<uint8_t> rom = readFile(options.romPath);
+	if (rom.size() < 0x150)
+	{
+		std::cerr << "gb2cpp: could not load " << options.romPath << "\n";
+		return 2;
+	}
+
+	// the core logs cartridge info to stdout
+	std::streambuf* coutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+	std::unordered_set<uint32_t> targets;
+	bool profiled = profile(rom, options, targets);
+	std::cout.rdbuf(coutBuffer);
+
+	if (!profiled)
+		return 2;
+
+	Translator translator(rom);
+	translator.addEntry(0x100);
+	for (uint32_t vector = 0; vector <= 0x60; vector += 8)
+		translator.addEntry(vector);
+	for (uint32_t target : targets)
+		translator.addEntry(target);
+	translator.trace();
+
+	std::string name = options.romPath.substr(options.romPath.find_last_of("/\\") + 1);
+	std::string out;
+	translator.emit(out, hashBytes(rom.data(), rom.size()), name);
+
+	std::ofstream os(options.outPath, std::ios::binary);
+	os.write(out.data(), out.size());
+	if (!os)
+	{
+		std::cerr << "gb2cpp: could not write " << options.outPath << "\n";
+		return 2;
+	}
+
+	std::cerr << "gb2cpp: " << translator.blockCount() << " blocks, " << translator.instructionCount()
+		<< " instructions\n";
+	return 0;
+}
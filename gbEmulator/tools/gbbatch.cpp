@@ -0,0 +1,449 @@
+// gbbatch: measures how BatchRunner scales, total emulated frames per second over all instances for 1, 2, 4 ... up
+// to --max-threads worker threads (default every hardware thread, which is always measured too).
+//
+// usage: gbbatch [--instances N] [--frames N] [--max-threads N] [--rom file] [--no-pin] [--out file]
+//                [--env] [--frame-skip N] [--lockstep]
+//
+// Every instance gets its own pseudo random buttons each frame, so they drift apart like playtesting bots do. Without
+// --rom the instances run a synthetic rom with sprites, a busy main loop and a vblank handler that reads the joypad.
+// The report is JSON with frames per second, speedup over one thread and parallel efficiency for each thread count.
+//
+// --env measures a VecEnv instead: --instances envs with 84x84 observations, --frames env steps of --frame-skip
+// frames each (default 4), random actions. The runs report env steps per second in total and per thread.
+//
+// --lockstep compares LockstepCore with running each instance on its own cpu, the way BatchRunner does, on two cpu
+// only kernels: one whose control flow is the same for every instance and one that branches on its data. Every
+// instance gets its own seed and table and runs --frames frames worth of cycles, --instances is rounded up to whole
+// LOCKSTEP_LANES groups. Both sides split the instances (or groups) evenly over the threads. The runs report
+// millions of instructions per second over all instances for both, and the lanes an average vector step ran for.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batchRunner.h"
+#include "lockstepCore.h"
+#include "vecEnv.h"
+#include "romBuilder.h"
+
+#define WARMUP_FRAMES 30
+
+// 40 sprites, the vblank handler scrolls the background by the d-pad and the main loop does alu work on wram
+static std::vector<uint8_t> buildPlaytestRom()
+{
+	RomBuilder b;
+
+	std::vector<uint8_t> oam;
+	for (int i = 0; i < 40; i++)
+	{
+		oam.push_back(16 + (i / 10) * 32);
+		oam.push_back(8 + (i % 10) * 16);
+		oam.push_back(1 + i % 3);
+		oam.push_back(0x00);
+	}
+	b.place(0x1000, oam);
+
+	// vblank: select the d-pad and add its lines to scx. Only vblank is enabled, so it can run over the other vectors.
+	b.org(0x40).emit({ 0xF5, 0xC5 }); // push af / push bc
+	b.writeIo(0x00, 0x20).emit({ 0xF0, 0x00, 0xE6, 0x0F, 0x47 }); // ldh a, (joyp) / and 0x0f / ld b, a
+	b.emit({ 0xF0, 0x43, 0x80, 0xE0, 0x43 }); // ldh a, (scx) / add b / ldh (scx), a
+	b.emit({ 0xC1, 0xF1, 0xD9 }); // pop bc / pop af / reti
+
+	b.org(0x150).prologue();
+	b.memset(0x8000, 0xA5, 0x1000);
+	b.memcpy(0xFE00, 0x1000, 160);
+	b.writeIo(0x48, 0xE4);
+	b.writeIo(0x40, 0x93).writeIo(0xFF, 0x01).emit({ 0xFB }); // lcd, bg and objects on, ie = vblank
+
+	b.emit({ 0x21, 0x00, 0xC0 }); // ld hl, 0xc000
+	uint16_t loop = b.here();
+	// ld a, (hl) / add a / xor l / inc a / ld (hl+), a / ld a, h / cp 0xd0
+	b.emit({ 0x7E, 0x87, 0xAD, 0x3C, 0x22, 0x7C, 0xFE, 0xD0 });
+	b.jr(0x20, loop);
+	b.emit({ 0x26, 0xC0 }); // ld h, 0xc0
+	b.jr(0x18, loop);
+	return b.rom;
+}
+
+// cpu only: mixes the instance's seed at 0xc000 into its table at 0xc100 over and over. With branchy set, entries
+// whose rotate carries out get extra work, so instances take different paths on different data.
+static std::vector<uint8_t> buildLockstepKernel(bool branchy)
+{
+	RomBuilder b;
+	b.emit({ 0x21, 0x00, 0xC1, 0xFA, 0x00, 0xC0, 0x47 }); // ld hl, 0xc100 / ld a, (0xc000) / ld b, a
+	uint16_t loop = b.here();
+	b.emit({ 0x7E, 0xA8, 0xC6, 0x3B, 0x07 }); // ld a, (hl) / xor b / add 0x3b / rlca
+	if (branchy)
+	{
+		uint16_t skip = b.here() + 2 + 4;
+		b.jr(0x30, skip);
+		b.emit({ 0xEE, 0x55, 0x14, 0x83 }); // xor 0x55 / inc d / add e
+	}
+	b.emit({ 0x22, 0x47, 0x0C, 0x7D, 0xB7 }); // ld (hl+), a / ld b, a / inc c / ld a, l / or a
+	b.jr(0x20, loop);
+	b.emit({ 0x26, 0xC1 }); // ld h, 0xc1
+	b.jr(0x18, loop);
+	return b.rom;
+}
+
+struct Measurement
+{
+	unsigned int threads;
+	// frames per second, or env steps per second with --env
+	double perSecond;
+};
+
+static Measurement measure(const std::vector<uint8_t>& rom, size_t instances, unsigned int threads, int frames, bool pin)
+{
+	BatchRunner batch(instances, threads, pin);
+	batch.loadRom(rom.data(), rom.size());
+
+	uint32_t random = 12345;
+	auto stepWithInput = [&]()
+	{
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			random = random * 1664525 + 1013904223;
+			batch.setButtons(i, (uint8_t)(random >> 24));
+		}
+		batch.stepFrame();
+	};
+
+	for (int i = 0; i < WARMUP_FRAMES; i++)
+		stepWithInput();
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; i++)
+		stepWithInput();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return { batch.threads(), (double)instances * frames / seconds };
+}
+
+static Measurement measureEnv(const std::vector<uint8_t>& rom, size_t envs, unsigned int threads, int steps,
+	int frameSkip, bool pin)
+{
+	EnvConfig config;
+	config.envs = envs;
+	config.threads = threads;
+	config.pinThreads = pin;
+	config.frameSkip = frameSkip;
+	config.observation = OBS_84X84;
+
+	VecEnv env(config);
+	env.loadRom(rom.data(), rom.size());
+
+	std::vector<uint8_t> observations(envs * env.observationSize());
+	std::vector<uint8_t> actions(envs);
+	std::vector<float> rewards(envs);
+	std::vector<uint8_t> dones(envs);
+
+	uint32_t random = 12345;
+	auto stepWithInput = [&]()
+	{
+		for (uint8_t& action : actions)
+		{
+			random = random * 1664525 + 1013904223;
+			action = (uint8_t)(random >> 24);
+		}
+		env.step(actions.data(), observations.data(), rewards.data(), dones.data());
+	};
+
+	env.reset(observations.data());
+	for (int i = 0; i < WARMUP_FRAMES / frameSkip; i++)
+		stepWithInput();
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; i++)
+		stepWithInput();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return { env.threads(), (double)envs * steps / seconds };
+}
+
+struct LockstepMeasurement
+{
+	const char* kernel;
+	unsigned int threads;
+	// millions of instructions per second over all instances
+	double scalarMips;
+	double lockstepMips;
+	double lanesPerStep;
+};
+
+// job(i) for every i below count, each of threads threads taking a contiguous share
+static void runShares(unsigned int threads, size_t count, const std::function<void(size_t)>& job)
+{
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; t++)
+	{
+		workers.emplace_back([&, t]()
+		{
+			for (size_t i = count * t / threads; i < count * (t + 1) / threads; i++)
+				job(i);
+		});
+	}
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+// instance i's seed and table
+static void fillInstanceRam(uint8_t* ram, size_t instance)
+{
+	uint32_t random = 777 + (uint32_t)instance * 7919;
+	for (size_t i = 0; i < LOCKSTEP_RAM_SIZE; i++)
+	{
+		random = random * 1664525 + 1013904223;
+		ram[i] = (uint8_t)(random >> 24);
+	}
+}
+
+static LockstepMeasurement measureLockstep(const char* kernel, const std::vector<uint8_t>& rom, size_t instances,
+	unsigned int threads, int frames)
+{
+	uint64_t cycles = (uint64_t)frames * CYCLES_PER_FRAME;
+	size_t groups = instances / LOCKSTEP_LANES;
+
+	struct ScalarInstance
+	{
+		LaneBus bus;
+		std::unique_ptr<uint8_t[]> ram;
+		CPU<LaneBus> cpu{ bus };
+		uint64_t instructions = 0;
+	};
+
+	std::vector<std::unique_ptr<ScalarInstance>> scalar(instances);
+	for (size_t i = 0; i < instances; i++)
+	{
+		scalar[i] = std::make_unique<ScalarInstance>();
+		scalar[i]->ram = std::make_unique<uint8_t[]>(LOCKSTEP_RAM_SIZE);
+		scalar[i]->bus.rom = rom.data();
+		scalar[i]->bus.ram = scalar[i]->ram.get();
+		fillInstanceRam(scalar[i]->ram.get(), i);
+	}
+
+	std::vector<std::unique_ptr<LockstepCore>> cores(groups);
+	for (size_t g = 0; g < groups; g++)
+	{
+		cores[g] = std::make_unique<LockstepCore>();
+		cores[g]->loadRom(rom.data(), rom.size());
+		for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++)
+			fillInstanceRam(cores[g]->laneRam(lane), g * LOCKSTEP_LANES + lane);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	runShares(threads, instances, [&](size_t i)
+	{
+		CPU<LaneBus>& cpu = scalar[i]->cpu;
+		uint64_t executed = 0;
+		while (!cpu.HALT && cpu.tCycles < cycles)
+		{
+			cpu.decodeAndExecute(cpu.fetch8());
+			executed++;
+		}
+		scalar[i]->instructions = executed;
+	});
+	double scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	runShares(threads, groups, [&](size_t g) { cores[g]->run(cycles); });
+	double lockstepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t scalarInstructions = 0;
+	for (const std::unique_ptr<ScalarInstance>& instance : scalar)
+		scalarInstructions += instance->instructions;
+
+	uint64_t vectorSteps = 0;
+	uint64_t laneInstructions = 0;
+	uint64_t vectorLaneSteps = 0;
+	for (const std::unique_ptr<LockstepCore>& core : cores)
+	{
+		const LockstepStats& stats = core->stats();
+		vectorSteps += stats.vectorSteps;
+		vectorLaneSteps += stats.vectorLaneSteps;
+		laneInstructions += stats.vectorLaneSteps + stats.scalarSteps;
+	}
+
+	// both sides ran the same programs on the same data, so the same instructions
+	if (laneInstructions != scalarInstructions)
+		std::fprintf(stderr, "gbbatch: lockstep ran %llu instructions, scalar %llu\n",
+			(unsigned long long)laneInstructions, (unsigned long long)scalarInstructions);
+
+	return { kernel, threads, scalarInstructions / scalarSeconds / 1e6, laneInstructions / lockstepSeconds / 1e6,
+		vectorSteps ? (double)vectorLaneSteps / vectorSteps : 0.0 };
+}
+
+static int runLockstep(size_t instances, int frames, const std::vector<unsigned int>& threadCounts,
+	const std::string& outPath)
+{
+	instances = (instances + LOCKSTEP_LANES - 1) / LOCKSTEP_LANES * LOCKSTEP_LANES;
+
+	std::vector<LockstepMeasurement> results;
+	for (bool branchy : { false, true })
+	{
+		std::vector<uint8_t> rom = buildLockstepKernel(branchy);
+		for (unsigned int threads : threadCounts)
+		{
+			results.push_back(measureLockstep(branchy ? "branchy" : "uniform", rom, instances, threads, frames));
+			const LockstepMeasurement& m = results.back();
+			std::fprintf(stderr, "%-8s %3u threads %8.1f scalar MIPS %8.1f lockstep MIPS\n", m.kernel, m.threads,
+				m.scalarMips, m.lockstepMips);
+		}
+	}
+
+	std::ostringstream os;
+	os << "{\n";
+	os << "  \"instances\": " << instances << ",\n";
+	os << "  \"frames\": " << frames << ",\n";
+	os << "  \"lanes\": " << LOCKSTEP_LANES << ",\n";
+	os << "  \"hardwareThreads\": " << std::max(1u, std::thread::hardware_concurrency()) << ",\n";
+	os << "  \"runs\": [\n";
+
+	char line[256];
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const LockstepMeasurement& m = results[i];
+		std::snprintf(line, sizeof(line), "    { \"kernel\": \"%s\", \"threads\": %u, \"scalarMips\": %.1f, "
+			"\"lockstepMips\": %.1f, \"speedup\": %.2f, \"lanesPerStep\": %.1f }%s\n", m.kernel, m.threads,
+			m.scalarMips, m.lockstepMips, m.lockstepMips / m.scalarMips, m.lanesPerStep,
+			i + 1 < results.size() ? "," : "");
+		os << line;
+	}
+
+	os << "  ]\n";
+	os << "}\n";
+
+	std::cout << os.str();
+	if (!outPath.empty())
+		std::ofstream(outPath) << os.str();
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	size_t instances = 32;
+	int frames = 60;
+	unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	unsigned int maxThreads = hardwareThreads;
+	bool pin = true;
+	bool envMode = false;
+	bool lockstepMode = false;
+	int frameSkip = 4;
+	std::string romPath;
+	std::string outPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--instances" && hasValue)
+			instances = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--frames" && hasValue)
+			frames = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--max-threads" && hasValue)
+			maxThreads = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--rom" && hasValue)
+			romPath = argv[++i];
+		else if (arg == "--no-pin")
+			pin = false;
+		else if (arg == "--out" && hasValue)
+			outPath = argv[++i];
+		else if (arg == "--env")
+			envMode = true;
+		else if (arg == "--frame-skip" && hasValue)
+			frameSkip = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--lockstep")
+			lockstepMode = true;
+		else
+		{
+			std::cerr << "usage: gbbatch [--instances N] [--frames N] [--max-threads N] [--rom file] [--no-pin] "
+				"[--out file] [--env] [--frame-skip N] [--lockstep]\n";
+			return 2;
+		}
+	}
+
+	std::vector<uint8_t> rom;
+	if (romPath.empty())
+	{
+		rom = buildPlaytestRom();
+	}
+	else
+	{
+		std::ifstream is(romPath, std::ifstream::binary);
+		rom.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+	}
+
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	if (lockstepMode)
+		return runLockstep(instances, frames, threadCounts, outPath);
+
+	// keep the cartridge info the core prints out of the report
+	std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+
+	std::vector<Measurement> results;
+	for (unsigned int threads : threadCounts)
+	{
+		if (envMode)
+			results.push_back(measureEnv(rom, instances, threads, frames, frameSkip, pin));
+		else
+			results.push_back(measure(rom, instances, threads, frames, pin));
+		std::fprintf(stderr, "%3u threads %10.1f %s/s\n", results.back().threads, results.back().perSecond,
+			envMode ? "steps" : "frames");
+	}
+
+	std::cout.rdbuf(coutBuffer);
+
+	std::ostringstream os;
+	os << "{\n";
+	os << "  \"instances\": " << instances << ",\n";
+	os << "  \"frames\": " << frames << ",\n";
+	os << "  \"hardwareThreads\": " << hardwareThreads << ",\n";
+	os << "  \"pinned\": " << (pin ? "true" : "false") << ",\n";
+	if (envMode)
+		os << "  \"frameSkip\": " << frameSkip << ",\n";
+	os << "  \"runs\": [\n";
+
+	char line[256];
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Measurement& m = results[i];
+		double speedup = m.perSecond / results[0].perSecond;
+		const char* last = i + 1 < results.size() ? "," : "";
+
+		if (envMode)
+			std::snprintf(line, sizeof(line), "    { \"threads\": %u, \"stepsPerSecond\": %.1f, "
+				"\"stepsPerSecondPerThread\": %.1f, \"speedup\": %.2f, \"efficiency\": %.2f }%s\n",
+				m.threads, m.perSecond, m.perSecond / m.threads, speedup, speedup / m.threads, last);
+		else
+			std::snprintf(line, sizeof(line),
+				"    { \"threads\": %u, \"framesPerSecond\": %.1f, \"speedup\": %.2f, \"efficiency\": %.2f }%s\n",
+				m.threads, m.perSecond, speedup, speedup / m.threads, last);
+		os << line;
+	}
+
+	os << "  ]\n";
+	os << "}\n";
+
+	std::cout << os.str();
+	if (!outPath.empty())
+		std::ofstream(outPath) << os.str();
+
+	return 0;
+}
@@ -0,0 +1,526 @@
+// gbbench: times the core on small synthetic roms, each one stressing a different part of the emulator, and compares
+// the results with a baseline file.
+//
+// usage: gbbench [--frames N] [--reps N] [--filter name] [--out file] [--baseline file] [--threshold percent] [--rewind]
+//               [--run-ahead N] [--clone]
+//
+// Every scenario runs a short warm up and then --reps timed repetitions of --frames frames. Repetitions are interleaved
+// across scenarios so slow drift on the machine (thermal, other load) hits all of them alike. The report holds the
+// median, minimum and standard deviation of ns per emulated frame plus the median ns per instruction. A scenario
+// regresses when its minimum ns per frame is more than --threshold percent (default 10) above the baseline's, in
+// which case the exit code is 1. The minimum is compared because noise only ever adds time. Baselines are just a
+// previous --out file from the same machine, record one on a quiet machine with enough --reps that the spread stays
+// well under the threshold.
+//
+// --rewind captures a rewind snapshot after every timed frame. The capture is timed on its own and left out of ns per
+// frame, the report adds its median cost per frame, that cost as a percent of the frame's and the delta bytes one
+// minute of history takes.
+//
+// --run-ahead N runs every frame through RunAhead, so the per frame numbers include the N frames run ahead and the
+// save and load around them. Compare it with a run without to get the cost of run-ahead.
+//
+// --clone branches CLONE_COUNT clones off every scenario after each repetition and adds the median ns per clone() (a
+// new instance) and per cloneInto() (reusing one) to the report, plus the bytes each clone holds once it has run a
+// frame of its own: the instance itself and the external ram if it wrote to it. The shared rom isn't counted.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gb.h"
+#include "rewind.h"
+#include "romBuilder.h"
+#include "runAhead.h"
+
+#define WARMUP_FRAMES 60
+#define CLONE_COUNT 64
+
+// alu heavy loop, lcd on with just the background
+static std::vector<uint8_t> buildAluRom()
+{
+	RomBuilder b;
+	b.prologue().writeIo(0x40, 0x91);
+	b.emit({ 0x06, 0x13, 0x0E, 0x57, 0x16, 0x21, 0x1E, 0x8C, 0x26, 0x40, 0x2E, 0x05 }); // ld b/c/d/e/h/l, n
+	uint16_t loop = b.here();
+	b.emit({
+		0x80, 0x89, 0x92, 0xA3, 0xAC, 0xB5, 0x3C, 0x04, // add b / adc c / sub d / and e / xor h / or l / inc a / inc b
+		0x0D, 0x17, 0x0F, 0xFE, 0x42, 0x9A, 0x2F, 0x37, // dec c / rla / rrca / cp 0x42 / sbc d / cpl / scf
+		0xCB, 0x11, 0xCB, 0x3B, 0xCB, 0x47, 0x09, 0x19, // rl c / srl e / bit 0, a / add hl, bc / add hl, de
+	});
+	b.jr(0x18, loop);
+	return b.rom;
+}
+
+// copies 4 KiB from rom to wram over and over
+static std::vector<uint8_t> buildMemcpyRom()
+{
+	RomBuilder b;
+	b.prologue().writeIo(0x40, 0x91);
+	uint16_t loop = b.here();
+	b.memcpy(0xC000, 0x0000, 0x1000);
+	b.jr(0x18, loop);
+	return b.rom;
+}
+
+// halts until every vblank, what most games do once their frame logic is done
+static std::vector<uint8_t> buildHaltRom()
+{
+	RomBuilder b;
+	b.org(0x40).emit({ 0xD9 }); // vblank: reti
+	b.org(0x150).prologue();
+	b.writeIo(0x40, 0x91).writeIo(0xFF, 0x01).emit({ 0xFB }); // ie = vblank, ei
+	uint16_t loop = b.here();
+	b.emit({ 0x76 }).jr(0x18, loop);
+	return b.rom;
+}
+
+// 40 sprites laid out 10 per line in four bands, plus the background
+static std::vector<uint8_t> buildSpritesRom()
+{
+	RomBuilder b;
+
+	std::vector<uint8_t> oam;
+	for (int i = 0; i < 40; i++)
+	{
+		oam.push_back(16 + (i / 10) * 32); // y
+		oam.push_back(8 + (i % 10) * 16);  // x
+		oam.push_back(1 + i % 3);          // tile
+		oam.push_back((i & 1) ? 0x20 : 0x00); // alternate x flip
+	}
+	b.place(0x1000, oam);
+
+	b.org(0x40).emit({ 0xD9 });
+	b.org(0x150).prologue();
+	b.memset(0x8000, 0xA5, 0x100);
+	b.memcpy(0xFE00, 0x1000, 160);
+	b.writeIo(0x48, 0xE4).writeIo(0x49, 0xD2); // obp0, obp1
+	b.writeIo(0x40, 0x93).writeIo(0xFF, 0x01).emit({ 0xFB }); // lcd, bg and objects on
+	uint16_t loop = b.here();
+	b.emit({ 0x76 }).jr(0x18, loop);
+	return b.rom;
+}
+
+// window over a background whose scroll changes on every hblank and every frame
+static std::vector<uint8_t> buildWindowScrollRom()
+{
+	RomBuilder b;
+
+	std::vector<uint8_t> tileMap(0x400);
+	for (size_t i = 0; i < tileMap.size(); i++)
+		tileMap[i] = (uint8_t)(i * 7);
+	b.place(0x1000, tileMap);
+
+	b.org(0x40).emit({ 0xF5, 0xF0, 0x42, 0x3C, 0xE0, 0x42, 0xF1, 0xD9 }); // vblank: scy++
+	b.org(0x48).emit({ 0xF5, 0xF0, 0x43, 0x3C, 0xE0, 0x43, 0xF1, 0xD9 }); // stat: scx++
+	b.org(0x150).prologue();
+	b.memset(0x8000, 0x3C, 0x1000);
+	b.memcpy(0x9800, 0x1000, 0x400);
+	b.memcpy(0x9C00, 0x1000, 0x400);
+	b.writeIo(0x4A, 40).writeIo(0x4B, 47); // wy, wx
+	b.writeIo(0x41, 0x08); // stat interrupt on hblank
+	b.writeIo(0x40, 0xF1).writeIo(0xFF, 0x03).emit({ 0xFB }); // window on with its own map, ie = vblank | stat
+	uint16_t loop = b.here();
+	b.emit({ 0x76 }).jr(0x18, loop);
+	return b.rom;
+}
+
+// mbc1 rom and mode switches as fast as the cpu can issue them, reading from the switched bank each time
+static std::vector<uint8_t> buildMbcRom()
+{
+	RomBuilder b(0x01, 0x01); // mbc1, 64 KiB
+	for (int bank = 1; bank < 4; bank++)
+		b.place(0x4000 * bank, { (uint8_t)bank });
+
+	b.prologue().writeIo(0x40, 0x91);
+	b.emit({ 0x21, 0x00, 0x20 }); // ld hl, 0x2000
+	uint16_t loop = b.here();
+	for (uint8_t bank = 1; bank < 4; bank++)
+		b.emit({ 0x3E, bank, 0x77, 0xFA, 0x00, 0x40 }); // ld a, bank / ld (hl), a / ld a, (0x4000)
+	b.emit({ 0x3E, 0x01, 0xEA, 0x00, 0x60, 0xAF, 0xEA, 0x00, 0x60 }); // mode 1, then back to mode 0
+	b.jr(0x18, loop);
+	return b.rom;
+}
+
+struct Scenario
+{
+	const char* name;
+	std::vector<uint8_t> (*build)();
+};
+
+static const Scenario scenarios[] = {
+	{ "alu", buildAluRom },
+	{ "memcpy", buildMemcpyRom },
+	{ "halt", buildHaltRom },
+	{ "sprites", buildSpritesRom },
+	{ "window_scroll", buildWindowScrollRom },
+	{ "mbc_switch", buildMbcRom },
+};
+
+struct Result
+{
+	std::string name;
+	double nsPerFrame = 0.0;
+	double nsPerFrameMin = 0.0;
+	double nsPerFrameStddev = 0.0;
+	double nsPerInstruction = 0.0;
+	double instructionsPerFrame = 0.0;
+	// only with --rewind
+	double rewindNsPerFrame = 0.0;
+	double rewindBytesPerMinute = 0.0;
+	// only with --clone
+	double cloneNs = 0.0;
+	double cloneIntoNs = 0.0;
+	double cloneBytes = 0.0;
+};
+
+static double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	size_t n = values.size();
+	return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+struct Run
+{
+	const Scenario* scenario = nullptr;
+	std::unique_ptr<GameBoy> gb;
+	std::vector<double> nsPerFrame;
+	std::vector<double> nsPerInstruction;
+	uint64_t instructions = 0;
+	RunAhead runAhead;
+	std::unique_ptr<Rewind> rewind;
+	std::vector<double> rewindNsPerFrame;
+	uint64_t rewindBytes = 0;
+	uint64_t rewindFrames = 0;
+	bool clone = false;
+	std::vector<double> cloneNs;
+	std::vector<double> cloneIntoNs;
+	double cloneBytes = 0.0;
+};
+
+static void startRun(Run& run)
+{
+	std::vector<uint8_t> rom = run.scenario->build();
+
+	run.gb = std::make_unique<GameBoy>();
+
+	// keep the cartridge info the core prints out of the report
+	std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+	run.gb->loadRom(rom.data(), rom.size());
+	std::cout.rdbuf(coutBuffer);
+
+	for (int i = 0; i < WARMUP_FRAMES; i++)
+		run.gb->runFrame();
+
+	// first capture keeps the whole state, the timed ones are all deltas
+	if (run.rewind)
+		run.rewind->capture(*run.gb);
+}
+
+static void timeClones(Run& run)
+{
+	GameBoy& gb = *run.gb;
+	std::vector<std::unique_ptr<GameBoy>> clones(CLONE_COUNT);
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::unique_ptr<GameBoy>& clone : clones)
+		clone = gb.clone();
+	auto cloned = std::chrono::steady_clock::now();
+	for (std::unique_ptr<GameBoy>& clone : clones)
+		gb.cloneInto(*clone);
+	auto end = std::chrono::steady_clock::now();
+
+	run.cloneNs.push_back(std::chrono::duration<double, std::nano>(cloned - start).count() / CLONE_COUNT);
+	run.cloneIntoNs.push_back(std::chrono::duration<double, std::nano>(end - cloned).count() / CLONE_COUNT);
+
+	size_t bytes = 0;
+	for (std::unique_ptr<GameBoy>& clone : clones)
+	{
+		clone->runFrame();
+		bytes += sizeof(GameBoy) + (clone->mmu.eRam.shared() ? 0 : clone->mmu.eRam.size());
+	}
+	run.cloneBytes = (double)bytes / CLONE_COUNT;
+}
+
+static void timeRepetition(Run& run, int frames)
+{
+	GameBoy& gb = *run.gb;
+	uint64_t instructions = gb.instructionCount;
+	double ns = 0.0;
+
+	if (run.rewind)
+	{
+		Rewind& rewind = *run.rewind;
+		double rewindNs = 0.0;
+		size_t bytes = rewind.deltaBytes();
+		uint32_t captured = rewind.frames();
+
+		for (int i = 0; i < frames; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			run.runAhead.runFrame(gb);
+			auto frameEnd = std::chrono::steady_clock::now();
+			rewind.capture(gb);
+			auto captureEnd = std::chrono::steady_clock::now();
+
+			ns += std::chrono::duration<double, std::nano>(frameEnd - start).count();
+			rewindNs += std::chrono::duration<double, std::nano>(captureEnd - frameEnd).count();
+		}
+
+		// bytes per frame only count when nothing was dropped to stay in the budget, the history starts over every
+		// repetition so that only happens with a very large --frames
+		if (rewind.frames() == captured + (uint32_t)frames)
+		{
+			run.rewindBytes += rewind.deltaBytes() - bytes;
+			run.rewindFrames += frames;
+		}
+		rewind.clear();
+		rewind.capture(gb);
+
+		run.rewindNsPerFrame.push_back(rewindNs / frames);
+	}
+	else
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < frames; i++)
+			run.runAhead.runFrame(gb);
+
+		ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	instructions = gb.instructionCount - instructions;
+	run.instructions += instructions;
+
+	run.nsPerFrame.push_back(ns / frames);
+	run.nsPerInstruction.push_back(instructions ? ns / instructions : 0.0);
+
+	if (run.clone)
+		timeClones(run);
+}
+
+static Result summarize(const Run& run, int frames)
+{
+	const std::vector<double>& nsPerFrame = run.nsPerFrame;
+
+	double mean = 0.0;
+	for (double value : nsPerFrame)
+		mean += value;
+	mean /= nsPerFrame.size();
+
+	double variance = 0.0;
+	for (double value : nsPerFrame)
+		variance += (value - mean) * (value - mean);
+	variance /= nsPerFrame.size();
+
+	Result result;
+	result.name = run.scenario->name;
+	result.nsPerFrame = median(nsPerFrame);
+	result.nsPerFrameMin = *std::min_element(nsPerFrame.begin(), nsPerFrame.end());
+	result.nsPerFrameStddev = std::sqrt(variance);
+	result.nsPerInstruction = median(run.nsPerInstruction);
+	result.instructionsPerFrame = (double)run.instructions / ((double)frames * nsPerFrame.size());
+
+	if (run.rewind)
+	{
+		result.rewindNsPerFrame = median(run.rewindNsPerFrame);
+		if (run.rewindFrames)
+			result.rewindBytesPerMinute = (double)run.rewindBytes / run.rewindFrames * 60.0 * 60.0;
+	}
+
+	if (run.clone)
+	{
+		result.cloneNs = median(run.cloneNs);
+		result.cloneIntoNs = median(run.cloneIntoNs);
+		result.cloneBytes = run.cloneBytes;
+	}
+	return result;
+}
+
+static std::string toJson(const std::vector<Result>& results, int frames, int reps, int runAhead, bool rewind,
+	bool clone)
+{
+	std::ostringstream os;
+	os << "{\n";
+	os << "  \"frames\": " << frames << ",\n";
+	os << "  \"repetitions\": " << reps << ",\n";
+	if (runAhead)
+		os << "  \"runAhead\": " << runAhead << ",\n";
+	os << "  \"scenarios\": [\n";
+
+	char line[512];
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		// one scenario per line, readBaseline depends on it
+		int length = std::snprintf(line, sizeof(line),
+			"    { \"name\": \"%s\", \"nsPerFrame\": %.1f, \"nsPerFrameMin\": %.1f, \"nsPerFrameStddev\": %.1f, "
+			"\"nsPerInstruction\": %.2f, \"instructionsPerFrame\": %.1f",
+			r.name.c_str(), r.nsPerFrame, r.nsPerFrameMin, r.nsPerFrameStddev, r.nsPerInstruction,
+			r.instructionsPerFrame);
+
+		if (rewind)
+		{
+			std::snprintf(line + length, sizeof(line) - length,
+				", \"rewindNsPerFrame\": %.1f, \"rewindPercentOfFrame\": %.2f, \"rewindBytesPerMinute\": %.0f",
+				r.rewindNsPerFrame, r.nsPerFrame > 0.0 ? r.rewindNsPerFrame / r.nsPerFrame * 100.0 : 0.0,
+				r.rewindBytesPerMinute);
+		}
+
+		if (clone)
+		{
+			length = (int)std::strlen(line);
+			std::snprintf(line + length, sizeof(line) - length,
+				", \"cloneNs\": %.1f, \"cloneIntoNs\": %.1f, \"cloneBytes\": %.0f", r.cloneNs, r.cloneIntoNs,
+				r.cloneBytes);
+		}
+
+		os << line << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+
+	os << "  ]\n";
+	os << "}\n";
+	return os.str();
+}
+
+// scenario name -> minimum ns per frame, from a file written by --out
+static std::map<std::string, double> readBaseline(const std::string& path)
+{
+	std::map<std::string, double> baseline;
+	std::ifstream is(path);
+	std::string line;
+
+	while (std::getline(is, line))
+	{
+		size_t name = line.find("\"name\": \"");
+		size_t ns = line.find("\"nsPerFrameMin\": ");
+		if (name == std::string::npos || ns == std::string::npos)
+			continue;
+
+		name += 9;
+		size_t nameEnd = line.find('"', name);
+		baseline[line.substr(name, nameEnd - name)] = std::strtod(line.c_str() + ns + 17, nullptr);
+	}
+
+	return baseline;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 120;
+	int reps = 5;
+	double threshold = 10.0;
+	std::string filter;
+	std::string outPath;
+	std::string baselinePath;
+	bool rewind = false;
+	bool clone = false;
+	int runAhead = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--frames" && hasValue)
+			frames = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--reps" && hasValue)
+			reps = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--threshold" && hasValue)
+			threshold = std::atof(argv[++i]);
+		else if (arg == "--filter" && hasValue)
+			filter = argv[++i];
+		else if (arg == "--out" && hasValue)
+			outPath = argv[++i];
+		else if (arg == "--baseline" && hasValue)
+			baselinePath = argv[++i];
+		else if (arg == "--rewind")
+			rewind = true;
+		else if (arg == "--clone")
+			clone = true;
+		else if (arg == "--run-ahead" && hasValue)
+			runAhead = std::clamp(std::atoi(argv[++i]), 0, RUN_AHEAD_MAX_FRAMES);
+		else
+		{
+			std::cerr << "usage: gbbench [--frames N] [--reps N] [--filter name] [--out file] [--baseline file] "
+				"[--threshold percent] [--rewind] [--run-ahead N] [--clone]\n";
+			return 2;
+		}
+	}
+
+	std::vector<Run> runs;
+	for (const Scenario& scenario : scenarios)
+	{
+		if (!filter.empty() && filter != scenario.name)
+			continue;
+
+		Run run;
+		run.scenario = &scenario;
+		runs.push_back(std::move(run));
+	}
+
+	for (Run& run : runs)
+	{
+		if (rewind)
+			run.rewind = std::make_unique<Rewind>();
+		run.clone = clone;
+		run.runAhead.setFrames(runAhead);
+		startRun(run);
+	}
+
+	for (int rep = 0; rep < reps; rep++)
+	{
+		for (Run& run : runs)
+			timeRepetition(run, frames);
+	}
+
+	std::vector<Result> results;
+	for (const Run& run : runs)
+		results.push_back(summarize(run, frames));
+
+	std::string json = toJson(results, frames, reps, runAhead, rewind, clone);
+	std::cout << json;
+
+	if (!outPath.empty())
+		std::ofstream(outPath) << json;
+
+	if (baselinePath.empty())
+		return 0;
+
+	std::map<std::string, double> baseline = readBaseline(baselinePath);
+	if (baseline.empty())
+	{
+		std::cerr << "gbbench: no results in baseline " << baselinePath << "\n";
+		return 2;
+	}
+
+	bool regressed = false;
+	for (const Result& result : results)
+	{
+		auto it = baseline.find(result.name);
+		if (it == baseline.end())
+		{
+			std::fprintf(stderr, "%-14s %12.0f ns/frame   (not in baseline)\n", result.name.c_str(), result.nsPerFrameMin);
+			continue;
+		}
+
+		double change = (result.nsPerFrameMin / it->second - 1.0) * 100.0;
+		bool slower = change > threshold;
+		regressed |= slower;
+
+		std::fprintf(stderr, "%-14s %12.0f ns/frame   baseline %12.0f   %+6.1f%%%s\n", result.name.c_str(),
+			result.nsPerFrameMin, it->second, change, slower ? "   REGRESSION" : "");
+	}
+
+	return regressed ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+// gbrun: runs a rom headless as fast as possible and prints a json report (throughput, halted time, final state
+// hashes). Only needs the gbcore library, so it builds and runs on machines without a display, GL or network.
+//
+// usage: gbrun <rom> [--frames N] [--movie file] [--record file] [--hash-interval N] [--until-pc hex]
+//              [--until-serial text] [--translated plugin [--compare]]
+//
+// --movie plays a movie (movie.h) through the core: it starts from the movie's start state, runs as many frames as
+// the movie has unless --frames says otherwise, and checks the state hashes on the way. The report adds the frame the
+// run stopped matching the recording, and the exit code is 3 if it did. Files without the movie header are read the
+// old way, one byte per frame holding the JOYPAD_* buttons held during that frame. Frames past the end of a movie
+// have nothing pressed.
+//
+// --record writes the run as a movie, with a state hash every --hash-interval frames (default 60, 0 for none).
+// Recording while playing an old style movie converts it. Replaying the recording runs exactly the same emulated
+// workload on any build, which is what performance comparisons between builds need.
+//
+// With an --until condition the run stops as soon as it is met and the exit code is 1 if it never was.
+//
+// --translated runs the rom with a plugin made by gb2cpp (gb_add_translated_rom in CMakeLists.txt) and reports the
+// share of instructions that ran in translated code. --compare first does the same run on the interpreter and adds
+// its time, the speedup and whether both ended in the same state; the exit code is 3 if they didn't.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gb.h"
+#include "fileIo.h"
+#include "hash.h"
+#include "movie.h"
+
+struct Options
+{
+	std::string romPath;
+	std::string moviePath;
+	std::string recordPath;
+	std::string translatedPath;
+	bool compare = false;
+	uint32_t hashInterval = MOVIE_DEFAULT_HASH_INTERVAL;
+	uint64_t frames = 600;
+	bool framesSet = false;
+
+	bool untilPc = false;
+	uint16_t untilPcAddress = 0;
+	std::string untilSerial;
+};
+
+static void printUsage()
+{
+	std::cerr << "usage: gbrun <rom> [--frames N] [--movie file] [--record file] [--hash-interval N] [--until-pc hex] "
+		"[--until-serial text] [--translated plugin [--compare]]\n";
+}
+
+static bool parseArgs(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--frames" && hasValue)
+		{
+			options.frames = std::strtoull(argv[++i], nullptr, 10);
+			options.framesSet = true;
+		}
+		else if (arg == "--movie" && hasValue)
+			options.moviePath = argv[++i];
+		else if (arg == "--record" && hasValue)
+			options.recordPath = argv[++i];
+		else if (arg == "--hash-interval" && hasValue)
+			options.hashInterval = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--until-pc" && hasValue)
+		{
+			options.untilPc = true;
+			options.untilPcAddress = (uint16_t)std::strtoul(argv[++i], nullptr, 16);
+		}
+		else if (arg == "--until-serial" && hasValue)
+			options.untilSerial = argv[++i];
+		else if (arg == "--translated" && hasValue)
+			options.translatedPath = argv[++i];
+		else if (arg == "--compare")
+			options.compare = true;
+		else if (arg[0] != '-' && options.romPath.empty())
+			options.romPath = arg;
+		else
+			return false;
+	}
+
+	return !options.romPath.empty() && (!options.compare || !options.translatedPath.empty());
+}
+
+static std::string jsonEscape(const std::string& text)
+{
+	std::string out;
+	for (unsigned char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (c < 0x20 || c >= 0x7F)
+		{
+			char buf[8];
+			std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out += buf;
+		}
+		else
+		{
+			out += c;
+		}
+	}
+	return out;
+}
+
+static std::string hex64(uint64_t value)
+{
+	char buf[17];
+	std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)value);
+	return buf;
+}
+
+static uint64_t hashRam(const MMU& mmu)
+{
+	uint64_t hash = hashBytes(mmu.wRam, sizeof(mmu.wRam));
+	hash = hashBytes(mmu.vRam, sizeof(mmu.vRam), hash);
+	hash = hashBytes(mmu.hRam, sizeof(mmu.hRam), hash);
+	hash = hashBytes(mmu.oam, sizeof(mmu.oam), hash);
+	return hashBytes(mmu.eRam.data(), mmu.eRam.size(), hash);
+}
+
+static const char* stopReasonName(StopReason reason)
+{
+	switch (reason)
+	{
+	case STOP_CYCLES: return "cycles";
+	case STOP_VBLANK: return "vblank";
+	case STOP_SERIAL: return "serial";
+	case STOP_BREAKPOINT: return "breakpoint";
+	case STOP_WATCHPOINT: return "watchpoint";
+	case STOP_PREDICATE: return "predicate";
+	case STOP_MOVIE: return "movie";
+	}
+	return "unknown";
+}
+
+// one run of the rom as the options say, the report is about the last one
+struct Run
+{
+	GameBoy gb;
+
+	// a movie played by the core, or the raw buttons of an old style one
+	Movie movie;
+	bool playing = false;
+	std::vector<uint8_t> rawMovie;
+	Movie recording;
+
+	std::string serial;
+	bool conditionMet = false;
+	StopReason lastReason = STOP_CYCLES;
+	uint64_t frame = 0;
+	double seconds = 0;
+	int64_t desyncFrame = -1;
+};
+
+// loads the rom, the movie and translated code into run, false with a message if something can't be loaded
+static bool setUp(Run& run, Options& options, bool translated, bool record)
+{
+	GameBoy& gb = run.gb;
+	gb.readRom(options.romPath, "");
+
+	if (!gb.validRomLoaded)
+	{
+		std::cerr << "gbrun: could not load " << options.romPath << "\n";
+		return false;
+	}
+
+	if (translated && !gb.loadTranslatedCode(options.translatedPath))
+		return false;
+
+	if (!options.moviePath.empty())
+	{
+		run.rawMovie = readFile(options.moviePath);
+		if (run.rawMovie.empty())
+		{
+			std::cerr << "gbrun: could not read " << options.moviePath << " or it is empty\n";
+			return false;
+		}
+
+		uint32_t magic = 0;
+		if (run.rawMovie.size() >= sizeof(magic))
+			std::memcpy(&magic, run.rawMovie.data(), sizeof(magic));
+		run.playing = magic == MOVIE_MAGIC;
+
+		if (run.playing)
+		{
+			if (!run.movie.deserialize(run.rawMovie.data(), run.rawMovie.size()))
+			{
+				std::cerr << "gbrun: " << options.moviePath << " is damaged or from another version\n";
+				return false;
+			}
+			run.rawMovie.clear();
+
+			if (!gb.startPlayback(run.movie))
+			{
+				std::cerr << "gbrun: can't play " << options.moviePath << "\n";
+				return false;
+			}
+
+			if (!options.framesSet)
+				options.frames = run.movie.frames();
+		}
+	}
+
+	if (record && !options.recordPath.empty())
+	{
+		if (run.playing)
+		{
+			std::cerr << "gbrun: --record can't be combined with playing a movie, only with an old style one\n";
+			return false;
+		}
+
+		gb.startRecording(run.recording, options.hashInterval);
+	}
+
+	if (options.untilPc)
+		gb.addBreakpoint(options.untilPcAddress);
+
+	// serial output is always captured, it is how most test roms report results
+	gb.stopEvents |= EVENT_SERIAL;
+	return true;
+}
+
+static void play(Run& run, const Options& options)
+{
+	GameBoy& gb = run.gb;
+	auto start = std::chrono::steady_clock::now();
+
+	while (run.frame < options.frames && !run.conditionMet)
+	{
+		if (!run.playing)
+			gb.setButtons(run.frame < run.rawMovie.size() ? run.rawMovie[run.frame] : 0);
+
+		RunResult result = gb.runFrame();
+		run.lastReason = result.reason;
+
+		switch (result.reason)
+		{
+		case STOP_SERIAL:
+			run.serial += (char)gb.mmu.serialOut;
+			run.conditionMet = !options.untilSerial.empty() && run.serial.find(options.untilSerial) != std::string::npos;
+			break;
+		case STOP_BREAKPOINT:
+			run.conditionMet = true;
+			break;
+		default:
+			run.frame++;
+			break;
+		}
+	}
+
+	run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	run.desyncFrame = gb.movieSession().desyncFrame;
+	gb.stopMovie();
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseArgs(argc, argv, options))
+	{
+		printUsage();
+		return 2;
+	}
+
+	// the core logs cartridge info and movie desyncs to stdout, keep stdout for the json report
+	std::streambuf* coutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+	// the same run on the interpreter first, to time it and check translated code against it
+	std::unique_ptr<Run> interpreted;
+	if (options.compare)
+	{
+		interpreted = std::make_unique<Run>();
+		if (!setUp(*interpreted, options, false, false))
+			return 2;
+		play(*interpreted, options);
+	}
+
+	auto run = std::make_unique<Run>();
+	if (!setUp(*run, options, !options.translatedPath.empty(), true))
+		return 2;
+	play(*run, options);
+
+	GameBoy& gb = run->gb;
+	std::cout.rdbuf(coutBuffer);
+
+	if (!options.recordPath.empty() && !run->recording.save(options.recordPath))
+	{
+		std::cerr << "gbrun: could not write " << options.recordPath << "\n";
+		return 2;
+	}
+
+	gb.ppu.frameBuffer.acquire();
+	uint64_t frameHash = hashBytes(gb.ppu.frameBuffer.readBuffer(), LCD_WIDTH * LCD_HEIGHT);
+
+	bool hasCondition = options.untilPc || !options.untilSerial.empty();
+	uint64_t cycles = gb.cpu.tCycles;
+	uint64_t frame = run->frame;
+	double seconds = run->seconds;
+	bool matches = !interpreted || interpreted->gb.fullStateHash() == gb.fullStateHash();
+
+	std::printf("{\n");
+	std::printf("  \"rom\": \"%s\",\n", jsonEscape(options.romPath).c_str());
+	std::printf("  \"frames\": %llu,\n", (unsigned long long)frame);
+	std::printf("  \"cycles\": %llu,\n", (unsigned long long)cycles);
+	std::printf("  \"instructions\": %llu,\n", (unsigned long long)gb.instructionCount);
+	std::printf("  \"seconds\": %.6f,\n", seconds);
+	std::printf("  \"fps\": %.2f,\n", seconds > 0 ? frame / seconds : 0.0);
+	std::printf("  \"mips\": %.3f,\n", seconds > 0 ? gb.instructionCount / seconds / 1e6 : 0.0);
+	std::printf("  \"speed\": %.2f,\n", seconds > 0 ? cycles / seconds / 4194304.0 : 0.0);
+	std::printf("  \"haltedPercent\": %.2f,\n", cycles > 0 ? 100.0 * gb.haltedCycles / cycles : 0.0);
+	if (!options.translatedPath.empty())
+	{
+		std::printf("  \"translatedPercent\": %.2f,\n",
+			gb.instructionCount > 0 ? 100.0 * gb.translatedInstructionCount / gb.instructionCount : 0.0);
+	}
+	if (interpreted)
+	{
+		std::printf("  \"interpreterSeconds\": %.6f,\n", interpreted->seconds);
+		std::printf("  \"speedup\": %.3f,\n", seconds > 0 ? interpreted->seconds / seconds : 0.0);
+		std::printf("  \"matchesInterpreter\": %s,\n", matches ? "true" : "false");
+	}
+	std::printf("  \"stopReason\": \"%s\",\n", stopReasonName(run->lastReason));
+	if (hasCondition)
+		std::printf("  \"conditionMet\": %s,\n", run->conditionMet ? "true" : "false");
+	if (run->playing)
+		std::printf("  \"desyncFrame\": %lld,\n", (long long)run->desyncFrame);
+	std::printf("  \"serial\": \"%s\",\n", jsonEscape(run->serial).c_str());
+	std::printf("  \"framebufferHash\": \"%s\",\n", hex64(frameHash).c_str());
+	std::printf("  \"ramHash\": \"%s\"\n", hex64(hashRam(gb.mmu)).c_str());
+	std::printf("}\n");
+
+	if (run->desyncFrame >= 0 || !matches)
+		return 3;
+	return hasCondition && !run->conditionMet ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+// gbtest: runs every rom in a directory headless, in parallel, and reports pass/fail for each.
+//
+// usage: gbtest <dir> [--jobs N] [--timeout seconds] [--filter text] [--hashes file] [--print-hashes]
+//
+// A rom passes or fails as soon as it reports a result in one of the ways the common test suites do:
+//   - serial output containing "Passed" or "Failed" (blargg)
+//   - the blargg memory protocol: signature DE B0 61 at 0xA001, result code at 0xA000 and text from 0xA004
+//   - ld b, b with the fibonacci numbers 3/5/8/13/21/34 in b/c/d/e/h/l, or 0x42 in all of them for a failure. The
+//     same bytes sent over serial work too (mooneye)
+//   - a frame whose hash matches the one listed for the rom in the hash file (dmg-acid2 and other screenshot tests)
+// Roms that do none of these within --timeout emulated seconds (default 120) time out. The hash file defaults to
+// <dir>/hashes.txt, one "<rom path relative to dir> <hex hash>" per line. Hashes are of the emulator's frame buffer,
+// get them with --print-hashes once the output has been checked by eye.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gb.h"
+#include "fileIo.h"
+#include "regs.h"
+
+namespace fs = std::filesystem;
+
+enum Outcome
+{
+	OUTCOME_PASS,
+	OUTCOME_FAIL,
+	OUTCOME_TIMEOUT,
+	OUTCOME_ERROR
+};
+
+struct TestRom
+{
+	fs::path path;
+	std::string name;
+	bool hasExpectedHash = false;
+	uint64_t expectedHash = 0;
+};
+
+struct TestResult
+{
+	Outcome outcome = OUTCOME_ERROR;
+	std::string detail;
+	double seconds = 0.0;
+	double emulatedSeconds = 0.0;
+	uint64_t frameHash = 0;
+};
+
+struct Options
+{
+	fs::path dir;
+	fs::path hashesPath;
+	std::string filter;
+	unsigned int jobs = 0;
+	double timeout = 120.0;
+	bool printHashes = false;
+};
+
+static const uint8_t fibonacci[6] = { 3, 5, 8, 13, 21, 34 };
+
+// last non empty line of the serial output, that is where the test suites put the verdict
+static std::string lastLine(const std::string& text)
+{
+	size_t end = text.find_last_not_of("\r\n ");
+	if (end == std::string::npos)
+		return "";
+
+	size_t start = text.find_last_of('\n', end);
+	start = start == std::string::npos ? 0 : start + 1;
+	return text.substr(start, end - start + 1);
+}
+
+static bool endsWith(const std::string& text, const uint8_t* bytes, size_t count)
+{
+	if (text.size() < count)
+		return false;
+
+	return std::equal(bytes, bytes + count, text.end() - count, [](uint8_t a, char b) { return a == (uint8_t)b; });
+}
+
+// blargg's verdict is only looked at once its line is complete, so the failure detail is not cut short
+static bool checkSerial(const std::string& serial, bool lineComplete, TestResult& result)
+{
+	static const uint8_t mooneyeFail[6] = { 0x42, 0x42, 0x42, 0x42, 0x42, 0x42 };
+
+	if (lineComplete && serial.find("Passed") != std::string::npos)
+		result.outcome = OUTCOME_PASS;
+	else if (lineComplete && serial.find("Failed") != std::string::npos)
+		result.outcome = OUTCOME_FAIL;
+	else if (endsWith(serial, fibonacci, 6))
+		result.outcome = OUTCOME_PASS;
+	else if (endsWith(serial, mooneyeFail, 6))
+		result.outcome = OUTCOME_FAIL;
+	else
+		return false;
+
+	result.detail = result.outcome == OUTCOME_FAIL ? lastLine(serial) : "";
+	return true;
+}
+
+static bool checkRegisters(CPU<SystemBus>& cpu, TestResult& result)
+{
+	const uint8_t regs[6] = { cpu.regs[REG_B], cpu.regs[REG_C], cpu.regs[REG_D], cpu.regs[REG_E], cpu.regs[REG_H],
+		cpu.regs[REG_L] };
+
+	if (std::equal(regs, regs + 6, fibonacci))
+	{
+		result.outcome = OUTCOME_PASS;
+		return true;
+	}
+
+	if (std::all_of(regs, regs + 6, [](uint8_t reg) { return reg == 0x42; }))
+	{
+		result.outcome = OUTCOME_FAIL;
+		result.detail = "ld b, b with failure registers";
+		return true;
+	}
+
+	return false;
+}
+
+static bool checkBlarggMemory(const MMU& mmu, TestResult& result)
+{
+	const CowBuffer& ram = mmu.eRam;
+
+	// 0x80 means still running
+	if (ram.size() < 5 || ram[1] != 0xDE || ram[2] != 0xB0 || ram[3] != 0x61 || ram[0] == 0x80)
+		return false;
+
+	result.outcome = ram[0] == 0 ? OUTCOME_PASS : OUTCOME_FAIL;
+
+	std::string text;
+	for (size_t i = 4; i < ram.size() && ram[i] != 0; i++)
+		text += (char)ram[i];
+
+	result.detail = result.outcome == OUTCOME_FAIL ? lastLine(text) : "";
+	return true;
+}
+
+static TestResult runTest(const TestRom& test, double timeout)
+{
+	TestResult result;
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<uint8_t> rom = readFile(test.path);
+
+	GameBoy gb;
+	if (!gb.loadRom(rom.data(), rom.size()))
+	{
+		result.detail = "could not load rom";
+		return result;
+	}
+
+	gb.stopEvents |= EVENT_SERIAL;
+
+	// ld b, b is how mooneye and dmg-acid2 signal the end of the test
+	auto atLdBB = [&gb](const GameBoy&) { return gb.mmu.read8(gb.cpu.PC) == 0x40; };
+
+	uint64_t maxCycles = (uint64_t)(timeout * DMG_FRAME_RATE) * CYCLES_PER_FRAME;
+	std::string serial;
+	bool done = false;
+
+	while (!done && gb.cpu.tCycles < maxCycles)
+	{
+		RunResult run = gb.runUntil(atLdBB, CYCLES_PER_FRAME);
+
+		if (run.reason == STOP_SERIAL)
+		{
+			serial += (char)gb.mmu.serialOut;
+			done = checkSerial(serial, gb.mmu.serialOut == '\n', result);
+		}
+		else if (run.reason == STOP_PREDICATE)
+		{
+			done = checkRegisters(gb.cpu, result);
+		}
+
+		if (gb.ppu.frameBuffer.acquire())
+		{
+			result.frameHash = gb.ppu.frameBuffer.readHash();
+
+			if (!done && test.hasExpectedHash && result.frameHash == test.expectedHash)
+			{
+				result.outcome = OUTCOME_PASS;
+				done = true;
+			}
+		}
+
+		if (!done && run.reason == STOP_CYCLES)
+			done = checkBlarggMemory(gb.mmu, result);
+	}
+
+	if (!done && !checkSerial(serial, true, result))
+	{
+		result.outcome = OUTCOME_TIMEOUT;
+		result.detail = test.hasExpectedHash ? "frame never matched the expected hash" : lastLine(serial);
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.emulatedSeconds = gb.cpu.tCycles / (DMG_FRAME_RATE * CYCLES_PER_FRAME);
+	return result;
+}
+
+static std::map<std::string, uint64_t> readHashes(const fs::path& path)
+{
+	std::map<std::string, uint64_t> hashes;
+	std::ifstream is(path);
+	std::string line;
+
+	while (std::getline(is, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		size_t split = line.find_last_of(" \t");
+		if (split == std::string::npos)
+			continue;
+
+		std::string name = line.substr(0, line.find_last_not_of(" \t", split) + 1);
+		hashes[name] = std::strtoull(line.c_str() + split + 1, nullptr, 16);
+	}
+
+	return hashes;
+}
+
+static std::vector<TestRom> findRoms(const Options& options)
+{
+	std::map<std::string, uint64_t> hashes = readHashes(options.hashesPath);
+	std::vector<TestRom> roms;
+
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(options.dir))
+	{
+		std::string extension = entry.path().extension().string();
+		if (!entry.is_regular_file() || (extension != ".gb" && extension != ".gbc"))
+			continue;
+
+		TestRom test;
+		test.path = entry.path();
+		test.name = fs::relative(entry.path(), options.dir).generic_string();
+
+		if (!options.filter.empty() && test.name.find(options.filter) == std::string::npos)
+			continue;
+
+		auto it = hashes.find(test.name);
+		if (it != hashes.end())
+		{
+			test.hasExpectedHash = true;
+			test.expectedHash = it->second;
+		}
+
+		roms.push_back(test);
+	}
+
+	std::sort(roms.begin(), roms.end(), [](const TestRom& a, const TestRom& b) { return a.name < b.name; });
+	return roms;
+}
+
+static bool parseArgs(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--jobs" && hasValue)
+			options.jobs = std::atoi(argv[++i]);
+		else if (arg == "--timeout" && hasValue)
+			options.timeout = std::atof(argv[++i]);
+		else if (arg == "--filter" && hasValue)
+			options.filter = argv[++i];
+		else if (arg == "--hashes" && hasValue)
+			options.hashesPath = argv[++i];
+		else if (arg == "--print-hashes")
+			options.printHashes = true;
+		else if (arg[0] != '-' && options.dir.empty())
+			options.dir = arg;
+		else
+			return false;
+	}
+
+	if (options.hashesPath.empty())
+		options.hashesPath = options.dir / "hashes.txt";
+
+	return !options.dir.empty();
+}
+
+static const char* outcomeName(Outcome outcome)
+{
+	switch (outcome)
+	{
+	case OUTCOME_PASS: return "PASS";
+	case OUTCOME_FAIL: return "FAIL";
+	case OUTCOME_TIMEOUT: return "TIMEOUT";
+	case OUTCOME_ERROR: return "ERROR";
+	}
+	return "?";
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseArgs(argc, argv, options) || !fs::is_directory(options.dir))
+	{
+		std::fprintf(stderr, "usage: gbtest <dir> [--jobs N] [--timeout seconds] [--filter text] [--hashes file] "
+			"[--print-hashes]\n");
+		return 2;
+	}
+
+	// the core logs cartridge info through std::cout, results go through stdio
+	std::cout.rdbuf(nullptr);
+
+	std::vector<TestRom> roms = findRoms(options);
+	std::vector<TestResult> results(roms.size());
+
+	unsigned int jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+	jobs = std::min<unsigned int>(jobs, std::max<size_t>(roms.size(), 1));
+
+	std::atomic<size_t> next{ 0 };
+	std::mutex printMutex;
+	auto start = std::chrono::steady_clock::now();
+
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < roms.size(); i = next++)
+		{
+			results[i] = runTest(roms[i], options.timeout);
+			const TestResult& result = results[i];
+
+			std::lock_guard<std::mutex> lock(printMutex);
+			std::printf("%-7s %s (%.2fs, %.1f emulated)%s%s", outcomeName(result.outcome), roms[i].name.c_str(),
+				result.seconds, result.emulatedSeconds, result.detail.empty() ? "" : ": ", result.detail.c_str());
+			if (options.printHashes)
+				std::printf(" hash %016llx", (unsigned long long)result.frameHash);
+			std::printf("\n");
+			std::fflush(stdout);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < jobs; i++)
+		threads.emplace_back(worker);
+	for (std::thread& thread : threads)
+		thread.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t passed = std::count_if(results.begin(), results.end(),
+		[](const TestResult& result) { return result.outcome == OUTCOME_PASS; });
+
+	std::printf("\n%zu/%zu passed in %.2fs using %u threads\n", passed, results.size(), seconds, jobs);
+
+	for (size_t i = 0; i < roms.size(); i++)
+	{
+		if (results[i].outcome != OUTCOME_PASS)
+			std::printf("  %-7s %s\n", outcomeName(results[i].outcome), roms[i].name.c_str());
+	}
+
+	return passed == results.size() ? 0 : 1;
+}
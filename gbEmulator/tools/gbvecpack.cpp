@@ -0,0 +1,177 @@
+// gbvecpack: packs the SingleStepTests sm83 json files ("00.json" ... "cb ff.json") into the binary vector file that
+// cputest maps. Parsing the json is by far the slowest part of running the corpus, this way it is done once.
+//
+// usage: gbvecpack <json dir> <output file>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "bus.h"
+#include "testVectors.h"
+
+namespace fs = std::filesystem;
+
+static bool readState(const nlohmann::json& json, VectorState& state, std::string& error)
+{
+	state.pc = json.value("pc", 0);
+	state.sp = json.value("sp", 0);
+	state.a = json.value("a", 0);
+	state.b = json.value("b", 0);
+	state.c = json.value("c", 0);
+	state.d = json.value("d", 0);
+	state.e = json.value("e", 0);
+	state.f = json.value("f", 0);
+	state.h = json.value("h", 0);
+	state.l = json.value("l", 0);
+	state.ime = json.value("ime", 0);
+	state.ie = json.value("ie", 0);
+
+	const nlohmann::json& ram = json.at("ram");
+	if (ram.size() > VECTOR_MAX_RAM)
+	{
+		error = "more than " + std::to_string(VECTOR_MAX_RAM) + " ram entries";
+		return false;
+	}
+
+	state.ramCount = (uint8_t)ram.size();
+	for (size_t i = 0; i < ram.size(); i++)
+	{
+		state.ram[i].address = ram[i][0].get<uint16_t>();
+		state.ram[i].value = ram[i][1].get<uint8_t>();
+	}
+
+	return true;
+}
+
+// cycles are [address, value, "r-m" / "-wm" / "---"], internal cycles can also be null
+static bool readCycles(const nlohmann::json& json, Vector& vector, std::string& error)
+{
+	if (json.size() > VECTOR_MAX_CYCLES)
+	{
+		error = "more than " + std::to_string(VECTOR_MAX_CYCLES) + " cycles";
+		return false;
+	}
+
+	vector.cycleCount = (uint8_t)json.size();
+	for (size_t i = 0; i < json.size(); i++)
+	{
+		const nlohmann::json& cycle = json[i];
+		VectorCycle& out = vector.cycles[i];
+
+		if (!cycle.is_array() || cycle.size() < 3 || !cycle[2].is_string())
+		{
+			out.type = BUS_IDLE;
+			continue;
+		}
+
+		std::string pins = cycle[2];
+		if (pins.find('r') != std::string::npos)
+			out.type = BUS_READ;
+		else if (pins.find('w') != std::string::npos)
+			out.type = BUS_WRITE;
+		else
+			out.type = BUS_IDLE;
+
+		if (out.type != BUS_IDLE)
+		{
+			out.address = cycle[0].is_number() ? cycle[0].get<uint16_t>() : 0;
+			out.value = cycle[1].is_number() ? cycle[1].get<uint8_t>() : 0;
+		}
+	}
+
+	return true;
+}
+
+static std::string opcodeFileName(int index)
+{
+	char name[16];
+	std::snprintf(name, sizeof(name), index < 0x100 ? "%02x.json" : "cb %02x.json", index & 0xFF);
+	return name;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "usage: gbvecpack <json dir> <output file>\n";
+		return 2;
+	}
+
+	fs::path dir = argv[1];
+
+	VectorFileHeader header{};
+	header.magic = VECTOR_MAGIC;
+	header.version = VECTOR_VERSION;
+
+	std::vector<Vector> vectors;
+
+	for (int index = 0; index < VECTOR_OPCODES; index++)
+	{
+		fs::path path = dir / opcodeFileName(index);
+		std::ifstream is(path);
+		if (!is)
+			continue;
+
+		header.opcodes[index].first = (uint32_t)vectors.size();
+
+		try
+		{
+			nlohmann::json tests;
+			is >> tests;
+
+			for (const nlohmann::json& test : tests)
+			{
+				Vector vector{};
+				std::string name = test.value("name", "");
+				std::strncpy(vector.name, name.c_str(), sizeof(vector.name) - 1);
+
+				std::string error;
+				if (!readState(test.at("initial"), vector.initial, error)
+					|| !readState(test.at("final"), vector.final, error)
+					|| !readCycles(test.at("cycles"), vector, error))
+				{
+					std::cerr << path.string() << " \"" << name << "\": " << error << "\n";
+					return 1;
+				}
+
+				vectors.push_back(vector);
+			}
+		}
+		catch (const nlohmann::json::exception& e)
+		{
+			std::cerr << path.string() << ": " << e.what() << "\n";
+			return 1;
+		}
+
+		header.opcodes[index].count = (uint32_t)vectors.size() - header.opcodes[index].first;
+	}
+
+	if (vectors.empty())
+	{
+		std::cerr << "gbvecpack: no test files found in " << dir.string() << "\n";
+		return 1;
+	}
+
+	header.vectorCount = (uint32_t)vectors.size();
+
+	std::ofstream os(argv[2], std::ofstream::binary);
+	os.write((const char*)&header, sizeof(header));
+	os.write((const char*)vectors.data(), vectors.size() * sizeof(Vector));
+
+	if (!os)
+	{
+		std::cerr << "gbvecpack: could not write " << argv[2] << "\n";
+		return 1;
+	}
+
+	std::cout << "packed " << vectors.size() << " vectors (" << (sizeof(header) + vectors.size() * sizeof(Vector)) / 1024
+		<< " KiB)\n";
+	return 0;
+}
@@ -0,0 +1,388 @@
+// gbverify: runs roms on the reference interpreter and on fast paths side by side and reports the first place they
+// stop matching (src/verifier.h). Headless, a directory of roms is verified in parallel like gbtest does.
+//
+// usage: gbverify <rom or dir> [--translated plugin | --translated-dir dir] [--clone] [--save-state]
+//                 [--per-instruction] [--frames N] [--movie file] [--seed N] [--trace N] [--jobs N] [--out dir]
+//
+// The fast paths are code translated by gb2cpp (--translated for one rom, --translated-dir for the plugins
+// gb_add_translated_rom builds, <rom name>_translated next to the tools), instances going on as clones of themselves
+// (--clone) and instances going on from their own save states (--save-state). Without any of them --clone and
+// --save-state are checked. Roms without a plugin in --translated-dir are skipped.
+//
+// Every rom runs --frames frames (default 600) with pseudo random buttons from --seed, or with the buttons of
+// --movie, which also sets the start state and the frame count unless --frames is given. The full state hashes are
+// compared after every frame, or every instruction with --per-instruction. When a rom diverges the state pair is
+// written to <out>/<rom>.reference.state and <out>/<rom>.fast.state (save states, GameBoy::loadState reads them) and
+// what differs with the last --trace instructions (default 32) of both sides to <out>/<rom>.txt. out defaults to
+// verify. The exit code is 1 if any rom diverged or couldn't be run.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gb.h"
+#include "fileIo.h"
+#include "hash.h"
+#include "movie.h"
+#include "regs.h"
+#include "verifier.h"
+
+namespace fs = std::filesystem;
+
+#if defined(_WIN32)
+#define PLUGIN_SUFFIX ".dll"
+#else
+#define PLUGIN_SUFFIX ".so"
+#endif
+
+#define DEFAULT_FRAMES 600
+
+enum Outcome
+{
+	OUTCOME_MATCH,
+	OUTCOME_DIVERGED,
+	OUTCOME_SKIPPED,
+	OUTCOME_ERROR
+};
+
+struct VerifyRom
+{
+	fs::path path;
+	std::string name;
+	fs::path translatedPath;
+};
+
+struct VerifyResult
+{
+	Outcome outcome = OUTCOME_ERROR;
+	std::string detail;
+	uint64_t frames = 0;
+	double seconds = 0.0;
+};
+
+struct Options
+{
+	fs::path path;
+	fs::path translatedPath;
+	fs::path translatedDir;
+	fs::path moviePath;
+	fs::path outDir = "verify";
+	uint32_t engines = 0;
+	bool perInstruction = false;
+	int frames = 0;
+	uint32_t seed = 1;
+	size_t traceWindow = 32;
+	unsigned int jobs = 0;
+};
+
+// the name gb_add_translated_rom gives the plugin of a rom: tetris.gb -> tetris_translated
+static fs::path pluginFor(const fs::path& dir, const fs::path& rom)
+{
+	std::string name = rom.stem().string();
+	for (char& c : name)
+	{
+		if (!std::isalnum((unsigned char)c))
+			c = '_';
+	}
+	if (name.empty() || std::isdigit((unsigned char)name[0]))
+		name = "_" + name;
+
+	return dir / (name + "_translated" PLUGIN_SUFFIX);
+}
+
+static void writeTrace(std::ofstream& os, const char* side, const std::vector<TraceEntry>& trace)
+{
+	os << side << ":\n";
+	os << "  instr     tCycles   pc   sp   a  f  b  c  d  e  h  l ime halt stateHash\n";
+
+	for (const TraceEntry& entry : trace)
+	{
+		char line[160];
+		std::snprintf(line, sizeof(line),
+			"  %5llu %11llu %04X %04X  %02X %02X %02X %02X %02X %02X %02X %02X  %d   %d   %016llx\n",
+			(unsigned long long)entry.instruction, (unsigned long long)entry.cycles, entry.pc, entry.sp,
+			entry.regs[REG_A], entry.regs[REG_F], entry.regs[REG_B], entry.regs[REG_C], entry.regs[REG_D],
+			entry.regs[REG_E], entry.regs[REG_H], entry.regs[REG_L], entry.ime, entry.halted,
+			(unsigned long long)entry.stateHash);
+		os << line;
+	}
+}
+
+static bool dumpDivergence(const fs::path& outDir, const std::string& name, const Divergence& divergence)
+{
+	// roms in subdirectories get flat names
+	std::string flat = name;
+	std::replace(flat.begin(), flat.end(), '/', '_');
+
+	std::error_code error;
+	fs::create_directories(outDir, error);
+
+	std::ofstream os(outDir / (flat + ".txt"));
+	os << name << " diverged in frame " << divergence.frame;
+	if (divergence.instruction >= 0)
+		os << " after instruction " << divergence.instruction << " of the frame\n";
+	else
+		os << " at the end of the frame, running it one instruction at a time didn't diverge\n";
+	os << "\nreference vs fast:\n" << divergence.differences << "\n";
+	writeTrace(os, "reference", divergence.referenceTrace);
+	os << "\n";
+	writeTrace(os, "fast", divergence.fastTrace);
+
+	return (bool)os && writeFile(outDir / (flat + ".reference.state"), divergence.referenceState)
+		&& writeFile(outDir / (flat + ".fast.state"), divergence.fastState);
+}
+
+static VerifyResult verifyRom(const VerifyRom& rom, const Options& options, const Movie* movie)
+{
+	VerifyResult result;
+	auto start = std::chrono::steady_clock::now();
+
+	VerifyConfig config;
+	config.engines = options.engines;
+	config.translatedPath = rom.translatedPath.string();
+	config.perInstruction = options.perInstruction;
+	config.traceWindow = options.traceWindow;
+
+	if ((config.engines & VERIFY_TRANSLATED) && !fs::exists(rom.translatedPath))
+	{
+		result.outcome = OUTCOME_SKIPPED;
+		result.detail = "no translated code";
+		return result;
+	}
+
+	std::vector<uint8_t> data = readFile(rom.path);
+	Verifier verifier(config);
+	if (!verifier.loadRom(data.data(), data.size()))
+	{
+		result.detail = config.engines & VERIFY_TRANSLATED ? "could not load the rom or its translated code"
+			: "could not load rom";
+		return result;
+	}
+
+	int frames = options.frames ? options.frames : DEFAULT_FRAMES;
+	if (movie)
+	{
+		if (movie->romHash != hashBytes(data.data(), data.size()))
+		{
+			result.detail = "the movie was recorded with another rom";
+			return result;
+		}
+		if (!movie->startState.empty() && !verifier.loadState(movie->startState.data(), movie->startState.size()))
+		{
+			result.detail = "could not load the movie's start state";
+			return result;
+		}
+		if (!options.frames)
+			frames = (int)movie->frames();
+	}
+
+	// buttons held for 8 frames at a time, so games see presses and releases
+	uint32_t random = options.seed;
+	uint8_t buttons = 0;
+	for (int i = 0; i < frames; i++)
+	{
+		if (movie)
+		{
+			buttons = (size_t)i < movie->frames() ? movie->buttons[i] : 0;
+		}
+		else if (i % 8 == 0)
+		{
+			random = random * 1664525 + 1013904223;
+			buttons = (random >> 24) & 0xFF;
+		}
+
+		if (!verifier.runFrame(buttons))
+			break;
+	}
+
+	result.frames = verifier.frames();
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const Divergence* divergence = verifier.divergence();
+	if (!divergence)
+	{
+		result.outcome = OUTCOME_MATCH;
+		return result;
+	}
+
+	result.outcome = OUTCOME_DIVERGED;
+	result.detail = "frame " + std::to_string(divergence->frame);
+	if (divergence->instruction >= 0)
+		result.detail += " instruction " + std::to_string(divergence->instruction);
+	result.detail += dumpDivergence(options.outDir, rom.name, *divergence) ? ", dumped to " + options.outDir.string()
+		: ", could not write the dump to " + options.outDir.string();
+	return result;
+}
+
+static std::vector<VerifyRom> findRoms(const Options& options)
+{
+	std::vector<VerifyRom> roms;
+
+	if (!fs::is_directory(options.path))
+	{
+		VerifyRom rom;
+		rom.path = options.path;
+		rom.name = options.path.filename().string();
+		rom.translatedPath = options.translatedDir.empty() ? options.translatedPath
+			: pluginFor(options.translatedDir, rom.path);
+		roms.push_back(rom);
+		return roms;
+	}
+
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(options.path))
+	{
+		std::string extension = entry.path().extension().string();
+		if (!entry.is_regular_file() || (extension != ".gb" && extension != ".gbc"))
+			continue;
+
+		VerifyRom rom;
+		rom.path = entry.path();
+		rom.name = fs::relative(entry.path(), options.path).generic_string();
+		if (!options.translatedDir.empty())
+			rom.translatedPath = pluginFor(options.translatedDir, rom.path);
+		roms.push_back(rom);
+	}
+
+	std::sort(roms.begin(), roms.end(), [](const VerifyRom& a, const VerifyRom& b) { return a.name < b.name; });
+	return roms;
+}
+
+static bool parseArgs(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--translated" && hasValue)
+			options.translatedPath = argv[++i];
+		else if (arg == "--translated-dir" && hasValue)
+			options.translatedDir = argv[++i];
+		else if (arg == "--clone")
+			options.engines |= VERIFY_CLONE;
+		else if (arg == "--save-state")
+			options.engines |= VERIFY_SAVE_STATE;
+		else if (arg == "--per-instruction")
+			options.perInstruction = true;
+		else if (arg == "--frames" && hasValue)
+			options.frames = std::atoi(argv[++i]);
+		else if (arg == "--movie" && hasValue)
+			options.moviePath = argv[++i];
+		else if (arg == "--seed" && hasValue)
+			options.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 0);
+		else if (arg == "--trace" && hasValue)
+			options.traceWindow = std::strtoul(argv[++i], nullptr, 0);
+		else if (arg == "--jobs" && hasValue)
+			options.jobs = std::atoi(argv[++i]);
+		else if (arg == "--out" && hasValue)
+			options.outDir = argv[++i];
+		else if (arg[0] != '-' && options.path.empty())
+			options.path = arg;
+		else
+			return false;
+	}
+
+	// a single plugin only fits a single rom
+	if (!options.translatedPath.empty() && (!options.translatedDir.empty() || fs::is_directory(options.path)))
+		return false;
+
+	if (!options.translatedPath.empty() || !options.translatedDir.empty())
+		options.engines |= VERIFY_TRANSLATED;
+	else if (options.engines == 0)
+		options.engines = VERIFY_CLONE | VERIFY_SAVE_STATE;
+
+	return !options.path.empty() && fs::exists(options.path);
+}
+
+static const char* outcomeName(Outcome outcome)
+{
+	switch (outcome)
+	{
+	case OUTCOME_MATCH: return "MATCH";
+	case OUTCOME_DIVERGED: return "DIVERGED";
+	case OUTCOME_SKIPPED: return "SKIP";
+	case OUTCOME_ERROR: return "ERROR";
+	}
+	return "?";
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseArgs(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: gbverify <rom or dir> [--translated plugin | --translated-dir dir] [--clone] "
+			"[--save-state] [--per-instruction] [--frames N] [--movie file] [--seed N] [--trace N] [--jobs N] "
+			"[--out dir]\n");
+		return 2;
+	}
+
+	Movie movie;
+	bool hasMovie = !options.moviePath.empty();
+	if (hasMovie && (fs::is_directory(options.path) || !movie.load(options.moviePath.string())))
+	{
+		std::fprintf(stderr, "gbverify: --movie needs a single rom and a movie file\n");
+		return 2;
+	}
+
+	// the core logs cartridge info through std::cout, results go through stdio
+	std::cout.rdbuf(nullptr);
+
+	std::vector<VerifyRom> roms = findRoms(options);
+	std::vector<VerifyResult> results(roms.size());
+
+	unsigned int jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+	jobs = std::min<unsigned int>(jobs, std::max<size_t>(roms.size(), 1));
+
+	std::atomic<size_t> next{ 0 };
+	std::mutex printMutex;
+	auto start = std::chrono::steady_clock::now();
+
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < roms.size(); i = next++)
+		{
+			results[i] = verifyRom(roms[i], options, hasMovie ? &movie : nullptr);
+			const VerifyResult& result = results[i];
+
+			std::lock_guard<std::mutex> lock(printMutex);
+			std::printf("%-8s %s (%llu frames, %.2fs)%s%s\n", outcomeName(result.outcome), roms[i].name.c_str(),
+				(unsigned long long)result.frames, result.seconds, result.detail.empty() ? "" : ": ",
+				result.detail.c_str());
+			std::fflush(stdout);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < jobs; i++)
+		threads.emplace_back(worker);
+	for (std::thread& thread : threads)
+		thread.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	auto count = [&results](Outcome outcome)
+	{
+		return std::count_if(results.begin(), results.end(),
+			[outcome](const VerifyResult& result) { return result.outcome == outcome; });
+	};
+	size_t matched = count(OUTCOME_MATCH);
+	size_t skipped = count(OUTCOME_SKIPPED);
+
+	std::printf("\n%zu/%zu matched", matched, results.size() - skipped);
+	if (skipped)
+		std::printf(", %zu skipped", skipped);
+	std::printf(" in %.2fs using %u threads\n", seconds, jobs);
+
+	return matched + skipped == results.size() ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cinttypes>
+#include <initializer_list>
+#include <vector>
+
+// Tiny helper to put test and benchmark roms together in code. Bytes are emitted at a cursor, jumps take absolute
+// target addresses, and the header is filled in so the core accepts the image. Execution starts at 0x150.
+class RomBuilder
+{
+public:
+	// cartType and romSizeCode are the header bytes at 0x147 and 0x148
+	RomBuilder(uint8_t cartType = 0x00, uint8_t romSizeCode = 0x00)
+		: rom(0x8000u << romSizeCode, 0x00)
+	{
+		rom[0x100] = 0x00; // nop
+		rom[0x101] = 0xC3; // jp 0x150
+		rom[0x102] = 0x50;
+		rom[0x103] = 0x01;
+		rom[0x147] = cartType;
+		rom[0x148] = romSizeCode;
+		rom[0x149] = 0x00;
+		cursor = 0x150;
+	}
+
+	uint16_t here() const { return cursor; }
+
+	RomBuilder& org(uint32_t address)
+	{
+		cursor = address;
+		return *this;
+	}
+
+	RomBuilder& emit(std::initializer_list<uint8_t> bytes)
+	{
+		for (uint8_t byte : bytes)
+			rom[cursor++] = byte;
+		return *this;
+	}
+
+	RomBuilder& emit(const std::vector<uint8_t>& bytes)
+	{
+		for (uint8_t byte : bytes)
+			rom[cursor++] = byte;
+		return *this;
+	}
+
+	// opcode is 0x18 (jr), 0x20 (jr nz), 0x28 (jr z), 0x30 (jr nc) or 0x38 (jr c)
+	RomBuilder& jr(uint8_t opcode, uint16_t target)
+	{
+		int offset = (int)target - (int)(cursor + 2);
+		return emit({ opcode, (uint8_t)(int8_t)offset });
+	}
+
+	RomBuilder& jp(uint16_t target) { return emit({ 0xC3, lo(target), hi(target) }); }
+	RomBuilder& call(uint16_t target) { return emit({ 0xCD, lo(target), hi(target) }); }
+
+	// ld a, value / ldh (reg), a
+	RomBuilder& writeIo(uint8_t reg, uint8_t value) { return emit({ 0x3E, value, 0xE0, reg }); }
+
+	// di, stack at the top of hram, lcd off, usual background palette
+	RomBuilder& prologue()
+	{
+		emit({ 0xF3, 0x31, 0xFE, 0xFF });
+		return writeIo(0x40, 0x00).writeIo(0x47, 0xE4);
+	}
+
+	// fills count bytes at dst with value using a cpu loop (clobbers a, bc, hl)
+	RomBuilder& memset(uint16_t dst, uint8_t value, uint16_t count)
+	{
+		emit({ 0x21, lo(dst), hi(dst), 0x01, lo(count), hi(count) });
+		uint16_t loop = here();
+		emit({ 0x3E, value, 0x22, 0x0B, 0x78, 0xB1 }); // ld a, value / ld (hl+), a / dec bc / ld a, b / or c
+		return jr(0x20, loop);
+	}
+
+	// copies count bytes from src to dst using a cpu loop (clobbers a, bc, de, hl)
+	RomBuilder& memcpy(uint16_t dst, uint16_t src, uint16_t count)
+	{
+		emit({ 0x21, lo(src), hi(src), 0x11, lo(dst), hi(dst), 0x01, lo(count), hi(count) });
+		uint16_t loop = here();
+		emit({ 0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1 }); // ld a, (hl+) / ld (de), a / inc de / dec bc / ld a, b / or c
+		return jr(0x20, loop);
+	}
+
+	// writes raw data somewhere in the rom without moving the cursor
+	void place(uint32_t address, const std::vector<uint8_t>& bytes)
+	{
+		for (size_t i = 0; i < bytes.size(); i++)
+			rom[address + i] = bytes[i];
+	}
+
+	std::vector<uint8_t> rom;
+
+	static uint8_t lo(uint16_t value) { return value & 0xFF; }
+	static uint8_t hi(uint16_t value) { return value >> 8; }
+
+private:
+	uint32_t cursor;
+};